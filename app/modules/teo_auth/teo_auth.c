@@ -1,323 +1,598 @@
-/** 
+/**
  * File:   teo_auth.c
  * Author: Kirill Scherba <kirill@scherba.ru>
- * 
+ *
  * Module to connect to Authentication server AuthPrototype
  *
+ * Authentication commands are sent to authentication server by the
+ * authentication thread, which executes up to max_transfers requests at once
+ * with curl multi interface. Answers are returned to the event loop and
+ * callbacks are called in the event loop thread.
+ *
+ * Token verification commands ("login", "me") are coalesced: identical
+ * commands received while the request is in flight wait the same answer.
+ * Successful answers of these commands are cached for cache_ttl seconds.
+ *
  * Created on December 1, 2015, 1:51 PM
  */
 
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <curl/curl.h>
 
 #include "teo_auth.h"
 #include "conf.h"
+#include "../teo_web/teo_web.h"
 
+#define TEO_AUTH_TIMEOUT 30L ///< Authentication server request timeout, sec
 
-static int teoAuthProccess(teoAuthClass *ta, const char *method, 
-        const char *url, const char *data, const char *header, 
-        void *nc_p, command_callback callback);
+/**
+ * C string implementation data structure
+ */
+struct string {
 
-static int send_request(char *url, void *data, size_t data_len, char *header, 
-        void *nc_p, command_callback callback);
+  char *ptr;
+  size_t len;
+
+};
 
 /**
- * Authentication module thread function
- * 
- * @param kh Pointer to ksnetEvMgrClass
- * 
- * @return 
+ * Command waiting for authentication server answer
  */
-static void* auth_thread(void *ta_p) {
+typedef struct teoAuthWaiter {
 
-    printf("Starting authentication thread ...\n");
-    
-    teoAuthClass *ta = ta_p;
-    ta->stopped = 0;
-    ta->stop = 0;
-    
-    pthread_mutex_lock(&ta->cv_mutex);
-    for (;;) {
-        
-        printf("Authentication thread wait signal\n");
-        ta->running = 0;
-        pthread_cond_wait(&ta->cv_threshold, &ta->cv_mutex); 
-        ta->running = 1;
-        printf("Authentication thread got signal\n");            
-        if(ta->stop) break;
-        
-        // Get first element from list and process it
-        while(!pblListIsEmpty(ta->list)) {
-            teoAuthData *element = pblListRemove(ta->list);
-            if(element != (void*)-1 && element != NULL) {
-                teoAuthProccess(ta, element->method, element->url, 
-                        element->data,  element->headers, 
-                        element->nc_p, element->callback);
-            }
-        }
-    }
-    pthread_mutex_unlock(&ta->cv_mutex);
-    
-    printf("Authentication thread stopped\n");
-    
-    ta->stopped = 1;
-    ta->running = 0;
-    
-    return NULL;
+    struct teoAuthWaiter *next;
+    void *nc_p;
+    command_callback callback; ///< Answer callback or NULL if canceled
+
+} teoAuthWaiter;
+
+/**
+ * Authentication server request
+ */
+typedef struct teoAuthRequest {
+
+    struct teoAuthRequest *next; ///< Next request in queue, transfers or done list
+    struct teoAuthRequest *pending_next; ///< Next not answered request
+
+    char *key; ///< Request key if request is coalesced and cached or NULL
+    size_t key_len; ///< Request key length
+    char *url; ///< Full request URL
+    char *data; ///< POST data
+    char *header; ///< Request header
+    teoAuthWaiter *waiters; ///< Commands waiting this request answer
+
+    double queued; ///< Time request was queued
+    double started; ///< Time request was started by curl
+
+    CURL *curl; ///< Curl easy handle while request is executed
+    struct curl_slist *headers; ///< Curl request headers
+    CURLcode res; ///< Curl result
+    long http_code; ///< HTTP response code
+    struct string s; ///< HTTP response
+
+} teoAuthRequest;
+
+/**
+ * Cached authentication server answer
+ */
+typedef struct teoAuthCacheData {
+
+    double expire; ///< Answer expire time
+    char result[]; ///< Answer sent to client
+
+} teoAuthCacheData;
+
+/**
+ * Valid authentication commands
+ */
+static const char *auth_urls[] = {
+    "register-client", "register", "login", "refresh", "restore",
+    "change-password",
+    "me", // Method GET and without Data
+    NULL
+};
+
+/**
+ * Authentication commands which answers are coalesced and cached
+ */
+static const char *cached_urls[] = { "login", "me", NULL };
+
+static void* auth_thread(void *ta_p);
+static void auth_done_cb(struct ev_loop *loop, ev_async *w, int revents);
+static void init_string(struct string *s);
+
+/**
+ * Check url is in list
+ *
+ * @param list NULL terminated list of urls
+ * @param url
+ *
+ * @return True if url is in list
+ */
+static int url_in_list(const char **list, const char *url) {
+
+    for(; *list != NULL; list++) if(!strcmp(*list, url)) return 1;
+    return 0;
 }
 
 /**
- * Send signal to authentication thread
- * 
- * @param ta
+ * Wake up authentication thread
+ *
+ * @param ta Pointer to teoAuthClass
  */
 static void auth_thread_signal(teoAuthClass *ta) {
-    
-    // Send signal to Authentication thread
-    if(!ta->stopped && !ta->running) {
-        
-        pthread_mutex_lock(&ta->cv_mutex);
-        printf("Send signal to Authentication thread\n");
-        pthread_cond_signal(&ta->cv_threshold);
-        pthread_mutex_unlock(&ta->cv_mutex);
+
+    char c = 0;
+    if(write(ta->wake_fd[1], &c, 1) < 0) {
+        // Pipe is full: thread is woken up already
     }
 }
 
 /**
  * Initialize Teonet authenticate module
- * 
- * @return 
+ *
+ * @param kh Pointer to ksnHTTPClass
+ *
+ * @return Pointer to teoAuthClass
  */
 teoAuthClass *teoAuthInit(ksnHTTPClass *kh) {
-    
-    teoAuthClass *ta = malloc(sizeof(teoAuthClass));
-    ta->list = pblListNewArrayList();
-    ta->kh = kh;
-    
-    // In windows, this will initialize the winsock stuff 
+
+    ksnetEvMgrClass *ke = kh->ke;
+    teoAuthClass *ta = teoAuthNew(ke->ev_loop, kh->conf->auth_server_url,
+            kh->conf->auth_transfers, kh->conf->auth_cache_ttl,
+            ke->tm != NULL ? teoMetricGetRegistry(ke->tm) : NULL);
+    if(ta != NULL) ta->kh = kh;
+
+    return ta;
+}
+
+/**
+ * Create Teonet authenticate module
+ *
+ * @param loop Event loop to call answer callbacks in
+ * @param server_url Authentication server URL
+ * @param max_transfers Number of concurrent requests, 0 - default
+ * @param cache_ttl Verified tokens cache TTL, sec; 0 - don't cache
+ * @param mr Metrics registry or NULL
+ *
+ * @return Pointer to teoAuthClass, should be destroyed with teoAuthDestroy
+ */
+teoAuthClass *teoAuthNew(struct ev_loop *loop, const char *server_url,
+        int max_transfers, double cache_ttl, teoMetricRegistry *mr) {
+
+    teoAuthClass *ta = calloc(1, sizeof(teoAuthClass));
+    ta->loop = loop;
+    ta->server_url = strdup(server_url);
+    ta->max_transfers = max_transfers > 0 ? max_transfers : TEO_AUTH_TRANSFERS;
+    ta->cache_ttl = cache_ttl > 0 ? cache_ttl : 0;
+    ta->cache = teoHashMapNew();
+    ta->in_flight = teoHashMapNew();
+
+    // In windows, this will initialize the winsock stuff
     CURLcode res = curl_global_init(CURL_GLOBAL_DEFAULT);
-    // Check for errors 
+    // Check for errors
     if(res != CURLE_OK) {
-        fprintf(stderr, "curl_global_init() failed: %s\n", 
+        fprintf(stderr, "curl_global_init() failed: %s\n",
                 curl_easy_strerror(res));
         //return 1;
     }
-    
-    // Initialize mutex
-    pthread_cond_init(&ta->cv_threshold, NULL);
-    pthread_mutex_init(&ta->async_mutex, NULL);
-    pthread_mutex_init(&ta->cv_mutex, NULL);
-     
+
+    // Register metrics
+    ta->mr = mr;
+    memset(&ta->m, -1, sizeof(ta->m));
+    if(mr != NULL) {
+        ta->m.requests = teoMetricRegisterCounter(mr,
+                "teoweb_auth_requests_total",
+                "Requests sent to authentication server");
+        ta->m.cache_hits = teoMetricRegisterCounter(mr,
+                "teoweb_auth_cache_hits_total",
+                "Authentication commands answered from cache");
+        ta->m.coalesced = teoMetricRegisterCounter(mr,
+                "teoweb_auth_coalesced_total",
+                "Authentication commands joined to request in flight");
+        ta->m.errors = teoMetricRegisterCounter(mr,
+                "teoweb_auth_errors_total",
+                "Failed authentication server requests");
+        ta->m.queue_depth = teoMetricRegisterGauge(mr,
+                "teoweb_auth_queue_depth",
+                "Authentication requests waiting for free transfer");
+        ta->m.transfers = teoMetricRegisterGauge(mr,
+                "teoweb_auth_transfers",
+                "Authentication requests executed now");
+        ta->m.queue_wait = teoMetricRegisterHistogram(mr,
+                "teoweb_auth_queue_wait_seconds",
+                "Authentication request wait time", 1e-9);
+        ta->m.latency = teoMetricRegisterHistogram(mr,
+                "teoweb_auth_latency_seconds",
+                "Authentication server answer time", 1e-9);
+    }
+
+    // Answers watcher
+    ev_async_init(&ta->done_w, auth_done_cb);
+    ta->done_w.data = ta;
+    ev_async_start(loop, &ta->done_w);
+
+    // Authentication thread wake up pipe
+    if(pipe(ta->wake_fd) == -1) {
+        fprintf(stderr, "Can't create Authentication thread pipe\n");
+        ta->wake_fd[0] = ta->wake_fd[1] = -1;
+    }
+    else {
+        fcntl(ta->wake_fd[0], F_SETFL, O_NONBLOCK);
+        fcntl(ta->wake_fd[1], F_SETFL, O_NONBLOCK);
+    }
+
     // Start authentication module thread
+    pthread_mutex_init(&ta->async_mutex, NULL);
     int err = pthread_create(&ta->tid, NULL, auth_thread, (void*)ta);
     if (err != 0) printf("Can't create Authentication thread :[%s]\n", strerror(err));
     else printf("Authentication thread created successfully\n");
-    
+
     return ta;
 }
 
 /**
- * Store authentication command in list
- * 
- * @param ta Pointer to teoAuthClass
- * @param method
+ * Make key of coalesced and cached command
+ *
  * @param url
  * @param data
  * @param headers
- * @param nc_p
- * @param callback
- * 
- * @return 
+ * @param key_len [out] Key length
+ *
+ * @return Key, should be free
  */
-int teoAuthProcessCommand(teoAuthClass *ta, const char *method, const char *url, 
-        const char *data, const char *headers, void *nc_p, 
-        command_callback callback) {
-    
-    // Create element and store it in list
-    teoAuthData *element = malloc(sizeof(teoAuthData));
-    //
-    element->method = strdup(method);
-    element->url = strdup(url);
-    element->data = strdup(data);
-    element->headers = strdup(headers);
-    element->callback = callback;
-    element->nc_p = nc_p;
-    //
-    pthread_mutex_lock (&ta->async_mutex);
-    pblListAdd(ta->list, element);
-    pthread_mutex_unlock (&ta->async_mutex);
-    
-    // Send signal to Authentication thread
-    auth_thread_signal(ta);
+static char *make_key(const char *url, const char *data, const char *headers,
+        size_t *key_len) {
 
-    return 1;
+    size_t url_len = strlen(url) + 1, data_len = strlen(data) + 1,
+           headers_len = strlen(headers) + 1;
+
+    char *key = malloc(url_len + data_len + headers_len);
+    memcpy(key, url, url_len);
+    memcpy(key + url_len, data, data_len);
+    memcpy(key + url_len + data_len, headers, headers_len);
+    *key_len = url_len + data_len + headers_len;
+
+    return key;
+}
+
+/**
+ * Get answer from cache
+ *
+ * @param ta Pointer to teoAuthClass
+ * @param key
+ * @param key_len
+ *
+ * @return Cached answer or NULL if absent or expired
+ */
+static const char *cache_get(teoAuthClass *ta, const char *key,
+        size_t key_len) {
+
+    teoHashMapEntry *e = teoHashMapGetEntry(ta->cache, key, key_len);
+    if(e == NULL) return NULL;
+
+    teoAuthCacheData *cd = e->data;
+    if(cd->expire > ev_now(ta->loop)) return cd->result;
+    teoHashMapRemoveEntry(ta->cache, e);
+
+    return NULL;
 }
 
 /**
- * Free teonet authentication data element
- * 
- * @param element
- * @return 
+ * Add answer to cache
+ *
+ * All answers have the same TTL, so the cache list is ordered by expire
+ * time: expired answers and, when cache is full, the first answer are removed
+ * from the list head.
+ *
+ * @param ta Pointer to teoAuthClass
+ * @param key
+ * @param key_len
+ * @param result Answer
  */
-static void teoAuthDataFree(teoAuthData *element) {
-    
-    free(element->method);
-    free(element->url);
-    free(element->data);
-    free(element->headers);
+static void cache_add(teoAuthClass *ta, const char *key, size_t key_len,
+        const char *result) {
+
+    double now = ev_now(ta->loop);
+
+    // Replaced answer is moved to the list end
+    teoHashMapRemove(ta->cache, key, key_len);
+    while(ta->cache->first != NULL &&
+            (teoHashMapSize(ta->cache) >= TEO_AUTH_CACHE_SIZE ||
+             ((teoAuthCacheData *)ta->cache->first->data)->expire <= now)) {
+        teoHashMapRemoveEntry(ta->cache, ta->cache->first);
+    }
+
+    size_t result_len = strlen(result) + 1;
+    teoAuthCacheData *cd = teoHashMapAdd(ta->cache, key, key_len, NULL,
+            sizeof(teoAuthCacheData) + result_len);
+    cd->expire = now + ta->cache_ttl;
+    memcpy(cd->result, result, result_len);
+}
+
+/**
+ * Free authentication request
+ *
+ * @param req
+ */
+static void request_free(teoAuthRequest *req) {
+
+    teoAuthWaiter *w, *next;
+    for(w = req->waiters; w != NULL; w = next) {
+        next = w->next;
+        free(w);
+    }
+    free(req->key);
+    free(req->url);
+    free(req->data);
+    free(req->header);
+    free(req->s.ptr);
+    free(req);
+}
+
+/**
+ * Add command to request waiters
+ *
+ * @param req
+ * @param nc_p
+ * @param callback
+ */
+static void request_wait(teoAuthRequest *req, void *nc_p,
+        command_callback callback) {
+
+    teoAuthWaiter *w = malloc(sizeof(teoAuthWaiter)), **last = &req->waiters;
+    w->next = NULL;
+    w->nc_p = nc_p;
+    w->callback = callback;
+    while(*last != NULL) last = &(*last)->next;
+    *last = w;
 }
 
 /**
  * Process authentication command
- * 
+ *
+ * The command is answered from cache or joined to the same request in flight
+ * if possible, otherwise the request is queued to authentication thread. The
+ * callback is called in the event loop thread.
+ *
  * @param ta Pointer to teoAuthClass
  * @param method
  * @param url
  * @param data
  * @param headers
- * @return 
+ * @param nc_p
+ * @param callback
+ *
+ * @return 1 if command is accepted, 0 if url is not valid
  */
-static int teoAuthProccess(teoAuthClass *ta, const char *method, 
-        const char *url, const char *data, const char *header, 
-        void *nc_p, command_callback callback) {
-    
-    int valid_url = 0;
-    
-    // Validate URL
-    if(strcmp(url, "register-client")) {
-        valid_url = 1;
-    }
-    
-    else if(strcmp(url, "register")) {
-        valid_url = 1;
+int teoAuthProcessCommand(teoAuthClass *ta, const char *method, const char *url,
+        const char *data, const char *headers, void *nc_p,
+        command_callback callback) {
+
+    if(url == NULL || !url_in_list(auth_urls, url)) {
+        printf("Wrong authentication command url: %s\n", url ? url : "");
+        return 0;
     }
-    
-    else if(strcmp(url, "login")) {
-        valid_url = 1;
+    if(data == NULL) data = "";
+    if(headers == NULL) headers = "";
+
+    // Answer from cache or join request in flight
+    char *key = NULL;
+    size_t key_len = 0;
+    if(ta->cache_ttl > 0 && url_in_list(cached_urls, url)) {
+
+        key = make_key(url, data, headers, &key_len);
+
+        const char *result = cache_get(ta, key, key_len);
+        if(result != NULL) {
+            teoMetricAdd(ta->mr, ta->m.cache_hits, 1);
+            free(key);
+            callback(nc_p, NULL, (char*)result);
+            return 1;
+        }
+
+        teoAuthRequest **in_flight = teoHashMapGet(ta->in_flight, key, key_len,
+                NULL);
+        if(in_flight != NULL) {
+            teoMetricAdd(ta->mr, ta->m.coalesced, 1);
+            request_wait(*in_flight, nc_p, callback);
+            free(key);
+            return 1;
+        }
     }
-    
-    else if(strcmp(url, "refresh")) {
-        valid_url = 1;
+
+    // Create new request
+    teoAuthRequest *req = calloc(1, sizeof(teoAuthRequest));
+    size_t url_len = strlen(ta->server_url) + strlen(url) + 1;
+    req->url = malloc(url_len);
+    snprintf(req->url, url_len, "%s%s", ta->server_url, url);
+    req->data = strdup(data);
+    req->header = strdup(headers);
+    req->key = key;
+    req->key_len = key_len;
+    req->queued = ev_time();
+    request_wait(req, nc_p, callback);
+    if(key != NULL)
+        teoHashMapAdd(ta->in_flight, key, key_len, &req, sizeof(req));
+    req->pending_next = ta->pending;
+    ta->pending = req;
+
+    // Queue request to authentication thread
+    pthread_mutex_lock(&ta->async_mutex);
+    if(ta->queue_last != NULL) ta->queue_last->next = req;
+    else ta->queue = req;
+    ta->queue_last = req;
+    teoMetricSet(ta->mr, ta->m.queue_depth, ++ta->queue_depth);
+    pthread_mutex_unlock(&ta->async_mutex);
+
+    auth_thread_signal(ta);
+
+    return 1;
+}
+
+/**
+ * Cancel commands of connection
+ *
+ * Callbacks of the connection commands waiting for answers are not called
+ * after this call. Should be called when connection is closed.
+ *
+ * @param ta Pointer to teoAuthClass
+ * @param nc_p Connection
+ */
+void teoAuthCancel(teoAuthClass *ta, void *nc_p) {
+
+    teoAuthRequest *req;
+    teoAuthWaiter *w;
+
+    if(ta == NULL) return;
+    for(req = ta->pending; req != NULL; req = req->pending_next) {
+        for(w = req->waiters; w != NULL; w = w->next) {
+            if(w->nc_p == nc_p) w->callback = NULL;
+        }
     }
-    
-    else if(strcmp(url, "restore")) {
-        valid_url = 1;
-        
+}
+
+/**
+ * Answer commands of executed request
+ *
+ * @param ta Pointer to teoAuthClass
+ * @param req Executed request
+ */
+static void request_answer(teoAuthClass *ta, teoAuthRequest *req) {
+
+    teoAuthWaiter *w;
+    char *err = NULL, *buf;
+    size_t buf_len;
+
+    // Check for curl errors
+    if(req->res != CURLE_OK) {
+
+        fprintf(stderr, "Authentication request failed: %s\n",
+              curl_easy_strerror(req->res));
+
+        err = (char*)curl_easy_strerror(req->res);
+        buf_len = strlen(err) + 64;
+        buf = malloc(buf_len);
+        snprintf(buf, buf_len, "{ \"status\": 0, \"data\": \"%s\" }", err);
     }
-    
-    else if(strcmp(url, "change-password")) {
-        valid_url = 1;
-        
+
+    // Success curl result
+    else {
+
+        // Create response json string
+        char http_code_s[32];
+        char *q = req->http_code != 200 ? "\"":"";
+        snprintf(http_code_s, sizeof(http_code_s), "%d", (int)req->http_code);
+        if(req->http_code != 200) err = http_code_s;
+        buf_len = req->s.len + 64;
+        buf = malloc(buf_len);
+        snprintf(buf, buf_len, "{ \"status\": %d, \"data\": %s%s%s }",
+                (int)req->http_code, q, req->s.ptr, q);
+
+        // Cache verified token
+        if(req->key != NULL && err == NULL)
+            cache_add(ta, req->key, req->key_len, buf);
     }
-        
-    else if(strcmp(url, "me")) { // Method GET and without Data
-        valid_url = 1;
+
+    // Call response callbacks
+    if(req->key != NULL) teoHashMapRemove(ta->in_flight, req->key, req->key_len);
+    for(w = req->waiters; w != NULL; w = w->next) {
+        if(w->callback != NULL) w->callback(w->nc_p, err, buf);
     }
-    
-        
-    if(valid_url) {
-    
-        char full_url[KSN_BUFFER_SM_SIZE];
-        snprintf(full_url, KSN_BUFFER_SM_SIZE,
-                "%s%s", ta->kh->conf->auth_server_url, url);
-        
-        // Send authentication request        
-        send_request(full_url, (void*) data, strlen(data), (char*)header, nc_p, 
-                callback);
+    free(buf);
+}
+
+/**
+ * Answers ready callback, called in the event loop thread
+ *
+ * @param loop
+ * @param w
+ * @param revents
+ */
+static void auth_done_cb(struct ev_loop *loop, ev_async *w, int revents) {
+
+    teoAuthClass *ta = w->data;
+    teoAuthRequest *done, *req, **p;
+
+    pthread_mutex_lock(&ta->async_mutex);
+    done = ta->done;
+    ta->done = NULL;
+    pthread_mutex_unlock(&ta->async_mutex);
+
+    while((req = done) != NULL) {
+        done = req->next;
+
+        // Remove from not answered requests
+        for(p = &ta->pending; *p != NULL; p = &(*p)->pending_next) {
+            if(*p == req) { *p = req->pending_next; break; }
+        }
+
+        request_answer(ta, req);
+        request_free(req);
     }
-    
-    return 0;
 }
 
 /**
  * Destroy Teonet authenticate module
- * 
+ *
  * @param ta
  */
 void teoAuthDestroy(teoAuthClass *ta) {
-    
+
     if(ta != NULL) {
-        
+
+        teoAuthRequest *req;
+
         // Stop Authentication thread
+        pthread_mutex_lock(&ta->async_mutex);
         ta->stop = 1;
+        pthread_mutex_unlock(&ta->async_mutex);
         auth_thread_signal(ta);
-        while(!ta->stopped) usleep(10000); // waiting thread stop per 10 ms
-        
-        pthread_cond_destroy(&ta->cv_threshold);
-        pthread_mutex_destroy(&ta->async_mutex);
-        pthread_mutex_destroy(&ta->cv_mutex);
-
-        // Loop list and destroy all loaded modules
-        PblIterator *it =  pblListIterator(ta->list);
-        if(it != NULL) {     
-            
-            while(pblIteratorHasNext(it)) {        
+        pthread_join(ta->tid, NULL);
 
-              teoAuthDataFree(pblIteratorNext(it));
-              
-            }
-            pblIteratorFree(it);
+        ev_async_stop(ta->loop, &ta->done_w);
+        pthread_mutex_destroy(&ta->async_mutex);
+        if(ta->wake_fd[0] != -1) {
+            close(ta->wake_fd[0]);
+            close(ta->wake_fd[1]);
         }
 
-        // Free list
-        pblListFree(ta->list);
+        // Free not executed and not answered requests
+        while((req = ta->queue) != NULL) {
+            ta->queue = req->next;
+            request_free(req);
+        }
+        while((req = ta->done) != NULL) {
+            ta->done = req->next;
+            request_free(req);
+        }
+        teoHashMapFree(ta->in_flight);
+        teoHashMapFree(ta->cache);
 
         // Free module class
+        free(ta->server_url);
         free(ta);
-        
+
         // Cleanup curl
         curl_global_cleanup();
-    } 
+    }
 }
 
-// Send POST/GET Requests to HTTP Server (with curl) --------------------------
+// Send POST/GET Requests to HTTP Server (with curl multi) --------------------
 //
 //
 //
- 
-struct WriteThis {
-    
-  const char *readptr;
-  long sizeleft;
-};
-
-/**
- * C string implementation data structure
- */
-struct string {
-    
-  char *ptr;
-  size_t len;
-  
-};
- 
-static size_t read_callback(void *ptr, size_t size, size_t nmemb, void *userp) {
-
-  struct WriteThis *pooh = (struct WriteThis *)userp;
-  //struct string *pooh = (struct string *)userp;
- 
-  if(size*nmemb < 1)
-    return 0;
- 
-  if(pooh->sizeleft) {
-    *(char *)ptr = pooh->readptr[0]; /* copy one single byte */ 
-    pooh->readptr++;                 /* advance pointer */ 
-    pooh->sizeleft--;                /* less data left */ 
-    return 1;                        /* we return 1 byte at a time! */ 
-  }
- 
-  return 0;                          /* no more data left to deliver */ 
-}
 
 /**
  * Initialize (create) C string
- * 
+ *
  * @param s
  */
 static void init_string(struct string *s) {
-    
+
   s->len = 0;
   s->ptr = malloc(s->len+1);
   if (s->ptr == NULL) {
@@ -329,15 +604,16 @@ static void init_string(struct string *s) {
 
 /**
  * Curl write callback
- * 
+ *
  * @param ptr
  * @param size
  * @param nmemb
- * @param s
- * @return 
+ * @param userp Pointer to string
+ * @return
  */
-static size_t write_callback(void *ptr, size_t size, size_t nmemb, struct string *s) {
+static size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userp) {
 
+  struct string *s = userp;
   size_t new_len = s->len + size*nmemb;
   s->ptr = realloc(s->ptr, new_len+1);
   if (s->ptr == NULL) {
@@ -350,136 +626,150 @@ static size_t write_callback(void *ptr, size_t size, size_t nmemb, struct string
 
   return size*nmemb;
 }
- 
+
 /**
- * Send request and get result
- * 
- * @param url
- * @param data
- * @param data_len
- * @return 
+ * Start request execution
+ *
+ * @param multi Curl multi handle
+ * @param curl Curl easy handle
+ * @param req Request
  */
-static int send_request(char *url, void *data, size_t data_len, char *header,
-        void *nc_p, command_callback callback) {
-
-  CURL *curl;
-  CURLcode res;
- 
-  struct WriteThis pooh;
-  pooh.readptr = data;
-  pooh.sizeleft = data_len;
-  
-  printf("### Post data: %s\n", (char*)data);
-  
-  struct string s;
-  init_string(&s);
-  
-  // get a curl handle
-  curl = curl_easy_init();
-  if(curl) {
-      
-    /* First set the URL that is about to receive our POST. */ 
-    curl_easy_setopt(curl, CURLOPT_URL, url); 
- 
-    /* Now specify we want to POST data */ 
+static void request_start(CURLM *multi, CURL *curl, teoAuthRequest *req) {
+
+    init_string(&req->s);
+    req->curl = curl;
+    req->started = ev_time();
+
+    if(req->header[0]) req->headers = curl_slist_append(NULL, req->header);
+    req->headers = curl_slist_append(req->headers,
+            "Content-Type: application/json");
+    // Don't wait for "100 Continue" answer
+    req->headers = curl_slist_append(req->headers, "Expect:");
+
+    curl_easy_setopt(curl, CURLOPT_URL, req->url);
     curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    
-    struct curl_slist *headers = curl_slist_append(NULL, header);
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
- 
-    /* we want to use our own read function */ 
-    curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
- 
-    /* pointer to pass to our read function */ 
-    curl_easy_setopt(curl, CURLOPT_READDATA, &pooh);
-    
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req->data);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)strlen(req->data));
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, req->headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
- 
-    /* get verbose debug output please */ 
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
- 
-    /*
-      If you use POST to a HTTP 1.1 server, you can send data without knowing
-      the size before starting the POST if you use chunked encoding. You
-      enable this by adding a header like "Transfer-Encoding: chunked" with
-      CURLOPT_HTTPHEADER. With HTTP 1.0 or without chunked transfer, you must
-      specify the size in the request.
-    */ 
-    #ifdef USE_CHUNKED
-    {
-      struct curl_slist *chunk = NULL;
- 
-      chunk = curl_slist_append(chunk, "Transfer-Encoding: chunked");
-      res = curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
-      /* use curl_slist_free_all() after the *perform() call to free this
-         list again */ 
-    }
-    #else
-    /* Set the expected POST size. If you want to POST large amounts of data,
-       consider CURLOPT_POSTFIELDSIZE_LARGE */ 
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, pooh.sizeleft);
-    #endif
- 
-    #ifdef DISABLE_EXPECT
-    /*
-      Using POST with HTTP 1.1 implies the use of a "Expect: 100-continue"
-      header.  You can disable this header with CURLOPT_HTTPHEADER as usual.
-      NOTE: if you want chunked transfer too, you need to combine these two
-      since you can only set one list of headers with CURLOPT_HTTPHEADER. */ 
- 
-    /* A less good option would be to enforce HTTP 1.0, but that might also
-       have other implications. */ 
-    {
-      struct curl_slist *chunk = NULL;
- 
-      chunk = curl_slist_append(chunk, "Expect:");
-      res = curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);
-      /* use curl_slist_free_all() after the *perform() call to free this
-         list again */ 
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req->s);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, req);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, TEO_AUTH_TIMEOUT);
+
+    curl_multi_add_handle(multi, curl);
+}
+
+/**
+ * Authentication module thread function
+ *
+ * Executes queued requests concurrently with curl multi interface. Easy
+ * handles are reused, and the multi handle keeps connections to
+ * authentication server open between requests.
+ *
+ * @param ta_p Pointer to teoAuthClass
+ *
+ * @return
+ */
+static void* auth_thread(void *ta_p) {
+
+    printf("Starting authentication thread ...\n");
+
+    teoAuthClass *ta = ta_p;
+    teoAuthRequest *transfers = NULL, *req, **p;
+    CURL **idle = malloc(ta->max_transfers * sizeof(CURL*));
+    int num_idle = 0, running, left;
+    CURLMsg *msg;
+
+    CURLM *multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)ta->max_transfers);
+
+    for (;;) {
+
+        // Start queued requests
+        pthread_mutex_lock(&ta->async_mutex);
+        if(ta->stop) {
+            pthread_mutex_unlock(&ta->async_mutex);
+            break;
+        }
+        while(ta->queue != NULL && ta->running < (size_t)ta->max_transfers) {
+            req = ta->queue;
+            ta->queue = req->next;
+            if(ta->queue == NULL) ta->queue_last = NULL;
+            ta->queue_depth--;
+            ta->running++;
+            req->next = transfers;
+            transfers = req;
+            request_start(multi, num_idle ? idle[--num_idle] :
+                    curl_easy_init(), req);
+            teoMetricAdd(ta->mr, ta->m.requests, 1);
+            teoMetricObserve(ta->mr, ta->m.queue_wait,
+                    (req->started - req->queued) * 1e9);
+        }
+        teoMetricSet(ta->mr, ta->m.queue_depth, ta->queue_depth);
+        teoMetricSet(ta->mr, ta->m.transfers, ta->running);
+        pthread_mutex_unlock(&ta->async_mutex);
+
+        curl_multi_perform(multi, &running);
+
+        // Return executed requests to the event loop
+        while((msg = curl_multi_info_read(multi, &left)) != NULL) {
+
+            if(msg->msg != CURLMSG_DONE) continue;
+
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&req);
+            req->res = msg->data.result;
+            curl_easy_getinfo(req->curl, CURLINFO_RESPONSE_CODE,
+                    &req->http_code);
+            teoMetricObserve(ta->mr, ta->m.latency,
+                    (ev_time() - req->started) * 1e9);
+            if(req->res != CURLE_OK) teoMetricAdd(ta->mr, ta->m.errors, 1);
+
+            curl_multi_remove_handle(multi, req->curl);
+            curl_easy_reset(req->curl);
+            idle[num_idle++] = req->curl;
+            req->curl = NULL;
+            curl_slist_free_all(req->headers);
+            req->headers = NULL;
+
+            for(p = &transfers; *p != req; p = &(*p)->next);
+            *p = req->next;
+
+            pthread_mutex_lock(&ta->async_mutex);
+            ta->running--;
+            req->next = ta->done;
+            ta->done = req;
+            pthread_mutex_unlock(&ta->async_mutex);
+            ev_async_send(ta->loop, &ta->done_w);
+        }
+
+        // Wait for sockets or new requests
+        if(ta->wake_fd[0] != -1) {
+
+            struct curl_waitfd wfd = { ta->wake_fd[0], CURL_WAIT_POLLIN, 0 };
+            curl_multi_wait(multi, &wfd, 1, 1000, NULL);
+            if(wfd.revents) {
+                char buf[64];
+                while(read(ta->wake_fd[0], buf, sizeof(buf)) > 0);
+            }
+        }
+        else curl_multi_wait(multi, NULL, 0, 10, NULL);
     }
-    #endif
- 
-    /* Perform the request, res will get the return code */ 
-    res = curl_easy_perform(curl);
-    
-    // Check for curl errors
-    if(res != CURLE_OK) {
-        fprintf(stderr, "curl_easy_perform() failed: %s\n",
-              curl_easy_strerror(res));
+
+    // Free requests executed when thread stopped
+    while((req = transfers) != NULL) {
+        transfers = req->next;
+        curl_multi_remove_handle(multi, req->curl);
+        curl_easy_cleanup(req->curl);
+        curl_slist_free_all(req->headers);
+        request_free(req);
     }
-    
-    // Success curl result
-    else {
-        
-        // Get response info
-        long http_code = 0;
-        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-        
-        printf("Post response: HTTP CODE: %d\n%s\n", (int)http_code, s.ptr);
-          
-        // Create response json string
-        size_t http_code_s_len = 32;
-        char http_code_s[http_code_s_len];
-        char *buf_format = "{ \"status\": %d, \"data\": %s%s%s }";
-        size_t buf_len = strlen(buf_format) + http_code_s_len + strlen(s.ptr);
-        char buf[buf_len];
-        char *q = http_code != 200 ? "\"":"";
-        snprintf(http_code_s, http_code_s_len, "%d", (int)http_code);
-        snprintf(buf, buf_len, buf_format, (int)http_code, q, s.ptr, q);
-        // Call response callback and send response
-        callback(nc_p, http_code != 200 ? http_code_s : NULL, buf);
-        // Free HTTP server response string
-        free(s.ptr);
-    }    
-    
-    // Always cleanup 
-    curl_easy_cleanup(curl);
-    
-    // Free the custom headers
-    curl_slist_free_all(headers);
-  }
-  
-  return 0;
+    while(num_idle) curl_easy_cleanup(idle[--num_idle]);
+    free(idle);
+    curl_multi_cleanup(multi);
+
+    printf("Authentication thread stopped\n");
+
+    return NULL;
 }
@@ -1,7 +1,7 @@
-/** 
+/**
  * File:   teo_auth.h
  * Author: Kirill Scherba <kirill@scherba.ru>
- * 
+ *
  * Module to connect to Authentication server AuthPrototype
  *
  * Created on December 1, 2015, 1:52 PM
@@ -12,58 +12,87 @@
 
 #include <stdio.h>
 #include <pthread.h>
+#include <ev.h>
+
+#include "utils/teo_hashmap.h"
+#include "modules/metric_registry.h"
+
+#define TEO_AUTH_TRANSFERS 8 ///< Default number of concurrent requests
+#define TEO_AUTH_CACHE_TTL 60.0 ///< Default verified tokens cache TTL, sec
+#define TEO_AUTH_CACHE_SIZE 4096 ///< Maximum number of cached answers
 
-#include <pbl.h>
+struct ksnHTTPClass;
+struct teoAuthRequest;
 
-#include "../teo_web/teo_web.h"
+/**
+ * Teonet authentication module metrics ids in metrics registry
+ */
+typedef struct teoAuthMetrics {
+    int requests; ///< Requests sent to authentication server
+    int cache_hits; ///< Commands answered from cache
+    int coalesced; ///< Commands joined to request in flight
+    int errors; ///< Failed requests
+    int queue_depth; ///< Requests waiting for free transfer
+    int transfers; ///< Requests executed by curl
+    int queue_wait; ///< Time request waits for free transfer
+    int latency; ///< Authentication server answer time
+} teoAuthMetrics;
 
 /**
  * Teonet authentication module class structure
+ *
+ * Commands are received and answered in the event loop thread. Requests to
+ * authentication server are executed concurrently by the authentication
+ * thread with curl multi interface, which keeps connections to the server
+ * open between requests.
  */
 typedef struct teoAuthClass {
-    ksnHTTPClass *kh; ///< Pointer to ksnHTTPClass
-    PblList* list; ///< Commands list
-    pthread_mutex_t async_mutex; ///< Command list mutex    
+    struct ksnHTTPClass *kh; ///< Pointer to ksnHTTPClass or NULL
+    struct ev_loop *loop; ///< Event loop which executes callbacks
+    char *server_url; ///< Authentication server URL
+    int max_transfers; ///< Number of concurrent requests
+    double cache_ttl; ///< Verified tokens cache TTL, sec; 0 - no cache
+
+    // Event loop thread data
+    teoHashMap *cache; ///< Answers cache: request key -> teoAuthCacheData
+    teoHashMap *in_flight; ///< Requests in flight: request key -> request
+    struct teoAuthRequest *pending; ///< All requests not answered yet
+    ev_async done_w; ///< Answers ready watcher
+
+    // Shared data
+    pthread_mutex_t async_mutex; ///< Queues mutex
+    struct teoAuthRequest *queue; ///< Requests waiting for authentication thread
+    struct teoAuthRequest *queue_last; ///< Last request in queue
+    struct teoAuthRequest *done; ///< Requests executed by authentication thread
+    size_t queue_depth; ///< Number of requests in queue
+    size_t running; ///< Number of requests executed by curl
+    int wake_fd[2]; ///< Authentication thread wake up pipe
     pthread_t tid; ///< Authentication module thread id
-    pthread_mutex_t cv_mutex; ///< Command list condition variables mutex
-    pthread_cond_t cv_threshold; ///< Command list condition variable    
-    
-    int stop; ///< Stop Authentication module thread server flag
-    int stopped; ///< Authentication module thread is stopped
-    int running; ///< Authentication module thread running state: 1 - running; 0 - waiting
+    int stop; ///< Stop Authentication module thread flag
+
+    teoMetricRegistry *mr; ///< Metrics registry or NULL
+    teoAuthMetrics m; ///< Metrics ids
 } teoAuthClass;
 
 //typedef void (*command_callback)(void *error, void *success);
 typedef void (*command_callback)(void *nc_p, char* err, char *result);
 
-/**
- * Teonet authentication request list data structure
- */
-typedef struct teoAuthData {
-    char *method;
-    char *url;
-    char *data; 
-    char *headers;
-    
-    void *nc_p;
-    command_callback callback;
-} teoAuthData;
-
-
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
-teoAuthClass *teoAuthInit(ksnHTTPClass *kh);
+teoAuthClass *teoAuthInit(struct ksnHTTPClass *kh);
+teoAuthClass *teoAuthNew(struct ev_loop *loop, const char *server_url,
+        int max_transfers, double cache_ttl, teoMetricRegistry *mr);
 void teoAuthDestroy(teoAuthClass *ta);
 
-int teoAuthProcessCommand(teoAuthClass *ta, const char *method, const char *url, 
-        const char *data, const char *headers, void *nc_p, 
+int teoAuthProcessCommand(teoAuthClass *ta, const char *method, const char *url,
+        const char *data, const char *headers, void *nc_p,
         command_callback callback);
+void teoAuthCancel(teoAuthClass *ta, void *nc_p);
 
 #ifdef	__cplusplus
 }
 #endif
 
 #endif	/* TEO_AUTH_H */
-
@@ -4,6 +4,10 @@
  * 
  * Teonet HTTP/WS Server module
  *
+ * The mongoose server runs in the teonet event loop: mongoose epoll fd is
+ * watched by libev and mongoose is polled when its sockets are ready, so HTTP
+ * requests and websocket messages are dispatched without polling thread.
+ *
  * Created on October 2, 2015, 12:04 AM
  */
 
@@ -16,6 +20,12 @@
  */
 #define tws ((teoWSClass *)kh->kws)
 
+#if defined(MG_MGR_EV_MGR) && MG_MGR_EV_MGR == 1
+#define MG_POLL_INTERVAL 1.0 ///< Mongoose timers check interval, sec
+#else
+#define MG_POLL_INTERVAL 0.002 ///< Mongoose select() poll interval, sec
+#endif
+
 /**
  * Mongoose websocket send broadcast
  * 
@@ -25,13 +35,60 @@
  */
 static void ws_broadcast(struct mg_connection *nc, const char *msg, size_t len) {
     
-    struct mg_connection *c;
     char buf[500];
 
-    snprintf(buf, sizeof(buf), "%p: %.*s", nc, (int) len, msg);
-    for(c = mg_next(nc->mgr, NULL); c != NULL; c = mg_next(nc->mgr, c)) {
-        mg_send_websocket_frame(c, WEBSOCKET_OP_TEXT, buf, strlen(buf));
+    int buf_len = snprintf(buf, sizeof(buf), "%p: %.*s", nc, (int) len, msg);
+    if(buf_len >= (int)sizeof(buf)) buf_len = sizeof(buf) - 1;
+    ksnHTTPBroadcast(nc->mgr->user_data, WEBSOCKET_OP_TEXT, buf, buf_len);
+}
+
+/**
+ * Send websocket frame to all websocket clients
+ * 
+ * The frame is encoded once and the same bytes are queued to all clients 
+ * (server frames are not masked).
+ * 
+ * @param kh Pointer to ksnHTTPClass
+ * @param op Websocket operation
+ * @param data Frame data
+ * @param len Frame data length
+ */
+void ksnHTTPBroadcast(ksnHTTPClass *kh, int op, const void *data, size_t len) {
+    
+    struct mg_connection *c;
+    size_t header_len;
+    uint8_t *frame = malloc(len + 10);
+
+    // Websocket frame header
+    frame[0] = 0x80 | (op & 0x0f);
+    if(len < 126) {
+        frame[1] = len;
+        header_len = 2;
     }
+    else if(len < 65535) {
+        uint16_t tmp = htons((uint16_t) len);
+        frame[1] = 126;
+        memcpy(&frame[2], &tmp, sizeof(tmp));
+        header_len = 4;
+    }
+    else {
+        uint32_t tmp;
+        frame[1] = 127;
+        tmp = htonl((uint32_t)((uint64_t) len >> 32));
+        memcpy(&frame[2], &tmp, sizeof(tmp));
+        tmp = htonl((uint32_t)(len & 0xffffffff));
+        memcpy(&frame[6], &tmp, sizeof(tmp));
+        header_len = 10;
+    }
+    memcpy(frame + header_len, data, len);
+
+    for(c = mg_next(&kh->mgr, NULL); c != NULL; c = mg_next(&kh->mgr, c)) {
+        if((c->flags & MG_F_IS_WEBSOCKET) && c->listener != NULL) {
+            mg_send(c, frame, header_len + len);
+        }
+    }
+    free(frame);
+    ksnHTTPFlush(kh);
 }
 
 /**
@@ -46,7 +103,9 @@ static int is_websocket(const struct mg_connection *nc) {
 }
 
 /**
- * Send async event to teonet library
+ * Send websocket event to teonet application
+ * 
+ * The event is sent as EV_K_ASYNC event directly from the event loop.
  * 
  * @param nc
  * @param cmd
@@ -56,12 +115,15 @@ static int is_websocket(const struct mg_connection *nc) {
 static void teoSendAsync(struct mg_connection *nc, uint16_t cmd, void *data, 
         size_t data_len) {
     
+    ksnetEvMgrClass *ke = ((ksnHTTPClass *)nc->mgr->user_data)->ke;
+    if(ke->event_cb == NULL) return;
+    
     size_t td_size = sizeof(struct teoweb_data) + data_len;
     struct teoweb_data *td = malloc(td_size);
     td->cmd = cmd; 
     td->data_len = data_len;
     if(data_len) memcpy(td->data, data, data_len);
-    ksnetEvMgrAsync(((ksnHTTPClass *)nc->mgr->user_data)->ke, td, td_size, nc);
+    ke->event_cb(ke, EV_K_ASYNC, td, td_size, nc);
     free(td);
 }
 
@@ -181,6 +243,7 @@ static void mg_ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
             // Disconnect websocket connection. Tell everybody.
             if(is_websocket(nc)) {
                 
+                teoAuthCancel(kh->ta, nc);
                 if(!tws->handler(tws, ev, nc, NULL, 0)) {
                     ws_broadcast(nc, "left", 4);
                     teoSendAsync(nc, WS_DISCONNECTED, NULL, 0);
@@ -194,38 +257,54 @@ static void mg_ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
 }
 
 /**
- * Mongoose main thread function
+ * Mongoose sockets callback
  * 
- * @param kh Pointer to ksnetEvMgrClass
- * 
- * @return 
+ * @param loop
+ * @param w
+ * @param revents
  */
-static void* http_thread(void *kh) {
-
-    struct mg_mgr mgr;
-    struct mg_connection *nc;
-
-    mg_mgr_init(&mgr, kh);
-    nc = mg_bind(&mgr, ((ksnHTTPClass *)kh)->s_http_port, mg_ev_handler);
-
-    // Set up HTTP server parameters
-    mg_set_protocol_http_websocket(nc);
-
-    printf("Starting web server on port %s ...\n", 
-        ((ksnHTTPClass *)kh)->s_http_port);
+static void mg_io_cb(struct ev_loop *loop, ev_io *w, int revents) {
     
-    for (;;) {
-      mg_mgr_poll(&mgr, 2);
-      if(((ksnHTTPClass *)kh)->stop) break;
-    }
-    mg_mgr_free(&mgr);
+    mg_mgr_poll(&((ksnHTTPClass *)w->data)->mgr, 0);
+}
+
+/**
+ * Mongoose timers callback
+ * 
+ * @param loop
+ * @param w
+ * @param revents
+ */
+static void mg_timer_cb(struct ev_loop *loop, ev_timer *w, int revents) {
     
-    printf("Web server on port %s stopped.\n", 
-        ((ksnHTTPClass *)kh)->s_http_port);
+    mg_mgr_poll(&((ksnHTTPClass *)w->data)->mgr, 0);
+}
+
+/**
+ * Mongoose flush callback, called before the event loop waits for events
+ * 
+ * @param loop
+ * @param w
+ * @param revents
+ */
+static void mg_flush_cb(struct ev_loop *loop, ev_prepare *w, int revents) {
     
-    ((ksnHTTPClass *)kh)->stopped = 1;
+    ev_prepare_stop(loop, w);
+    mg_mgr_poll(&((ksnHTTPClass *)w->data)->mgr, 0);
+}
+
+/**
+ * Flush data sent to mongoose connections outside of mongoose handlers
+ * 
+ * Mongoose updates its sockets write interest when it is polled, so the poll
+ * is requested before the event loop waits for events next time.
+ * 
+ * @param kh Pointer to ksnHTTPClass
+ */
+void ksnHTTPFlush(ksnHTTPClass *kh) {
     
-    return NULL;
+    if(!ev_is_active(&kh->flush_w)) 
+        ev_prepare_start(((ksnetEvMgrClass *)kh->ke)->ev_loop, &kh->flush_w);
 }
 
 /**
@@ -243,8 +322,6 @@ ksnHTTPClass* ksnHTTPInit(ksnetEvMgrClass *ke, teoweb_config *tw_cfg) {
     kh->conf = tw_cfg;
     kh->ta = teoAuthInit(kh); // Initialize authentication class
    
-    kh->stop = 0;
-    kh->stopped = 0;
     char buffer[KSN_BUFFER_SIZE];
     snprintf(buffer, KSN_BUFFER_SIZE, "%d", (int)tw_cfg->http_port);
     kh->s_http_port = strdup(buffer); 
@@ -255,10 +332,32 @@ ksnHTTPClass* ksnHTTPInit(ksnetEvMgrClass *ke, teoweb_config *tw_cfg) {
     
     kh->kws = teoWSInit(kh); // Initialize websocket class
 
-    // Start mongoose thread
-    int err = pthread_create(&kh->tid, NULL, &http_thread, kh);
-    if (err != 0) printf("Can't create mongoose thread :[%s]\n", strerror(err));
-    else printf("Mongoose thread created successfully\n");       
+    // Start mongoose server
+    struct mg_connection *nc;
+    mg_mgr_init(&kh->mgr, kh);
+    nc = mg_bind(&kh->mgr, kh->s_http_port, mg_ev_handler);
+    if(nc != NULL) {
+        
+        // Set up HTTP server parameters
+        mg_set_protocol_http_websocket(nc);
+        printf("Starting web server on port %s ...\n", kh->s_http_port);
+    }
+    else printf("Can't start web server on port %s\n", kh->s_http_port);
+    
+    // Watch mongoose sockets and timers in the event loop
+    struct ev_loop *loop = ke->ev_loop;
+    #if defined(MG_MGR_EV_MGR) && MG_MGR_EV_MGR == 1
+    ev_io_init(&kh->w, mg_io_cb, (int)(intptr_t)kh->mgr.mgr_data, EV_READ);
+    kh->w.data = kh;
+    ev_io_start(loop, &kh->w);
+    #else
+    memset(&kh->w, 0, sizeof(kh->w));
+    #endif
+    ev_timer_init(&kh->t_w, mg_timer_cb, MG_POLL_INTERVAL, MG_POLL_INTERVAL);
+    kh->t_w.data = kh;
+    ev_timer_start(loop, &kh->t_w);
+    ev_prepare_init(&kh->flush_w, mg_flush_cb);
+    kh->flush_w.data = kh;
     
     return kh;
 }
@@ -270,8 +369,15 @@ ksnHTTPClass* ksnHTTPInit(ksnetEvMgrClass *ke, teoweb_config *tw_cfg) {
  */
 void ksnHTTPDestroy(ksnHTTPClass *kh) {
         
-    kh->stop = 1;
-    while(!kh->stopped) usleep(100000);
+    struct ev_loop *loop = ((ksnetEvMgrClass *)kh->ke)->ev_loop;
+    
+    // Stop mongoose server
+    ev_io_stop(loop, &kh->w);
+    ev_timer_stop(loop, &kh->t_w);
+    ev_prepare_stop(loop, &kh->flush_w);
+    mg_mgr_free(&kh->mgr);
+    printf("Web server on port %s stopped.\n", kh->s_http_port);
+    
     tws->destroy(tws);
     free(kh->s_http_port);
     
@@ -25,9 +25,10 @@ typedef struct ksnHTTPClass {
     teoweb_config *conf; ///< Pointer to teoweb_config
     char *s_http_port; ///< HTTP port
     struct mg_serve_http_opts s_http_server_opts; ///< HTTP server options
-    pthread_t tid; ///< HTTP thread id
-    int stop; ///< Stop HTTP server flag
-    int stopped; ///< HTTP server is stopped
+    struct mg_mgr mgr; ///< Mongoose connections manager
+    ev_io w; ///< Mongoose sockets watcher
+    ev_timer t_w; ///< Mongoose timers watcher
+    ev_prepare flush_w; ///< Flush data sent outside of mongoose handlers
 } ksnHTTPClass;
 
 /**
@@ -57,6 +58,8 @@ extern "C" {
 
 ksnHTTPClass* ksnHTTPInit(ksnetEvMgrClass *ke, teoweb_config *tw_cfg);
 void ksnHTTPDestroy(ksnHTTPClass *kh);
+void ksnHTTPFlush(ksnHTTPClass *kh);
+void ksnHTTPBroadcast(ksnHTTPClass *kh, int op, const void *data, size_t len);
 
 #ifdef	__cplusplus
 }
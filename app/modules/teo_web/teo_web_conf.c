@@ -17,6 +17,7 @@
 #include "conf.h"
 #include "utils/utils.h"
 #include "modules/teo_web/teo_web_conf.h"
+#include "modules/teo_auth/teo_auth.h"
 
 //teoweb_config tw_cfg;
 
@@ -32,6 +33,8 @@ static void teoweb_set_defaults(teoweb_config *tw_cfg) {
     strncpy(tw_cfg->l0_server_name, "gt1.kekalan.net", KSN_BUFFER_SM_SIZE);
     tw_cfg->l0_server_port = 9010;
     strncpy(tw_cfg->auth_server_url, "http://localhost:1234/api/auth/", KSN_BUFFER_SM_SIZE);
+    tw_cfg->auth_transfers = TEO_AUTH_TRANSFERS;
+    tw_cfg->auth_cache_ttl = TEO_AUTH_CACHE_TTL;
 }
 
 /**
@@ -64,6 +67,8 @@ void teowebConfigRead(teoweb_config *conf, const char *network, int port_param)
         CFG_SIMPLE_STR("l0_server_name", &l0_server_name),
         CFG_SIMPLE_INT("l0_server_port", &conf->l0_server_port),
         CFG_SIMPLE_STR("auth_server_url", &auth_server_url),
+        CFG_SIMPLE_INT("auth_transfers", &conf->auth_transfers),
+        CFG_SIMPLE_INT("auth_cache_ttl", &conf->auth_cache_ttl),
 
         CFG_END()
     };
@@ -20,6 +20,8 @@ typedef struct teoweb_config {
     char l0_server_name[KSN_BUFFER_SM_SIZE];
     long l0_server_port;
     char auth_server_url[KSN_BUFFER_SM_SIZE];
+    long auth_transfers; ///< Number of concurrent authentication requests
+    long auth_cache_ttl; ///< Verified tokens cache TTL, sec; 0 - no cache
     
 } teoweb_config;
 
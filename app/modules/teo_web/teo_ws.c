@@ -1,14 +1,26 @@
-/** 
+/**
  * File:   teo_ws.c
  * Author: Kirill Scherba <kirill@scherba.ru>
- * 
+ *
  * Teonet websocket L0 connector module
  *
+ * Websocket clients are attached to the in-process L0 server as L0 clients,
+ * so a lot of browsers does not create a lot of TCP connections to our own L0
+ * server, and answers are routed to websocket clients by the L0 client name.
+ * When this host does not run L0 server, each websocket client uses its own
+ * connection to the L0 server from the teoweb configuration.
+ *
+ * The HTTP server runs in the event loop, so websocket messages are processed
+ * and answered without thread hand-off.
+ *
  * Created on November 8, 2015, 3:58 PM
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 
 #include "embedded/jsmn/jsmn.h"
 #include "utils/rlutil.h"
@@ -20,14 +32,14 @@
 
 // Local functions
 static void teoWSDestroy(teoWSClass *kws);
-static teoLNullConnectData *teoWSadd(teoWSClass *kws, void *nc_p, 
-                            const char *server, const int port, char *login);
+static int teoWSadd(teoWSClass *kws, void *nc_p, char *login);
 static int teoWSremove(teoWSClass *kws, void *nc_p);
 static int teoWSevHandler(teoWSClass *kws, int ev, void *nc, void *data, size_t data_length);
-static ssize_t teoWSLNullsend(teoWSClass *kws, void *nc_p, int cmd, 
+static ssize_t teoWSLNullsend(teoWSClass *kws, void *nc_p, int cmd,
         const char *to_peer_name, void *data, size_t data_length);
 static int teoWSprocessMsg(teoWSClass *kws, void *nc, void *data, size_t data_length);
 
+static void session_close(teoWSClass *kws, teoWSmapData *td);
 static void send_auth_answer(void *nc_p, char* err, char *result);
 
 /**
@@ -45,374 +57,519 @@ static void send_auth_answer(void *nc_p, char* err, char *result);
 
 /**
  * Initialize teonet websocket module
- * 
+ *
  * @param kh Pointer to ksnHTTPClass
- * 
- * @return 
+ *
+ * @return
  */
 teoWSClass* teoWSInit(ksnHTTPClass *kh) {
-    
+
     #ifdef DEBUG_KSNET
     ksn_puts(((ksnetEvMgrClass*)kh->ke), MODULE, DEBUG, "initialize");
     #endif
-    
+
     teoWSClass *this = malloc(sizeof(teoWSClass));
     this->kh = kh;
-    this->map = pblMapNewHashMap();
-    
+    this->map = teoHashMapNew();
+    memset(&this->json, 0, sizeof(this->json));
+
     this->destroy = teoWSDestroy;
     this->add = teoWSadd;
     this->remove = teoWSremove;
     this->handler = teoWSevHandler;
     this->send = teoWSLNullsend;
     this->processMsg = teoWSprocessMsg;
-    
+
     return this;
 }
 
-#define teoLNullDisconnectThis(con) { free(con->user_data); teoLNullDisconnect(con); }
-
 /**
  * Destroy teonet HTTP module]
+ *
+ * Should be called after HTTP server was stopped.
+ *
  * @param kws Pointer to teoWSClass
  */
 static void teoWSDestroy(teoWSClass *kws) {
-        
+
     if(kws != NULL) {
 
         #ifdef DEBUG_KSNET
         ksn_puts(kev, MODULE, DEBUG, "Destroy");
         #endif
 
-        // Disconnect all connected clients and stop it watchers
-        PblIterator *it = pblMapIteratorReverseNew(kws->map);
-        if (it != NULL) {
-            while (pblIteratorHasPrevious(it)) {
-                void *entry = pblIteratorPrevious(it);
-                teoWSmapData *td = pblMapEntryValue(entry);
-                ev_io_stop(((ksnetEvMgrClass*)kws->kh->ke)->ev_loop, &td->w); // stop watcher
-                teoLNullDisconnectThis(td->con); // disconnect connection to L0 server
-            }
-            pblIteratorFree(it);
+        // Detach all websocket clients
+        teoHashMapIter it;
+        teoHashMapEntry *entry;
+        teoHashMapIterInit(kws->map, &it);
+        while((entry = teoHashMapIterNext(&it))) {
+            session_close(kws, entry->data);
         }
-        
-        pblMapFree(kws->map);
+
+        teoHashMapFree(kws->map);
+        free(kws->json.buf);
         free(kws);
     }
 }
 
 /**
- * L0 server teonet L0 connect user data
+ * Reserve space in JSON encoder buffer
+ *
+ * @param js Pointer to teoWSJson
+ * @param length Length to reserve
+ *
+ * @return Pointer to the end of encoded data
  */
-typedef struct teoLNullConnectUserData {
-    
-    void *nc_p; ///< Pointer to mg_connection structure
-    teoWSClass *kws; ///< Pointer to teoWSClass
-    
-} teoLNullConnectUserData;
+static char *json_reserve(teoWSJson *js, size_t length) {
+
+    if(js->len + length > js->size) {
+        size_t size = js->size ? js->size : KSN_BUFFER_SIZE;
+        while(size < js->len + length) size *= 2;
+        js->buf = realloc(js->buf, size);
+        js->size = size;
+    }
+
+    return js->buf + js->len;
+}
 
 /**
- * Read data from L0 server
- * 
+ * Add raw data to JSON encoder
+ */
+static void json_put(teoWSJson *js, const char *data, size_t length) {
+
+    memcpy(json_reserve(js, length), data, length);
+    js->len += length;
+}
+
+/**
+ * Add string to JSON encoder
+ */
+static inline void json_puts(teoWSJson *js, const char *str) {
+
+    json_put(js, str, strlen(str));
+}
+
+/**
+ * Add formatted string to JSON encoder
+ */
+static void json_printf(teoWSJson *js, const char *format, ...) {
+
+    va_list args;
+    size_t avail;
+
+    json_reserve(js, 64);
+    avail = js->size - js->len;
+
+    va_start(args, format);
+    int length = vsnprintf(js->buf + js->len, avail, format, args);
+    va_end(args);
+
+    if(length > 0 && (size_t)length >= avail) {
+        json_reserve(js, length + 1);
+        va_start(args, format);
+        vsnprintf(js->buf + js->len, length + 1, format, args);
+        va_end(args);
+    }
+    if(length > 0) js->len += length;
+}
+
+/**
+ * Add quoted and escaped string to JSON encoder
+ */
+static void json_string(teoWSJson *js, const char *str, size_t length) {
+
+    char *p = json_reserve(js, length * 6 + 2), *b = p;
+    size_t i;
+
+    *p++ = '"';
+    for(i = 0; i < length; i++) {
+        unsigned char c = str[i];
+        if(c == '"' || c == '\\') { *p++ = '\\'; *p++ = c; }
+        else if(c < 0x20) p += sprintf(p, "\\u%04x", c);
+        else *p++ = c;
+    }
+    *p++ = '"';
+    js->len += p - b;
+}
+
+/**
+ * Add quoted base64 encoded data to JSON encoder
+ */
+static void json_base64(teoWSJson *js, const void *data, size_t length) {
+
+    size_t b64_length = (length + 2) / 3 * 4;
+    char *p = json_reserve(js, b64_length + 3);
+
+    *p = '"';
+    mg_base64_encode((const unsigned char*)data, length, p + 1);
+    p[b64_length + 1] = '"';
+    js->len += b64_length + 2;
+}
+
+/**
+ * Encode L0 packet data to JSON encoder
+ *
+ * @param js Pointer to teoWSJson
+ * @param cp Pointer to L0 packet
+ */
+static void json_packet_data(teoWSJson *js, teoLNullCPacket *cp) {
+
+    char *data = cp->peer_name + cp->peer_name_length;
+    size_t data_length = cp->data_length;
+    size_t data_str_len = strnlen(data, data_length);
+
+    // Define json type of data field
+    //
+    jsmntype_t type = JSMN_UNDEFINED;
+    size_t num_of_tags = get_num_of_tags(data, data_length);
+    if(num_of_tags) {
+
+        // Parse json
+        jsmntok_t *t = malloc(num_of_tags * sizeof(jsmntok_t));
+        //
+        jsmn_parser p;
+        jsmn_init(&p);
+        int r = jsmn_parse(&p, data, data_length, t, num_of_tags);
+        if(!(r < 1)) type = t[0].type;
+        //
+        free(t);
+    }
+
+    // Convert binary peer list data to json (JSON answer is sent as is)
+    if(cp->cmd == CMD_L_PEERS_ANSWER && type != JSMN_OBJECT &&
+       data_length >= sizeof(ksnet_arp_data_ar) &&
+       ksnetArpShowDataLength((ksnet_arp_data_ar *) data) <= data_length) {
+
+        ksnet_arp_data_ar *arp_data_ar = (ksnet_arp_data_ar *) data;
+        int i;
+        json_printf(js, "{ \"length\": %d, \"arp_data_ar\": [ ",
+                arp_data_ar->length);
+        for(i = 0; i < arp_data_ar->length; i++) {
+            json_puts(js, i ? ", { \"name\": " : "{ \"name\": ");
+            json_string(js, arp_data_ar->arp_data[i].name,
+                    strlen(arp_data_ar->arp_data[i].name));
+            json_printf(js, ", "
+                    "\"mode\": %d, "
+                    "\"addr\": \"%s\", "
+                    "\"port\": %d, "
+                    "\"triptime\": %.3f,"
+                    "\"uptime\": %.3f"
+                    " }",
+                    arp_data_ar->arp_data[i].data.mode,
+                    arp_data_ar->arp_data[i].data.addr,
+                    arp_data_ar->arp_data[i].data.port,
+                    arp_data_ar->arp_data[i].data.last_triptime,
+                    arp_data_ar->arp_data[i].data.connected_time);
+        }
+        json_puts(js, " ] }");
+    }
+
+    // Convert binary client list data to json
+    else if(cp->cmd == CMD_L_L0_CLIENTS_ANSWER &&
+       data_length >= sizeof(teonet_client_data_ar) &&
+       ksnLNullClientsListLength((teonet_client_data_ar *) data) <= data_length) {
+
+        teonet_client_data_ar *client_data_ar = (teonet_client_data_ar *) data;
+        int i;
+        json_printf(js, "{ \"length\": %d, \"client_data_ar\": [ ",
+                client_data_ar->length);
+        for(i = 0; i < client_data_ar->length; i++) {
+            json_puts(js, i ? ", { \"name\": " : "{ \"name\": ");
+            json_string(js, client_data_ar->client_data[i].name,
+                    strlen(client_data_ar->client_data[i].name));
+            json_puts(js, " }");
+        }
+        json_puts(js, " ] }");
+    }
+
+    // Subscribe answer with base64 encoded event data
+    else if(cp->cmd == CMD_L_SUBSCRIBE_ANSWER &&
+            data_length >= sizeof(teoSScrData)) {
+
+        teoSScrData *sscr_data = (teoSScrData *) data;
+        json_printf(js, "{ \"ev\": %d, \"cmd\": %d, \"data\": ",
+                sscr_data->ev, sscr_data->cmd);
+        json_base64(js, sscr_data->data, data_length - sizeof(teoSScrData));
+        json_puts(js, " }");
+    }
+
+    // Binary echo: message and time
+    else if(cp->cmd == CMD_L_ECHO && !num_of_tags &&
+            data_str_len + 1 + sizeof(double) <= data_length) {
+
+        double echo_time;
+        memcpy(&echo_time, data + data_str_len + 1, sizeof(echo_time));
+        json_puts(js, "{ \"msg\": ");
+        json_string(js, data, data_str_len);
+        json_printf(js, ", \"time\": %f }", echo_time);
+    }
+
+    else if(type == JSMN_UNDEFINED) {
+
+        // fix "can't show database JSON strings with quotas without slash":
+        // escape quotes inside first object after 'data'
+        char *st = memmem(data, data_str_len, "\"data\":", 7);
+        if(st != NULL) {
+
+            size_t i = st - data, beg;
+
+            // Add Text before 'data' and before '{'
+            while(i < data_str_len && data[i] != '{') i++;
+            json_put(js, data, i);
+
+            // Replace " to \" up to '}'
+            while(i < data_str_len && data[i] != '}') {
+                for(beg = i; i < data_str_len && data[i] != '}' &&
+                        data[i] != '"'; i++);
+                json_put(js, data + beg, i - beg);
+                if(i < data_str_len && data[i] == '"') {
+                    json_put(js, "\\\"", 2);
+                    i++;
+                }
+            }
+
+            // Add text after '}' of line
+            json_put(js, data + i, data_str_len - i);
+        }
+
+        // Send binary data base64 encoded
+        else json_base64(js, data, data_length);
+    }
+
+    else if(type == JSMN_STRING) {
+        json_put(js, "\"", 1);
+        json_put(js, data, data_str_len);
+        json_put(js, "\"", 1);
+    }
+
+    else json_put(js, data, data_str_len);
+}
+
+/**
+ * Send L0 packet to websocket client as JSON
+ *
+ * The answer is encoded in one pass to the encoder buffer reused by all
+ * answers.
+ *
+ * @param kws Pointer to teoWSClass
+ * @param nc_p Pointer to mg_connection structure
+ * @param cp Pointer to L0 packet
+ */
+static void send_answer(teoWSClass *kws, void *nc_p, teoLNullCPacket *cp) {
+
+    teoWSJson *js = &kws->json;
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(kev, MODULE, DEBUG_VV,
+        "receive %d bytes data from L0 server, "
+        "from peer %s, cmd = %d\n",
+        cp->data_length, cp->peer_name, cp->cmd);
+    #endif
+
+    js->len = 0;
+    json_printf(js, "{ \"cmd\": %d, \"from\": ", cp->cmd);
+    json_string(js, cp->peer_name, strnlen(cp->peer_name,
+            cp->peer_name_length));
+    json_puts(js, ", \"data\": ");
+    json_packet_data(js, cp);
+    json_puts(js, " }");
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(kev, MODULE, DEBUG_VV,
+        "send %d bytes JSON: %.*s to L0 client\n",
+        (int)js->len, (int)js->len, js->buf);
+    #endif
+
+    mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, js->buf, js->len);
+    ksnHTTPFlush(kws->kh);
+}
+
+/**
+ * Send L0 packet of websocket client session to websocket client
+ *
+ * The welcome message is sent when L0 server has confirmed the client login.
+ *
+ * @param td Pointer to teoWSmapData
+ * @param cp Pointer to L0 packet
+ */
+static void session_answer(teoWSmapData *td, teoLNullCPacket *cp) {
+
+    if(cp->cmd == CMD_CONFIRM_AUTH && !td->welcome) {
+
+        char *name = cp->peer_name + cp->peer_name_length;
+        char *WELCOME_NET = ksnet_formatMessage("Hi %.*s! Welcome to Teonet!",
+                (int)strnlen(name, cp->data_length), name);
+        void *nc_p = td->nc_p;
+        mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, WELCOME_NET,
+                strlen(WELCOME_NET) + 1);
+        free(WELCOME_NET);
+        td->welcome = 1;
+    }
+
+    send_answer(td->kws, td->nc_p, cp);
+}
+
+/**
+ * In-process L0 client callback: send L0 packet to websocket client
+ *
+ * When L0 server disconnects the client (login rejected) the websocket client
+ * gets error message and is closed, the session is removed at websocket close.
+ *
+ * @param user_data Pointer to teoWSmapData
+ * @param packet Pointer to L0 packet or NULL if L0 client was disconnected
+ * @param packet_length Packet length
+ */
+static void local_cb(void *user_data, teoLNullCPacket *packet,
+        size_t packet_length) {
+
+    teoWSmapData *td = user_data;
+
+    if(packet != NULL) session_answer(td, packet);
+
+    // Skip disconnect made by session_close
+    else if(td->fd != -1) {
+
+        void *nc_p = td->nc_p;
+        const char *ERROR_NET = "Disconnected by Teonet L0 server";
+        td->fd = -1;
+        mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, ERROR_NET,
+                strlen(ERROR_NET) + 1);
+        nc->flags |= MG_F_SEND_AND_CLOSE;
+        ksnHTTPFlush(td->kws->kh);
+    }
+}
+
+/**
+ * Read data from L0 server connection of websocket client
+ *
  * @param loop
  * @param w
  * @param revents
  */
 static void read_cb(struct ev_loop *loop, struct ev_io *w, int revents) {
-    
-    teoLNullConnectData *con = w->data;
-    #define kev_t \
-    ((ksnetEvMgrClass*)((teoLNullConnectUserData*)con->user_data)->kws->kh->ke)
-    void *nc_p = ((teoLNullConnectUserData*)con->user_data)->nc_p;
-    
-    for(;;) {
-        
-        // Read data
-        ssize_t rc = teoLNullRecv(con);
-        
-        // Process received data
-        if(rc > 0) {
-            
-            teoLNullCPacket *cp = (teoLNullCPacket*) con->read_buffer;
-            char *data = cp->peer_name + cp->peer_name_length;
-            
-            #ifdef DEBUG_KSNET
-            ksn_printf(kev_t, MODULE, DEBUG_VV,
-                "receive %d bytes: %d bytes data from L0 server, "
-                "from peer %s, cmd = %d\n",
-                (int)rc, cp->data_length, cp->peer_name, cp->cmd);
-            #endif
-                        
-            // Define json type of data field
-            //
-            char *beg, *end;
-            jsmntype_t type = JSMN_UNDEFINED;
-            size_t num_of_tags = get_num_of_tags(data, cp->data_length);
-            if(num_of_tags) {
-                
-                // Parse json
-                jsmntok_t *t = malloc(num_of_tags * sizeof(jsmntok_t));
-                //
-                jsmn_parser p;
-                jsmn_init(&p);
-                int r = jsmn_parse(&p, data, cp->data_length, t, num_of_tags);    
-                if(!(r < 1)) type = t[0].type;
-                //
-                free(t);
-            }
-            
-            if(type == JSMN_STRING || type == JSMN_UNDEFINED) beg = end = "\"";
-            else beg = end = "";             
-            
-            char *data_str = data;
-            size_t data_len = cp->data_length;
-            if(cp->cmd == CMD_L_PEERS_ANSWER) {               
-                // Convert binary peer list data to json
-                data_str = ksnetArpShowDataJson((ksnet_arp_data_ar *) data, &data_len);
-                data_len--;
-                beg = end = ""; 
-            }
-            else if(cp->cmd == CMD_L_L0_CLIENTS_ANSWER) {
-                
-                // Convert binary client list data to json
-                teonet_client_data_ar *client_data_ar = (teonet_client_data_ar *) data;
-                data_str = malloc(sizeof(client_data_ar->client_data[0]) * 2 * client_data_ar->length);
-                int ptr = sprintf(data_str, "{ \"length\": %d, \"client_data_ar\": [ ", client_data_ar->length);
-                int i = 0;
-                for(i = 0; i < client_data_ar->length; i++) {
-                    ptr += sprintf(data_str + ptr, 
-                            "%s{ "
-                            "\"name\": \"%s\""
-                            " }", 
-                            i ? ", " : "", 
-                            client_data_ar->client_data[i].name
-                    );
-                }
-                sprintf(data_str + ptr, " ] }");
-                data_len = strlen(data_str);
-                beg = end = ""; 
-            }
-            else if(cp->cmd == CMD_L_SUBSCRIBE_ANSWER) {
-                
-                teoSScrData *sscr_data = (teoSScrData *) data;
-                data_len =  cp->data_length - sizeof(teoSScrData);
-                int b64_data_size = 2 * data_len + 4;
-                char *b64_data = malloc(b64_data_size);
-                mg_base64_encode((const unsigned char*)sscr_data->data, data_len, b64_data);
-                data_str = ksnet_formatMessage(
-                    "{ \"ev\": %d, \"cmd\": %d, \"data\": \"%s\" }", 
-                    sscr_data->ev, sscr_data->cmd, b64_data);
-                data_len = strlen(data_str);
-                free(b64_data);
-                beg = end = ""; 
-            }
-            else if(cp->cmd == CMD_L_ECHO && !num_of_tags) {
-                data_str = ksnet_formatMessage(
-                    "{ \"cmd\": %d, \"from\": \"%s\", \"data\": { \"msg\": \"%s\", \"time\": %f } }", 
-                    cp->cmd, cp->peer_name,    
-                    (char*)data, *((double*) (data + strlen((char*)data) + 1))
-                );
-                data_len = strlen(data_str);
-            }
-            else if(type == JSMN_UNDEFINED) {
-
-                // fix "can't show database JSON strings with quotas without slash"
-                char *st;                
-                if((st = strstr(data, "\"data\":")) != NULL) {
-                    
-                    char *data_new = malloc(cp->data_length*2);
-                    int i = st - data, j = i;
-                    size_t data_new_len = 0;
-                    
-                    // Add Text before 'data'
-                    memcpy(data_new, data, i);
-                    
-                    /*
-                     * state_f values:
-                     * 0 - find {
-                     * 1 - find " and replace to \"
-                     */
-                    int state_f = 0; // Set state to 0
-                    
-                    // Replace quotes inside data tag
-                    for(; i < cp->data_length;) {
-                        
-                        switch(state_f) {
-                            
-                            // State 0
-                            case 0:
-                                // Find begin of substring
-                                if(data[i] == '{') state_f = 1; // change state to 1                               
-                                break;
-                                
-                            // State 1
-                            case 1:
-                                // Find end of substring
-                                if(data[i] == '}') {
-                                    goto exit_loop; // exit from loop
-                                }
-                                // replace " to \"
-                                else if(data[i] == '"') {
-                                    data_new[j++] = '\\';
-                                }
-                                break;
-                                
-                            default:
-                                break;
-                        }
-                        data_new[j++] = data[i++];
-                    }
-                    exit_loop: ;
-                    
-                    // Add text after '}' of line
-                    memcpy(&data_new[j], &data[i], cp->data_length - i);
-                    data_new_len = j + cp->data_length - i;
-                    data_len = data_new_len;
-                    data_str = data_new;
-                    beg = end = "";
-                }                
-                else {                
-                    data_len = cp->data_length;
-                    int b64_data_size = 2 * data_len + 4;
-                    char *b64_data = malloc(b64_data_size);
-                    mg_base64_encode((const unsigned char*)data, data_len, b64_data);
-                    data_str = b64_data; //strdup("undefined"); 
-                    data_len = strlen(data_str);
-                }
-            }
 
-            // Create json data and send it to websocket client
-            size_t data_json_len = 128 + cp->data_length;
-            char *data_json = malloc(data_json_len);
-            data_json_len = snprintf(data_json, data_json_len, 
-                "{ \"cmd\": %d, \"from\": \"%s\", \"data\": %s%.*s%s }",
-                cp->cmd, cp->peer_name, 
-                beg, (int)data_len, data_str, end
-            );
-            
-            #ifdef DEBUG_KSNET
-            ksn_printf(kev_t, MODULE, DEBUG_VV,
-                "send %d bytes JSON: %s to L0 client\n",
-                data_json_len, data_json);
-            #endif
-
-            mg_send_websocket_frame(nc_p, WEBSOCKET_OP_TEXT, data_json, 
-                    data_json_len);                        
-            
-            if(data_str != data) free(data_str);
-            free(data_json);
-        }
-        else break;
+    teoWSmapData *td = w->data;
+
+    while(teoLNullRecv(td->con) > 0) {
+        session_answer(td, (teoLNullCPacket*) td->con->read_buffer);
     }
-    #undef kev_t
 }
 
 /**
- * Connect WS client with L0 server, add it to connected map and create READ 
- * watcher
- * 
+ * Attach WS client to L0 server, login and add it to sessions map
+ *
  * @param kws Pointer to teoWSClass
  * @param nc_p Pointer to websocket connector
- * @param server L0 Server name or IP
- * @param port L0 Server port
  * @param login L0 server login
- * 
- * @return Pointer to teoLNullConnectData or NULL if error
+ *
+ * @return Zero at success or -1 if error
  */
-static teoLNullConnectData *teoWSadd(teoWSClass *kws, void *nc_p, 
-        const char *server, const int port, char *login) {
-    
-    int rv = -1;
-    
-    // Connect to L0 server
-    teoLNullConnectData *con = teoLNullConnect(server, port, TCP);
-    con->user_data = malloc(sizeof(teoLNullConnectUserData));
-    ((teoLNullConnectUserData*)con->user_data)->kws = kws;
-            
-    if(con != NULL && con->fd > 0) {
-        
-        ssize_t snd = teoLNullLogin(con, login);
-        if(snd != -1) {
-
-            // Add to map
-            int rc;
-            teoWSmapData tws_map_data, *td;
-            tws_map_data.con = con;
-            size_t valueLength;
-            if((rc = pblMapAdd(kws->map, (void*)&nc_p, sizeof(nc_p), 
-                    &tws_map_data, sizeof(tws_map_data))) >= 0) {   
-               
-                if((td = pblMapGet(kws->map, (void*)&nc_p, sizeof(nc_p), 
-                        &valueLength)) != NULL) {
-                    
-                    // Create and start fd watcher
-                    ev_init (&td->w, read_cb);
-                    ev_io_set (&td->w, td->con->fd, EV_READ);
-                    td->w.data = con;
-                    ((teoLNullConnectUserData*)con->user_data)->nc_p = nc_p;
-                    ev_io_start (((ksnetEvMgrClass*)kws->kh->ke)->ev_loop, 
-                            &td->w);                
-
-                    #ifdef DEBUG_KSNET
-                    ksn_printf(kev, MODULE, DEBUG,
-                            "WS client %p has connected to L0 server ...\n", 
-                            nc_p);
-                    #endif
-
-                    // Send websocket welcome message
-                    char *WELCOME_NET = ksnet_formatMessage("Hi %s! Welcome to Teonet!", login);
-                    mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, WELCOME_NET, strlen(WELCOME_NET) + 1);
-                    free(WELCOME_NET);
-
-                    rv = 0;
-                }
-            }
+static int teoWSadd(teoWSClass *kws, void *nc_p, char *login) {
+
+    // Login of connected websocket client replaces its session
+    teoHashMapEntry *entry = teoHashMapGetEntry(kws->map, &nc_p, sizeof(nc_p));
+    if(entry != NULL) {
+        session_close(kws, entry->data);
+        teoHashMapRemoveEntry(kws->map, entry);
+    }
+
+    teoWSmapData *td = teoHashMapAdd(kws->map, &nc_p, sizeof(nc_p), NULL,
+            sizeof(teoWSmapData));
+    td->kws = kws;
+    td->nc_p = nc_p;
+    td->fd = -1;
+    td->con = NULL;
+    td->welcome = 0;
+
+    // Attach to in-process L0 server
+    if(kev->kl != NULL) {
+
+        char addr[48];
+        mg_sock_addr_to_str(&nc->sa, addr, sizeof(addr), MG_SOCK_STRINGIFY_IP);
+        td->fd = ksnLNullLocalClientConnect(kev->kl, addr, local_cb, td);
+        if(td->fd != -1 && ksnLNullLocalClientSend(kev->kl, td->fd, 0, "",
+                login, strlen(login) + 1) == -1) {
+
+            session_close(kws, td);
         }
+    }
 
-        // Disconnect from L0 server at error
-        if(rv) {
-            teoLNullDisconnectThis(con);
-            con = NULL;
+    // Connect to L0 server
+    else {
+
+        teoLNullConnectData *con = teoLNullConnect(
+                kws->kh->conf->l0_server_name, kws->kh->conf->l0_server_port,
+                TCP);
+        if(con != NULL && con->fd > 0 && teoLNullLogin(con, login) != -1) {
+
+            // Create and start fd watcher
+            con->user_data = td;
+            td->con = con;
+            ev_init (&td->w, read_cb);
+            ev_io_set (&td->w, con->fd, EV_READ);
+            td->w.data = td;
+            ev_io_start (kev->ev_loop, &td->w);
         }
-    } 
-    else con = NULL;
-    
-    return con;
+        else if(con != NULL) teoLNullDisconnect(con);
+    }
+
+    if(td->fd == -1 && td->con == NULL) {
+
+        teoHashMapRemove(kws->map, &nc_p, sizeof(nc_p));
+        return -1;
+    }
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(kev, MODULE, DEBUG,
+            "WS client %p has connected to L0 server ...\n",
+            nc_p);
+    #endif
+
+    return 0;
+}
+
+/**
+ * Detach WS client session from L0 server
+ *
+ * @param kws Pointer to teoWSClass
+ * @param td Pointer to teoWSmapData
+ */
+static void session_close(teoWSClass *kws, teoWSmapData *td) {
+
+    if(td->fd != -1) {
+        int fd = td->fd;
+        td->fd = -1;
+        ksnLNullClientDisconnect(kev->kl, fd, 1);
+    }
+    if(td->con != NULL) {
+        ev_io_stop(kev->ev_loop, &td->w); // stop watcher
+        teoLNullDisconnect(td->con); // disconnect connection to L0 server
+        td->con = NULL;
+    }
 }
 
 /*
- * Disconnect WS client from L0 server, remove it from connected map and stop 
- * READ watcher
- * 
+ * Detach WS client from L0 server and remove it from sessions map
+ *
  * @param kws Pointer to teoWSClass
  * @param nc_p Pointer to mg_connection structure
- * 
+ *
  * @return Return true at success
  */
 static int teoWSremove(teoWSClass *kws, void *nc_p) {
-    
-    int rv = 0;
-    
-    size_t valueLength;
-    //teoLNullConnectData *con;
-    teoWSmapData *td;
-    
-    if((td = pblMapGet(kws->map, (void*)&nc_p, sizeof(nc_p), &valueLength)) 
-            != NULL) { 
-        
-        ev_io_stop(((ksnetEvMgrClass*)kws->kh->ke)->ev_loop, &td->w); // stop watcher
-        teoLNullDisconnectThis(td->con); // disconnect connection to L0 server
-        pblMapRemoveFree(kws->map, (void*)&nc_p, sizeof(nc_p), &valueLength);
-        
-        #ifdef DEBUG_KSNET
-        ksn_printf(kev, MODULE, DEBUG,
-                "WS client %p has disconnected from L0 server ...\n", nc_p);        
-        #endif
-        
-        rv = 1;
-    }
-    
-    return rv;
+
+    teoHashMapEntry *entry = teoHashMapGetEntry(kws->map, &nc_p, sizeof(nc_p));
+    if(entry == NULL) return 0;
+
+    session_close(kws, entry->data);
+    teoHashMapRemoveEntry(kws->map, entry);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(kev, MODULE, DEBUG,
+            "WS client %p has disconnected from L0 server ...\n", nc_p);
+    #endif
+
+    return 1;
 }
 
 /**
@@ -475,9 +632,11 @@ static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
 /**
  * Send command to L0 server
  * 
- * Create L0 clients packet and send it to L0 server
+ * Create L0 clients packet and send it to L0 server from the WS client
+ * session
  * 
- * @param con Pointer to teoLNullConnectData
+ * @param kws Pointer to teoWSClass
+ * @param nc_p Pointer to mg_connection structure
  * @param cmd Command
  * @param peer_name Peer name to send to
  * @param data Pointer to data
@@ -488,16 +647,16 @@ static int jsoneq(const char *json, jsmntok_t *tok, const char *s) {
 static ssize_t teoWSLNullsend(teoWSClass *kws, void *nc_p, int cmd, 
         const char *to_peer_name, void *data, size_t data_length) {
 
-    teoWSmapData *td;    
     ssize_t snd = -1;
-    size_t valueLength;
-    
-    if((td = pblMapGet(kws->map, (void*)&nc_p, sizeof(nc_p), &valueLength)) 
-            != NULL) { 
+    teoWSmapData *td = teoHashMapGet(kws->map, &nc_p, sizeof(nc_p), NULL);
 
-        snd = teoLNullSend(td->con, cmd, to_peer_name, data, data_length);
+    if(td != NULL) {
+        if(td->fd != -1) snd = ksnLNullLocalClientSend(kev->kl, td->fd, cmd,
+                to_peer_name, data, data_length);
+        else if(td->con != NULL) snd = teoLNullSend(td->con, cmd,
+                to_peer_name, data, data_length);
     }
-    
+
     return snd;
 }
 
@@ -611,11 +770,8 @@ static int teoWSprocessMsg(teoWSClass *kws, void *nc_p, void *data,
                 "login from \"%s\" received\n", cmd_data);
         #endif
 
-        // Connect to L0 server
-        // \todo Send L0 server name and port in Login command or use WS host L0 server
-        if(kws->add(kws, nc_p, kws->kh->conf->l0_server_name, 
-           kws->kh->conf->l0_server_port, cmd_data) != NULL)        
-                processed = 1;
+        // Attach to L0 server
+        if(!kws->add(kws, nc_p, cmd_data)) processed = 1;
     }
     
     // Check for L0 websocket Peers command
@@ -712,11 +868,15 @@ static int teoWSprocessMsg(teoWSClass *kws, void *nc_p, void *data,
                 }
 
                 // Process and execute authenticate command
-                if(ALL_KEYS) {
+                if(keys & URL) {
 
                     teoAuthProcessCommand(kws->kh->ta, method, url, data, headers,
                             nc_p, send_auth_answer);
                 }
+                free(method);
+                free(url);
+                free(data);
+                free(headers);
             }
             free(t);
         }
@@ -747,6 +907,8 @@ static int teoWSprocessMsg(teoWSClass *kws, void *nc_p, void *data,
 /**
  * Send authenticate command answer
  * 
+ * Called in the event loop thread by authentication module.
+ * 
  * @param nc_p
  * @param err
  * @param result
@@ -759,4 +921,5 @@ static void send_auth_answer(void *nc_p, char* err, char *result) {
     char data[data_json_len + 1];
     data_json_len = snprintf(data, data_json_len, data_json, result);
     mg_send_websocket_frame(nc_p, WEBSOCKET_OP_TEXT, data, data_json_len);    
+    ksnHTTPFlush(((struct mg_connection *)nc_p)->mgr->user_data);
 }
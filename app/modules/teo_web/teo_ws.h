@@ -11,6 +11,18 @@
 #define	TEO_WS_H
 
 #include "teo_web.h"
+#include "utils/teo_hashmap.h"
+
+/**
+ * Streaming JSON encoder buffer
+ */
+typedef struct teoWSJson {
+    
+    char *buf; ///< Buffer
+    size_t len; ///< Length of encoded data
+    size_t size; ///< Buffer size
+    
+} teoWSJson;
 
 typedef struct teoWSClass teoWSClass;
 /**
@@ -19,7 +31,8 @@ typedef struct teoWSClass teoWSClass;
 struct teoWSClass {
     
     ksnHTTPClass *kh; ///< Pointer to ksnHTTPClass
-    PblMap* map; ///< Hash Map to store websocket clients
+    teoHashMap *map; ///< Hash Map to store websocket clients sessions
+    teoWSJson json; ///< Answers encoder buffer
     
     // Public methods
     
@@ -30,23 +43,18 @@ struct teoWSClass {
     void (*destroy)(teoWSClass *kws); 
     
     /**
-     * Connect WS client with L0 server and add it to connected map and create 
-     * READ watcher
+     * Attach WS client to L0 server, login and add it to sessions map
      * 
      * @param kws Pointer to teoWSClass
      * @param nc_p Pointer to websocket connector
-     * @param server L0 Server name or IP
-     * @param port L0 Server port
      * @param login L0 server login
      * 
-     * @return Pointer to teoLNullConnectData or NULL if error
+     * @return Zero at success or -1 if error
      */    
-    teoLNullConnectData * (*add)(teoWSClass *kws, void *nc_p, 
-                            const char *server, const int port, char *login);
+    int (*add)(teoWSClass *kws, void *nc_p, char *login);
     
     /*
-     * Disconnect WS client from L0 server, remove it from connected map and stop 
-     * READ watcher
+     * Detach WS client from L0 server and remove it from sessions map
      * 
      * @param kws Pointer to teoWSClass
      * @param nc_p Pointer to mg_connection structure
@@ -73,7 +81,8 @@ struct teoWSClass {
      * 
      * Create L0 clients packet and send it to L0 server
      * 
-     * @param con Pointer to teoLNullConnectData
+     * @param kws Pointer to teoWSClass
+     * @param nc_p Pointer to mg_connection structure
      * @param cmd Command
      * @param peer_name Peer name to send to
      * @param data Pointer to data
@@ -99,12 +108,20 @@ struct teoWSClass {
 };
 
 /**
- * Websocket L0 connector map data
+ * Websocket L0 connector map data (websocket client session)
+ *
+ * The session is attached to in-process L0 server as L0 client, so answers
+ * are routed to it by the client name. When this host does not run L0 server
+ * the session uses its own connection to L0 server.
  */
 typedef struct teoWSmapData {
     
-    teoLNullConnectData *con; ///< Pointer to L0 client connect data
+    teoWSClass *kws; ///< Pointer to teoWSClass
+    void *nc_p; ///< Pointer to mg_connection structure
+    int fd; ///< In-process L0 client fd or -1
+    teoLNullConnectData *con; ///< Pointer to L0 client connect data or NULL
     ev_io w; ///< L0 client watcher
+    int welcome; ///< Welcome message was sent after login confirmation
     
 } teoWSmapData;
 
@@ -0,0 +1,243 @@
+/**
+ * File:   teoweb_bench.c
+ * Author: Kirill Scherba <kirill@scherba.ru>
+ *
+ * Teonet HTTP/WS server benchmark
+ *
+ * Measures HTTP requests per second and websocket messages per second of
+ * running teoweb server:
+ *
+ * * HTTP: keeps the number of concurrent GET requests and counts replies
+ * * WS: opens websocket connections, each connection sends a message and
+ *   waits its broadcast echo before the next message; all broadcast frames
+ *   received by all connections are counted too
+ *
+ * Usage: teoweb_bench [host:port] [connections] [seconds]
+ *
+ * Created on October 19, 2026
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedded/mongoose/mongoose.h"
+
+#define BENCH_MSG_SIZE 64
+
+/**
+ * Benchmark state
+ */
+typedef struct teowebBench {
+
+    const char *addr; ///< Server address host:port
+    char url[128]; ///< Server URL
+    int connections; ///< Number of concurrent connections
+    int ws_ready; ///< Number of websocket connections after handshake
+    int stop; ///< Stop sending new requests
+    unsigned long requests; ///< HTTP replies received
+    unsigned long errors; ///< Connection errors
+    unsigned long sent; ///< Websocket messages sent
+    unsigned long echoes; ///< Own websocket messages received back
+    unsigned long frames; ///< Websocket frames received
+
+} teowebBench;
+
+/**
+ * Websocket client data
+ */
+typedef struct teowebBenchWS {
+
+    teowebBench *tb; ///< Pointer to teowebBench
+    int id; ///< Client number
+    unsigned seq; ///< Sent message sequence
+    char prefix[32]; ///< Own messages prefix
+
+} teowebBenchWS;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void http_ev_handler(struct mg_connection *nc, int ev, void *ev_data);
+
+/**
+ * Start new HTTP request
+ */
+static void http_request(struct mg_mgr *mgr, teowebBench *tb) {
+
+    struct mg_connection *nc = mg_connect_http(mgr, http_ev_handler, tb->url,
+            NULL, NULL);
+    if(nc == NULL) tb->errors++;
+    else nc->user_data = tb;
+}
+
+/**
+ * HTTP client event handler
+ */
+static void http_ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
+
+    teowebBench *tb = nc->user_data;
+
+    switch(ev) {
+
+        case MG_EV_CONNECT:
+            if(*(int *)ev_data) tb->errors++;
+            break;
+
+        case MG_EV_HTTP_REPLY:
+            tb->requests++;
+            nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            break;
+
+        // Keep the number of concurrent requests
+        case MG_EV_CLOSE:
+            if(!tb->stop) http_request(nc->mgr, tb);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Send next websocket message
+ */
+static void ws_send(struct mg_connection *nc, teowebBenchWS *tw) {
+
+    char msg[BENCH_MSG_SIZE];
+    int len = snprintf(msg, sizeof(msg), "%s%u", tw->prefix, tw->seq++);
+    mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, msg, len);
+    tw->tb->sent++;
+}
+
+/**
+ * Websocket client event handler
+ */
+static void ws_ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
+
+    teowebBenchWS *tw = nc->user_data;
+    struct websocket_message *wm = ev_data;
+
+    switch(ev) {
+
+        case MG_EV_CONNECT:
+            if(*(int *)ev_data) tw->tb->errors++;
+            else mg_send_websocket_handshake(nc, "/", NULL);
+            break;
+
+        case MG_EV_WEBSOCKET_HANDSHAKE_DONE:
+            tw->tb->ws_ready++;
+            break;
+
+        case MG_EV_WEBSOCKET_FRAME:
+            tw->tb->frames++;
+            // Own message was received back: send next one
+            if(memmem(wm->data, wm->size, tw->prefix, strlen(tw->prefix))) {
+                tw->tb->echoes++;
+                if(!tw->tb->stop) ws_send(nc, tw);
+            }
+            break;
+
+        case MG_EV_CLOSE:
+            free(tw);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Run HTTP requests benchmark
+ */
+static void bench_http(teowebBench *tb, double seconds) {
+
+    struct mg_mgr mgr;
+    int i;
+
+    mg_mgr_init(&mgr, tb);
+    tb->stop = 0;
+    for(i = 0; i < tb->connections; i++) http_request(&mgr, tb);
+
+    double t = now(), end = t + seconds;
+    while(now() < end) mg_mgr_poll(&mgr, 10);
+    t = now() - t;
+    tb->stop = 1;
+    mg_mgr_free(&mgr);
+
+    printf("HTTP: %lu requests, %lu errors, %.0f requests/s\n",
+            tb->requests, tb->errors, tb->requests / t);
+}
+
+/**
+ * Run websocket messages benchmark
+ */
+static void bench_ws(teowebBench *tb, double seconds) {
+
+    struct mg_mgr mgr;
+    struct mg_connection *nc;
+    int i;
+
+    mg_mgr_init(&mgr, tb);
+    tb->stop = 0;
+    tb->errors = 0;
+    for(i = 0; i < tb->connections; i++) {
+        nc = mg_connect(&mgr, tb->addr, ws_ev_handler);
+        if(nc == NULL) { tb->errors++; continue; }
+        teowebBenchWS *tw = calloc(1, sizeof(teowebBenchWS));
+        tw->tb = tb;
+        tw->id = i;
+        snprintf(tw->prefix, sizeof(tw->prefix), "bench-%d-", i);
+        nc->user_data = tw;
+        mg_set_protocol_http_websocket(nc);
+    }
+
+    // Wait all handshakes
+    double t = now(), end = t + 10.0;
+    while(tb->ws_ready + (int)tb->errors < tb->connections && now() < end)
+        mg_mgr_poll(&mgr, 10);
+
+    // Send first messages
+    for(nc = mg_next(&mgr, NULL); nc != NULL; nc = mg_next(&mgr, nc)) {
+        if(nc->flags & MG_F_IS_WEBSOCKET) ws_send(nc, nc->user_data);
+    }
+
+    t = now();
+    end = t + seconds;
+    while(now() < end) mg_mgr_poll(&mgr, 10);
+    t = now() - t;
+    tb->stop = 1;
+    mg_mgr_free(&mgr);
+
+    printf("WS: %d connections, %lu errors, %.0f messages/s sent, "
+            "%.0f echoes/s, %.0f frames/s received\n",
+            tb->ws_ready, tb->errors, tb->sent / t, tb->echoes / t,
+            tb->frames / t);
+}
+
+int main(int argc, char** argv) {
+
+    teowebBench tb;
+    memset(&tb, 0, sizeof(tb));
+    tb.addr = argc > 1 ? argv[1] : "127.0.0.1:8000";
+    tb.connections = argc > 2 ? atoi(argv[2]) : 16;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    if(tb.connections < 1 || seconds <= 0) {
+        fprintf(stderr, "Usage: %s [host:port] [connections] [seconds]\n",
+                argv[0]);
+        return 1;
+    }
+    snprintf(tb.url, sizeof(tb.url), "http://%s/", tb.addr);
+
+    printf("teoweb benchmark: %s, %d connections, %.1f s\n", tb.addr,
+            tb.connections, seconds);
+    bench_http(&tb, seconds);
+    bench_ws(&tb, seconds);
+
+    return 0;
+}
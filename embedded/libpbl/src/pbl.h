@@ -252,6 +252,16 @@ extern "C" {
 #define PBLLE               6
 #define PBLLT               7
 
+/** @name D: Definitions for Key File Durability
+  * DEFINES FOR PARAMETER <B> mode </B> OF \Ref{pblKfSetSync}()
+  * @field PBL_KF_SYNC_NONE         no fsync, kernel buffer cache only
+  * @field PBL_KF_SYNC_PERIODIC     fsync on flush every interval seconds
+  * @field PBL_KF_SYNC_FLUSH        fsync on every flush
+  */
+#define PBL_KF_SYNC_NONE        0
+#define PBL_KF_SYNC_PERIODIC    1
+#define PBL_KF_SYNC_FLUSH       2
+
 /** @name E: Definitions for ISAM Parameters
   * DEFINES FOR PARAMETER <B> which </B> OF \Ref{pblIsamGet}()
   * @field PBLTHIS                  get key and keylen of current record
@@ -1751,6 +1761,9 @@ extern int pblPriorityQueueJoin( /*                      */
  * FUNCTIONS ON KEY FILES
  */
 int                   pblKfInit  ( int nblocks );
+extern long           pblKfSetCacheBlocks( long nblocks );
+extern int            pblKfSetReadAhead( int nblocks );
+extern int            pblKfSetSync( int mode, long interval );
 extern pblKeyFile_t * pblKfCreate( char * path, void * filesettag );
 extern pblKeyFile_t * pblKfOpen  ( char * path, int update, void * filesettag );
 extern int            pblKfClose ( pblKeyFile_t * k );
@@ -67,6 +67,7 @@ char * pblkf_c_id = "$Id: pblkf.c,v 1.22 2010/05/30 20:06:45 peter Exp $";
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -289,6 +290,7 @@ typedef struct PBLBIGFILEHANDLE_s
 
     int    fh;                     /* filesystem handle                       */
     int    mode;                   /* open mode                               */
+    int    unsynced;               /* written to since the last fsync         */
 
     struct PBLBIGFILEHANDLE_s * next;
     struct PBLBIGFILEHANDLE_s * prev;
@@ -359,6 +361,25 @@ static int            pblnblocks;
 static int            pblblocksperfile = PBLBLOCKSPERFILE;
 static long           pblnfiles;
 
+/*
+ * size of the block cache shared by all open files, if set
+ */
+static long           pblcacheblocks;
+#define PBLCACHEBLOCKS  ( pblcacheblocks > 0 ? pblcacheblocks \
+                        : 8 + ( pblblocksperfile * pblnfiles ))
+
+/*
+ * number of blocks read ahead during sequential scans
+ */
+static int            pblreadahead;
+
+/*
+ * durability mode
+ */
+static int            pblsyncmode = PBL_KF_SYNC_NONE;
+static long           pblsyncinterval;
+static time_t         pbllastsync;
+
 /*
  * block reference hash table
  */
@@ -638,6 +659,54 @@ static PBLBIGFILEHANDLE_t * pbf_fh_find( int bf, int n )
     return( 0 );
 }
 
+/*
+ * flush a filesystem file to disk if it was written since the last sync
+ */
+static int pbf_fh_sync( PBLBIGFILEHANDLE_t * entry )
+{
+    int rc;
+
+    if( !entry->unsynced || pblsyncmode == PBL_KF_SYNC_NONE )
+    {
+        return( 0 );
+    }
+
+#ifdef _WIN32
+    rc = _commit( entry->fh );
+#else
+    rc = fsync( entry->fh );
+#endif
+    if( rc )
+    {
+        pbl_errno = PBL_ERROR_WRITE;
+        return( -1 );
+    }
+
+    entry->unsynced = 0;
+    return( 0 );
+}
+
+/*
+ * flush all filesystem files written since the last sync to disk,
+ * one fsync per file for all the blocks written to it
+ */
+static int pbf_sync( void )
+{
+    PBLBIGFILEHANDLE_t * entry;
+    int                  rc = 0;
+
+    for( entry = pbf_ft_head; entry; entry = entry->next )
+    {
+        if( pbf_fh_sync( entry ))
+        {
+            rc = -1;
+        }
+    }
+
+    pbllastsync = time( 0 );
+    return( rc );
+}
+
 /*
  * close files with the filesystem
  */
@@ -658,6 +727,7 @@ static void pbf_fh_close( int bf, int n )
 
             if( bf == tmp->bf )
             {
+                pbf_fh_sync( tmp );
                 close( tmp->fh );
                 PBL_LIST_UNLINK( pbf_ft_head, pbf_ft_tail, tmp, next, prev );
                 PBL_FREE( tmp );
@@ -676,6 +746,7 @@ static void pbf_fh_close( int bf, int n )
         return;
     }
 
+    pbf_fh_sync( entry );
     close( entry->fh );
 
     PBL_LIST_UNLINK( pbf_ft_head, pbf_ft_tail, entry, next, prev );
@@ -932,7 +1003,9 @@ unsigned char * buffer
     long       n;
     int        fh;
     int        i;
+#ifdef _WIN32
     int        j;
+#endif
     long       offset;
 
     if( bf < 0 || bf >= PBL_NFILES || !pbf_pool[ bf ].name )
@@ -963,6 +1036,7 @@ unsigned char * buffer
          */
         for( i = 0; i < 3; i++ )
         {
+#ifdef _WIN32
             /*
              * try the seek more than once if needed
              */
@@ -982,6 +1056,12 @@ unsigned char * buffer
             }
 
             rc = write( fh, buffer, (unsigned int) pbf_pool[ bf ].blocksize );
+#else
+            /*
+             * positioned write, no seek system call needed
+             */
+            rc = pwrite( fh, buffer, (size_t) pbf_pool[ bf ].blocksize, offset );
+#endif
             if( rc != pbf_pool[ bf ].blocksize )
             {
                 if( errno == EINTR )
@@ -999,6 +1079,10 @@ unsigned char * buffer
             return( -1 );
         }
 
+        /*
+         * pbf_fh_open moved the handle of the file to the head of the list
+         */
+        pbf_ft_head->unsynced = 1;
         pblnwrites++;
     }
     else
@@ -1008,6 +1092,7 @@ unsigned char * buffer
          */
         for( i = 0; i < 3; i++ )
         {
+#ifdef _WIN32
             /*
              * try the seek more than once if needed
              */
@@ -1027,6 +1112,12 @@ unsigned char * buffer
             }
 
             rc = read( fh, buffer, (unsigned int) pbf_pool[ bf ].blocksize );
+#else
+            /*
+             * positioned read, no seek system call needed
+             */
+            rc = pread( fh, buffer, (size_t) pbf_pool[ bf ].blocksize, offset );
+#endif
             if( rc < 0 )
             {
                 if( errno == EINTR )
@@ -1059,6 +1150,41 @@ unsigned char * buffer
     return( 0 );
 }
 
+/*
+ * tell the system we are going to read some blocks of a bigfile soon
+ */
+static void pbf_blockadvise( int bf, long blockno, long nblocks )
+{
+#ifdef POSIX_FADV_WILLNEED
+    int        fh;
+    long       n;
+
+    if( bf < 0 || bf >= PBL_NFILES || !pbf_pool[ bf ].name )
+    {
+        return;
+    }
+
+    n = blockno / pbf_pool[ bf ].blocksperfile;
+
+    fh = pbf_fh_open( pbf_pool[ bf ].name, pbf_pool[ bf ].mode, bf, n );
+    if( -1 == fh )
+    {
+        pbl_errno = 0;
+        return;
+    }
+
+    blockno %= pbf_pool[ bf ].blocksperfile;
+    if( blockno + nblocks > pbf_pool[ bf ].blocksperfile )
+    {
+        nblocks = pbf_pool[ bf ].blocksperfile - blockno;
+    }
+
+    posix_fadvise( fh, (off_t) blockno * pbf_pool[ bf ].blocksize,
+                   (off_t) nblocks * pbf_pool[ bf ].blocksize,
+                   POSIX_FADV_WILLNEED );
+#endif
+}
+
 /*
  * read a block from a bigfile
  */
@@ -2964,7 +3090,7 @@ static PBLBLOCK_t * pblBlockGetVictim( PBLKFILE_t * file )
      * if we have not exceeded the number of blocks we can have at most
      * or of the last block in the LRU chain is dirty and we are updating
      */
-    if(( pblnblocks < 8 + ( pblblocksperfile * pblnfiles ) )
+    if(( pblnblocks < PBLCACHEBLOCKS )
      ||( blockListTail && blockListTail->dirty
       && blockListTail->bf != -1 && file->writeableListHead ))
     {
@@ -3872,7 +3998,7 @@ static int pblBlockListTruncate( void )
     /*
      * truncate the list of blocks we have in memory
      */
-    while( pblnblocks >= 8 + ( pblblocksperfile * pblnfiles ) )
+    while( pblnblocks >= PBLCACHEBLOCKS )
     {
         block = blockListTail;
         if( !block )
@@ -3940,6 +4066,97 @@ int nblocks            /* number of blocks used per open file */
     return( pblblocksperfile );
 }
 
+/**
+ * set the size of the block cache shared by all open key files
+ *
+ * by default the cache holds \Ref{pblKfInit}() blocks per open file,
+ * with a shared size set the cache is not shrunk when files are closed
+ * and not grown when files are opened, so many small files opened
+ * at the same time share one large cache
+ *
+ * @return int rc: the number of blocks of the shared cache after the call,
+ *                 0 if the number of blocks per open file is used
+ */
+
+long pblKfSetCacheBlocks(
+long nblocks           /* number of blocks in cache, 0 to use blocks per file */
+)
+{
+    pbl_errno = 0;
+
+    if( nblocks < 1 )
+    {
+        nblocks = 0;
+    }
+    else if( nblocks < 8 )
+    {
+        nblocks = 8;
+    }
+
+    pblcacheblocks = nblocks;
+
+    return( pblcacheblocks );
+}
+
+/**
+ * set the number of blocks read ahead during sequential scans
+ *
+ * when \Ref{pblKfNext}() moves to the next block of the file, the
+ * system is advised to read that many blocks starting at the block
+ * following it, 0 switches the read ahead off
+ *
+ * @return int rc: the number of blocks read ahead after the call
+ */
+
+int pblKfSetReadAhead(
+int nblocks            /* number of blocks to read ahead */
+)
+{
+    pbl_errno = 0;
+
+    pblreadahead = nblocks > 0 ? nblocks : 0;
+
+    return( pblreadahead );
+}
+
+/**
+ * set the durability mode of key files
+ *
+ * PBL_KF_SYNC_NONE:     changes are written to the kernel buffer cache only,
+ *                       the default
+ *
+ * PBL_KF_SYNC_PERIODIC: \Ref{pblKfFlush}() syncs the files to disk
+ *                       if interval seconds passed since the last sync
+ *
+ * PBL_KF_SYNC_FLUSH:    every \Ref{pblKfFlush}() syncs the files to disk
+ *
+ * a sync calls fsync once for every filesystem file written to
+ * since the last sync by any of the open key files
+ *
+ * @return int rc == 0: call went ok
+ * @return int rc != 0: some error, see pbl_errno
+ */
+
+int pblKfSetSync(
+int  mode,             /* durability mode                               */
+long interval          /* sync interval for PBL_KF_SYNC_PERIODIC, seconds */
+)
+{
+    pbl_errno = 0;
+
+    if( mode < PBL_KF_SYNC_NONE || mode > PBL_KF_SYNC_FLUSH )
+    {
+        pbl_errno = PBL_ERROR_PARAM_MODE;
+        return( -1 );
+    }
+
+    pblsyncmode = mode;
+    pblsyncinterval = interval > 0 ? interval : 0;
+    pbllastsync = time( 0 );
+
+    return( 0 );
+}
+
 /*
  * FILE functions
  */
@@ -4568,6 +4785,20 @@ pblKeyFile_t * k   /** key file to flush */
     }
 
     rc = pblBlockListTruncate();
+    if( rc )
+    {
+        return( rc );
+    }
+
+    /*
+     * sync all files written to since the last sync
+     */
+    if( pblsyncmode == PBL_KF_SYNC_FLUSH
+     || ( pblsyncmode == PBL_KF_SYNC_PERIODIC
+       && time( 0 ) - pbllastsync >= pblsyncinterval ))
+    {
+        rc = pbf_sync();
+    }
 
     return( rc );
 }
@@ -6721,6 +6952,15 @@ size_t        * okeylen   /** length of the result key after return  */
                 break;
             }
 
+            /*
+             * read ahead the blocks following the next block
+             */
+            if( pblreadahead && block->nblock
+             && !pblBlockHashFind( block->nblock, kf->bf ))
+            {
+                pbf_blockadvise( kf->bf, block->nblock, pblreadahead );
+            }
+
             if( block->nentries )
             {
                 index = 0;
@@ -0,0 +1,203 @@
+/**
+ * \file   teoasync_bench.c
+ * \author max
+ *
+ * Teonet cross thread send benchmark.
+ *
+ * Sends messages to peer from 1, 2, 4 ... 32 producer threads with the
+ * submission ring API (teoAsyncRing*) and with the legacy async functions
+ * (ksnCoreSendCmdtoA) and prints messages per second for each run.
+ *
+ * Usage: teoasync_bench [options] <host_name> <peer> <messages>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ev_mgr.h"
+#include "modules/async_calls.h"
+
+#define TAB_VERSION "0.0.1"
+#define TAB_MAX_THREADS 32
+#define TAB_BATCH 64
+#define TAB_RING_SLOTS 1024
+#define TAB_DATA_SIZE 64
+
+static char *peer_name;
+static long num_messages = 100000;
+
+typedef struct bench_thread {
+    ksnetEvMgrClass *ke;
+    int ring_f; // Use submission ring
+    long sent;
+    long completed;
+} bench_thread;
+
+static double bench_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void complete_cb(int rv, void *user_data) {
+    ((bench_thread*)user_data)->completed++;
+}
+
+/**
+ * Producer thread
+ */
+static void *producer(void *arg) {
+
+    bench_thread *bt = arg;
+    char data[TAB_DATA_SIZE] = "teoasync_bench";
+
+    if(!bt->ring_f) {
+        for(bt->sent = 0; bt->sent < num_messages; bt->sent++) {
+            ksnCoreSendCmdtoA(bt->ke, peer_name, CMD_USER, data, sizeof(data));
+        }
+        bt->completed = bt->sent;
+        return NULL;
+    }
+
+    teoAsyncRing *ring = teoAsyncRingNew(bt->ke, TAB_RING_SLOTS);
+    for(bt->sent = 0; bt->sent < num_messages; ) {
+        int i;
+        for(i = 0; i < TAB_BATCH && bt->sent < num_messages; i++) {
+            if(teoAsyncRingSendCmdto(ring, peer_name, CMD_USER, data,
+                    sizeof(data), complete_cb, bt)) break;
+            bt->sent++;
+        }
+        teoAsyncRingSubmitBatch(ring);
+        if(!teoAsyncRingPollCompletions(ring) && !i) usleep(10);
+    }
+    while(teoAsyncRingPending(ring)) {
+        if(!teoAsyncRingPollCompletions(ring)) usleep(10);
+    }
+    teoAsyncRingFree(ring);
+
+    return NULL;
+}
+
+/**
+ * Run producers and return messages per second
+ */
+static double bench_run(ksnetEvMgrClass *ke, int num_threads, int ring_f) {
+
+    pthread_t tid[TAB_MAX_THREADS];
+    bench_thread bt[TAB_MAX_THREADS];
+
+    double start = bench_time();
+    int i;
+    for(i = 0; i < num_threads; i++) {
+        bt[i].ke = ke;
+        bt[i].ring_f = ring_f;
+        bt[i].sent = bt[i].completed = 0;
+        pthread_create(&tid[i], NULL, producer, &bt[i]);
+    }
+    long completed = 0;
+    for(i = 0; i < num_threads; i++) {
+        pthread_join(tid[i], NULL);
+        completed += bt[i].completed;
+    }
+
+    return completed / (bench_time() - start);
+}
+
+/**
+ * Benchmark controller thread
+ */
+static void *controller(void *arg) {
+
+    ksnetEvMgrClass *ke = arg;
+
+    printf("\nSend %ld messages of %d bytes per thread to peer '%s'\n\n",
+            num_messages, TAB_DATA_SIZE, peer_name);
+    printf("%8s %16s %16s\n", "threads", "ring, msg/s", "legacy, msg/s");
+
+    int num_threads;
+    for(num_threads = 1; num_threads <= TAB_MAX_THREADS; num_threads *= 2) {
+        double ring = bench_run(ke, num_threads, 1);
+        double legacy = bench_run(ke, num_threads, 0);
+        printf("%8d %16.0f %16.0f\n", num_threads, ring, legacy);
+    }
+
+    ksnetEvMgrStop(ke);
+
+    return NULL;
+}
+
+/**
+ * Teonet Events callback
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param event Teonet Event (ksnetEvMgrEvents)
+ * @param data Events data
+ * @param data_len Data length
+ * @param user_data Some user data (may be set in ksnetEvMgrInitPort)
+ */
+void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event, void *data,
+              size_t data_len, void *user_data) {
+
+    switch(event) {
+
+        // Start benchmark when teonet started
+        case EV_K_STARTED: {
+
+            if(ke->teo_cfg.app_argv[1][0]) peer_name = ke->teo_cfg.app_argv[1];
+            else peer_name = ksnetEvMgrGetHostName(ke);
+            if(atol(ke->teo_cfg.app_argv[2]) > 0)
+                num_messages = atol(ke->teo_cfg.app_argv[2]);
+
+            pthread_t tid;
+            pthread_create(&tid, NULL, controller, ke);
+            pthread_detach(tid);
+
+        } break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Main teoasync_bench application function
+ *
+ * @param argc Number of parameters
+ * @param argv Parameters array
+ *
+ * @return EXIT_SUCCESS
+ */
+int main(int argc, char** argv) {
+
+    printf("Teonet cross thread send benchmark ver " TAB_VERSION ", "
+           "based on teonet ver. " VERSION "\n");
+
+    // Application parameters
+    const char *app_argv[] = { "", "peer", "messages" };
+    const char *app_argv_descr[] = { "",
+        "Peer name to send messages to, \"\" - this host",
+        "Number of messages sent by each thread" };
+    ksnetEvMgrAppParam app_param;
+    app_param.app_argc = 3;
+    app_param.app_argv = app_argv;
+    app_param.app_descr = app_argv_descr;
+
+    // Initialize teonet event manager and Read configuration
+    ksnetEvMgrClass *ke = ksnetEvMgrInitPort(argc, argv, event_cb,
+            READ_OPTIONS|READ_CONFIGURATION|APP_PARAM, 0, &app_param);
+
+    // Set application type
+    teoSetAppType(ke, "teo-async-bench");
+    teoSetAppVersion(ke, TAB_VERSION);
+
+    // Start teonet
+    ksnetEvMgrRun(ke);
+
+    return (EXIT_SUCCESS);
+}
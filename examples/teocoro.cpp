@@ -0,0 +1,100 @@
+/**
+ * \file   teocoro.cpp
+ * \author max
+ *
+ * Teonet coroutines example.
+ *
+ * Run two applications: the first answers requests, the second sends
+ * requests to the first one from coroutine:
+ *
+ *   teocoro teo-coro-server ""
+ *   teocoro teo-coro-client teo-coro-server -r 9000 -a 127.0.0.1
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <iostream>
+
+#include "teonet.hpp"
+
+#define TCORO_VERSION "0.0.1"
+
+class MyTeonet : public teo::Teonet {
+
+public:
+  Coro co = Coro(this);
+  bool started = false;
+
+  MyTeonet(int argc, char** argv, teo::teoAppParam* app_param)
+      : teo::Teonet(argc, argv, NULL, READ_ALL | APP_PARAM, 0, app_param) {}
+
+  /**
+   * Send one request and than three requests at once
+   */
+  Task client(std::string peer) {
+
+    auto r = co_await co.request(peer, CMD_USER, std::string("Hello"), 2.0);
+    std::cout << "Got answer: " << (r.ok() ? r.getStr() : "timeout") << "\n";
+
+    auto r1 = co.request(peer, CMD_USER, std::string("One"), 2.0);
+    auto r2 = co.request(peer, CMD_USER, std::string("Two"), 2.0);
+    auto r3 = co.request(peer, CMD_USER, std::string("Three"), 2.0);
+    co_await co.whenAll(r1, r2, r3);
+    for(auto r : {&r1, &r2, &r3}) {
+      auto& res = r->getResponse();
+      std::cout << "Got answer: " << (res.ok() ? res.getStr() : "timeout") << "\n";
+    }
+
+    stop();
+  }
+
+  void eventCb(teo::teoEvents event, void* data, size_t data_len, void* user_data) override {
+
+    switch(event) {
+
+    // Start client when connected to server peer
+    case EV_K_CONNECTED: {
+      auto rd = getPacket(data);
+      if(!started && !strcmp(rd->from, getKe()->teo_cfg.app_argv[1])) {
+        started = true;
+        client(rd->from);
+      }
+    } break;
+
+    case EV_K_RECEIVED: {
+      if(co.process(event, data)) break;
+
+      // Answer requests
+      auto rd = getPacket(data);
+      if(rd->cmd == CMD_USER && Coro::isRequest(rd)) {
+        std::string answer = std::string("Answer to ") + (char*)Coro::getRequestData(rd);
+        co.answer(rd, CMD_USER + 1, answer);
+      }
+    } break;
+
+    default: break;
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+
+  std::cout << "Teocoro example ver " TCORO_VERSION ", "
+               "based on teonet ver. " VERSION "\n";
+
+  // Application parameters
+  const char* app_argv[] = {"", "server_peer"};
+  const char* app_argv_descr[] = {"", "Server peer name or \"\" in server mode"};
+  teo::teoAppParam app_param;
+  app_param.app_argc = 2;
+  app_param.app_argv = app_argv;
+  app_param.app_descr = app_argv_descr;
+
+  auto teo = new MyTeonet(argc, argv, &app_param);
+  teo->setAppType("teo-coro");
+  teo->setAppVersion(TCORO_VERSION);
+  teo->run();
+  delete(teo);
+
+  return (EXIT_SUCCESS);
+}
@@ -77,6 +77,11 @@ void set_defaults(teonet_cfg *teo_cfg) {
     teo_cfg->l0_allow_f = 0;
     teo_cfg->l0_tcp_port = teo_cfg->port;
     teo_cfg->l0_tcp_ip_remote[0] = '\0';
+    teo_cfg->l0_out_queue_high = 256 * 1024;
+    teo_cfg->l0_out_queue_low = 64 * 1024;
+    teo_cfg->l0_out_queue_max = 1024 * 1024;
+    teo_cfg->l0_slow_client_policy = 0;
+    teo_cfg->l0_auth_workers = 0;
     
     // Display log filter
     teo_cfg->filter[0] = '\0';
@@ -121,6 +126,17 @@ void set_defaults(teonet_cfg *teo_cfg) {
 
     // Send peers metric flag
     teo_cfg->statsd_peers_f = 0;
+
+    // Prometheus metrics scrape endpoint port
+    teo_cfg->metrics_port = 0;
+
+    // Teonet DB namespaces cache
+    teo_cfg->tdb_cache_size = 16;
+    teo_cfg->tdb_flush_writes = 1;
+    teo_cfg->tdb_block_cache = 8192;
+    teo_cfg->tdb_read_ahead = 8;
+    teo_cfg->tdb_sync = 0;
+    teo_cfg->tdb_sync_interval = 1;
     
 
     // Create prefix
@@ -191,6 +207,11 @@ void read_config(teonet_cfg *conf, int port_param) {
         CFG_SIMPLE_BOOL("l0_allow_f", (cfg_bool_t*)&conf->l0_allow_f),
         CFG_SIMPLE_INT("l0_tcp_port", &conf->l0_tcp_port),
         CFG_SIMPLE_STR("l0_tcp_ip_remote", &l0_tcp_ip_remote),
+        CFG_SIMPLE_INT("l0_out_queue_high", &conf->l0_out_queue_high),
+        CFG_SIMPLE_INT("l0_out_queue_low", &conf->l0_out_queue_low),
+        CFG_SIMPLE_INT("l0_out_queue_max", &conf->l0_out_queue_max),
+        CFG_SIMPLE_INT("l0_slow_client_policy", &conf->l0_slow_client_policy),
+        CFG_SIMPLE_INT("l0_auth_workers", &conf->l0_auth_workers),
 
         CFG_SIMPLE_STR("filter", &filter),
         
@@ -246,6 +267,14 @@ void read_config(teonet_cfg *conf, int port_param) {
         CFG_SIMPLE_STR("statsd_ip", &statsd_ip),
         CFG_SIMPLE_INT("statsd_port", &conf->statsd_port),
         CFG_SIMPLE_BOOL("statsd_peers_f", (cfg_bool_t*)&conf->statsd_peers_f),
+        CFG_SIMPLE_INT("metrics_port", &conf->metrics_port),
+
+        CFG_SIMPLE_INT("tdb_cache_size", &conf->tdb_cache_size),
+        CFG_SIMPLE_INT("tdb_flush_writes", &conf->tdb_flush_writes),
+        CFG_SIMPLE_INT("tdb_block_cache", &conf->tdb_block_cache),
+        CFG_SIMPLE_INT("tdb_read_ahead", &conf->tdb_read_ahead),
+        CFG_SIMPLE_INT("tdb_sync", &conf->tdb_sync),
+        CFG_SIMPLE_INT("tdb_sync_interval", &conf->tdb_sync_interval),
 
         CFG_END()
     };
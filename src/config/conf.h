@@ -20,9 +20,10 @@
 #define KSN_MAX_HOST_NAME 31
 #define NUMBER_TRY_PORTS 1000
 
-//#ifndef RELEASE_KSNET
+// Debug messages are compiled out in release build (--enable-release)
+#ifndef RELEASE_TEONET
 #define DEBUG_KSNET  1
-//#endif
+#endif
 
 #define KSNET_EVENT_MGR_TIMER 0.25  ///< Main event manager timer interval
 #define KSNET_PORT_DEFAULT "9000" ///< Main network port
@@ -103,6 +104,11 @@ typedef struct teonet_cfg {
     int  l0_allow_f;                             ///< Allow L0 Server and l0 client connections to this host
     char l0_tcp_ip_remote[KSN_BUFFER_SM_SIZE/2]; ///< L0 Server remote IP address (send clients to connect to server)
     long l0_tcp_port;                            ///< L0 Server TCP port number
+    long l0_out_queue_high;                      ///< L0 client output queue high watermark (bytes)
+    long l0_out_queue_low;                       ///< L0 client output queue low watermark (bytes)
+    long l0_out_queue_max;                       ///< L0 client output queue size limit (bytes)
+    long l0_slow_client_policy;                  ///< L0 client with full output queue: 0 - drop frames, 1 - disconnect
+    long l0_auth_workers;                        ///< L0 clients login verification threads, 0 - verify in event loop
     
     // Display log filter
     char filter[KSN_BUFFER_SM_SIZE/2];      ///<  Display log filter
@@ -136,6 +142,15 @@ typedef struct teonet_cfg {
     char statsd_ip[KSN_BUFFER_SM_SIZE/2];
     long statsd_port;
     int statsd_peers_f;
+    // Prometheus metrics scrape endpoint
+    long metrics_port;
+    // Teonet DB namespaces cache
+    long tdb_cache_size;                    ///< Number of cached namespace key files
+    long tdb_flush_writes;                  ///< Flush namespace key file after number of writes, 0 - on close
+    long tdb_block_cache;                   ///< Key files shared block cache size, blocks, 0 - per file cache
+    long tdb_read_ahead;                    ///< Key files scan read ahead, blocks
+    long tdb_sync;                          ///< Key files durability: 0 - none, 1 - periodic, 2 - on each flush
+    long tdb_sync_interval;                 ///< Key files periodic sync interval, seconds
     
     // Helpers
     int pp;
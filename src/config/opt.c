@@ -94,6 +94,7 @@ char ** ksnet_optRead(int argc, char **argv, teonet_cfg *conf,
         { "statsd_ip",      required_argument, 0, 's' },
         { "statsd_port",    required_argument, 0, 'S' },
         { "statsd_peers",   no_argument,       &conf->statsd_peers_f, 1 },
+        { "metrics_port",   required_argument, 0, 'M' },
 
         { "sig_segv",       no_argument,       &conf->sig_segv_f, 1 },
         { "log_priority",   required_argument, 0, 'L' }, 
@@ -243,6 +244,10 @@ char ** ksnet_optRead(int argc, char **argv, teonet_cfg *conf,
         case 'S':
           conf->statsd_port = atoi(optarg);
           break;
+
+        case 'M':
+          conf->metrics_port = atoi(optarg);
+          break;
           
         case 'L':
           conf->log_priority = atoi(optarg);
@@ -440,6 +445,7 @@ void opt_usage(char *app_name, int app_argc, char** app_argv) {
     "       --statsd_ip          Metric exporter IP address\n"
     "       --statsd_port        Metric exporter Port number\n"
     "       --statsd_peers       Send preers metrics\n"
+    "       --metrics_port       Prometheus metrics scrape endpoint port\n"
     "\n"
     "       --sig_segv           Segmentation fault error processing by library\n"
     "       --log_priority       Syslog priority (Default: 4):\n"
@@ -896,7 +896,7 @@ void idle_cb (EV_P_ ev_idle *w, int revents) {
         if(ke->ta) ke->ta->t_id = pthread_self();
         if(ke->event_cb != NULL) ke->event_cb(ke, EV_K_STARTED, NULL, 0, NULL);
         // Start host socket in the event manager
-        if(!ke->teo_cfg.r_tcp_f) {
+        if(!ke->teo_cfg.r_tcp_f && ke->transport == NULL) {
             ev_io_start(ke->ev_loop, &ke->kc->host_w);
         }
     }
@@ -927,9 +927,7 @@ void idle_cb (EV_P_ ev_idle *w, int revents) {
  */
 void timer_cb(EV_P_ ev_timer *w, int revents) {
 
-    #ifdef DEBUG_KSNET
     const int show_interval = 5 / KSNET_EVENT_MGR_TIMER;
-    #endif
     const int activity_interval = (CHECK_EVENTS_AFTER / 8) / KSNET_EVENT_MGR_TIMER;
     ksnetEvMgrClass *ke = w->data;
     double t = ksnetEvMgrGetTime(ke);
@@ -987,8 +985,8 @@ void timer_cb(EV_P_ ev_timer *w, int revents) {
  */
 void sigint_cb (struct ev_loop *loop, ev_signal *w, int revents) {
 
-    ksnetEvMgrClass *ke = (ksnetEvMgrClass *)w->data;
     #ifdef DEBUG_KSNET
+    ksnetEvMgrClass *ke = (ksnetEvMgrClass *)w->data;
     ksn_puts(ke, MODULE, DEBUG,
             "got a signal to stop event manager ...");
     #endif
@@ -1300,6 +1298,12 @@ int modules_init(ksnetEvMgrClass *ke) {
     // PBL KeyFile Module
     #if M_ENAMBE_PBLKF
     ke->kf = ksnTDBinit(ke);
+    ksnTDBcacheSet(ke->kf, ke->teo_cfg.tdb_cache_size > 0 ?
+            ke->teo_cfg.tdb_cache_size : 0, ke->teo_cfg.tdb_flush_writes > 0 ?
+            ke->teo_cfg.tdb_flush_writes : 0);
+    ksnTDBioSet(ke->kf, ke->teo_cfg.tdb_block_cache,
+            ke->teo_cfg.tdb_read_ahead, ke->teo_cfg.tdb_sync,
+            ke->teo_cfg.tdb_sync_interval);
     #endif
 
     // VPN Module
@@ -23,6 +23,7 @@
 #include "modules/teodb.h"
 #include "modules/stream.h"
 #include "modules/metric.h"
+#include "modules/net_sim.h"
 #include "modules/net_tcp.h"
 #include "modules/net_tun.h"
 #include "modules/net_term.h"
@@ -222,6 +223,30 @@ typedef enum ksnetEvMgrEvents {
  
     EV_K_LOG_READER,                ///< #29 LogReader read data.  
 
+    /**
+     * #30 L0 client output queue reached high watermark
+     *
+     * Parameters of Teonet Events callback function:
+     *
+     * @param ke Pointer to ksnetEvMgrClass
+     * @param event This event
+     * @param data Pointer to ksnLNullData of the client
+     * @param data_len Size of ksnLNullData
+     * @param user_data Pointer to int client fd
+     */
+    EV_K_L0_QUEUE_HIGH,             ///< #30 L0 client output queue reached high watermark
+    EV_K_L0_QUEUE_LOW,              ///< #31 L0 client output queue drained to low watermark, parameters as in EV_K_L0_QUEUE_HIGH
+
+    /**
+     * #32 Peers table changed
+     *
+     * Sent to subscribers only (CMD_SUBSCRIBE), once per event loop
+     * iteration. Event data is teoArpDeltaHeader with changes since previous
+     * event. Subscriber applies it if from_version is equal to version of its
+     * copy, otherwise it requests CMD_PEERS_DELTA.
+     */
+    EV_K_PEERS_CHANGED,             ///< #32 Peers table changed
+
     EV_K_APP_USER = 0x8000          ///< #0x8000 Teonet based Applications events
 
 } ksnetEvMgrEvents;
@@ -269,6 +294,8 @@ typedef struct ksnetEvMgrClass {
 
     teoMetricClass *tm; ///< Metric send module
 
+    teoTransport *transport; ///< Transport used instead of UDP socket or NULL
+
     int runEventMgr; ///< Run even manages (stop if 0)
     uint32_t timer_val; ///< Event loop timer value
     uint32_t idle_count; ///< Idle callback count
@@ -76,12 +76,27 @@ void hotkeysResetFilter(ksnetHotkeysClass *hotkeys) {
         free(hotkeys->filter);
         hotkeys->filter = NULL;
     }
+    if (hotkeys->filter_c != NULL) {
+        teoLogFilterFree(hotkeys->filter_c);
+        hotkeys->filter_c = NULL;
+    }
  }
 
+/**
+ * Set log filter
+ *
+ * The filter is compiled once here and then applied to each log line by
+ * teoLogCheck. If the filter can't be compiled the slow log_string_match
+ * parser is used for it.
+ *
+ * @param hotkeys Pointer to ksnetHotkeysClass
+ * @param filter Filter expression
+ */
 void teoHotkeySetFilter(ksnetHotkeysClass *hotkeys, char *filter) {
     hotkeysResetFilter(hotkeys);
     hotkeys->filter = malloc(strlen(filter) + 1);
     strncpy(hotkeys->filter, filter, strlen(filter) + 1);
+    hotkeys->filter_c = teoLogFilterCompile(filter);
  }
 
  
@@ -99,7 +114,10 @@ unsigned char teoFilterFlagCheck(void *ke) {
 unsigned char teoLogCheck(void *ke, void *log) {
 
     if ((log != NULL) && (khv != NULL) && (khv->filter != NULL)) {
-        if (log_string_match((char *)log, khv->filter)) return 1;
+        if (khv->filter_c != NULL) {
+            if (teoLogFilterMatch(khv->filter_c, (char *)log)) return 1;
+        }
+        else if (log_string_match((char *)log, khv->filter)) return 1;
     } else return 1;
     return 0;
 }
@@ -617,6 +635,7 @@ ksnetHotkeysClass *ksnetHotkeysInit(void *ke) {
     kh->pet = NULL;
     kh->put = NULL;
     kh->filter = NULL;
+    kh->filter_c = NULL;
     kh->filter_f = 1;
     kh->ke = ke;
 
@@ -659,6 +678,7 @@ void ksnetHotkeysDestroy(ksnetHotkeysClass *kh) {
         
         ev_io_stop (ke->ev_loop, &kh->stdin_w);
         _keys_non_blocking_stop(kh);
+        hotkeysResetFilter(kh);
         free(kh);
         ke->kh = NULL;
     }
@@ -22,6 +22,7 @@
 #include "net_core.h"
 
 #include "utils/string_arr.h"
+#include "text-filter/text-filter.h"
 /**
  * Ping timer data
  */
@@ -97,6 +98,7 @@ typedef struct ksnetHotkeysClass  {
 
     unsigned filter_f;
     char *filter;
+    teoLogFilter *filter_c; ///< Compiled filter
 
     ping_timer_data *pt; ///< Hotkey Pinger timer data
     monitor_timer_data *mt; ///< Hotkey Monitor timer data
@@ -1,3 +1,5 @@
+#include <stdatomic.h>
+
 #include "ev_mgr.h"
 #include "async_calls.h"
 
@@ -249,6 +251,8 @@ static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event, void *data,
     }
 }
 
+static void ring_cb(EV_P_ ev_async *w, int revents);
+
 teoAsyncClass *teoAsyncInit(void *ke) {
 
     teoAsyncClass *ta = malloc(sizeof(teoAsyncClass));
@@ -264,6 +268,13 @@ teoAsyncClass *teoAsyncInit(void *ke) {
     pthread_cond_init(&ta->cv_threshold, NULL);
     pthread_mutex_init(&ta->cv_mutex, NULL);
 
+    // Initialize submission rings watcher
+    pthread_mutex_init(&ta->rings_mutex, NULL);
+    ta->rings = NULL;
+    ev_async_init(&ta->ring_w, ring_cb);
+    ta->ring_w.data = ta;
+    ev_async_start(kev->ev_loop, &ta->ring_w);
+
     #ifdef DEBUG_KSNET
     ksn_puts(kev, MODULE, DEBUG_VV,
             "have been initialized");
@@ -274,6 +285,8 @@ teoAsyncClass *teoAsyncInit(void *ke) {
 
 void teoAsyncDestroy(teoAsyncClass *ta) {
 
+    ev_async_stop(((ksnetEvMgrClass*)ta->ke)->ev_loop, &ta->ring_w);
+    pthread_mutex_destroy(&ta->rings_mutex);
     pthread_mutex_destroy(&ta->async_func_mutex);
     pthread_cond_destroy(&ta->cv_threshold);
     pthread_mutex_destroy(&ta->cv_mutex);
@@ -487,6 +500,363 @@ void teoSScrSubscribeA(teoSScrClass *sscr, char *peer, uint16_t ev) {
     else teoSScrSubscribe(kev->kc->kco->ksscr, (char*)peer, ev);
 }
 
+/******************************************************************************/
+/* Submission rings                                                           */
+/*                                                                            */
+/******************************************************************************/
+
+/**
+ * Submission ring slot
+ */
+typedef struct teoAsyncSlot {
+
+    uint8_t f_type; // Function type: ASYNC_FUNC
+    uint8_t cmd;
+    uint8_t l0_f;
+    uint16_t name_length; // Peer or L0 client name length
+    uint16_t event;
+    uint32_t port;
+    int rv; // Result set by event loop
+    teoAsyncCompleteCb cb;
+    void *user_data;
+    char name[KSN_BUFFER_SM_SIZE]; // Peer or L0 client name
+    char addr[KSN_BUFFER_64_SIZE]; // Peer address
+    void *data; // Points to inline_data or to allocated data
+    size_t data_length;
+    char inline_data[TEO_ASYNC_RING_DATA_SIZE];
+
+} teoAsyncSlot;
+
+/**
+ * Submission ring: single producer (owner thread), single consumer (event
+ * loop). Slots between tail and head are submitted to the event loop; slots
+ * between reclaimed and tail are processed and wait for completion in
+ * producer thread; slots between head and staged are filled but not
+ * submitted yet.
+ */
+struct teoAsyncRing {
+
+    teoAsyncClass *ta;
+    teoAsyncRing *next; // Next ring in teoAsyncClass rings list
+    teoAsyncSlot *slots;
+    size_t mask; // Number of slots - 1
+    atomic_size_t head; // Submitted by producer
+    atomic_size_t tail; // Processed by event loop
+    size_t staged; // Filled by producer (producer only)
+    size_t reclaimed; // Completed (producer only)
+};
+
+/**
+ * Create submission ring for current thread
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param slots Number of slots, rounded up to power of two
+ *
+ * @return Pointer to teoAsyncRing, should be freed with teoAsyncRingFree
+ */
+teoAsyncRing *teoAsyncRingNew(void *ke, size_t slots) {
+
+    size_t size = 2;
+    while(size < slots) size <<= 1;
+
+    teoAsyncRing *ring = malloc(sizeof(teoAsyncRing));
+    ring->ta = kev->ta;
+    ring->slots = malloc(size * sizeof(teoAsyncSlot));
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->staged = 0;
+    ring->reclaimed = 0;
+
+    pthread_mutex_lock(&ring->ta->rings_mutex);
+    ring->next = ring->ta->rings;
+    ring->ta->rings = ring;
+    pthread_mutex_unlock(&ring->ta->rings_mutex);
+
+    return ring;
+}
+
+/**
+ * Free submission ring
+ *
+ * Runs completion callbacks of processed messages, not processed messages
+ * are dropped. Should be called before the event manager is stopped.
+ *
+ * @param ring Pointer to teoAsyncRing
+ */
+void teoAsyncRingFree(teoAsyncRing *ring) {
+
+    if(ring == NULL) return;
+
+    teoAsyncClass *ta = ring->ta;
+    pthread_mutex_lock(&ta->rings_mutex);
+    teoAsyncRing **r;
+    for(r = &ta->rings; *r; r = &(*r)->next) {
+        if(*r == ring) { *r = ring->next; break; }
+    }
+    pthread_mutex_unlock(&ta->rings_mutex);
+
+    teoAsyncRingPollCompletions(ring);
+    for(; ring->reclaimed != ring->staged; ring->reclaimed++) {
+        teoAsyncSlot *slot = &ring->slots[ring->reclaimed & ring->mask];
+        if(slot->data != slot->inline_data) free(slot->data);
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+/**
+ * Get next free slot of submission ring
+ *
+ * @return Pointer to slot or NULL if ring is full
+ */
+static teoAsyncSlot *ringReserve(teoAsyncRing *ring, void *data,
+        size_t data_length, teoAsyncCompleteCb cb, void *user_data) {
+
+    if(ring->staged - ring->reclaimed > ring->mask) {
+        teoAsyncRingPollCompletions(ring);
+        if(ring->staged - ring->reclaimed > ring->mask) return NULL;
+    }
+
+    teoAsyncSlot *slot = &ring->slots[ring->staged & ring->mask];
+    slot->cb = cb;
+    slot->user_data = user_data;
+    slot->data_length = data_length;
+    slot->data = data_length <= TEO_ASYNC_RING_DATA_SIZE ? slot->inline_data :
+            malloc(data_length);
+    if(data_length) memcpy(slot->data, data, data_length);
+
+    return slot;
+}
+
+/**
+ * Put send command by name to peer to submission ring
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @param peer Peer name
+ * @param cmd Command
+ * @param data Commands data
+ * @param data_length Commands data length
+ * @param cb Completion callback or NULL
+ * @param user_data Completion callback user data
+ *
+ * @return 0 on success; -1 if ring is full (submit and poll completions)
+ */
+int teoAsyncRingSendCmdto(teoAsyncRing *ring, const char *peer, uint8_t cmd,
+        void *data, size_t data_length, teoAsyncCompleteCb cb,
+        void *user_data) {
+
+    size_t peer_length = strlen(peer) + 1;
+    if(peer_length > KSN_BUFFER_SM_SIZE) return -1;
+
+    teoAsyncSlot *slot = ringReserve(ring, data, data_length, cb, user_data);
+    if(slot == NULL) return -1;
+    slot->f_type = KSN_CORE_SEND_CMD_TO;
+    slot->cmd = cmd;
+    slot->name_length = peer_length;
+    memcpy(slot->name, peer, peer_length);
+    ring->staged++;
+
+    return 0;
+}
+
+/**
+ * Put send event to all subscribers to submission ring
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @param event Event
+ * @param data Event data
+ * @param data_length Event data length
+ * @param cmd Command
+ * @param cb Completion callback or NULL
+ * @param user_data Completion callback user data
+ *
+ * @return 0 on success; -1 if ring is full (submit and poll completions)
+ */
+int teoAsyncRingSScrSend(teoAsyncRing *ring, uint16_t event, void *data,
+        size_t data_length, uint8_t cmd, teoAsyncCompleteCb cb,
+        void *user_data) {
+
+    teoAsyncSlot *slot = ringReserve(ring, data, data_length, cb, user_data);
+    if(slot == NULL) return -1;
+    slot->f_type = TEO_SSCR_SEND;
+    slot->cmd = cmd;
+    slot->event = event;
+    ring->staged++;
+
+    return 0;
+}
+
+/**
+ * Put send answer to L0 client or to peer address to submission ring
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @param rdp Pointer to ksnCorePacketData of request
+ * @param cmd Command
+ * @param data Commands data
+ * @param data_length Commands data length
+ * @param cb Completion callback or NULL
+ * @param user_data Completion callback user data
+ *
+ * @return 0 on success; -1 if ring is full (submit and poll completions)
+ */
+int teoAsyncRingSendCmdAnswerTo(teoAsyncRing *ring, void *rdp, uint8_t cmd,
+        void *data, size_t data_length, teoAsyncCompleteCb cb,
+        void *user_data) {
+
+    ksnCorePacketData *rd = rdp;
+    size_t addr_length = strlen(rd->addr) + 1;
+    if(addr_length > KSN_BUFFER_64_SIZE) return -1;
+
+    teoAsyncSlot *slot = ringReserve(ring, data, data_length, cb, user_data);
+    if(slot == NULL) return -1;
+    slot->f_type = SEND_CMD_ANSWER_TO;
+    slot->cmd = cmd;
+    slot->l0_f = rd->l0_f;
+    slot->port = rd->port;
+    memcpy(slot->addr, rd->addr, addr_length);
+    slot->name_length = rd->from_len;
+    memcpy(slot->name, rd->from, rd->from_len);
+    ring->staged++;
+
+    return 0;
+}
+
+/**
+ * Submit all messages put to the ring since previous submit
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @return Number of submitted messages
+ */
+int teoAsyncRingSubmitBatch(teoAsyncRing *ring) {
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int num = ring->staged - head;
+    if(num) {
+        atomic_store_explicit(&ring->head, ring->staged, memory_order_release);
+        ev_async_send(((ksnetEvMgrClass*)ring->ta->ke)->ev_loop,
+                &ring->ta->ring_w);
+    }
+
+    return num;
+}
+
+/**
+ * Run completion callbacks of messages processed by event loop and release
+ * their slots. Should be called in producer thread.
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @return Number of completed messages
+ */
+int teoAsyncRingPollCompletions(teoAsyncRing *ring) {
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    int num = 0;
+    for(; ring->reclaimed != tail; ring->reclaimed++, num++) {
+        teoAsyncSlot *slot = &ring->slots[ring->reclaimed & ring->mask];
+        if(slot->cb) slot->cb(slot->rv, slot->user_data);
+        if(slot->data != slot->inline_data) free(slot->data);
+    }
+
+    return num;
+}
+
+/**
+ * Get number of not completed messages in the ring
+ *
+ * @param ring Pointer to teoAsyncRing
+ * @return Number of messages put to the ring and not completed yet
+ */
+size_t teoAsyncRingPending(teoAsyncRing *ring) {
+    return ring->staged - ring->reclaimed;
+}
+
+/**
+ * Get number of async calls waiting for the event loop
+ *
+ * @param ta Pointer to teoAsyncClass
+ * @return Number of submitted ring messages and async queue records not
+ *         processed yet
+ */
+size_t teoAsyncQueueDepth(teoAsyncClass *ta) {
+
+    ksnetEvMgrClass *ke = ta->ke;
+    size_t depth = 0;
+
+    pthread_mutex_lock(&ta->rings_mutex);
+    teoAsyncRing *ring;
+    for(ring = ta->rings; ring; ring = ring->next) {
+        depth += atomic_load_explicit(&ring->head, memory_order_acquire) -
+                 atomic_load_explicit(&ring->tail, memory_order_acquire);
+    }
+    pthread_mutex_unlock(&ta->rings_mutex);
+
+    pthread_mutex_lock(&ke->async_mutex);
+    depth += pblListSize(ke->async_queue);
+    pthread_mutex_unlock(&ke->async_mutex);
+
+    return depth;
+}
+
+/**
+ * Execute submission ring slot in event loop
+ */
+static void ringExec(void *ke, teoAsyncSlot *slot) {
+
+    switch(slot->f_type) {
+
+        case KSN_CORE_SEND_CMD_TO:
+            slot->rv = _check_send_queue(ke, slot->name, NULL, 0);
+            ksnCoreSendCmdto(kev->kc, slot->name, slot->cmd, slot->data,
+                    slot->data_length);
+            break;
+
+        case TEO_SSCR_SEND:
+            slot->rv = 0;
+            teoSScrSend(kev->kc->kco->ksscr, slot->event, slot->data,
+                    slot->data_length, slot->cmd);
+            break;
+
+        case SEND_CMD_ANSWER_TO:
+            slot->rv = _check_send_queue(ke, NULL, slot->addr, slot->port);
+            if(slot->l0_f) ksnLNullSendToL0(ke, slot->addr, slot->port,
+                    slot->name, slot->name_length, slot->cmd, slot->data,
+                    slot->data_length);
+            else ksnCoreSendto(kev->kc, slot->addr, slot->port, slot->cmd,
+                    slot->data, slot->data_length);
+            break;
+
+        default:
+            slot->rv = CHSQ_WRONG_REQUEST;
+            break;
+    }
+}
+
+/**
+ * Submission rings async callback: process submitted slots of all rings
+ */
+static void ring_cb(EV_P_ ev_async *w, int revents) {
+
+    teoAsyncClass *ta = w->data;
+    int more = 0;
+
+    pthread_mutex_lock(&ta->rings_mutex);
+    teoAsyncRing *ring;
+    for(ring = ta->rings; ring; ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        int num;
+        for(num = 0; tail != head && num < TEO_ASYNC_RING_BUDGET; num++, tail++)
+            ringExec(ta->ke, &ring->slots[tail & ring->mask]);
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        if(tail != head) more = 1;
+    }
+    pthread_mutex_unlock(&ta->rings_mutex);
+
+    // Continue at next loop iteration to not block other events
+    if(more) ev_async_send(EV_A_ w);
+}
+
 void teoAsyncTest(void *ke) {
 
     #ifdef DEBUG_KSNET
@@ -10,6 +10,24 @@
 
 #include "subscribe.h"
 
+#define TEO_ASYNC_RING_DATA_SIZE 512 ///< Data size stored in submission ring slot without allocation
+#define TEO_ASYNC_RING_BUDGET 1024 ///< Maximum number of slots processed from one ring per loop iteration
+
+/**
+ * Submission ring completion callback, called in producer thread by
+ * teoAsyncRingPollCompletions
+ *
+ * @param rv Send queue size of the peer channel at send time (>= 0) or
+ *           negative value if peer or address was not found
+ * @param user_data Pointer to user data
+ */
+typedef void (*teoAsyncCompleteCb)(int rv, void *user_data);
+
+/**
+ * Per producer thread submission ring
+ */
+typedef struct teoAsyncRing teoAsyncRing;
+
 /**
  * Teonet Async class data definition
  */
@@ -23,6 +41,9 @@ typedef struct teoAsyncClass {
     pthread_mutex_t cv_mutex; // Condition variables mutex
     pthread_cond_t cv_threshold; // Condition variable threshold
     pthread_mutex_t async_func_mutex; // Async functions mutex
+    pthread_mutex_t rings_mutex; // Submission rings list mutex
+    teoAsyncRing *rings; // Submission rings list
+    ev_async ring_w; // Submission rings watcher
 
 } teoAsyncClass;
 
@@ -68,6 +89,30 @@ void sendCmdAnswerToBinaryA(void *ke, void *rd, uint8_t cmd, void *data,
  */
 void teoSScrSubscribeA(teoSScrClass *sscr, char *peer_name, uint16_t ev);
 
+// Submission rings
+//
+// A producer thread creates its own ring, puts messages to it with
+// teoAsyncRing* send functions and makes them visible to the event loop with
+// one teoAsyncRingSubmitBatch call. Messages are copied to preallocated ring
+// slots, and the hand-off between producer and event loop does not take
+// locks. Completion callbacks run in the producer thread when it calls
+// teoAsyncRingPollCompletions.
+
+teoAsyncRing *teoAsyncRingNew(void *ke, size_t slots);
+void teoAsyncRingFree(teoAsyncRing *ring);
+int teoAsyncRingSendCmdto(teoAsyncRing *ring, const char *peer, uint8_t cmd,
+        void *data, size_t data_length, teoAsyncCompleteCb cb, void *user_data);
+int teoAsyncRingSScrSend(teoAsyncRing *ring, uint16_t event, void *data,
+        size_t data_length, uint8_t cmd, teoAsyncCompleteCb cb, void *user_data);
+int teoAsyncRingSendCmdAnswerTo(teoAsyncRing *ring, void *rd, uint8_t cmd,
+        void *data, size_t data_length, teoAsyncCompleteCb cb, void *user_data);
+int teoAsyncRingSubmitBatch(teoAsyncRing *ring);
+int teoAsyncRingPollCompletions(teoAsyncRing *ring);
+size_t teoAsyncRingPending(teoAsyncRing *ring);
+
+// Number of async calls waiting for the event loop
+size_t teoAsyncQueueDepth(teoAsyncClass *ta);
+
 #ifdef __cplusplus
 }
 #endif
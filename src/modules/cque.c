@@ -29,6 +29,7 @@
 
 #include "ev_mgr.h"
 #include "cque.h"
+#include "utils/teo_trace.h"
 
 #define kev ((ksnetEvMgrClass*)(kq->ke))
 
@@ -46,7 +47,7 @@ ksnCQueClass *ksnCQueInit(void *ke, uint8_t send_event) {
     if(kq != NULL) {
         kq->ke = ke; // Pointer event manager class
         kq->event_f = send_event ? 1 : 0; // Send cque event if true
-        kq->cque_map = pblMapNewHashMap(); // Create a new hash map
+        kq->cque_map = teoHashMapNew(); // Create a new hash map
         kq->id = 0; // New callback queue id
     }
 
@@ -60,22 +61,18 @@ ksnCQueClass *ksnCQueInit(void *ke, uint8_t send_event) {
  */
 static int teoCqueStopAll(ksnCQueClass *kq) {
     int retval = -1;
-    PblIterator *it =  pblMapIteratorNew(kq->cque_map);
+    teoHashMapIter it;
+    teoHashMapEntry *entry;
 
+    teoHashMapIterInit(kq->cque_map, &it);
+    while((entry = teoHashMapIterNext(&it))) {
+        ksnCQueData *cq = entry->data;
 
-    if(it != NULL) {
-        while(pblIteratorHasNext(it)) {
-            void *entry = pblIteratorNext(it);
-            ksnCQueData *cq = pblMapEntryValue(entry);
-
-            if(cq != NULL && cq->timeout > 0.0 && ksnetEvMgrStatus(kev) == kEventMgrRunning) {
-                ev_timer_stop(kev->ev_loop, &cq->w);
-            }
-
+        if(cq->timeout > 0.0 && ksnetEvMgrStatus(kev) == kEventMgrRunning) {
+            ev_timer_stop(kev->ev_loop, &cq->w);
         }
-        pblIteratorFree(it);
-        pblMapClear(kq->cque_map);
     }
+    teoHashMapClear(kq->cque_map);
 
     return retval;
 }
@@ -88,7 +85,7 @@ static int teoCqueStopAll(ksnCQueClass *kq) {
 void ksnCQueDestroy(ksnCQueClass *kq) {
     if(kq != NULL) {
         teoCqueStopAll(kq);
-        pblMapFree(kq->cque_map);
+        teoHashMapFree(kq->cque_map);
         free(kq);
     }
 }
@@ -107,9 +104,7 @@ int ksnCQueExec(ksnCQueClass *kq, uint32_t id) {
 
     const int type = 1;
     int retval = -1;
-    size_t data_len;
-
-    ksnCQueData *cq = pblMapGet(kq->cque_map, &id, sizeof(id), &data_len);
+    ksnCQueData *cq = teoHashMapGetInt(kq->cque_map, id, NULL);
 
     if(cq != NULL) {
 
@@ -118,6 +113,7 @@ int ksnCQueExec(ksnCQueClass *kq, uint32_t id) {
             ev_timer_stop(kev->ev_loop, &cq->w);
 
         // Execute queue callback
+        TEO_TRACE2(cque_exec, id, type);
         if(cq->cb != NULL)
             cq->cb(id, type, cq->data); // Type 1: successful callback
 
@@ -127,10 +123,8 @@ int ksnCQueExec(ksnCQueClass *kq, uint32_t id) {
                     (void*)&type);
 
         // Remove record from queue
-        if(pblMapRemoveFree(kq->cque_map, &id, sizeof(id), &data_len) != (void*)-1) {
-
-            retval = 0;
-        }
+        teoHashMapRemoveInt(kq->cque_map, id);
+        retval = 0;
     }
 
     return retval;
@@ -146,9 +140,7 @@ int ksnCQueExec(ksnCQueClass *kq, uint32_t id) {
  */
 int ksnCQueRemove(ksnCQueClass *kq, uint32_t id) {
     int retval = -1;
-    size_t data_len;
-
-    ksnCQueData *cq = pblMapGet(kq->cque_map, &id, sizeof(id), &data_len);
+    ksnCQueData *cq = teoHashMapGetInt(kq->cque_map, id, NULL);
     if(cq != NULL) {
 
         // Stop watcher
@@ -156,10 +148,8 @@ int ksnCQueRemove(ksnCQueClass *kq, uint32_t id) {
             ev_timer_stop(kev->ev_loop, &cq->w);
 
         // Remove record from queue
-        if(pblMapRemoveFree(kq->cque_map, &id, sizeof(id), &data_len) != (void*)-1) {
-
-            retval = 0;
-        }
+        teoHashMapRemoveInt(kq->cque_map, id);
+        retval = 0;
     }
 
     return retval;
@@ -178,8 +168,7 @@ int ksnCQueRemove(ksnCQueClass *kq, uint32_t id) {
 int ksnCQueSetData(ksnCQueClass *kq, uint32_t id, void *data) {
 
     int retval = -1;
-    size_t data_len;
-    ksnCQueData *cq = pblMapGet(kq->cque_map, &id, sizeof(id), &data_len);
+    ksnCQueData *cq = teoHashMapGetInt(kq->cque_map, id, NULL);
     if(cq != NULL) {
 
        cq->data = data;
@@ -200,8 +189,7 @@ int ksnCQueSetData(ksnCQueClass *kq, uint32_t id, void *data) {
 void * ksnCQueGetData(ksnCQueClass *kq, uint32_t id) {
 
     void * retval = NULL;
-    size_t data_len;
-    ksnCQueData *cq = pblMapGet(kq->cque_map, &id, sizeof(id), &data_len);
+    ksnCQueData *cq = teoHashMapGetInt(kq->cque_map, id, NULL);
     if(cq != NULL) {
 
        retval = cq->data;
@@ -226,6 +214,7 @@ void cq_timer_cb(EV_P_ ev_timer *w, int revents) {
     ev_timer_stop(EV_A_ w);
 
     // Execute queue callback
+    TEO_TRACE2(cque_exec, cq->id, type);
     if(cq->cb != NULL)
         cq->cb(cq->id, type, cq->data); // Type 0: timeout callback
 
@@ -237,11 +226,7 @@ void cq_timer_cb(EV_P_ ev_timer *w, int revents) {
     #undef kev2
 
     // Remove record from Callback Queue
-    size_t data_len;
-    if(pblMapRemoveFree(cq->kq->cque_map, &cq->id, sizeof(cq->id),
-            &data_len) != (void*)-1) {
-        // Do something in success
-    }
+    teoHashMapRemoveInt(cq->kq->cque_map, cq->id);
 
     #undef cq
 }
@@ -263,26 +248,25 @@ ksnCQueData *ksnCQueAdd(ksnCQueClass *kq, ksnCQueCallback cb, double timeout,
     ksnCQueData data_new, *cq = NULL; // Create CQue data buffer
     if(!kq->id) kq->id++; // Skip ID = 0
     uint32_t id = kq->id++; // Get new ID
-    size_t data_len; // Length of data
 
     // Set Callback Queue data
     data_new.kq = kq; // ksnCQueClass
     data_new.id = id; // ID
     data_new.cb = cb; // Callback
     data_new.data = data; // User data
+    data_new.timeout = 0.0; // No timeout watcher
 
     // Add data to the Callback Queue
-    if(pblMapAdd(kq->cque_map, &id, sizeof(id), &data_new, sizeof(data_new)) >= 0) {
-        // If successfully added get real ksnCQueData pointer and start timeout
-        // watcher
-        cq = pblMapGet(kq->cque_map, &id, sizeof(id), &data_len);
-        if(cq != NULL && timeout > 0.0) {
+    if((cq = teoHashMapAddInt(kq->cque_map, id, &data_new, sizeof(data_new)))) {
+        // Start timeout watcher of real ksnCQueData
+        if(timeout > 0.0) {
             // Initialize, set user data and start the timer
             cq->timeout = timeout;
             ev_timer_init(&cq->w, cq_timer_cb, timeout, 0.0);
             cq->w.data = cq; // Watcher data link to the ksnCQueData
             ev_timer_start(kev->ev_loop, &cq->w);
         }
+        TEO_TRACE2(cque_add, id, (long)(timeout * 1000));
     }
 
     return cq;
@@ -301,18 +285,17 @@ ksnCQueData *ksnCQueAdd(ksnCQueClass *kq, ksnCQueCallback cb, double timeout,
 void *ksnCQueFindData(ksnCQueClass *kq, void* find, ksnCQueCompare compare, size_t *key_length) {
 
     void *key = NULL;
-    PblIterator *it = pblMapIteratorNew(kq->cque_map);
-    if(it != NULL) {
-        while(pblIteratorHasNext(it)) {
-            void *entry = pblIteratorNext(it);
-            ksnCQueData *data =  pblMapEntryValue(entry);
-            if(compare(find, data->data)) {
-                key = pblMapEntryKey(entry);
-                if(key_length) *key_length = pblMapEntryKeyLength(entry);
-                break;
-            }
+    teoHashMapIter it;
+    teoHashMapEntry *entry;
+
+    teoHashMapIterInit(kq->cque_map, &it);
+    while((entry = teoHashMapIterNext(&it))) {
+        ksnCQueData *data = entry->data;
+        if(compare(find, data->data)) {
+            key = entry->key;
+            if(key_length) *key_length = entry->key_len;
+            break;
         }
-        pblIteratorFree(it);
     }
     return key;
 }
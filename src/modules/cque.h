@@ -12,6 +12,8 @@
 #include <pbl.h>
 #include <stdint.h>
 
+#include "utils/teo_hashmap.h"
+
 /**
  * ksnCQue Class structure definition
  */
@@ -19,7 +21,7 @@ typedef struct ksnCQueClass {
     
     void *ke; ///< Pointer to ksnEvMgrClass
     uint32_t id; ///< New callback queue ID
-    PblMap *cque_map; ///< Pointer to the callback queue pblMap
+    teoHashMap *cque_map; ///< Pointer to the callback queue map
     uint8_t event_f; ///< Send cque event if true
     
 } ksnCQueClass;
@@ -0,0 +1,399 @@
+/**
+ * \file   l0-auth.c
+ * \author max
+ *
+ * L0 server clients login verification.
+ *
+ * The signature is MD5(userId + secret + timestamp), so the hash state can't
+ * be prepared before the client name is known. The secret and its length are
+ * prepared once, signatures are compared as binary digests, and verified
+ * signatures are cached until their timestamp.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <openssl/md5.h>
+#include <openssl/crypto.h>
+
+#include "l0-auth.h"
+#include "jsmn.h"
+
+#define SIGN_LEN (MD5_DIGEST_LENGTH * 2) ///< Hex signature length
+
+/**
+ * Cached verified credentials, stored by signature
+ */
+typedef struct teoL0AuthCacheData {
+    size_t name_len;
+    size_t valid_until_len;
+    char data[];              ///< Name and timestamp
+} teoL0AuthCacheData;
+
+/**
+ * Worker thread job
+ */
+struct teoL0AuthJob {
+    teoL0AuthJob *next;
+    int fd;                   ///< Client fd
+    uint32_t seq;             ///< Client login sequence number
+    int verified;             ///< Verification result
+    teoL0AuthData ad;         ///< Credentials, point to data
+    char data[];              ///< Name, timestamp and signature
+};
+
+static void *auth_worker(void *arg);
+static void auth_done_cb(struct ev_loop *loop, ev_async *w, int revents);
+
+/**
+ * Create L0 login verification class
+ *
+ * @param loop Event loop
+ * @param secret Server secret
+ * @param workers_num Number of worker threads, 0 - verify in the event loop
+ * @param cb Worker thread result callback
+ * @param user_data Worker thread result callback user data
+ *
+ * @return Pointer to teoL0Auth, should be free with teoL0AuthFree
+ */
+teoL0Auth *teoL0AuthNew(struct ev_loop *loop, const char *secret,
+        int workers_num, teoL0AuthCb cb, void *user_data) {
+
+    teoL0Auth *la = calloc(1, sizeof(teoL0Auth));
+    la->loop = loop;
+    la->secret = strdup(secret);
+    la->secret_len = strlen(secret);
+    la->cache = teoHashMapNew();
+    la->cb = cb;
+    la->user_data = user_data;
+
+    if(workers_num > 0 && cb != NULL) {
+
+        pthread_mutex_init(&la->mutex, NULL);
+        pthread_cond_init(&la->cond, NULL);
+        ev_async_init(&la->done_w, auth_done_cb);
+        la->done_w.data = la;
+        ev_async_start(loop, &la->done_w);
+
+        la->workers = malloc(workers_num * sizeof(pthread_t));
+        for(; la->workers_num < workers_num; la->workers_num++) {
+            if(pthread_create(&la->workers[la->workers_num], NULL,
+                    auth_worker, la)) break;
+        }
+    }
+
+    return la;
+}
+
+/**
+ * Free L0 login verification class
+ *
+ * Jobs not verified yet are dropped.
+ *
+ * @param la Pointer to teoL0Auth
+ */
+void teoL0AuthFree(teoL0Auth *la) {
+
+    teoL0AuthJob *job;
+    int i;
+
+    if(la == NULL) return;
+
+    if(la->workers != NULL) {
+        pthread_mutex_lock(&la->mutex);
+        la->stop = 1;
+        pthread_cond_broadcast(&la->cond);
+        pthread_mutex_unlock(&la->mutex);
+        for(i = 0; i < la->workers_num; i++) pthread_join(la->workers[i], NULL);
+        free(la->workers);
+
+        ev_async_stop(la->loop, &la->done_w);
+        while((job = la->jobs) != NULL) { la->jobs = job->next; free(job); }
+        while((job = la->done) != NULL) { la->done = job->next; free(job); }
+        pthread_cond_destroy(&la->cond);
+        pthread_mutex_destroy(&la->mutex);
+    }
+
+    teoHashMapFree(la->cache);
+    free(la->secret);
+    free(la);
+}
+
+static int json_eq(const char *json, jsmntok_t *tok, const char *s) {
+    return tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start
+            && !strncmp(json + tok->start, s, tok->end - tok->start);
+}
+
+/**
+ * Parse login payload
+ *
+ * @param payload Zero terminated JSON login payload
+ * @param ad [out] Credentials, point to payload
+ *
+ * @return True if all credentials fields are present
+ */
+int teoL0AuthParse(const char *payload, teoL0AuthData *ad) {
+
+    jsmn_parser p;
+    jsmntok_t tokens[128];
+    int i;
+
+    memset(ad, 0, sizeof(*ad));
+
+    jsmn_init(&p);
+    int token_num = jsmn_parse(&p, payload, strlen(payload), tokens,
+            sizeof(tokens) / sizeof(tokens[0]));
+    if(token_num < 1 || tokens[0].type != JSMN_OBJECT) return 0;
+
+    for(i = 1; i + 1 < token_num; i++) {
+        const char *value = payload + tokens[i + 1].start;
+        size_t value_len = tokens[i + 1].end - tokens[i + 1].start;
+        if(json_eq(payload, &tokens[i], "userId")) {
+            ad->name = value;
+            ad->name_len = value_len;
+            i++;
+        } else if(json_eq(payload, &tokens[i], "sign")) {
+            ad->sign = value;
+            ad->sign_len = value_len;
+            i++;
+        } else if(json_eq(payload, &tokens[i], "timestamp")) {
+            ad->valid_until = value;
+            ad->valid_until_len = value_len;
+            i++;
+        }
+    }
+
+    return ad->name != NULL && ad->sign != NULL && ad->valid_until != NULL;
+}
+
+/**
+ * Check credentials timestamp is not outdated
+ *
+ * @param ad Credentials
+ * @param now Current time
+ *
+ * @return True if timestamp is not less than current time
+ */
+int teoL0AuthTimeValid(teoL0AuthData *ad, long now) {
+
+    char now_str[32];
+    size_t now_len = snprintf(now_str, sizeof(now_str), "%ld", now);
+
+    return !(now_len > ad->valid_until_len || (now_len == ad->valid_until_len
+            && strncmp(ad->valid_until, now_str, now_len) < 0));
+}
+
+static inline int hex_digit(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * Verify credentials signature
+ *
+ * @param secret Server secret
+ * @param secret_len Server secret length
+ * @param ad Credentials
+ *
+ * @return True if signature is valid
+ */
+int teoL0AuthVerify(const char *secret, size_t secret_len, teoL0AuthData *ad) {
+
+    unsigned char sign[MD5_DIGEST_LENGTH], digest[MD5_DIGEST_LENGTH];
+    int i;
+
+    // Signature is lower case hex string
+    if(ad->sign_len != SIGN_LEN) return 0;
+    for(i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        int hi = hex_digit(ad->sign[i * 2]), lo = hex_digit(ad->sign[i * 2 + 1]);
+        if(hi < 0 || lo < 0) return 0;
+        sign[i] = hi << 4 | lo;
+    }
+
+    MD5_CTX ctx;
+    MD5_Init(&ctx);
+    MD5_Update(&ctx, ad->name, ad->name_len);
+    MD5_Update(&ctx, secret, secret_len);
+    MD5_Update(&ctx, ad->valid_until, ad->valid_until_len);
+    MD5_Final(digest, &ctx);
+
+    return !CRYPTO_memcmp(digest, sign, MD5_DIGEST_LENGTH);
+}
+
+/**
+ * Check credentials are in cache
+ *
+ * Outdated credentials found in cache are removed.
+ */
+static int cache_check(teoL0Auth *la, teoL0AuthData *ad, long now) {
+
+    teoHashMapEntry *e = teoHashMapGetEntry(la->cache, ad->sign, ad->sign_len);
+    if(e == NULL) return 0;
+
+    teoL0AuthCacheData *cd = e->data;
+    teoL0AuthData cad = { .valid_until = cd->data + cd->name_len,
+            .valid_until_len = cd->valid_until_len };
+    if(!teoL0AuthTimeValid(&cad, now)) {
+        teoHashMapRemoveEntry(la->cache, e);
+        return 0;
+    }
+
+    return cd->name_len == ad->name_len &&
+            cd->valid_until_len == ad->valid_until_len &&
+            !memcmp(cd->data, ad->name, ad->name_len) &&
+            !memcmp(cd->data + cd->name_len, ad->valid_until,
+                ad->valid_until_len);
+}
+
+/**
+ * Add verified credentials to cache
+ *
+ * The first added credentials are removed when cache is full.
+ */
+static void cache_add(teoL0Auth *la, teoL0AuthData *ad) {
+
+    if(teoHashMapSize(la->cache) >= TEO_L0_AUTH_CACHE_SIZE)
+        teoHashMapRemoveEntry(la->cache, la->cache->first);
+
+    teoL0AuthCacheData *cd = teoHashMapAdd(la->cache, ad->sign, ad->sign_len,
+            NULL, sizeof(teoL0AuthCacheData) + ad->name_len +
+            ad->valid_until_len);
+    cd->name_len = ad->name_len;
+    cd->valid_until_len = ad->valid_until_len;
+    memcpy(cd->data, ad->name, ad->name_len);
+    memcpy(cd->data + ad->name_len, ad->valid_until, ad->valid_until_len);
+}
+
+/**
+ * Check login credentials
+ *
+ * Credentials are verified from cache, by worker thread if workers are
+ * started or in the calling thread.
+ *
+ * @param la Pointer to teoL0Auth
+ * @param ad Credentials
+ * @param now Current time
+ * @param fd Client fd returned to worker thread result callback
+ * @param seq Client login sequence number returned to worker thread result
+ *            callback
+ *
+ * @return TEO_L0_AUTH_OK, TEO_L0_AUTH_FAILED or TEO_L0_AUTH_PENDING if
+ *         result will be sent to worker thread result callback
+ */
+teoL0AuthResult teoL0AuthCheck(teoL0Auth *la, teoL0AuthData *ad, long now,
+        int fd, uint32_t seq) {
+
+    la->stat.checks++;
+
+    if(ad->sign_len != SIGN_LEN || !teoL0AuthTimeValid(ad, now)) {
+        la->stat.failed++;
+        return TEO_L0_AUTH_FAILED;
+    }
+
+    if(cache_check(la, ad, now)) {
+        la->stat.cache_hits++;
+        return TEO_L0_AUTH_OK;
+    }
+
+    // Send to worker thread
+    if(la->workers_num) {
+
+        size_t data_len = ad->name_len + ad->valid_until_len + ad->sign_len;
+        teoL0AuthJob *job = malloc(sizeof(teoL0AuthJob) + data_len);
+        job->next = NULL;
+        job->fd = fd;
+        job->seq = seq;
+        job->verified = 0;
+        job->ad.name = memcpy(job->data, ad->name, ad->name_len);
+        job->ad.name_len = ad->name_len;
+        job->ad.valid_until = memcpy(job->data + ad->name_len,
+                ad->valid_until, ad->valid_until_len);
+        job->ad.valid_until_len = ad->valid_until_len;
+        job->ad.sign = memcpy(job->data + ad->name_len + ad->valid_until_len,
+                ad->sign, ad->sign_len);
+        job->ad.sign_len = ad->sign_len;
+
+        pthread_mutex_lock(&la->mutex);
+        if(la->jobs_last != NULL) la->jobs_last->next = job;
+        else la->jobs = job;
+        la->jobs_last = job;
+        pthread_cond_signal(&la->cond);
+        pthread_mutex_unlock(&la->mutex);
+
+        la->stat.offloaded++;
+        return TEO_L0_AUTH_PENDING;
+    }
+
+    la->stat.hashed++;
+    if(!teoL0AuthVerify(la->secret, la->secret_len, ad)) {
+        la->stat.failed++;
+        return TEO_L0_AUTH_FAILED;
+    }
+    cache_add(la, ad);
+
+    return TEO_L0_AUTH_OK;
+}
+
+/**
+ * Worker thread function
+ */
+static void *auth_worker(void *arg) {
+
+    teoL0Auth *la = arg;
+    teoL0AuthJob *job;
+
+    pthread_mutex_lock(&la->mutex);
+    for(;;) {
+        while(la->jobs == NULL && !la->stop)
+            pthread_cond_wait(&la->cond, &la->mutex);
+        if(la->stop) break;
+
+        job = la->jobs;
+        la->jobs = job->next;
+        if(la->jobs == NULL) la->jobs_last = NULL;
+        pthread_mutex_unlock(&la->mutex);
+
+        job->verified = teoL0AuthVerify(la->secret, la->secret_len, &job->ad);
+
+        pthread_mutex_lock(&la->mutex);
+        job->next = la->done;
+        la->done = job;
+        ev_async_send(la->loop, &la->done_w);
+    }
+    pthread_mutex_unlock(&la->mutex);
+
+    return NULL;
+}
+
+/**
+ * Verified jobs callback, called in the event loop
+ */
+static void auth_done_cb(struct ev_loop *loop, ev_async *w, int revents) {
+
+    teoL0Auth *la = w->data;
+    teoL0AuthJob *done, *job, *fifo = NULL;
+
+    pthread_mutex_lock(&la->mutex);
+    done = la->done;
+    la->done = NULL;
+    pthread_mutex_unlock(&la->mutex);
+
+    // Return results in order of verification
+    while((job = done) != NULL) {
+        done = job->next;
+        job->next = fifo;
+        fifo = job;
+    }
+
+    while((job = fifo) != NULL) {
+        fifo = job->next;
+        la->stat.hashed++;
+        if(job->verified) cache_add(la, &job->ad);
+        else la->stat.failed++;
+        la->cb(la->user_data, job->fd, job->seq, &job->ad, job->verified);
+        free(job);
+    }
+}
@@ -0,0 +1,116 @@
+/**
+ * \file   l0-auth.h
+ * \author max
+ *
+ * L0 server clients login verification.
+ *
+ * Login payload is JSON object with "userId", "timestamp" and "sign" fields,
+ * where sign is hex MD5 of userId, server secret and timestamp. Verified
+ * signatures are cached until their timestamp, so clients reconnecting with
+ * the same credentials are verified without hashing. Signatures missing in
+ * the cache may be verified by worker threads, results are returned to the
+ * event loop.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#ifndef L0_AUTH_H
+#define L0_AUTH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <ev.h>
+
+#include "utils/teo_hashmap.h"
+
+#define TEO_L0_AUTH_CACHE_SIZE 16384 ///< Maximum number of cached signatures
+
+/**
+ * Login check result
+ */
+typedef enum teoL0AuthResult {
+    TEO_L0_AUTH_FAILED = 0,  ///< Wrong or outdated credentials
+    TEO_L0_AUTH_OK,          ///< Credentials verified
+    TEO_L0_AUTH_PENDING      ///< Credentials are verified by worker thread
+} teoL0AuthResult;
+
+/**
+ * Login credentials, fields point to login payload
+ */
+typedef struct teoL0AuthData {
+    const char *name;         ///< User id
+    size_t name_len;
+    const char *valid_until;  ///< Timestamp credentials are valid until
+    size_t valid_until_len;
+    const char *sign;         ///< Hex MD5 signature
+    size_t sign_len;
+} teoL0AuthData;
+
+/**
+ * Worker thread verification result callback, called in the event loop
+ *
+ * @param user_data User data
+ * @param fd Client fd passed to teoL0AuthCheck
+ * @param seq Login sequence number passed to teoL0AuthCheck
+ * @param ad Verified credentials, valid during the call
+ * @param verified True if credentials are verified
+ */
+typedef void (*teoL0AuthCb)(void *user_data, int fd, uint32_t seq,
+        teoL0AuthData *ad, int verified);
+
+/**
+ * Login verification statistic
+ */
+typedef struct teoL0AuthStat {
+    uint64_t checks;      ///< Logins checked
+    uint64_t cache_hits;  ///< Logins verified from cache
+    uint64_t hashed;      ///< Signatures hashed
+    uint64_t offloaded;   ///< Signatures sent to worker threads
+    uint64_t failed;      ///< Logins failed
+} teoL0AuthStat;
+
+typedef struct teoL0AuthJob teoL0AuthJob;
+
+/**
+ * L0 login verification class
+ */
+typedef struct teoL0Auth {
+    struct ev_loop *loop;     ///< Event loop
+    char *secret;             ///< Server secret
+    size_t secret_len;        ///< Server secret length
+    teoHashMap *cache;        ///< Verified signatures: sign -> credentials
+    teoL0AuthStat stat;       ///< Statistic
+
+    teoL0AuthCb cb;           ///< Worker thread result callback
+    void *user_data;          ///< Worker thread result callback user data
+    int workers_num;          ///< Number of worker threads, 0 - no workers
+    pthread_t *workers;       ///< Worker threads
+    pthread_mutex_t mutex;    ///< Jobs queues mutex
+    pthread_cond_t cond;      ///< New job condition
+    teoL0AuthJob *jobs;       ///< Jobs queue head
+    teoL0AuthJob *jobs_last;  ///< Jobs queue tail
+    teoL0AuthJob *done;       ///< Verified jobs
+    int stop;                 ///< Stop worker threads
+    ev_async done_w;          ///< Verified jobs watcher
+} teoL0Auth;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+teoL0Auth *teoL0AuthNew(struct ev_loop *loop, const char *secret,
+        int workers_num, teoL0AuthCb cb, void *user_data);
+void teoL0AuthFree(teoL0Auth *la);
+
+int teoL0AuthParse(const char *payload, teoL0AuthData *ad);
+int teoL0AuthTimeValid(teoL0AuthData *ad, long now);
+int teoL0AuthVerify(const char *secret, size_t secret_len, teoL0AuthData *ad);
+teoL0AuthResult teoL0AuthCheck(teoL0Auth *la, teoL0AuthData *ad, long now,
+        int fd, uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* L0_AUTH_H */
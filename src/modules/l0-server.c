@@ -12,16 +12,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
 
 #include "ev_mgr.h"
 #include "l0-server.h"
 #include "utils/rlutil.h"
+#include "utils/teo_trace.h"
 #include "jsmn.h"
 
 #include "teonet_l0_client_crypt.h"
 
-#include <openssl/md5.h>
-
 #define MODULE _ANSI_LIGHTCYAN "l0_server" _ANSI_NONE
 #define TEO_AUTH "teo-auth"
 #define WG001 "wg001-"
@@ -34,8 +36,19 @@ static ksnet_arp_data *ksnLNullSendFromL0(ksnLNullClass *kl, teoLNullCPacket *pa
         char *cname, size_t cname_length);
 static ksnLNullData* ksnLNullClientRegister(ksnLNullClass *kl, int fd, const char *remote_addr, int remote_port);
 static ssize_t ksnLNullSend(ksnLNullClass *kl, int fd, uint8_t cmd, void* data, size_t data_length);
+static ssize_t l0PacketSend(ksnLNullClass *kl, int fd, void *pkg, size_t pkg_length, teoL0Frame *frame);
+static void l0OutClear(ksnLNullClass *kl, ksnLNullData *kld);
+static void l0OutFlush(ksnLNullClass *kl, ksnLNullData *kld, int fd);
+static void cmd_l0_write_cb(struct ev_loop *loop, struct ev_io *w, int revents);
+static void l0ClientActivity(ksnLNullClass *kl, ksnLNullData *kld);
+static void l0IdleUnlink(ksnLNullData *kld);
+static ssize_t l0FrameSendShared(ksnLNullClass *kl, ksnLNullData *kld,
+        teoL0Frame *shared);
+static int extendedLog(ksnLNullClass *kl);
 static int ksnLNullSendBroadcast(ksnLNullClass *kl, uint8_t cmd, void* data, size_t data_length);
 static bool ksnLNullClientAuthCheck(ksnLNullClass *kl, ksnLNullData *kld, int fd, teoLNullCPacket *packet);
+static void l0AuthDone(void *user_data, int fd, uint32_t seq,
+        teoL0AuthData *ad, int verified);
 static bool sendKEXResponse(ksnLNullClass *kl, ksnLNullData *kld, int fd);
 static bool processKeyExchange(ksnLNullClass *kl, ksnLNullData *kld, int fd,
         KeyExchangePayload_Common *kex, size_t kex_length);
@@ -55,6 +68,10 @@ extern const char *localhost;
 #define kev ((ksnetEvMgrClass*)kl->ke)
 #define L0_VERSION 0 ///< L0 Server version
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 void teoLNullPacketCheckMiscrypted(ksnLNullClass *kl, ksnLNullData *kld,
                                    teoLNullCPacket *packet) {
     if (packet->reserved_2 == 0 || packet->data_length == 0) {
@@ -102,10 +119,23 @@ ksnLNullClass *ksnLNullInit(void *ke) {
         kl = malloc(sizeof(ksnLNullClass));
         if(kl != NULL)  {
             kl->ke = ke; // Pointer event manager class
-            kl->map = pblMapNewHashMap(); // Create a new hash map
-            kl->map_n = pblMapNewHashMap(); // Create a new hash map
+            kl->map = teoHashMapNew(); // Create a new hash map
+            kl->map_n = teoHashMapNew(); // Create a new hash map
             memset(&kl->stat, 0, sizeof(kl->stat)); // Clear statistic data
             kl->fd_trudp = MAX_FD_NUMBER;
+            kl->out_free = NULL;
+            kl->active.head = kl->active.tail = NULL;
+            kl->pinged.head = kl->pinged.tail = NULL;
+            kl->ping_frame = NULL;
+            memset(&kl->bcast, 0, sizeof(kl->bcast));
+            kl->auth = NULL;
+            kl->auth_seq = 0;
+            if(((ksnetEvMgrClass*)ke)->teo_cfg.auth_secret[0] != '\0') {
+                kl->auth = teoL0AuthNew(((ksnetEvMgrClass*)ke)->ev_loop,
+                    ((ksnetEvMgrClass*)ke)->teo_cfg.auth_secret,
+                    ((ksnetEvMgrClass*)ke)->teo_cfg.l0_auth_workers,
+                    l0AuthDone, kl);
+            }
             ksnLNullStart(kl); // Start L0 Server
         }
     }
@@ -137,8 +167,7 @@ static int ksnLNullGetNextFakeFd(ksnLNullClass *kl) {
  * @return Client or NULL if not connected
  */
 static ksnLNullData* ksnLNullGetClientConnection(ksnLNullClass *kl, int fd) {
-    size_t valueLength;
-    return pblMapGet(kl->map, &fd, sizeof(fd), &valueLength);
+    return teoHashMapGetInt(kl->map, fd, NULL);
 }
 
 /**
@@ -150,9 +179,15 @@ void ksnLNullDestroy(ksnLNullClass *kl) {
 
     if(kl != NULL) {
         ksnLNullStop(kl);
+        teoL0AuthFree(kl->auth);
 //        teoSScrDestroy(kl->sscr);
-        free(kl->map_n);
-        free(kl->map);
+        while(kl->out_free != NULL) {
+            teoL0OutItem *item = kl->out_free;
+            kl->out_free = item->next;
+            free(item);
+        }
+        teoHashMapFree(kl->map_n);
+        teoHashMapFree(kl->map);
         free(kl);
     }
 }
@@ -211,7 +246,7 @@ static void cmd_l0_read_cb(struct ev_loop *loop, struct ev_io *w, int revents) {
         if(kld != NULL) {
 
             // Set last time received
-            kld->last_time = ksnetEvMgrGetTime(kl->ke);
+            l0ClientActivity(kl, kld);
 
             // Add received data to the read buffer
             if(received > kld->read_buffer_size - kld->read_buffer_ptr) {
@@ -253,6 +288,7 @@ static void cmd_l0_read_cb(struct ev_loop *loop, struct ev_io *w, int revents) {
 
                     if (teoLNullPacketDecrypt(kld->server_crypt, packet)) {
                         teoLNullPacketCheckMiscrypted(kl, kld, packet);
+                        TEO_TRACE3(l0_frame_in, w->fd, packet->cmd, len);
 
                         // Check initialize packet:
                         // cmd = 0, to_length = 1, data_length = 1 + data_len,
@@ -388,6 +424,60 @@ static int extendedLog(ksnLNullClass *kl) {
     return log_level;
 }
 
+/**
+ * Process data received from L0 client by this host
+ *
+ * The packet data is dispatched to teonet commands and to the application
+ * event callback directly, the same way as CMD_L0 received from network is
+ * processed by cmd_l0_cb.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param packet L0 packet received from L0 client
+ * @param cname L0 client name (include trailing zero)
+ * @param cname_length Length of the L0 client name
+ * @return Pointer to this host ARP data or NULL if it is absent
+ */
+static ksnet_arp_data *l0ProcessLocal(ksnLNullClass *kl,
+        teoLNullCPacket *packet, char *cname, size_t cname_length) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+
+    ksnet_arp_data_ext *arp = ksnetArpGet(ke->kc->ka,
+            ksnetEvMgrGetHostName(ke));
+    if(arp == NULL || ksnetEvMgrStatus(ke) == kEventMgrStopped) return NULL;
+
+    if(!ksnCommandL0Allowed(ke->kc->kco, packet->cmd)) {
+        #ifdef DEBUG_KSNET
+        ksn_printf(ke, MODULE, DEBUG_VV,
+            "%s" "got wrong command No %d from %s client with %d bytes data, "
+            "the command skipped ...%s\n",
+            ANSI_RED, packet->cmd, cname, packet->data_length, ANSI_NONE);
+        #endif
+        return &arp->data;
+    }
+
+    ksnCorePacketData rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.addr = (char*)localhost;
+    rd.port = ke->kc->port;
+    rd.cmd = packet->cmd;
+    rd.from = cname;
+    rd.from_len = cname_length;
+    rd.data = packet->peer_name + packet->peer_name_length;
+    rd.data_len = packet->data_length;
+    rd.arp = arp;
+    rd.l0_f = 1;
+
+    arp->data.last_activity = ksnetEvMgrGetTime(ke);
+
+    // Execute L0 client command or send it to application
+    if(!ksnCommandCheck(ke->kc->kco, &rd) && ke->event_cb) {
+        ke->event_cb(ke, EV_K_RECEIVED, (void*)&rd, sizeof(rd), NULL);
+    }
+
+    return &arp->data;
+}
+
 /**
  * Send data received from L0 client to teonet peer
  *
@@ -400,52 +490,43 @@ static int extendedLog(ksnLNullClass *kl) {
 static ksnet_arp_data *ksnLNullSendFromL0(ksnLNullClass *kl, teoLNullCPacket *packet,
         char *cname, size_t cname_length) {
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
-    size_t out_data_len = sizeof(ksnLNullSPacket) + cname_length +
-            packet->data_length;
-    char *out_data = malloc(out_data_len);
-    memset(out_data, 0, out_data_len);
-    ksnLNullSPacket *spacket = (ksnLNullSPacket*) out_data;
-
-    // Create teonet L0 packet
-    spacket->cmd = packet->cmd;
-    spacket->client_name_length = cname_length;
-    memcpy(spacket->payload, cname, cname_length);
-    spacket->data_length = packet->data_length;
-    memcpy(spacket->payload + spacket->client_name_length,
-        packet->peer_name + packet->peer_name_length, spacket->data_length);
-
-    // Send teonet L0 packet
     ksnet_arp_data *arp_data = NULL;
+
     #ifdef DEBUG_KSNET
     ksn_printf(ke, MODULE, extendedLog(kl),
         "send packet to peer \"%s\" from L0 client \"%s\" ...\n",
-        packet->peer_name, spacket->payload);
+        packet->peer_name, cname);
     #endif
 
+    // Send to this host
+    if(!packet->peer_name[0] || !strcmp((char*)packet->peer_name, ksnetEvMgrGetHostName(ke))) {
+        arp_data = l0ProcessLocal(kl, packet, cname, cname_length);
+    }
     // Send to peer
-    if(strlen((char*)packet->peer_name) && strcmp((char*)packet->peer_name, ksnetEvMgrGetHostName(ke))) {        
+    else {
+        size_t out_data_len = sizeof(ksnLNullSPacket) + cname_length +
+                packet->data_length;
+        char *out_data = malloc(out_data_len);
+        memset(out_data, 0, out_data_len);
+        ksnLNullSPacket *spacket = (ksnLNullSPacket*) out_data;
+
+        // Create teonet L0 packet
+        spacket->cmd = packet->cmd;
+        spacket->client_name_length = cname_length;
+        memcpy(spacket->payload, cname, cname_length);
+        spacket->data_length = packet->data_length;
+        memcpy(spacket->payload + spacket->client_name_length,
+            packet->peer_name + packet->peer_name_length, spacket->data_length);
+
         arp_data = ksnCoreSendCmdto(ke->kc, packet->peer_name, CMD_L0,
                 spacket, out_data_len);
-    }
-    // Send to this host
-    else {
-        // Create packet
-        size_t pkg_len;
-        void *pkg = ksnCoreCreatePacket(ke->kc, CMD_L0, spacket, out_data_len, &pkg_len);
-        struct sockaddr_storage addr;             // address structure
-        socklen_t addrlen = sizeof(addr); // length of addresses
-        if(!make_addr(localhost, ke->kc->port, (__SOCKADDR_ARG) &addr, &addrlen)) {
-            ksnCoreProcessPacket(ke->kc, pkg, pkg_len, (__SOCKADDR_ARG) &addr);
-            arp_data = (ksnet_arp_data *)ksnetArpGet(ke->kc->ka, (char*)packet->peer_name);
-        }
-        free(pkg);
+
+        free(out_data);
     }
 
     // Send packet to peer statistic
     kl->stat.packets_to_peer++;
 
-    free(out_data);
-
     return arp_data;
 }
 
@@ -567,7 +648,20 @@ static ksnLNullData* ksnLNullClientRegister(ksnLNullClass *kl, int fd, const cha
     data.t_port = remote_port;
     data.t_channel = 0;
     data.last_time = ksnetEvMgrGetTime(kl->ke);
-    pblMapAdd(kl->map, &fd, sizeof(fd), &data, sizeof(ksnLNullData));
+    data.out_head = NULL;
+    data.out_tail = NULL;
+    data.out_offset = 0;
+    data.out_high_f = 0;
+    memset(&data.out_stat, 0, sizeof(data.out_stat));
+    data.fd = fd;
+    data.ping_time = 0.0;
+    data.idle_prev = NULL;
+    data.idle_next = NULL;
+    data.idle_list = NULL;
+    data.local_cb = NULL;
+    data.local_data = NULL;
+    data.auth_seq = 0;
+    teoHashMapAddInt(kl->map, fd, &data, sizeof(ksnLNullData));
 
     ksnLNullData* kld = ksnLNullGetClientConnection(kl, fd);
     // #ifdef DEBUG_KSNET
@@ -579,6 +673,9 @@ static ksnLNullData* ksnLNullClientRegister(ksnLNullClass *kl, int fd, const cha
     }
     // #endif
 
+    // Add client to the end of active clients list
+    l0ClientActivity(kl, kld);
+
     // L0 statistic - client connected
     kl->stat.clients++;
 
@@ -617,126 +714,12 @@ void _send_subscribe_event_newvisit(ksnetEvMgrClass *ke, const char *payload,
     free(vd);
 }
 
-/**
- * \TODO: move this function to utils
- */
-static bool json_eq(const char *json, jsmntok_t *tok, const char *s) {
-    if (tok->type == JSMN_STRING && (int) strlen(s) == tok->end - tok->start &&
-            strncmp(json + tok->start, s, tok->end - tok->start) == 0) {
-        return true;
-    }
-    return false;
-}
-
-typedef struct string_view
-{
-    char *data;
-    size_t len;
-} string_view;
-
-static void stringViewReset(string_view *s) {
-    if (s == NULL) { return; }
-
-    s->data = NULL;
-    s->len = 0;
-}
-
-
-static bool parseAuthPayload(ksnLNullClass *kl, uint8_t *payload, string_view *name, string_view *sign, string_view *auth_data_valid_until) {
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
-    if (name == NULL || sign == NULL || auth_data_valid_until == NULL) {
-        ksn_printf(ke, MODULE, DEBUG, "Missing output params: name=%p, sign=%p, valid_ts=%p\n", name, sign, auth_data_valid_until);
-        return false;
-    }
-
-    char *jsondata = (char *)payload;
-    jsmn_parser p;
-    jsmntok_t tokens[128];
-
-    jsmn_init(&p);
-    int token_num = jsmn_parse(&p, jsondata, strlen(jsondata), tokens, sizeof(tokens)/sizeof(tokens[0]));
-    if (token_num < 0) {
-        printf("Failed to parse JSON: %d\n", token_num);
-        return false;
-    }
-
-    if (token_num < 1 || tokens[0].type != JSMN_OBJECT) {
-        printf("Object expected\n");
-        return false;
-    }
-
-    stringViewReset(name);
-    stringViewReset(sign);
-    stringViewReset(auth_data_valid_until);
-
-    for (int i = 1; i < token_num; i++) {
-        if (json_eq(jsondata, &tokens[i], "userId")) {
-            printf("ID: %.*s\n", tokens[i+1].end - tokens[i+1].start, jsondata + tokens[i+1].start);
-            name->data = (char*)jsondata + tokens[i+1].start;
-            name->len = tokens[i+1].end - tokens[i+1].start;
-            i++;
-        } else if (json_eq(jsondata, &tokens[i], "sign")) {
-            printf("SIGN: %.*s\n", tokens[i+1].end - tokens[i+1].start, jsondata + tokens[i+1].start);
-            sign->data = (char*)jsondata + tokens[i+1].start;
-            sign->len = tokens[i+1].end - tokens[i+1].start;
-            i++;
-        } else if (json_eq(jsondata, &tokens[i], "timestamp")) {
-            printf("TS: %.*s\n", tokens[i+1].end - tokens[i+1].start,
-                    jsondata + tokens[i+1].start);
-            auth_data_valid_until->data = (char*)jsondata + tokens[i+1].start;
-            auth_data_valid_until->len = tokens[i+1].end - tokens[i+1].start;
-            i++;
-        }
-    }
-
-    return auth_data_valid_until->data != NULL && sign->data != NULL && name->data != NULL;
-}
-
-static bool checkAuthData(ksnLNullClass *kl, string_view *name, string_view *auth_data_valid_until, string_view *sign, const char *secret) {
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
-
-    if (sign->len != MD5_DIGEST_LENGTH*2) {
-        ksn_printf(ke, MODULE, DEBUG, "Invalid signature length:  %.*s\n",
-            sign->len, sign->data);
-        return false;
-    }
-
-    char current_time_str[64];
-    //TODO: not sure that this cast to int is valid
-    int current_time = ksnetEvMgrGetTime(((ksnetEvMgrClass*)kl->ke));
-    snprintf(current_time_str, sizeof(current_time_str), "%d", current_time);
-
-    int current_time_str_len = strlen(current_time_str);
-    if ((current_time_str_len > auth_data_valid_until->len) ||
-            (current_time_str_len == auth_data_valid_until->len &&
-            strncmp(auth_data_valid_until->data, current_time_str, auth_data_valid_until->len) < 0)) {
-        ksn_printf(ke, MODULE, DEBUG, "timestamp %.*s outdated, current time: %d\n",
-            auth_data_valid_until->len, auth_data_valid_until->data, current_time);
-        return false;
-    }
-
-    unsigned char digarray[MD5_DIGEST_LENGTH];
-    MD5_CTX ctx;
-    MD5_Init(&ctx);
-    MD5_Update(&ctx, name->data, name->len);
-    MD5_Update(&ctx, secret, strlen(secret));
-    MD5_Update(&ctx, auth_data_valid_until->data, auth_data_valid_until->len);
-    MD5_Final(digarray, &ctx);
-
-    char md5str[MD5_DIGEST_LENGTH*2 + 1];
-    for(int i = 0; i < MD5_DIGEST_LENGTH; ++i) {
-        sprintf(&md5str[i*2], "%02x", (unsigned int)digarray[i]);
-    }
-
-    return strncmp(md5str, sign->data, MD5_DIGEST_LENGTH*2) == 0;
-}
-
-static void updateClientName(ksnLNullClass *kl, ksnLNullData *kld, int fd, string_view *name) {
+static void updateClientName(ksnLNullClass *kl, ksnLNullData *kld, int fd, const char *name, size_t name_len) {
     int wg001_len = strlen(WG001);
-    int client_name_len = wg001_len + name->len + 1;//wg001-name + terminating null
+    int client_name_len = wg001_len + name_len + 1;//wg001-name + terminating null
     char *client_name = malloc(client_name_len);
     strncpy(client_name, WG001, wg001_len);
-    strncpy(client_name + wg001_len, name->data, name->len);
+    strncpy(client_name + wg001_len, name, name_len);
     client_name[client_name_len - 1] = '\0';
 
     // Remove client with the same name
@@ -753,17 +736,17 @@ static void updateClientName(ksnLNullClass *kl, ksnLNullData *kld, int fd, strin
     if (kld->name) free(kld->name);
     kld->name = client_name;
     kld->name_length = client_name_len;
-    if(fd_ex != fd) pblMapAdd(kl->map_n, kld->name, kld->name_length, &fd, sizeof(fd));
+    if(fd_ex != fd) teoHashMapAdd(kl->map_n, kld->name, kld->name_length, &fd, sizeof(fd));
 }
 
 static void sendConnectedEvent(ksnLNullClass *kl, ksnLNullData *kld) {
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
-    // TODO: I must use kl->stat.clients or ke->kl->stat.visits ????? instead pblMapSize(kl->map)
+    // TODO: I must use kl->stat.clients or ke->kl->stat.visits ????? instead teoHashMapSize(kl->map)
     int playload_size = snprintf(0, 0, "{\"client_name\":\"%s\",\"trudp_ip\":\"%s\",\"count_of_clients\":%d}",
-        kld->name, kld->t_addr ? kld->t_addr : "error", pblMapSize(kl->map));
+        kld->name, kld->t_addr ? kld->t_addr : "error", (int)teoHashMapSize(kl->map));
     char *payload = malloc(playload_size + 1);
     snprintf(payload, playload_size + 1, "{\"client_name\":\"%s\",\"trudp_ip\":\"%s\",\"count_of_clients\":%d}",
-        kld->name, kld->t_addr ? kld->t_addr : "error", pblMapSize(kl->map));
+        kld->name, kld->t_addr ? kld->t_addr : "error", (int)teoHashMapSize(kl->map));
 
     _send_subscribe_event_connected(ke, payload, playload_size + 1);
     free(payload);
@@ -791,19 +774,87 @@ static void confirmAuth(ksnLNullClass *kl, ksnLNullData *kld, int fd) {
     free(out_data);
 }
 
+/**
+ * Set name of client which credentials are verified and confirm login
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ * @param fd Client connection file descriptor
+ * @param ad Verified credentials
+ */
+static void l0AuthAccept(ksnLNullClass *kl, ksnLNullData *kld, int fd,
+        teoL0AuthData *ad) {
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+
+    updateClientName(kl, kld, fd, ad->name, ad->name_len);
+    //NOTE: if there're any subs, then we have some work to be done before client enters
+    // so we wait for external auth confirm, otherwise confirm instantly
+    int connected_subs_num = teoSScrNumberOfEventSubscribers(ke->kc->kco->ksscr, EV_K_L0_CONNECTED);
+    if (connected_subs_num > 0) {
+        sendConnectedEvent(kl, kld);
+    } else {
+        confirmAuth(kl, kld, fd);
+    }
+}
+
+/**
+ * Login verified by worker thread callback
+ *
+ * @param user_data Pointer to ksnLNullClass
+ * @param fd Client connection file descriptor
+ * @param seq Login sequence number
+ * @param ad Verified credentials
+ * @param verified True if credentials are verified
+ */
+static void l0AuthDone(void *user_data, int fd, uint32_t seq,
+        teoL0AuthData *ad, int verified) {
+    ksnLNullClass *kl = user_data;
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+
+    // Skip result if client disconnected or sent other login
+    ksnLNullData *kld = ksnLNullGetClientConnection(kl, fd);
+    if (kld == NULL || kld->auth_seq != seq) { return; }
+
+    if (!verified) {
+        ksn_printf(ke, MODULE, DEBUG,"Failed to verify signature '%.*s' - '%.*s' - '%.*s' received from fd %d\n",
+            (int)ad->name_len, ad->name, (int)ad->valid_until_len, ad->valid_until,
+            (int)ad->sign_len, ad->sign, fd);
+
+        // Reset TR-UDP channel as inline login check does (in-process
+        // clients have fake fd too, but no channel)
+        if (fd >= MAX_FD_NUMBER && kld->local_cb == NULL &&
+                kld->t_addr != NULL) {
+            trudpChannelData *tcd = trudpGetChannelAddr(ke->kc->ku,
+                    kld->t_addr, kld->t_port, 0);
+            if (tcd != (void*)-1) { trudp_ChannelSendReset(tcd); }
+        }
+        ksnLNullClientDisconnect(kl, fd, 1);
+        return;
+    }
+
+    l0AuthAccept(kl, kld, fd, ad);
+}
+
 /**
  * Set client name and check it in auth server
  *
+ * Verified credentials are cached, so clients which reconnect with the same
+ * credentials are accepted without signature check. If l0_auth_workers is
+ * set, signatures are checked by worker threads and the client is accepted
+ * or disconnected when the result returns to the event loop.
+ *
  * @param kl Pointer to ksnLNullClass
  * @param kld Pointer to ksnLNullData
  * @param fd TCP client connection file descriptor
  * @param packet Pointer to teoLNullCPacket
+ *
+ * @return False if client was disconnected
  */
 static bool ksnLNullClientAuthCheck(ksnLNullClass *kl, ksnLNullData *kld,
         int fd, teoLNullCPacket *packet) {
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
 
-    if (((ksnetEvMgrClass*)kl->ke)->teo_cfg.auth_secret[0] == '\0') {
+    if (kl->auth == NULL) {
         ksn_printf(ke, MODULE, DEBUG, "secret not provided, disconnect %d\n", fd);
         ksnLNullClientDisconnect(kl, fd, 1);
         return false;
@@ -811,41 +862,30 @@ static bool ksnLNullClientAuthCheck(ksnLNullClass *kl, ksnLNullData *kld,
 
     uint8_t *payload = teoLNullPacketGetPayload(packet);
 
-    ksn_printf(ke, MODULE, DEBUG,"Checking payload from fd %d:\n%s\n", fd, (const char*)payload);
-
-    //NOTE: string_views will be reseted inside parseAuthPayload
-    string_view name;
-    string_view sign;
-    string_view auth_data_valid_until;
+    #ifdef DEBUG_KSNET
+    ksn_printf(ke, MODULE, DEBUG_VV,"Checking payload from fd %d:\n%s\n", fd, (const char*)payload);
+    #endif
 
-    if (!parseAuthPayload(kl, payload, &name, &sign, &auth_data_valid_until)) {
+    teoL0AuthData ad;
+    if (!teoL0AuthParse((const char *)payload, &ad)) {
         ksn_printf(ke, MODULE, DEBUG,"Invalid payload received from fd %d:\n%s\n", fd, (const char*)payload);
         ksnLNullClientDisconnect(kl, fd, 1);
         return false;
     }
 
-    if (!checkAuthData(kl, &name, &auth_data_valid_until, &sign, ((ksnetEvMgrClass*)kl->ke)->teo_cfg.auth_secret)) {
+    kld->auth_seq = ++kl->auth_seq;
+    teoL0AuthResult rv = teoL0AuthCheck(kl->auth, &ad,
+            (long)ksnetEvMgrGetTime(ke), fd, kld->auth_seq);
+    if (rv == TEO_L0_AUTH_PENDING) { return true; }
+    if (rv == TEO_L0_AUTH_FAILED) {
         ksn_printf(ke, MODULE, DEBUG,"Failed to verify signature '%.*s' - '%.*s' - '%.*s' received from fd %d\n",
-            name.len,
-            name.data,
-            auth_data_valid_until.len,
-            auth_data_valid_until.data,
-            sign.len,
-            sign.data,
-            fd);
+            (int)ad.name_len, ad.name, (int)ad.valid_until_len, ad.valid_until,
+            (int)ad.sign_len, ad.sign, fd);
         ksnLNullClientDisconnect(kl, fd, 1);
         return false;
     }
 
-    updateClientName(kl, kld, fd, &name);
-    //NOTE: if there're any subs, then we have some work to be done before client enters
-    // so we wait for external auth confirm, otherwise confirm instantly
-    int connected_subs_num = teoSScrNumberOfEventSubscribers(ke->kc->kco->ksscr, EV_K_L0_CONNECTED);
-    if (connected_subs_num > 0) {
-        sendConnectedEvent(kl, kld);
-    } else {
-        confirmAuth(kl, kld, fd);
-    }
+    l0AuthAccept(kl, kld, fd, &ad);
 
     return true;
 }
@@ -853,6 +893,9 @@ static bool ksnLNullClientAuthCheck(ksnLNullClass *kl, ksnLNullData *kld,
 /**
  * Send command from this L0 server to all L0 clients
  *
+ * The L0 packet is created once and the same frame is queued to all clients,
+ * only clients with encryption get their own sealed copy of the frame.
+ *
  * @param kl Pointer to ksnLNullClass
  * @param cmd Command
  * @param data_e Pointer to data
@@ -862,24 +905,41 @@ static bool ksnLNullClientAuthCheck(ksnLNullClass *kl, ksnLNullData *kld,
 static int ksnLNullSendBroadcast(ksnLNullClass *kl, uint8_t cmd, void* data,
         size_t data_length) {
 
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+    double start = ev_time();
     int num_clients = 0;
 
+    teoL0Frame *frame = teoL0FrameCreate(cmd, ksnetEvMgrGetHostName(ke),
+            data, data_length);
+
     // Send to all clients
-    PblIterator *it = pblMapIteratorReverseNew(kl->map);
-    if(it != NULL) {
-        while(pblIteratorHasPrevious(it) > 0) {
-            void *entry = pblIteratorPrevious(it);
-            ksnLNullData *client = pblMapEntryValue(entry);
-            if(client != NULL && client->name != NULL) {
-                int fd = ksnLNullClientIsConnected(kl, client->name);
-                if(!fd) continue;
-                ksnLNullSend(kl, fd, cmd, data, data_length);
-                num_clients++;
-            }
+    teoHashMapIter it;
+    teoHashMapEntry *entry;
+    teoHashMapIterInit(kl->map, &it);
+    while((entry = teoHashMapIterNext(&it))) {
+        ksnLNullData *client = entry->data;
+        if(client->name != NULL) {
+            l0FrameSendShared(kl, client, frame);
+            num_clients++;
         }
-        pblIteratorFree(it);
     }
-    return num_clients; 
+    teoL0FrameRelease(frame);
+
+    // Broadcast statistic
+    double bcast_time = ev_time() - start;
+    kl->bcast.broadcasts++;
+    kl->bcast.last_clients = num_clients;
+    kl->bcast.last_time = bcast_time;
+    if(bcast_time > kl->bcast.max_time) kl->bcast.max_time = bcast_time;
+    if(ke->tm != NULL) teoMetricMs(ke->tm, "l0_broadcast", bcast_time * 1000.0);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(ke, MODULE, DEBUG_VV,
+        "broadcast cmd %d with %d bytes data to %d clients in %.3f ms\n",
+        cmd, (int)data_length, num_clients, bcast_time * 1000.0);
+    #endif
+
+    return num_clients;
 }
 
 /**
@@ -896,21 +956,356 @@ static ssize_t ksnLNullSend(ksnLNullClass *kl, int fd, uint8_t cmd, void* data,
         size_t data_length) {
 
     const char *from = ksnetEvMgrGetHostName(kl->ke);
-    size_t from_len = strlen(from) + 1;
-    // Create L0 packet
-    size_t packet_len = teoLNullBufferSize(from_len, data_length);
-    char *packet = malloc(packet_len);
-    memset(packet, 0, packet_len);
 
-    size_t packet_length =
-        teoLNullPacketCreate(packet, packet_len, cmd, from, data, data_length);
+    // Create L0 packet
+    teoL0Frame *frame = teoL0FrameCreate(cmd, from, data, data_length);
 
     // Send packet
-    ssize_t snd = ksnLNullPacketSend(kl, fd, packet, packet_length);
-    free(packet);
+    ssize_t snd = ksnLNullFrameSend(kl, fd, frame);
+    teoL0FrameRelease(frame);
     return snd;
 }
 
+/**
+ * Create L0 frame
+ *
+ * @param cmd Command
+ * @param from Peer name
+ * @param data Pointer to data
+ * @param data_length Data length
+ *
+ * @return Pointer to teoL0Frame with one reference, should be released with
+ *         teoL0FrameRelease
+ */
+teoL0Frame *teoL0FrameCreate(uint8_t cmd, const char *from, const void *data,
+        size_t data_length) {
+
+    size_t from_len = strlen(from) + 1;
+    size_t buf_len = teoLNullBufferSize(from_len, data_length);
+    teoL0Frame *frame = malloc(sizeof(teoL0Frame) + buf_len);
+    memset(frame->data, 0, buf_len);
+    frame->ref = 1;
+    frame->sealed = 0;
+    frame->length = teoLNullPacketCreate(frame->data, buf_len, cmd, from, data,
+            data_length);
+
+    return frame;
+}
+
+/**
+ * Release L0 frame reference, free frame when it is not referenced
+ *
+ * @param frame Pointer to teoL0Frame
+ */
+void teoL0FrameRelease(teoL0Frame *frame) {
+    if(!--frame->ref) free(frame);
+}
+
+/**
+ * Send L0 frame to L0 client
+ *
+ * The frame is sealed in place, so the frame should not be shared between
+ * clients which use encryption. A frame sealed without encryption is not
+ * sealed again.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param fd L0 client socket
+ * @param frame Pointer to teoL0Frame
+ *
+ * @return Length of send or queued data or -1 at error
+ */
+ssize_t ksnLNullFrameSend(ksnLNullClass *kl, int fd, teoL0Frame *frame) {
+    return l0PacketSend(kl, fd, frame->data, frame->length, frame);
+}
+
+/**
+ * Send frame shared between several L0 clients
+ *
+ * Clients without encryption get the shared frame, which is sealed once.
+ * Encrypted clients get a copy because the frame is encrypted in place.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ * @param shared Shared frame
+ *
+ * @return Length of send or queued data or -1 at error
+ */
+static ssize_t l0FrameSendShared(ksnLNullClass *kl, ksnLNullData *kld,
+        teoL0Frame *shared) {
+
+    if(kld->server_crypt == NULL ||
+       !CMD_TRUDP_CHECK(((teoLNullCPacket *)shared->data)->cmd)) {
+        return ksnLNullFrameSend(kl, kld->fd, shared);
+    }
+
+    teoL0Frame *frame = malloc(sizeof(teoL0Frame) + shared->length);
+    frame->ref = 1;
+    frame->sealed = 0;
+    frame->length = shared->length;
+    memcpy(frame->data, shared->data, shared->length);
+    ssize_t snd = ksnLNullFrameSend(kl, kld->fd, frame);
+    teoL0FrameRelease(frame);
+
+    return snd;
+}
+
+/**
+ * Get L0 broadcast statistic
+ *
+ * @param kl Pointer to ksnLNullClass
+ *
+ * @return Pointer to teoL0BroadcastStat
+ */
+teoL0BroadcastStat *ksnLNullBroadcastStat(ksnLNullClass *kl) {
+    return kl != NULL ? &kl->bcast : NULL;
+}
+
+/**
+ * Get L0 client output queue statistic
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param fd L0 client socket
+ *
+ * @return Pointer to teoL0OutStat or NULL if client is not connected
+ */
+teoL0OutStat *ksnLNullClientOutStat(ksnLNullClass *kl, int fd) {
+    ksnLNullData *kld = ksnLNullGetClientConnection(kl, fd);
+    return kld != NULL ? &kld->out_stat : NULL;
+}
+
+/**
+ * Send L0 queue watermark event
+ */
+static void l0OutEvent(ksnLNullClass *kl, ksnLNullData *kld, int fd,
+        ksnetEvMgrEvents event) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(ke, MODULE, extendedLog(kl),
+        "output queue of client \"%s\" fd %d %s watermark, %d bytes queued\n",
+        kld->name ? kld->name : "", fd,
+        event == EV_K_L0_QUEUE_HIGH ? "reached high" : "drained to low",
+        (int)kld->out_stat.queued);
+    #endif
+
+    if(ke->event_cb != NULL)
+        ke->event_cb(ke, event, kld, sizeof(ksnLNullData), &fd);
+}
+
+/**
+ * Add frame to L0 client output queue
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ * @param fd L0 client socket
+ * @param frame Pointer to teoL0Frame, the queue takes its own reference
+ * @param offset Bytes of the frame already sent
+ */
+static void l0OutEnqueue(ksnLNullClass *kl, ksnLNullData *kld, int fd,
+        teoL0Frame *frame, size_t offset) {
+
+    teoL0OutItem *item = kl->out_free;
+    if(item != NULL) kl->out_free = item->next;
+    else item = malloc(sizeof(teoL0OutItem));
+
+    frame->ref++;
+    item->frame = frame;
+    item->next = NULL;
+    if(kld->out_tail != NULL) kld->out_tail->next = item;
+    else {
+        kld->out_head = item;
+        kld->out_offset = offset;
+    }
+    kld->out_tail = item;
+
+    kld->out_stat.queued += frame->length - offset;
+    if(kld->out_stat.queued > kld->out_stat.queued_max)
+        kld->out_stat.queued_max = kld->out_stat.queued;
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+    if(!ev_is_active(&kld->w_write)) ev_io_start(ke->ev_loop, &kld->w_write);
+
+    if(!kld->out_high_f &&
+            kld->out_stat.queued >= (size_t)ke->teo_cfg.l0_out_queue_high) {
+        kld->out_high_f = 1;
+        l0OutEvent(kl, kld, fd, EV_K_L0_QUEUE_HIGH);
+    }
+}
+
+/**
+ * Remove written bytes from L0 client output queue
+ */
+static void l0OutConsume(ksnLNullClass *kl, ksnLNullData *kld, size_t length) {
+
+    kld->out_stat.queued -= length;
+    kld->out_stat.sent += length;
+    while(length) {
+        teoL0OutItem *item = kld->out_head;
+        size_t rest = item->frame->length - kld->out_offset;
+        if(length < rest) {
+            kld->out_offset += length;
+            break;
+        }
+        length -= rest;
+        kld->out_offset = 0;
+        kld->out_head = item->next;
+        if(kld->out_head == NULL) kld->out_tail = NULL;
+        teoL0FrameRelease(item->frame);
+        item->next = kl->out_free;
+        kl->out_free = item;
+    }
+}
+
+/**
+ * Free L0 client output queue
+ */
+static void l0OutClear(ksnLNullClass *kl, ksnLNullData *kld) {
+
+    while(kld->out_head != NULL) {
+        teoL0OutItem *item = kld->out_head;
+        kld->out_head = item->next;
+        teoL0FrameRelease(item->frame);
+        item->next = kl->out_free;
+        kl->out_free = item;
+    }
+    kld->out_tail = NULL;
+    kld->out_offset = 0;
+    kld->out_stat.queued = 0;
+}
+
+/**
+ * Write L0 client output queue to socket
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ * @param fd L0 client socket
+ */
+static void l0OutFlush(ksnLNullClass *kl, ksnLNullData *kld, int fd) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+    struct iovec iov[L0_OUT_IOV_MAX];
+
+    while(kld->out_head != NULL) {
+
+        int cnt = 0;
+        size_t offset = kld->out_offset, length = 0;
+        teoL0OutItem *item;
+        for(item = kld->out_head; item != NULL && cnt < L0_OUT_IOV_MAX;
+                item = item->next, cnt++) {
+            iov[cnt].iov_base = item->frame->data + offset;
+            iov[cnt].iov_len = item->frame->length - offset;
+            length += iov[cnt].iov_len;
+            offset = 0;
+        }
+
+        ssize_t snd = writev(fd, iov, cnt);
+        if(snd < 0) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+            // Connection error: drop queue and let read callback disconnect
+            #ifdef DEBUG_KSNET
+            ksn_printf(ke, MODULE, DEBUG_VV,
+                "write error to fd %d: %s\n", fd, strerror(errno));
+            #endif
+            l0OutClear(kl, kld);
+            shutdown(fd, SHUT_RDWR);
+            break;
+        }
+        l0OutConsume(kl, kld, snd);
+        if((size_t)snd < length) break;
+    }
+
+    if(kld->out_head == NULL) ev_io_stop(ke->ev_loop, &kld->w_write);
+
+    if(kld->out_high_f &&
+            kld->out_stat.queued <= (size_t)ke->teo_cfg.l0_out_queue_low) {
+        kld->out_high_f = 0;
+        l0OutEvent(kl, kld, fd, EV_K_L0_QUEUE_LOW);
+    }
+}
+
+/**
+ * L0 Server client write callback
+ *
+ * Called when TCP client socket is ready to write and output queue is not
+ * empty
+ *
+ * @param loop Event manager loop
+ * @param w Pointer to watcher
+ * @param revents Events
+ */
+static void cmd_l0_write_cb(struct ev_loop *loop, struct ev_io *w, int revents) {
+
+    ksnLNullClass *kl = w->data;
+    ksnLNullData *kld = ksnLNullGetClientConnection(kl, w->fd);
+    if(kld != NULL) l0OutFlush(kl, kld, w->fd);
+    else ev_io_stop(loop, w);
+}
+
+/**
+ * Send packet to TCP L0 client
+ *
+ * Write packet to socket if output queue is empty, the rest of packet which
+ * was not written is added to output queue.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ * @param fd L0 client socket
+ * @param pkg Package to send
+ * @param pkg_length Package length
+ * @param frame Pointer to teoL0Frame which contains pkg or NULL
+ *
+ * @return Length of send or queued data or -1 at error
+ */
+static ssize_t l0TcpSend(ksnLNullClass *kl, ksnLNullData *kld, int fd,
+        void *pkg, size_t pkg_length, teoL0Frame *frame) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+    size_t offset = 0;
+
+    if(kld->out_head == NULL) {
+        ssize_t snd = send(fd, pkg, pkg_length, MSG_NOSIGNAL);
+        if(snd < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return -1;
+            snd = 0;
+        }
+        kld->out_stat.sent += snd;
+        if((size_t)snd == pkg_length) return snd;
+        offset = snd;
+    }
+
+    // Slow client: output queue is full
+    else if(kld->out_stat.queued + pkg_length >
+            (size_t)ke->teo_cfg.l0_out_queue_max) {
+
+        kld->out_stat.dropped++;
+        if(ke->teo_cfg.l0_slow_client_policy == L0_SLOW_CLIENT_DISCONNECT) {
+            ksn_printf(ke, MODULE, DEBUG,
+                "disconnect slow client \"%s\" fd %d, %d bytes queued\n",
+                kld->name ? kld->name : "", fd, (int)kld->out_stat.queued);
+            l0OutClear(kl, kld);
+            shutdown(fd, SHUT_RDWR);
+        }
+        return -1;
+    }
+
+    // Queue the rest of packet
+    if(frame == NULL) {
+        frame = malloc(sizeof(teoL0Frame) + pkg_length - offset);
+        frame->ref = 1;
+        frame->length = pkg_length - offset;
+        memcpy(frame->data, (uint8_t *)pkg + offset, frame->length);
+        l0OutEnqueue(kl, kld, fd, frame, 0);
+        teoL0FrameRelease(frame);
+    }
+    else l0OutEnqueue(kl, kld, fd, frame, offset);
+
+    return pkg_length;
+}
+
 /**
  * Send packet to L0 client
  *
@@ -922,6 +1317,22 @@ static ssize_t ksnLNullSend(ksnLNullClass *kl, int fd, uint8_t cmd, void* data,
  */
 ssize_t ksnLNullPacketSend(ksnLNullClass *kl, int fd, void *pkg,
                            size_t pkg_length) {
+    return l0PacketSend(kl, fd, pkg, pkg_length, NULL);
+}
+
+/**
+ * Send packet to L0 client
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param fd L0 client socket
+ * @param pkg Package to send
+ * @param pkg_length Package length
+ * @param frame Pointer to teoL0Frame which contains pkg or NULL
+ *
+ * @return Length of send or queued data or -1 at error
+ */
+static ssize_t l0PacketSend(ksnLNullClass *kl, int fd, void *pkg,
+                            size_t pkg_length, teoL0Frame *frame) {
     teoLNullCPacket *packet = (teoLNullCPacket *)pkg;
     #ifdef DEBUG_KSNET
     char hexdump[32];
@@ -937,19 +1348,35 @@ ssize_t ksnLNullPacketSend(ksnLNullClass *kl, int fd, void *pkg,
     bool with_encryption = CMD_TRUDP_CHECK(packet->cmd);
 
     ksnLNullData *kld = ksnLNullGetClientConnection(kl, fd);
+
+    // In-process client gets the packet as is
+    if(kld != NULL && kld->local_cb != NULL) {
+        TEO_TRACE3(l0_frame_out, fd, packet->cmd, pkg_length);
+        kld->local_cb(kld->local_data, packet, pkg_length);
+        if(packet->cmd) kl->stat.packets_to_client++;
+        return pkg_length;
+    }
+
     teoLNullEncryptionContext *ctx =
         (with_encryption && (kld != NULL)) ? kld->server_crypt : NULL;
 
-    teoLNullPacketSeal(ctx, with_encryption, packet);
+    // Frame without encryption may be shared and is sealed once
+    if(frame == NULL || !frame->sealed || ctx != NULL) {
+        teoLNullPacketSeal(ctx, with_encryption, packet);
+        if(frame != NULL && ctx == NULL) frame->sealed = 1;
+    }
+    TEO_TRACE3(l0_frame_out, fd, packet->cmd, pkg_length);
 
     ssize_t snd = -1;
 
     // Send by TCP
     if(fd < MAX_FD_NUMBER) {
-        teosockSend(fd, pkg, pkg_length);
+        if(kld != NULL) snd = l0TcpSend(kl, kld, fd, pkg, pkg_length, frame);
+        else snd = teosockSend(fd, pkg, pkg_length);
 
     } else {    // Send by TR-UDP
         if(kld != NULL) {
+            snd = pkg_length;
             struct sockaddr_storage remaddr;                   ///< Remote address
             socklen_t addrlen = sizeof(remaddr);          ///< Remote address length
             trudpUdpMakeAddr(kld->t_addr, kld->t_port, (__SOCKADDR_ARG) &remaddr, &addrlen);
@@ -998,8 +1425,9 @@ ssize_t ksnLNullPacketSend(ksnLNullClass *kl, int fd, void *pkg,
 static void ksnLNullClientConnect(ksnLNullClass *kl, int fd, const char *remote_addr, int remote_port) {
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
 
-    // Set TCP_NODELAY option
+    // Set TCP_NODELAY option and non block mode
     teosockSetTcpNodelay(fd);
+    teosockSetBlockingMode(fd, TEOSOCK_NON_BLOCKING_MODE);
 
     ksn_printf(ke, MODULE, DEBUG_VV,
                "L0 client with fd %d connected from %s:%d\n",
@@ -1014,6 +1442,10 @@ static void ksnLNullClientConnect(ksnLNullClass *kl, int fd, const char *remote_
         kld->w.data = kl;
         ev_io_start (ke->ev_loop, &kld->w);
 
+        // Create TCP write watcher, it starts when output queue is not empty
+        ev_io_init (&kld->w_write, cmd_l0_write_cb, fd, EV_WRITE);
+        kld->w_write.data = kl;
+
     } else {
         // Error: can't register TCP fd in tcp proxy map
         // \todo process error: can't register TCP fd in tcp proxy map
@@ -1037,18 +1469,24 @@ static void ksnLNullClientConnect(ksnLNullClass *kl, int fd, const char *remote_
 void ksnLNullClientDisconnect(ksnLNullClass *kl, int fd, int remove_f) {
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
 
-    size_t valueLength;
-
     // Get data from L0 Clients map, close TCP watcher and remove this
     // data record from map
-    ksnLNullData* kld = pblMapGet(kl->map, &fd, sizeof(fd), &valueLength);
+    ksnLNullData* kld = teoHashMapGetInt(kl->map, fd, NULL);
     if(kld != NULL) {
 
-        // Stop L0 client watcher
+        teoL0LocalClientCb local_cb = kld->local_cb;
+        void *local_data = kld->local_data;
+        kld->local_cb = NULL;
+
+        // Stop L0 client watchers and free output queue
         if(fd < MAX_FD_NUMBER) {
             ev_io_stop(ke->ev_loop, &kld->w);
+            if(remove_f == 2) l0OutFlush(kl, kld, fd); // Try to send queued data
+            ev_io_stop(ke->ev_loop, &kld->w_write);
             if(remove_f != 2) close(fd);
         }
+        l0OutClear(kl, kld);
+        l0IdleUnlink(kld);
         if (kld->name != NULL  && !strstr(kld->name, "-new-")) {
             // Show disconnect message
             ksn_printf(ke, MODULE, CONNECT, "### 0005,%s\n", kld->name);
@@ -1072,8 +1510,7 @@ void ksnLNullClientDisconnect(ksnLNullClass *kl, int fd, int remove_f) {
         if(kld->name != NULL) {
 
             if(remove_f)
-                pblMapRemoveFree(kl->map_n, kld->name, kld->name_length,
-                        &valueLength);
+                teoHashMapRemove(kl->map_n, kld->name, kld->name_length);
 
             free(kld->name);
             kld->name = NULL;
@@ -1101,11 +1538,99 @@ void ksnLNullClientDisconnect(ksnLNullClass *kl, int fd, int remove_f) {
 
         // Remove data from map
         if(remove_f) {
-            pblMapRemoveFree(kl->map, &fd, sizeof(fd), &valueLength);
+            teoHashMapRemoveInt(kl->map, fd);
         }
+
+        // Tell in-process client that it was disconnected
+        if(local_cb != NULL) local_cb(local_data, NULL, 0);
     }
 }
 
+/**
+ * Connect in-process L0 client
+ *
+ * Registers L0 client which lives in this process (f.e. websocket gateway
+ * session) in the L0 clients map. The client gets a fake fd, does not use
+ * socket and encryption, and receives its packets through the callback. It
+ * is not checked by the liveness check: the owner disconnects it with
+ * ksnLNullClientDisconnect.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param remote_addr Client remote address string or NULL
+ * @param cb Callback which gets packets sent to this client
+ * @param user_data Callback user data
+ *
+ * @return Client fd or -1 at error
+ */
+int ksnLNullLocalClientConnect(ksnLNullClass *kl, const char *remote_addr,
+        teoL0LocalClientCb cb, void *user_data) {
+
+    if(kl == NULL || cb == NULL) return -1;
+
+    int fd = ksnLNullGetNextFakeFd(kl);
+    ksnLNullData *kld = ksnLNullClientRegister(kl, fd, remote_addr, 0);
+    if(kld == NULL) return -1;
+
+    kld->local_cb = cb;
+    kld->local_data = user_data;
+    l0IdleUnlink(kld);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(EVENT_MANAGER_OBJECT(kl), MODULE, DEBUG_VV,
+            "in-process L0 client with fd %d connected\n", fd);
+    #endif
+
+    return fd;
+}
+
+/**
+ * Send packet from in-process L0 client
+ *
+ * The packet is processed as if it was received from L0 client connection:
+ * the login command (cmd = 0, to = "", data = login payload) checks the
+ * client, other commands are resent to teonet.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param fd In-process client fd
+ * @param cmd Command
+ * @param to Peer name to send to
+ * @param data Pointer to data
+ * @param data_length Data length
+ *
+ * @return Length of sent data or -1 at error
+ */
+ssize_t ksnLNullLocalClientSend(ksnLNullClass *kl, int fd, uint8_t cmd,
+        const char *to, const void *data, size_t data_length) {
+
+    ksnLNullData *kld = ksnLNullGetClientConnection(kl, fd);
+    if(kld == NULL || kld->local_cb == NULL) return -1;
+
+    // Login command
+    if(cmd == 0 && !to[0]) {
+        if(!data_length || ((const char *)data)[data_length - 1] ||
+           strlen(data) + 1 != data_length) return -1;
+    }
+    // Drop packets before login
+    else if(kld->name == NULL) return -1;
+
+    size_t to_len = strlen(to) + 1;
+    size_t buf_len = teoLNullBufferSize(to_len, data_length);
+    char *buf = malloc(buf_len);
+    memset(buf, 0, buf_len);
+    teoLNullCPacket *packet = (teoLNullCPacket *)buf;
+    teoLNullPacketCreate(buf, buf_len, cmd, to, data, data_length);
+    kld->last_time = ksnetEvMgrGetTime(kl->ke);
+
+    ssize_t snd = data_length;
+    if(!cmd && !to[0]) {
+        if(!ksnLNullClientAuthCheck(kl, kld, fd, packet)) snd = -1;
+    }
+    else ksnLNullSendFromL0(kl, packet, kld->name, kld->name_length);
+    free(buf);
+
+    return snd;
+}
+
 /**
  * L0 Server accept callback
  *
@@ -1134,54 +1659,158 @@ static void cmd_l0_accept_cb(struct ev_loop *loop, struct ev_ksnet_io *w,
     ksnLNullClientConnect(w->data, fd, remote_addr, remote_port);
 }
 
+/**
+ * Remove client from its idle list
+ *
+ * @param kld Pointer to ksnLNullData
+ */
+static void l0IdleUnlink(ksnLNullData *kld) {
+
+    teoL0IdleList *list = kld->idle_list;
+    if(list == NULL) return;
+
+    if(kld->idle_prev != NULL) kld->idle_prev->idle_next = kld->idle_next;
+    else list->head = kld->idle_next;
+    if(kld->idle_next != NULL) kld->idle_next->idle_prev = kld->idle_prev;
+    else list->tail = kld->idle_prev;
+
+    kld->idle_prev = kld->idle_next = NULL;
+    kld->idle_list = NULL;
+}
+
+/**
+ * Add client to the end of idle list
+ *
+ * @param list Pointer to teoL0IdleList
+ * @param kld Pointer to ksnLNullData
+ */
+static void l0IdleAppend(teoL0IdleList *list, ksnLNullData *kld) {
+
+    kld->idle_prev = list->tail;
+    kld->idle_next = NULL;
+    if(list->tail != NULL) list->tail->idle_next = kld;
+    else list->head = kld;
+    list->tail = kld;
+    kld->idle_list = list;
+}
+
+/**
+ * Set client last activity time
+ *
+ * Moves the client to the end of active clients list, so the list stays
+ * ordered by last activity time and the liveness check reads only its head.
+ *
+ * @param kl Pointer to ksnLNullClass
+ * @param kld Pointer to ksnLNullData
+ */
+static void l0ClientActivity(ksnLNullClass *kl, ksnLNullData *kld) {
+
+    kld->last_time = ksnetEvMgrGetTime(kl->ke);
+    if(kld->idle_list == &kl->active && kl->active.tail == kld) return;
+    l0IdleUnlink(kld);
+    l0IdleAppend(&kl->active, kld);
+}
+
+/**
+ * Get shared ping frame
+ *
+ * The ping frame is created once and only its echo time is updated. When the
+ * previous ping frame is still queued to some client a new frame is created.
+ *
+ * @param kl Pointer to ksnLNullClass
+ *
+ * @return Pointer to teoL0Frame owned by ksnLNullClass
+ */
+static teoL0Frame *l0PingFrame(ksnLNullClass *kl) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+
+    if(kl->ping_frame != NULL && kl->ping_frame->ref > 1) {
+        teoL0FrameRelease(kl->ping_frame);
+        kl->ping_frame = NULL;
+    }
+
+    if(kl->ping_frame == NULL) {
+        size_t data_e_length;
+        void *data_e = ksnCommandEchoBuffer(ke->kc->kco, "ping", 5,
+                &data_e_length);
+        kl->ping_frame = teoL0FrameCreate(CMD_ECHO, ksnetEvMgrGetHostName(ke),
+                data_e, data_e_length);
+        free(data_e);
+    }
+    else {
+        // Update echo time which follows the "ping" string
+        double ct = ksnetEvMgrGetTime(ke);
+        uint8_t *payload = teoLNullPacketGetPayload(
+                (teoLNullCPacket *)kl->ping_frame->data);
+        memcpy(payload + 5, &ct, sizeof(ct));
+        kl->ping_frame->sealed = 0;
+    }
+
+    return kl->ping_frame;
+}
+
 #define CHECK_TIMEOUT 10.00
 #define SEND_PING_TIMEOUT 30.00
 #define DISCONNECT_TIMEOUT 60.00
 
+/**
+ * Check L0 clients liveness
+ *
+ * Clients which did not send anything during SEND_PING_TIMEOUT are moved from
+ * the active list to the pinged list and are pinged every CHECK_TIMEOUT until
+ * they send something or until DISCONNECT_TIMEOUT. Both lists are ordered, so
+ * the check stops at the first client which is not due yet.
+ *
+ * @param id CQue callback id
+ * @param type CQue callback type
+ * @param data Pointer to ksnLNullClass
+ */
 void _check_connected(uint32_t id, int type, void *data) {
 
     ksnLNullClass *kl = data;
     ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kl);
+    double ct = ksnetEvMgrGetTime(kl->ke);
+    teoL0Frame *ping = NULL;
 
-    // Disconnect all clients which don't send nothing during timeout
-    PblIterator *it = pblMapIteratorReverseNew(kl->map);
-    if(it != NULL) {
-        while(pblIteratorHasPrevious(it) > 0) {
-            void *entry = pblIteratorPrevious(it);
-            ksnLNullData *l0_data = pblMapEntryValue(entry);
-            int *fd = (int *) pblMapEntryKey(entry);
-            // Disconnect client
-            if(ksnetEvMgrGetTime(kl->ke) - l0_data->last_time >= DISCONNECT_TIMEOUT) {
-                ksn_printf(ke, MODULE, DEBUG, "Disconnect client by timeout, fd: %d, name: %s\n", *fd, l0_data->name);
-                ksnLNullClientDisconnect(kl, *fd, 1);
-            }
-            // Send echo to client, if authorized
-            else if(l0_data->name != NULL && ksnetEvMgrGetTime(kl->ke) - l0_data->last_time >= SEND_PING_TIMEOUT) {
-                ksn_printf(ke, MODULE, DEBUG, "Send ping to client by timeout, fd: %d, name: %s\n", *fd, l0_data->name);
+    // Clients which became idle
+    while(kl->active.head != NULL &&
+          ct - kl->active.head->last_time >= SEND_PING_TIMEOUT) {
 
-                // From this host(peer)
-                const char *from = ksnetEvMgrGetHostName(kl->ke);
-                size_t data_e_length, from_len = strlen(from) + 1;
+        ksnLNullData *kld = kl->active.head;
+        l0IdleUnlink(kld);
+        l0IdleAppend(&kl->pinged, kld);
+        kld->ping_time = ct;
 
-                // Create echo buffer
-                void *data_e = ksnCommandEchoBuffer(((ksnetEvMgrClass *)(kl->ke))->kc->kco, "ping", 5, &data_e_length);
+        // Send echo to client, if authorized
+        if(kld->name != NULL) {
+            ksn_printf(ke, MODULE, DEBUG, "Send ping to client by timeout, fd: %d, name: %s\n", kld->fd, kld->name);
+            if(ping == NULL) ping = l0PingFrame(kl);
+            l0FrameSendShared(kl, kld, ping);
+        }
+    }
 
-                // Create L0 packet
-                size_t out_data_len = sizeof(teoLNullCPacket) + from_len + data_e_length;
-                char *out_data = malloc(out_data_len);
-                memset(out_data, 0, out_data_len);
+    // Pinged clients: disconnect or ping again
+    while(kl->pinged.head != NULL &&
+          ct - kl->pinged.head->ping_time >= CHECK_TIMEOUT) {
 
-                size_t packet_length = teoLNullPacketCreate(
-                    out_data, out_data_len, CMD_ECHO, from,
-                    data_e, data_e_length);
+        ksnLNullData *kld = kl->pinged.head;
 
-                ksnLNullPacketSend(kl, *fd, out_data, packet_length);
+        // Disconnect client
+        if(ct - kld->last_time >= DISCONNECT_TIMEOUT) {
+            ksn_printf(ke, MODULE, DEBUG, "Disconnect client by timeout, fd: %d, name: %s\n", kld->fd, kld->name);
+            ksnLNullClientDisconnect(kl, kld->fd, 1);
+            continue;
+        }
 
-                free(data_e);
-                free(out_data);
-            }
+        l0IdleUnlink(kld);
+        l0IdleAppend(&kl->pinged, kld);
+        kld->ping_time = ct;
+        if(kld->name != NULL) {
+            ksn_printf(ke, MODULE, DEBUG, "Send ping to client by timeout, fd: %d, name: %s\n", kld->fd, kld->name);
+            if(ping == NULL) ping = l0PingFrame(kl);
+            l0FrameSendShared(kl, kld, ping);
         }
-        pblIteratorFree(it);
     }
 
     ksnCQueAdd(kl->cque, _check_connected, CHECK_TIMEOUT, kl);
@@ -1243,21 +1872,22 @@ static void ksnLNullStop(ksnLNullClass *kl) {
     if(ke->teo_cfg.l0_allow_f && kl->fd) {
 
         // Disconnect all clients
-        PblIterator *it = pblMapIteratorReverseNew(kl->map);
-        if(it != NULL) {
-            while(pblIteratorHasPrevious(it) > 0) {
-                void *entry = pblIteratorPrevious(it);
-                int *fd = (int *) pblMapEntryKey(entry);
-                ksnLNullClientDisconnect(kl, *fd, 0);
-            }
-            pblIteratorFree(it);
+        teoHashMapIter it;
+        teoHashMapEntry *entry;
+        teoHashMapIterInit(kl->map, &it);
+        while((entry = teoHashMapIterNext(&it))) {
+            ksnLNullClientDisconnect(kl, ((ksnLNullData*)entry->data)->fd, 0);
         }
 
         // Clear maps
-        pblMapClear(kl->map_n);
-        pblMapClear(kl->map);
+        teoHashMapClear(kl->map_n);
+        teoHashMapClear(kl->map);
 
         ksnCQueDestroy(kl->cque); // Init check clients cque
+        if(kl->ping_frame != NULL) {
+            teoL0FrameRelease(kl->ping_frame);
+            kl->ping_frame = NULL;
+        }
 
         // Stop the server
         ksnTcpServerStop(ke->kt, kl->fd);
@@ -1293,15 +1923,7 @@ int cmd_l0_cb(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
     ksnLNullSPacket *data = rd->data;
 
     // Process command
-    if(data->cmd == CMD_ECHO || data->cmd == CMD_ECHO_ANSWER ||
-       data->cmd == CMD_ECHO_UNRELIABLE || data->cmd == CMD_ECHO_UNRELIABLE_ANSWER ||
-       data->cmd == CMD_PEERS || data->cmd == CMD_L0_CLIENTS ||
-       data->cmd == CMD_RESET || data->cmd == CMD_SUBSCRIBE || data->cmd == CMD_SUBSCRIBE_RND || data->cmd == CMD_UNSUBSCRIBE ||
-       data->cmd == CMD_L0_CLIENTS_N || data->cmd == CMD_L0_STAT ||
-       data->cmd == CMD_HOST_INFO || data->cmd == CMD_GET_NUM_PEERS ||
-       data->cmd == CMD_TRUDP_INFO ||
-       (data->cmd >= CMD_USER && data->cmd < CMD_192_RESERVED) ||
-       (data->cmd >= CMD_USER_NR && data->cmd < CMD_LAST)) {
+    if(ksnCommandL0Allowed(ke->kc->kco, data->cmd)) {
 
         // \TODO: char *client_name = data->payload;
         #ifdef DEBUG_KSNET
@@ -1346,9 +1968,7 @@ int cmd_l0_cb(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
  */
 int ksnLNullClientIsConnected(ksnLNullClass *kl, char *client_name) {
 
-    size_t valueLength;
-    int *fd = pblMapGet(kl->map_n, client_name, strlen(client_name) + 1,
-                &valueLength);
+    int *fd = teoHashMapGetStr(kl->map_n, client_name, NULL);
 
     return fd != NULL ? *fd : 0;
 }
@@ -1382,28 +2002,23 @@ int cmd_l0_to_cb(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
         if (fd) {
 
             // Create L0 packet
-            size_t out_data_len = sizeof(teoLNullCPacket) + rd->from_len +
-                    data->data_length;
-            char *out_data = malloc(out_data_len);
-            memset(out_data, 0, out_data_len);
-            size_t packet_length = teoLNullPacketCreate(out_data, out_data_len,
-                    data->cmd, rd->from, (const uint8_t*)data->payload + data->client_name_length,
+            teoL0Frame *frame = teoL0FrameCreate(data->cmd, rd->from,
+                    (const uint8_t*)data->payload + data->client_name_length,
                     data->data_length);
 
             // Send command to L0 client
-            ssize_t snd = ksnLNullPacketSend(ke->kl, fd, out_data, packet_length);
+            ssize_t snd = ksnLNullFrameSend(ke->kl, fd, frame);
             (void)snd;
 
             #ifdef DEBUG_KSNET
-            teoLNullCPacket *packet = (teoLNullCPacket *)out_data;
-            //void *packet_data = packet->peer_name + packet->peer_name_length;
+            teoLNullCPacket *packet = (teoLNullCPacket *)frame->data;
             ksn_printf(ke, MODULE, DEBUG_VV,
                 "send %d bytes to \"%s\" L0 client: %d bytes data, "
                 "from peer \"%s\"\n",
                 (int)snd, data->payload,
                 packet->data_length, packet->peer_name);
             #endif
-            free(out_data);
+            teoL0FrameRelease(frame);
         }
 
         // The L0 client was disconnected
@@ -1592,7 +2207,7 @@ int cmd_l0_check_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
     int fd = -1;
     
     if(jp.userId && (fd = ksnLNullClientIsConnected(kl, jp.userId))) {
-        ksnLNullData* kld = pblMapGet(kl->map, &fd, sizeof(fd), NULL);
+        ksnLNullData* kld = teoHashMapGetInt(kl->map, fd, NULL);
         if(kld != NULL) {
             confirmAuth(kl, kld, fd);
         } else {
@@ -1658,8 +2273,7 @@ int cmd_l0_kick_client(ksnCommandClass *kco, ksnCorePacketData *rd) {
         ksnLNullSend(kl, fd, CMD_L0_CLIENT_RESET, "2", 2);
 
         // Check user already connected
-        size_t valueLength;
-        ksnLNullData* kld = pblMapGet(kl->map, &fd, sizeof(fd), &valueLength);
+        ksnLNullData* kld = teoHashMapGetInt(kl->map, fd, NULL);
         if(kld != NULL) {
             ksnLNullClientDisconnect(kl, fd, 2);
         }
@@ -1688,25 +2302,22 @@ teonet_client_data_ar *ksnLNullClientsList(ksnLNullClass *kl) {
 
     if(kl != NULL && ke->teo_cfg.l0_allow_f && kl->fd) {
 
-        uint32_t length = pblMapSize(kl->map);
+        uint32_t length = teoHashMapSize(kl->map);
         data_ar = malloc(sizeof(teonet_client_data_ar) +
                 length * sizeof(data_ar->client_data[0]));
         int i = 0;
 
         // Create clients list
-        PblIterator *it = pblMapIteratorReverseNew(kl->map);
-        if(it != NULL) {
-            while(pblIteratorHasPrevious(it) > 0) {
-                void *entry = pblIteratorPrevious(it);
-                //int *fd = (int *) pblMapEntryKey(entry);
-                ksnLNullData *data = pblMapEntryValue(entry);
-                if(data != NULL && data->name != NULL) {
-                    strncpy(data_ar->client_data[i].name, data->name,
-                            sizeof(data_ar->client_data[i].name));
-                    i++;
-                }
+        teoHashMapIter it;
+        teoHashMapEntry *entry;
+        teoHashMapIterInit(kl->map, &it);
+        while((entry = teoHashMapIterNext(&it))) {
+            ksnLNullData *data = entry->data;
+            if(data->name != NULL) {
+                strncpy(data_ar->client_data[i].name, data->name,
+                        sizeof(data_ar->client_data[i].name));
+                i++;
             }
-            pblIteratorFree(it);
         }
         data_ar->length = i;
     }
@@ -1920,6 +2531,7 @@ static int processPacket(ksnLNullClass *kl, ksnLNullData *kld,
     }
 
     teoLNullPacketCheckMiscrypted(kl, kld, packet);
+    TEO_TRACE3(l0_frame_in, tcd->fd, packet->cmd, packet->data_length);
 
     #ifdef DEBUG_KSNET
     uint8_t *data = teoLNullPacketGetPayload(packet);
@@ -1998,7 +2610,7 @@ static int processPacket(ksnLNullClass *kl, ksnLNullData *kld,
         // Process other L0 TR-UDP packets
         // Send packet to peer
         if (kld->name != NULL) {
-            kld->last_time = ksnetEvMgrGetTime(kl->ke);
+            l0ClientActivity(kl, kld);
             ksnLNullSendFromL0(kl, packet, kld->name, kld->name_length);
         } else {
             //TODO: do we want to disconnect client here?
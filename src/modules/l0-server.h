@@ -11,10 +11,84 @@
 #include <ev.h>
 #include <pbl.h>
 #include "modules/cque.h"
+#include "utils/teo_hashmap.h"
+#include "l0-auth.h"
 #include "net_com.h"
 #include "subscribe.h"
 #include "teonet_l0_client.h"
 
+#define L0_OUT_IOV_MAX 64 ///< Maximum frames written to client by one writev
+
+/**
+ * What to do with L0 client which output queue is full
+ */
+typedef enum teoL0SlowClientPolicy {
+    L0_SLOW_CLIENT_DROP = 0,      ///< Drop new frames
+    L0_SLOW_CLIENT_DISCONNECT = 1 ///< Disconnect client
+} teoL0SlowClientPolicy;
+
+/**
+ * L0 output frame (L0 packet), may be shared between output queues of
+ * several clients
+ */
+typedef struct teoL0Frame {
+    uint32_t ref;      ///< Number of references: creator and output queues
+    int sealed;        ///< Frame was sealed without encryption
+    size_t length;     ///< Packet length
+    uint8_t data[];    ///< Packet
+} teoL0Frame;
+
+/**
+ * L0 client output queue item
+ */
+typedef struct teoL0OutItem {
+    struct teoL0OutItem *next;
+    teoL0Frame *frame;
+} teoL0OutItem;
+
+/**
+ * L0 client output queue statistic
+ */
+typedef struct teoL0OutStat {
+    size_t   queued;           ///< Bytes in output queue
+    size_t   queued_max;       ///< Maximum bytes in output queue
+    uint64_t sent;             ///< Bytes sent to client
+    uint64_t dropped;          ///< Frames dropped because output queue was full
+} teoL0OutStat;
+
+/**
+ * L0 broadcast statistic
+ */
+typedef struct teoL0BroadcastStat {
+    uint64_t broadcasts;       ///< Number of broadcasts
+    uint32_t last_clients;     ///< Number of clients of last broadcast
+    double   last_time;        ///< Last broadcast completion time, sec
+    double   max_time;         ///< Maximum broadcast completion time, sec
+} teoL0BroadcastStat;
+
+struct ksnLNullData;
+
+/**
+ * In-process L0 client callback
+ *
+ * Gets L0 packets sent to the in-process client, the packet is NULL when the
+ * client was disconnected by L0 server.
+ *
+ * @param user_data User data of the in-process client
+ * @param packet Pointer to teoLNullCPacket or NULL
+ * @param packet_length Packet length
+ */
+typedef void (*teoL0LocalClientCb)(void *user_data, teoLNullCPacket *packet,
+        size_t packet_length);
+
+/**
+ * L0 clients idle list, clients are ordered by last activity time
+ */
+typedef struct teoL0IdleList {
+    struct ksnLNullData *head; ///< Client idle for the longest time
+    struct ksnLNullData *tail; ///< Most recently active client
+} teoL0IdleList;
+
 /**
  * L0 Server map data structure
  * 
@@ -33,6 +107,23 @@ typedef struct ksnLNullData { // \TODO: will be renamed to teoL0Data
     double  last_time;
 
     teoLNullEncryptionContext *server_crypt; // \TODO: will be renamed to teoL0EncryptionContext
+
+    ev_io   w_write;           ///< TCP Client write watcher, active while output queue is not empty
+    teoL0OutItem *out_head;    ///< Output queue head
+    teoL0OutItem *out_tail;    ///< Output queue tail
+    size_t  out_offset;        ///< Bytes of the head frame already written
+    int     out_high_f;        ///< Output queue reached high watermark
+    teoL0OutStat out_stat;     ///< Output queue statistic
+
+    int     fd;                ///< Client fd (key in the L0 clients map)
+    double  ping_time;         ///< Time of last ping sent to idle client
+    struct ksnLNullData *idle_prev; ///< Previous client in idle list
+    struct ksnLNullData *idle_next; ///< Next client in idle list
+    teoL0IdleList *idle_list;  ///< Idle list which contains this client
+
+    teoL0LocalClientCb local_cb; ///< In-process client callback or NULL
+    void   *local_data;        ///< In-process client callback user data
+    uint32_t auth_seq;         ///< Last login sequence number
 } ksnLNullData;
 
 /**
@@ -40,12 +131,19 @@ typedef struct ksnLNullData { // \TODO: will be renamed to teoL0Data
  */
 typedef struct  ksnLNullClass { // \TODO: will be renamed to teoL0Class
     void           *ke;         ///< Pointer to ksnEvMgrClass
-    PblMap         *map;        ///< Pointer to the L0 clients map (by fd)
-    PblMap         *map_n;      ///< Pointer to the L0 FDs map (by name)
+    teoHashMap     *map;        ///< Pointer to the L0 clients map (by fd)
+    teoHashMap     *map_n;      ///< Pointer to the L0 FDs map (by name)
     int             fd;         ///< L0 TCP Server FD
     ksnLNullSStat   stat;       ///< L0 server statistic
     int             fd_trudp;   ///< Last free TR-UDP L0 FD
     ksnCQueClass   *cque;       ///< CQUe to check dead clients
+    teoL0OutItem   *out_free;   ///< Free output queue items
+    teoL0IdleList   active;     ///< Clients which was not pinged yet
+    teoL0IdleList   pinged;     ///< Idle clients pinged by liveness check
+    teoL0Frame     *ping_frame; ///< Shared ping frame template
+    teoL0BroadcastStat bcast;   ///< Broadcast statistic
+    teoL0Auth      *auth;       ///< Login verification
+    uint32_t        auth_seq;   ///< Last login sequence number
 } ksnLNullClass;
 
 #pragma pack(push)
@@ -82,7 +180,17 @@ size_t ksnLNullClientsListLength(teonet_client_data_ar *clients_data);
 ksnLNullSStat *ksnLNullStat(ksnLNullClass *kl);
 int ksnLNulltrudpCheckPaket(ksnLNullClass *kl, ksnCorePacketData *rd);
 ssize_t ksnLNullPacketSend(ksnLNullClass *kl, int fd, void *pkg, size_t pkg_length);
+teoL0Frame *teoL0FrameCreate(uint8_t cmd, const char *from, const void *data,
+        size_t data_length);
+void teoL0FrameRelease(teoL0Frame *frame);
+ssize_t ksnLNullFrameSend(ksnLNullClass *kl, int fd, teoL0Frame *frame);
+teoL0OutStat *ksnLNullClientOutStat(ksnLNullClass *kl, int fd);
+teoL0BroadcastStat *ksnLNullBroadcastStat(ksnLNullClass *kl);
 void ksnLNullClientDisconnect(ksnLNullClass *kl, int fd, int remove_f);
+int ksnLNullLocalClientConnect(ksnLNullClass *kl, const char *remote_addr,
+        teoL0LocalClientCb cb, void *user_data);
+ssize_t ksnLNullLocalClientSend(ksnLNullClass *kl, int fd, uint8_t cmd,
+        const char *to, const void *data, size_t data_length);
 
 teoLNullEncryptionContext *ksnLNullClientGetCrypto(ksnLNullClass *kl, int fd);
 
@@ -13,24 +13,40 @@
 
 #include <fcntl.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include "ev_mgr.h"
 #include "log_reader.h"
 
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#define LOG_READER_INOTIFY_MASK (IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF)
+#endif
+
 #define MODULE "log_reader"
 #define kev ((ksnetEvMgrClass*)(lr->ke))
 
-#define BUFINC 256
+static void inotify_cb(EV_P_ ev_io *w, int revents);
 
 teoLogReaderClass *teoLogReaderInit(void *ke) {
     teoLogReaderClass *lr = malloc(sizeof(teoLogReaderClass));
-    lr->buf_size = 0;
-    lr->buffer = NULL;
-    lr->line_buf_size = 0;
-    lr->line_buffer = NULL;
     lr->ke = ke;
+    lr->map = teoMapNew(MAP_SIZE_DEFAULT, 1);
+    lr->fd = -1;
+
+    // One inotify descriptor serves all watched files of this event loop
+    #ifdef HAVE_SYS_INOTIFY_H
+    lr->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(lr->fd != -1) {
+        ev_io_init(&lr->w, inotify_cb, lr->fd, EV_READ);
+        lr->w.data = lr;
+        ev_io_start(kev->ev_loop, &lr->w);
+    }
+    #endif
+
     #ifdef DEBUG_KSNET
-    ksn_puts(kev, MODULE, DEBUG_VV, "have been initialized");
+    ksn_printf(kev, MODULE, DEBUG_VV, "have been initialized%s\n",
+            lr->fd == -1 ? " (inotify is not available, use stat)" : "");
     #endif
     return lr;
 }
@@ -38,8 +54,11 @@ teoLogReaderClass *teoLogReaderInit(void *ke) {
 void teoLogReaderDestroy(teoLogReaderClass *lr) {
     if(lr) {
         ksnetEvMgrClass *ke = lr->ke;
-        if(lr->line_buffer) free(lr->line_buffer);
-        if(lr->buffer) free(lr->buffer);
+        if(lr->fd != -1) {
+            ev_io_stop(ke->ev_loop, &lr->w);
+            close(lr->fd);
+        }
+        teoMapDestroy(lr->map);
         free(lr);
 
         #ifdef DEBUG_KSNET
@@ -48,69 +67,187 @@ void teoLogReaderDestroy(teoLogReaderClass *lr) {
     }
 }
 
-static void *readBuffer(teoLogReaderClass *lr, int fd, size_t *data_length) {
+/**
+ * Send line to event loop and watcher callback
+ *
+ * @param wd Pointer to teoLogReaderWatcher
+ * @param line Line begin in watcher buffer
+ * @param eol Line end in watcher buffer, will be replaced by string terminator
+ */
+static void sendLine(teoLogReaderWatcher *wd, char *line, char *eol) {
+    teoLogReaderClass *lr = wd->lr;
+    if(eol > line && eol[-1] == '\r') eol--;
+    *eol = '\0';
+    if(!((wd->flags & SKIP_EMPTY) && eol == line)) {
+        size_t data_len = eol - line + 1;
+        kev->event_cb(kev, EV_K_LOG_READER, (void*)line, data_len, wd);
+        if(wd->cb) wd->cb((void*)line, data_len, wd);
+    }
+}
 
-    size_t ptr = 0, rd;
-    for(;;) {
-        // Allocate and reallocate buffer
-        if(!lr->buf_size) {
-            lr->buf_size = BUFINC * 2;
-            lr->buffer = malloc(lr->buf_size);
-        }
-        else if(lr->buf_size - ptr < BUFINC) {
-            lr->buf_size += BUFINC * 2;
-            lr->buffer = realloc(lr->buffer, lr->buf_size);
-        }
-        // Read from file
-        rd = read(fd, lr->buffer + ptr, lr->buf_size - ptr);
-        if(rd > 0) ptr += rd;
-        else break;
+/**
+ * Split read buffer by end of lines and send finished lines
+ *
+ * Lines are sent directly from the read buffer, the not finished line is
+ * moved to the buffer begin to be continued by next read.
+ *
+ * @param wd Pointer to teoLogReaderWatcher
+ */
+static void processLines(teoLogReaderWatcher *wd) {
+    char *line = wd->buffer, *end = wd->buffer + wd->buf_len, *eol;
+    while((eol = memchr(line, '\n', end - line)) != NULL) {
+        sendLine(wd, line, eol);
+        line = eol + 1;
     }
-    if(data_length) *data_length = ptr;
-    return lr->buffer;
+    // The line is longer than buffer, send it by parts
+    if(line == wd->buffer && wd->buf_len == LOG_READER_BUFFER_SIZE - 1) {
+        sendLine(wd, line, end);
+        line = end;
+    }
+    wd->buf_len = end - line;
+    if(wd->buf_len && line != wd->buffer) memmove(wd->buffer, line, wd->buf_len);
 }
 
-static char *readLineBuffer(teoLogReaderClass *lr, size_t *ptr, size_t data_length) {
-    // Allocate line buffer
-    if(!lr->line_buffer) {
-        lr->line_buf_size = BUFINC;
-        lr->line_buffer = malloc(lr->line_buf_size);
+/**
+ * Read new data from watched file
+ *
+ * Reads not more than LOG_READER_MAX_READS buffers and continues in idle
+ * watcher if the file has more data.
+ *
+ * @param wd Pointer to teoLogReaderWatcher
+ */
+static void readFile(teoLogReaderWatcher *wd) {
+    teoLogReaderClass *lr = wd->lr;
+    if(wd->fd == -1) return;
+
+    // File was truncated, read it from the beginning
+    struct stat st;
+    if(!fstat(wd->fd, &st) && st.st_size < wd->offset) {
+        #ifdef DEBUG_KSNET
+        ksn_printf(kev, MODULE, DEBUG_VV, "file %s truncated\n", wd->file_name);
+        #endif
+        lseek(wd->fd, 0, SEEK_SET);
+        wd->offset = 0;
+        wd->buf_len = 0;
     }
-    // Split input buffer by end of line  
-    #define retstr ((char*)lr->line_buffer)
-    retstr[0] = 0;
-    for(int i = 0; *ptr < data_length; ) {
-        char ch = ((char*)lr->buffer)[(*ptr)++];
-        if(ch == '\r') continue;
-        if(ch != '\n') {
-            retstr[i++] = ch;
-            retstr[i] = 0;
-            // Reallocate line buffer
-            if(i >= lr->line_buf_size-1) {
-                lr->line_buf_size += BUFINC;
-                lr->line_buffer = realloc(lr->line_buffer, lr->line_buf_size);
-            }
+
+    int reads;
+    for(reads = 0; reads < LOG_READER_MAX_READS; reads++) {
+        ssize_t rd = read(wd->fd, wd->buffer + wd->buf_len,
+                LOG_READER_BUFFER_SIZE - 1 - wd->buf_len);
+        if(rd <= 0) break;
+        wd->offset += rd;
+        wd->buf_len += rd;
+        processLines(wd);
+    }
+    if(reads == LOG_READER_MAX_READS) ev_idle_start(kev->ev_loop, &wd->read_w);
+}
+
+/**
+ * Add inotify watch of watcher file
+ */
+static void addWatch(teoLogReaderWatcher *wd) {
+    teoLogReaderClass *lr = wd->lr;
+    #ifdef HAVE_SYS_INOTIFY_H
+    if(lr->fd != -1) {
+        wd->wd = inotify_add_watch(lr->fd, wd->file_name, 
+                LOG_READER_INOTIFY_MASK);
+        if(wd->wd != -1) {
+            teoMapAdd(lr->map, &wd->wd, sizeof(wd->wd), &wd, sizeof(wd));
+            return;
         }
-        else break;
     }
-    return retstr;
+    #endif
+    // Inotify is not available, use stat watcher
+    if(!ev_is_active(&wd->stat_w)) ev_stat_start(kev->ev_loop, &wd->stat_w);
 }
 
-static void receive_cb(EV_P_ ev_stat *w, int revents) {
-    teoLogReaderWatcher *wd = w->data;
+/**
+ * Remove inotify watch of watcher file
+ *
+ * @param wd Pointer to teoLogReaderWatcher
+ * @param rm_watch Remove watch from inotify (0 if it was already removed)
+ */
+static void removeWatch(teoLogReaderWatcher *wd, int rm_watch) {
+    teoLogReaderClass *lr = wd->lr;
+    if(wd->wd != -1) {
+        teoMapDelete(lr->map, &wd->wd, sizeof(wd->wd));
+        #ifdef HAVE_SYS_INOTIFY_H
+        if(rm_watch) inotify_rm_watch(lr->fd, wd->wd);
+        #endif
+        wd->wd = -1;
+    }
+}
+
+/**
+ * Watched file was moved or deleted: read rest of data and wait for new file
+ */
+static void rotated(teoLogReaderWatcher *wd) {
     teoLogReaderClass *lr = wd->lr;
-    int empty;
-    size_t data_length, ptr = 0;
-    readBuffer(lr, wd->fd, &data_length);
-    if(data_length) do {
-        const char *line = readLineBuffer(lr, &ptr, data_length);
-        empty = !line[0];
-        if(!((wd->flags & SKIP_EMPTY) && empty)) {
-            size_t data_len = strlen(line) + 1;
-            kev->event_cb(kev, EV_K_LOG_READER, (void*)line, data_len, wd);
-            if(wd->cb) wd->cb((void*)line, data_len, wd);
+    #ifdef DEBUG_KSNET
+    ksn_printf(kev, MODULE, DEBUG_VV, "file %s rotated\n", wd->file_name);
+    #endif
+    do {
+        ev_idle_stop(kev->ev_loop, &wd->read_w);
+        readFile(wd);
+    } while(ev_is_active(&wd->read_w));
+    removeWatch(wd, 1);
+    close(wd->fd);
+    wd->fd = -1;
+    wd->buf_len = 0;
+    ev_timer_again(kev->ev_loop, &wd->reopen_w);
+}
+
+static void read_cb(EV_P_ ev_idle *w, int revents) {
+    ev_idle_stop(EV_A_ w);
+    readFile(w->data);
+}
+
+static void stat_cb(EV_P_ ev_stat *w, int revents) {
+    teoLogReaderWatcher *wd = w->data;
+    struct stat st;
+    // File name removed or points to other file
+    if(wd->fd != -1 && (!w->attr.st_nlink || 
+            (!fstat(wd->fd, &st) && st.st_ino != w->attr.st_ino))) {
+        ev_stat_stop(EV_A_ w);
+        rotated(wd);
+    }
+    else readFile(wd);
+}
+
+static void reopen_cb(EV_P_ ev_timer *w, int revents) {
+    teoLogReaderWatcher *wd = w->data;
+    int fd = open(wd->file_name, O_RDONLY);
+    if(fd == -1) return;
+    ev_timer_stop(EV_A_ w);
+    wd->fd = fd;
+    wd->offset = 0;
+    addWatch(wd);
+    readFile(wd);
+}
+
+static void inotify_cb(EV_P_ ev_io *w, int revents) {
+    #ifdef HAVE_SYS_INOTIFY_H
+    teoLogReaderClass *lr = w->data;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while((len = read(lr->fd, buf, sizeof(buf))) > 0) {
+        const struct inotify_event *event;
+        char *ptr;
+        for(ptr = buf; ptr < buf + len; 
+                ptr += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) ptr;
+            size_t wdp_len;
+            teoLogReaderWatcher **wdp = teoMapGet(lr->map, (void*)&event->wd,
+                    sizeof(event->wd), &wdp_len);
+            if(wdp == (void*)-1 || wdp == NULL) continue;
+            teoLogReaderWatcher *wd = *wdp;
+            if(event->mask & IN_IGNORED) removeWatch(wd, 0);
+            else if(event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) rotated(wd);
+            else if(event->mask & IN_MODIFY) readFile(wd);
         }
-    } while(ptr < data_length);
+    }
+    #endif
 }
 
 teoLogReaderWatcher *teoLogReaderOpenCbPP(teoLogReaderClass *lr,
@@ -123,20 +260,27 @@ teoLogReaderWatcher *teoLogReaderOpenCbPP(teoLogReaderClass *lr,
             "Data file %s not present\n", file_name);
     else {
         wd = malloc(sizeof(teoLogReaderWatcher));
-        ev_stat *w = malloc(sizeof(ev_stat));
         wd->file_name = strdup(file_name);
         wd->user_data = user_data;
         wd->name = strdup(name);
         wd->flags = flags;
         wd->lr = lr;
         wd->fd = fd;
+        wd->wd = -1;
         wd->cb = cb;
-        wd->w = w;
-        ev_stat_init (w, receive_cb, file_name, 0.01);
-        w->data = wd;
-        ev_stat_start (kev->ev_loop, w);
-        if(flags & READ_FROM_END) lseek(fd, 0, SEEK_END);
-        else receive_cb(kev->ev_loop, w, 0);
+        wd->offset = 0;
+        wd->buffer = malloc(LOG_READER_BUFFER_SIZE);
+        wd->buf_len = 0;
+        ev_idle_init(&wd->read_w, read_cb);
+        wd->read_w.data = wd;
+        ev_init(&wd->reopen_w, reopen_cb);
+        wd->reopen_w.repeat = LOG_READER_REOPEN_INTERVAL;
+        wd->reopen_w.data = wd;
+        ev_stat_init(&wd->stat_w, stat_cb, wd->file_name, 0.01);
+        wd->stat_w.data = wd;
+        addWatch(wd);
+        if(flags & READ_FROM_END) wd->offset = lseek(fd, 0, SEEK_END);
+        else readFile(wd);
     }
     return wd;
 }
@@ -156,11 +300,15 @@ int teoLogReaderClose(teoLogReaderWatcher *wd) {
     int retval = -1;
     if(wd) {
         // Stop this watcher and free memory
-        ev_stat_stop(((ksnetEvMgrClass*)wd->lr->ke)->ev_loop, wd->w);
-        retval = close(wd->fd);
+        teoLogReaderClass *lr = wd->lr;
+        removeWatch(wd, 1);
+        ev_stat_stop(kev->ev_loop, &wd->stat_w);
+        ev_idle_stop(kev->ev_loop, &wd->read_w);
+        ev_timer_stop(kev->ev_loop, &wd->reopen_w);
+        retval = wd->fd != -1 ? close(wd->fd) : 0;
         free((void*)wd->file_name);
         free((void*)wd->name);
-        free(wd->w);
+        free(wd->buffer);
         free(wd);
     }
     return retval;
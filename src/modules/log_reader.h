@@ -21,13 +21,16 @@ typedef enum _teoLogReaderFlag {
   SKIP_EMPTY    = 0b010   // 010 Skip empty strings
 } _teoLogReaderFlag;
 
+#define LOG_READER_BUFFER_SIZE (64 * 1024) // Size of watcher read buffer
+#define LOG_READER_MAX_READS 16 // Maximum number of buffer reads per loop iteration
+#define LOG_READER_REOPEN_INTERVAL 0.5 // Interval to try reopen rotated file (sec)
+
 typedef struct teoLogReaderClass {
 
     void *ke; // Pointer to ksnEvMgrClass
-    void *buffer; // Pointer to read buffer
-    size_t buf_size; // Size of current allocated read buffer size
-    void *line_buffer; // Pointer to read line buffer
-    size_t line_buf_size; // Size of current allocated read line buffer size
+    int fd; // Inotify file descriptor or -1 if inotify is not available
+    ev_io w; // Inotify watcher
+    teoMap *map; // Inotify watch descriptor -> teoLogReaderWatcher*
 
 } teoLogReaderClass;
 
@@ -42,8 +45,14 @@ typedef struct teoLogReaderWatcher {
     const char *file_name;
     const char *name; 
     void *user_data;
-    ev_stat *w;
-    int fd;
+    int fd; // File descriptor or -1 while rotated file is absent
+    int wd; // Inotify watch descriptor or -1
+    off_t offset; // Read position in file
+    char *buffer; // Read buffer, LOG_READER_BUFFER_SIZE bytes
+    size_t buf_len; // Length of not finished line in read buffer
+    ev_idle read_w; // Continue reading watcher
+    ev_timer reopen_w; // Reopen rotated file watcher
+    ev_stat stat_w; // File stat watcher (used if inotify is not available)
 } teoLogReaderWatcher;
 
 #ifdef	__cplusplus
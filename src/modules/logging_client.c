@@ -10,6 +10,10 @@
 #include "ev_mgr.h"
 #include "logging_client.h"
 
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
 #define MODULE "logging_client"
 #define kev ((ksnetEvMgrClass*)(ke))
 //#define MAP_SIZE_DEFAULT 10
@@ -17,14 +21,27 @@
 // Logging Async call label
 static const uint32_t ASYNC_LABEL = 0xAA77AA77; 
 
+/**
+ * Logging server flags (logging servers map data)
+ */
+enum teoLoggingServerFlags {
+
+    LOGGING_SERVER_LEGACY = 0, ///< Server accepts one record per command
+    LOGGING_SERVER_FRAMES = 0x80 ///< Server accepts teoLoggingFrame, low bits are teoLoggingCaps flags
+};
+
 /**
  * Logging servers Maps Foreach user data
  */
 typedef struct teoLoggingClientSendData {
 
     const teoLoggingClientClass *lc;
-    void *data; 
-    size_t data_length;
+    const char *records; ///< Log records (cstrings)
+    size_t records_len; ///< Log records length
+    teoLoggingFrame *frame; ///< Frame with records
+    size_t frame_len; ///< Frame length
+    teoLoggingFrame *frame_c; ///< Frame with compressed records or NULL
+    size_t frame_c_len; ///< Compressed frame length
 
 } teoLoggingClientSendData;
 
@@ -33,11 +50,26 @@ typedef struct teoLoggingClientSendData {
  * 
  * @param ls Pointer to teoLoggingClientClass
  * @param peer Logger server peer name
+ * @param flags Server flags
  */
 static void teoLoggingClientAddServer(teoLoggingClientClass *lc, 
-        const char *peer) {
+        const char *peer, uint8_t flags) {
+    #ifdef DEBUG_KSNET
     ksnetEvMgrClass *ke = lc->ke;
-    if(teoMapAdd(lc->map, (void*)peer, strlen(peer)+1, NULL, 0) != (void*)-1) {
+    #endif
+
+    // Update flags of existing server
+    size_t flags_len;
+    uint8_t *server_flags = teoMapGet(lc->map, (void*)peer, strlen(peer)+1, 
+            &flags_len);
+    if(server_flags != (void*)-1 && server_flags != NULL) {
+        *server_flags = flags;
+        return;
+    }
+
+    if(teoMapAdd(lc->map, (void*)peer, strlen(peer)+1, &flags, 
+            sizeof(flags)) != (void*)-1) {
+        lc->num_servers++;
         #ifdef DEBUG_KSNET
         ksn_printf(ke, MODULE, DEBUG /*DEBUG_VV*/, // \TODO set DEBUG_VV
                 "add logging server peer '%s'\n", peer);
@@ -59,8 +91,11 @@ static void teoLoggingClientAddServer(teoLoggingClientClass *lc,
  */
 static void teoLoggingClientRemoveServer(teoLoggingClientClass *lc, 
         const char *peer) {
+    #ifdef DEBUG_KSNET
     ksnetEvMgrClass *ke = lc->ke;
+    #endif
     if(!teoMapDelete(lc->map, (void*)peer, strlen(peer)+1)) {
+        lc->num_servers--;
         #ifdef DEBUG_KSNET
         ksn_printf(ke, MODULE, DEBUG /*DEBUG_VV*/, 
                 "remove logging server peer '%s'\n", peer); // \TODO set DEBUG_VV
@@ -82,19 +117,177 @@ static int teoLoggingClientSendOne(teoMap *m, int idx, teoMapElementData *el,
     const teoLoggingClientSendData *data = user_data;
     const ksnetEvMgrClass *ke = data->lc->ke;
     const char* peer = el->data;
-    ksnCoreSendCmdto(ke->kc, (char*)peer, CMD_LOGGING, data->data, 
-            data->data_length);
+    const uint8_t flags = *(uint8_t*)teoMapIteratorElementData(el, NULL);
+
+    // Send frame
+    if(flags & LOGGING_SERVER_FRAMES) {
+        if(data->frame_c != NULL && (flags & LOGGING_FRAME_LZ4))
+            ksnCoreSendCmdto(ke->kc, (char*)peer, CMD_LOGGING, data->frame_c, 
+                    data->frame_c_len);
+        else
+            ksnCoreSendCmdto(ke->kc, (char*)peer, CMD_LOGGING, data->frame, 
+                    data->frame_len);
+    }
+    // Send records one by one to legacy server
+    else {
+        const char *rec = data->records, *end = rec + data->records_len;
+        while(rec < end) {
+            size_t rec_len = strlen(rec) + 1;
+            ksnCoreSendCmdto(ke->kc, (char*)peer, CMD_LOGGING, (void*)rec, 
+                    rec_len);
+            rec += rec_len;
+        }
+    }
     return 0;
 }
 
-// Send log data to logging servers
-static void teoLoggingClientSendAll(ksnetEvMgrClass *ke, void *data, 
-        size_t data_length) {
-    const teoLoggingClientClass *lc = ke->lc;
-    if(lc) {
-        teoLoggingClientSendData d = { lc, data, data_length };
-        teoMapForeach(lc->map, teoLoggingClientSendOne, &d);
+/**
+ * Pack log records to frame and send it to all logging servers
+ *
+ * @param lc Pointer to teoLoggingClientClass
+ * @param records Log records (cstrings)
+ * @param records_len Log records length
+ * @param count Number of records
+ * @param seq Sequence number of first record
+ * @param dropped Number of records dropped before this records
+ */
+static void teoLoggingClientSendFrame(teoLoggingClientClass *lc, 
+        const char *records, size_t records_len, uint16_t count, uint32_t seq, 
+        uint32_t dropped) {
+
+    char frame_buf[sizeof(teoLoggingFrame) + LOGGING_FRAME_RAW_MAX];
+    teoLoggingFrame *frame = (teoLoggingFrame *)frame_buf;
+    frame->magic = LOGGING_FRAME_MAGIC;
+    frame->version = LOGGING_PROTOCOL_VERSION;
+    frame->flags = 0;
+    frame->reserved = 0;
+    frame->seq = seq;
+    frame->dropped = dropped;
+    frame->count = count;
+    frame->raw_len = records_len;
+    memcpy(frame->payload, records, records_len);
+
+    teoLoggingClientSendData d = { lc, records, records_len, 
+            frame, sizeof(teoLoggingFrame) + records_len, NULL, 0 };
+
+    #ifdef HAVE_LIBLZ4
+    // Compressed copy of frame for servers which support it
+    char frame_c_buf[sizeof(teoLoggingFrame) + LOGGING_FRAME_RAW_MAX];
+    teoLoggingFrame *frame_c = (teoLoggingFrame *)frame_c_buf;
+    int c_len = LZ4_compress_default(records, frame_c->payload, 
+            records_len, LOGGING_FRAME_RAW_MAX);
+    if(c_len > 0 && (size_t)c_len < records_len) {
+        memcpy(frame_c, frame, sizeof(teoLoggingFrame));
+        frame_c->flags = LOGGING_FRAME_LZ4;
+        d.frame_c = frame_c;
+        d.frame_c_len = sizeof(teoLoggingFrame) + c_len;
+    }
+    #endif
+
+    teoMapForeach(lc->map, teoLoggingClientSendOne, &d);
+}
+
+/**
+ * Send collected log records to logging servers
+ *
+ * Takes all not sent records from queue and sends them packed to frames of
+ * up to LOGGING_FRAME_RAW_MAX bytes. Should be called from event loop thread.
+ *
+ * @param lc Pointer to teoLoggingClientClass
+ */
+static void teoLoggingClientFlush(teoLoggingClientClass *lc) {
+
+    // Take records from queue
+    pthread_mutex_lock(&lc->mutex);
+    char *buf = lc->buf;
+    size_t buf_len = lc->buf_len;
+    uint32_t seq = lc->seq - lc->count;
+    uint32_t dropped = lc->dropped;
+    lc->buf = NULL;
+    lc->buf_len = lc->buf_size = 0;
+    lc->count = 0;
+    lc->dropped = 0;
+    lc->flush_requested = 0;
+    pthread_mutex_unlock(&lc->mutex);
+
+    if(buf == NULL) return;
+
+    // Split records to frames
+    size_t ptr = 0, frame_start = 0;
+    uint16_t count = 0;
+    while(ptr < buf_len) {
+        size_t rec_len = strlen(buf + ptr) + 1;
+
+        // Too long record, send it truncated in its own frame
+        if(rec_len > LOGGING_FRAME_RAW_MAX) {
+            if(count) {
+                teoLoggingClientSendFrame(lc, buf + frame_start, 
+                        ptr - frame_start, count, seq, dropped);
+                seq += count; dropped = 0; count = 0;
+            }
+            buf[ptr + LOGGING_FRAME_RAW_MAX - 1] = '\0';
+            teoLoggingClientSendFrame(lc, buf + ptr, LOGGING_FRAME_RAW_MAX, 
+                    1, seq, dropped);
+            seq++; dropped = 0;
+            ptr += rec_len;
+            frame_start = ptr;
+            continue;
+        }
+
+        if(ptr + rec_len - frame_start > LOGGING_FRAME_RAW_MAX || 
+                count == UINT16_MAX) {
+            teoLoggingClientSendFrame(lc, buf + frame_start, 
+                    ptr - frame_start, count, seq, dropped);
+            seq += count; dropped = 0; count = 0;
+            frame_start = ptr;
+        }
+        ptr += rec_len;
+        count++;
     }
+    if(count) teoLoggingClientSendFrame(lc, buf + frame_start, 
+            ptr - frame_start, count, seq, dropped);
+
+    free(buf);
+}
+
+/**
+ * Flush timer callback
+ */
+static void flush_cb(EV_P_ ev_timer *w, int revents) {
+    teoLoggingClientFlush(w->data);
+}
+
+/**
+ * CMD_LOGGING command handler: add logging server to map
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to ksnCorePacketData
+ * @param user_data Pointer to teoLoggingClientClass
+ *
+ * @return True if logging server announce was processed
+ */
+static int cmd_logging_cb(ksnCommandClass *kco, ksnCorePacketData *rd,
+        void *user_data) {
+
+    teoLoggingClientClass *lc = user_data;
+
+    if(rd->data_len == 0) {
+        teoLoggingClientAddServer(lc, rd->from, LOGGING_SERVER_LEGACY);
+        return 1;
+    }
+
+    // Logging server capabilities
+    if(rd->data_len == sizeof(teoLoggingCaps) &&
+            ((teoLoggingCaps*)rd->data)->version >= LOGGING_PROTOCOL_VERSION) {
+        uint8_t flags = LOGGING_SERVER_FRAMES;
+        #ifdef HAVE_LIBLZ4
+        flags |= ((teoLoggingCaps*)rd->data)->flags & LOGGING_FRAME_LZ4;
+        #endif
+        teoLoggingClientAddServer(lc, rd->from, flags);
+        return 1;
+    }
+
+    return 0;
 }
 
 // Event loop to gab teonet events
@@ -110,18 +303,10 @@ static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event, void *data,
             teoLoggingClientRemoveServer(ke->lc, rd->from);
             break;
 
-        // Add logging server to map
-        case EV_K_RECEIVED:
-            if(rd->cmd == CMD_LOGGING && rd->data_len == 0) {
-                teoLoggingClientAddServer(ke->lc, rd->from);
-                processed = 1;
-            }
-            break;
-            
-        // Async event from teoLoggingClientSend (kns_printf)
+        // Async event from teoLoggingClientSend (kns_printf): queue is full
         case EV_K_ASYNC:
             if(user_data && *(uint32_t*)user_data == ASYNC_LABEL) {
-                teoLoggingClientSendAll(ke, data, data_length);
+                teoLoggingClientFlush(ke->lc);
                 processed = 1;
             }
             break;
@@ -145,10 +330,19 @@ teoLoggingClientClass *teoLoggingClientInit(void *ke) {
     }
 
     teoLoggingClientClass *lc = malloc(sizeof(teoLoggingClientClass));
+    memset(lc, 0, sizeof(teoLoggingClientClass));
     lc->ke = ke;
     lc->map = teoMapNew(MAP_SIZE_DEFAULT, 1);
     lc->event_cb = kev->event_cb;
     kev->event_cb = event_cb;
+    ksnCommandRegister(kev->kc->kco, CMD_LOGGING, cmd_logging_cb, lc);
+    pthread_mutex_init(&lc->mutex, NULL);
+
+    // Start flush timer
+    ev_timer_init(&lc->flush_w, flush_cb, LOGGING_FLUSH_INTERVAL, 
+            LOGGING_FLUSH_INTERVAL);
+    lc->flush_w.data = lc;
+    ev_timer_start(kev->ev_loop, &lc->flush_w);
 
     #ifdef DEBUG_KSNET
     ksn_puts(kev, MODULE, DEBUG_VV,
@@ -162,10 +356,14 @@ teoLoggingClientClass *teoLoggingClientInit(void *ke) {
 void teoLoggingClientDestroy(teoLoggingClientClass *lc) {
     if(lc) {
         ksnetEvMgrClass *ke = lc->ke;
+        ev_timer_stop(ke->ev_loop, &lc->flush_w);
+        teoLoggingClientFlush(lc);
+        ke->lc = NULL;
         teoMapDestroy(lc->map);
         ke->event_cb = lc->event_cb;
+        ksnCommandUnregister(ke->kc->kco, CMD_LOGGING, cmd_logging_cb, lc);
+        pthread_mutex_destroy(&lc->mutex);
         free(lc);
-        ke->lc = NULL;
 
         #ifdef DEBUG_KSNET
         ksn_puts(ke, MODULE, DEBUG_VV,
@@ -176,9 +374,43 @@ void teoLoggingClientDestroy(teoLoggingClientClass *lc) {
 
 // Send log data to logging servers
 void teoLoggingClientSend(void *ke, const char *message) {
-    if(!kev->teo_cfg.log_disable_f) {
-        if(kev->teo_cfg.send_all_logs_f || message[0] == '#' || strstr(message,": ### "))
-            ksnetEvMgrAsync(ke, (void*)message, strlen(message)+1, 
-                    (void*)&ASYNC_LABEL);
+    teoLoggingClientClass *lc = kev->lc;
+    if(!kev->teo_cfg.log_disable_f && lc != NULL && lc->num_servers) {
+        if(kev->teo_cfg.send_all_logs_f || message[0] == '#' || strstr(message,": ### ")) {
+
+            size_t len = strlen(message) + 1;
+            int request_flush = 0;
+
+            pthread_mutex_lock(&lc->mutex);
+
+            // Drop record if queue is full
+            if(lc->buf_len + len > LOGGING_QUEUE_MAX) {
+                lc->dropped++;
+                lc->dropped_total++;
+            }
+            // Add record to queue
+            else {
+                if(lc->buf_len + len > lc->buf_size) {
+                    size_t size = lc->buf_size ? lc->buf_size * 2 : LOGGING_FRAME_SIZE;
+                    while(size < lc->buf_len + len) size *= 2;
+                    if(size > LOGGING_QUEUE_MAX) size = LOGGING_QUEUE_MAX;
+                    lc->buf = realloc(lc->buf, size);
+                    lc->buf_size = size;
+                }
+                memcpy(lc->buf + lc->buf_len, message, len);
+                lc->buf_len += len;
+                lc->count++;
+                lc->seq++;
+            }
+
+            // Ask event loop to send records without waiting for the timer
+            if(lc->buf_len >= LOGGING_FRAME_SIZE && !lc->flush_requested) {
+                lc->flush_requested = request_flush = 1;
+            }
+
+            pthread_mutex_unlock(&lc->mutex);
+
+            if(request_flush) ksnetEvMgrAsync(ke, NULL, 0, (void*)&ASYNC_LABEL);
+        }
     }
 }
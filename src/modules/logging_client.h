@@ -10,15 +10,36 @@
 #ifndef LOGGING_CLIENT_H
 #define LOGGING_CLIENT_H
 
+#include <ev.h>
+#include <pthread.h>
+
+#define LOGGING_FLUSH_INTERVAL 0.1 ///< Send collected log records interval (sec)
+#define LOGGING_FRAME_SIZE 4096 ///< Send collected log records when they reach this size
+#define LOGGING_QUEUE_MAX (256 * 1024) ///< Drop log records when not sent records reach this size
+
 /**
  * Teonet Logging client class data definition
  */
 typedef struct teoLoggingClientClass {
 
     void *ke; // Pointer to ksnEvMgrClass
-    teoMap *map; // Logging servers set
+    teoMap *map; // Logging servers set: peer name -> server flags
     void *event_cb; // Pointer to event callback
 
+    volatile int num_servers; // Number of logging servers
+    ev_timer flush_w; // Flush timer watcher
+
+    // Log records queue (cstrings), guarded by mutex
+    pthread_mutex_t mutex;
+    char *buf; // Not sent log records
+    size_t buf_len; // Length of not sent records
+    size_t buf_size; // Size of allocated buffer
+    uint32_t count; // Number of not sent records
+    uint32_t seq; // Sequence number of next record
+    uint32_t dropped; // Records dropped since last sent frame
+    uint64_t dropped_total; // Records dropped total
+    int flush_requested; // Async flush request sent
+
 } teoLoggingClientClass;
 
 
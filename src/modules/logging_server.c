@@ -12,6 +12,10 @@
 #include "logging_server.h"
 #include "modules/teodb_com.h"
 
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
 #define MODULE "logging_server"
 #define kev ((ksnetEvMgrClass*)(ke))
 typedef void (*event_cb_t)(struct ksnetEvMgrClass *ke, ksnetEvMgrEvents event, 
@@ -19,6 +23,187 @@ typedef void (*event_cb_t)(struct ksnetEvMgrClass *ke, ksnetEvMgrEvents event,
 
 signed char teoLoggingServerLogCheck(void *ke, void *log);
 
+/**
+ * Send logging server capabilities to peer
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param peer Peer name
+ */
+static void teoLoggingServerSendCaps(ksnetEvMgrClass *ke, char *peer) {
+
+    teoLoggingCaps caps = { LOGGING_PROTOCOL_VERSION, 0 };
+    #ifdef HAVE_LIBLZ4
+    caps.flags |= LOGGING_FRAME_LZ4;
+    #endif
+    ksnCoreSendCmdto(ke->kc, peer, CMD_LOGGING, &caps, sizeof(caps));
+}
+
+/**
+ * Get logging client statistic
+ *
+ * @param ls Pointer to teoLoggingServerClass
+ * @param peer Peer name
+ * @return Pointer to teoLoggingPeerStat
+ */
+static teoLoggingPeerStat *teoLoggingServerPeerStat(teoLoggingServerClass *ls, 
+        const char *peer) {
+
+    size_t stat_len;
+    teoLoggingPeerStat *stat = teoMapGet(ls->map, (void*)peer, 
+            strlen(peer) + 1, &stat_len);
+    if(stat == (void*)-1 || stat == NULL) {
+        teoLoggingPeerStat new_stat;
+        memset(&new_stat, 0, sizeof(new_stat));
+        stat = teoMapAdd(ls->map, (void*)peer, strlen(peer) + 1, &new_stat, 
+                sizeof(new_stat));
+    }
+    return stat;
+}
+
+/**
+ * Process one log record
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param rd Pointer to ksnCorePacketData with log record in data
+ */
+static void teoLoggingServerRecord(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
+
+    // Add log to syslog
+    syslog(LOG_INFO, "TEO_LOGGING: %s: %s", rd->from, (char*)rd->data);
+
+    // Send logging event to process it at user level
+    if(ke->ls->event_cb != NULL)
+        ((event_cb_t)ke->ls->event_cb)(ke, EV_K_LOGGING, rd, sizeof(*rd), NULL);
+}
+
+/**
+ * Process frame of log records
+ *
+ * Unpacks the frame, prints all records which pass the log filter with one
+ * write and then adds each record to syslog and sends it to user level.
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param rd Pointer to ksnCorePacketData with teoLoggingFrame in data
+ *
+ * @return 1 if frame was processed, 0 if frame is wrong
+ */
+static int teoLoggingServerFrame(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
+
+    teoLoggingServerClass *ls = ke->ls;
+    const teoLoggingFrame *frame = rd->data;
+    size_t payload_len = rd->data_len - sizeof(teoLoggingFrame);
+    const char *records;
+
+    if(frame->raw_len > LOGGING_FRAME_RAW_MAX || !frame->raw_len) return 0;
+
+    // Unpack records
+    if(frame->flags & LOGGING_FRAME_LZ4) {
+        #ifdef HAVE_LIBLZ4
+        if(LZ4_decompress_safe(frame->payload, ls->buffer, payload_len, 
+                LOGGING_FRAME_RAW_MAX) != (int)frame->raw_len) return 0;
+        records = ls->buffer;
+        #else
+        return 0;
+        #endif
+    }
+    else {
+        if(payload_len != frame->raw_len) return 0;
+        records = frame->payload;
+    }
+    if(records[frame->raw_len - 1] != '\0') return 0;
+
+    // Count records, the frame count should be the same
+    const char *rec, *end = records + frame->raw_len;
+    uint32_t count = 0;
+    for(rec = records; rec < end; rec += strlen(rec) + 1) count++;
+    if(count != frame->count) return 0;
+
+    // Update client statistic
+    teoLoggingPeerStat *stat = teoLoggingServerPeerStat(ls, rd->from);
+    if(stat != (void*)-1 && stat != NULL) {
+        if(stat->received && frame->seq != stat->next_seq)
+            stat->lost += (uint32_t)(frame->seq - stat->next_seq);
+        stat->next_seq = frame->seq + count;
+        stat->received += count;
+        stat->dropped += frame->dropped;
+    }
+    #ifdef DEBUG_KSNET
+    if(frame->dropped) {
+        ksn_printf(ke, MODULE, DEBUG,
+                "peer '%s' dropped %u log records\n", rd->from, 
+                (unsigned)frame->dropped);
+    }
+    #endif
+
+    // Show log messages which pass the filter by one write
+    if(teoFilterFlagCheck(ke)) {
+        size_t out_len = 0;
+        char *out = malloc(frame->raw_len + count * (rd->from_len + 3));
+        for(rec = records; rec < end; rec += strlen(rec) + 1) {
+            if(!teoLogCheck(ke, (void*)rec)) continue;
+            out_len += sprintf(out + out_len, "%s: %s\n", rd->from, rec);
+        }
+        if(out_len) {
+            fwrite(out, 1, out_len, stdout);
+            fflush(stdout);
+        }
+        free(out);
+    }
+
+    // Send each record to syslog and user level
+    ksnCorePacketData rec_rd = *rd;
+    for(rec = records; rec < end; rec += rec_rd.data_len) {
+        rec_rd.data = (void*)rec;
+        rec_rd.data_len = strlen(rec) + 1;
+        teoLoggingServerRecord(ke, &rec_rd);
+    }
+
+    return 1;
+}
+
+/**
+ * CMD_LOGGING command handler
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to ksnCorePacketData
+ * @param user_data Pointer to teoLoggingServerClass
+ *
+ * @return True if log record or frame of log records was processed
+ */
+static int cmd_logging_cb(ksnCommandClass *kco, ksnCorePacketData *rd,
+        void *user_data) {
+
+    teoLoggingServerClass *ls = user_data;
+    ksnetEvMgrClass *ke = ls->ke;
+
+    // Frame of log records
+    if(rd->data_len > sizeof(teoLoggingFrame) &&
+            ((teoLoggingFrame*)rd->data)->magic == LOGGING_FRAME_MAGIC) {
+
+        if(!teoLoggingServerFrame(ke, rd)) {
+            #ifdef DEBUG_KSNET
+            ksn_printf(kev, MODULE, ERROR_M,
+                    "wrong log frame from peer '%s'\n", rd->from);
+            #endif
+        }
+        return 1;
+    }
+
+    // Legacy log record
+    if(rd->data_len) {
+
+        // Show log message
+        if (teoFilterFlagCheck(kev) &&  teoLogCheck(ke, rd->data)) {
+            printf("%s: %s\n", rd->from, (char*)rd->data);
+        }
+
+        teoLoggingServerRecord(ke, rd);
+        return 1;
+    }
+
+    return 0;
+}
+
 // Event loop to gab teonet events
 static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event,
         void *data, size_t data_len, void *user_data) {
@@ -34,6 +219,7 @@ static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event,
                     "Peer '%s' connected\n", (char*) rd->from);
             #endif
             ksnCoreSendCmdto(ke->kc, rd->from, CMD_LOGGING, NULL, 0);
+            teoLoggingServerSendCaps(ke, rd->from);
             break;
 
         
@@ -42,25 +228,7 @@ static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event,
             ksn_printf(kev, MODULE, DEBUG_VV,
                     "Peer '%s' disconnected\n", (char*) rd->from);
             #endif
-            break;
-
-        case EV_K_RECEIVED:
-            if(rd->cmd == CMD_LOGGING && rd->data_len) {
-                
-                // Show log message
-                if (teoFilterFlagCheck(kev) &&  teoLogCheck(ke, rd->data)) {
-                    printf("%s: %s\n", rd->from, (char*)rd->data);
-                }
-                
-                // Add log to syslog
-                syslog(LOG_INFO, "TEO_LOGGING: %s: %s", rd->from, (char*)rd->data);
-                
-                // Send logging event to process it at user level 
-                if(ke->ls->event_cb != NULL)
-                    ((event_cb_t)ke->ls->event_cb)(ke, EV_K_LOGGING, data, data_len, NULL);
-                
-                processed = 1;
-            }
+            teoMapDelete(ke->ls->map, rd->from, strlen(rd->from) + 1);
             break;
 
         default:
@@ -78,8 +246,11 @@ teoLoggingServerClass *teoLoggingServerInit(void *ke) {
 
     teoLoggingServerClass *ls = malloc(sizeof(teoLoggingServerClass));
     ls->ke = ke;
+    ls->map = teoMapNew(MAP_SIZE_DEFAULT, 1);
+    ls->buffer = malloc(LOGGING_FRAME_RAW_MAX);
     ls->event_cb = kev->event_cb;
     kev->event_cb = event_cb;
+    ksnCommandRegister(kev->kc->kco, CMD_LOGGING, cmd_logging_cb, ls);
 
     #ifdef DEBUG_KSNET
     ksn_puts(kev, MODULE, DEBUG /*DEBUG_VV*/, // \TODO set DEBUG_VV
@@ -95,6 +266,9 @@ void teoLoggingServerDestroy(teoLoggingServerClass *ls) {
     if(ls) {
         ksnetEvMgrClass *ke = ls->ke;
         ke->event_cb = ls->event_cb;
+        ksnCommandUnregister(ke->kc->kco, CMD_LOGGING, cmd_logging_cb, ls);
+        teoMapDestroy(ls->map);
+        free(ls->buffer);
         free(ls);
         ke->ls = NULL;
 
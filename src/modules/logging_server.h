@@ -10,6 +10,53 @@
 #ifndef LOGGING_SERVER_H
 #define LOGGING_SERVER_H
 
+#include <stdint.h>
+
+/*
+ * Logging protocol
+ *
+ * Logging server announces itself to connected peer with empty CMD_LOGGING
+ * command (understood by legacy clients) followed by CMD_LOGGING with
+ * teoLoggingCaps. Legacy clients send each log record as separate cstring.
+ * Clients which received teoLoggingCaps pack log records to teoLoggingFrame.
+ */
+#define LOGGING_PROTOCOL_VERSION 1
+#define LOGGING_FRAME_MAGIC 0       ///< First byte of frame, legacy log record never starts with it
+#define LOGGING_FRAME_LZ4 0x01      ///< Frame payload is compressed with LZ4
+#define LOGGING_FRAME_RAW_MAX 8192  ///< Maximum uncompressed frame payload size
+
+#pragma pack(push)
+#pragma pack(1)
+
+/**
+ * Logging server capabilities, sent by logging server to connected peer
+ */
+typedef struct teoLoggingCaps {
+
+    uint8_t version;    ///< LOGGING_PROTOCOL_VERSION
+    uint8_t flags;      ///< Supported frame flags: LOGGING_FRAME_LZ4
+
+} teoLoggingCaps;
+
+/**
+ * Batch of log records sent by logging client
+ */
+typedef struct teoLoggingFrame {
+
+    uint8_t magic;      ///< LOGGING_FRAME_MAGIC
+    uint8_t version;    ///< LOGGING_PROTOCOL_VERSION
+    uint8_t flags;      ///< Frame flags: LOGGING_FRAME_LZ4
+    uint8_t reserved;
+    uint32_t seq;       ///< Sequence number of first record in frame
+    uint32_t dropped;   ///< Number of records dropped by client since previous frame
+    uint16_t count;     ///< Number of records in frame
+    uint32_t raw_len;   ///< Payload length before compression
+    char payload[];     ///< Records: count of cstrings (compressed if LOGGING_FRAME_LZ4)
+
+} teoLoggingFrame;
+
+#pragma pack(pop)
+
 /**
  * Teonet Logging server class data definition
  */
@@ -17,9 +64,23 @@ typedef struct teoLoggingServerClass {
 
     void *ke; // Pointer to ksnEvMgrClass
     void *event_cb; // Pointer to event callback
-    
+    teoMap *map; // Logging clients statistic: peer name -> teoLoggingPeerStat
+    char *buffer; // Frame unpack buffer, LOGGING_FRAME_RAW_MAX bytes
+
 } teoLoggingServerClass;
 
+/**
+ * Logging server per client statistic
+ */
+typedef struct teoLoggingPeerStat {
+
+    uint32_t next_seq;  ///< Expected sequence number of next record
+    uint64_t received;  ///< Number of received records
+    uint64_t dropped;   ///< Number of records dropped by client
+    uint64_t lost;      ///< Number of records lost between client and server
+
+} teoLoggingPeerStat;
+
 
 #ifdef __cplusplus
 extern "C" {
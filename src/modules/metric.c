@@ -8,13 +8,52 @@
  * 
  * See Teonet Metrics System description in sh/statsd/README.md 
  * 
+ * Teonet metrics are kept in the in-process metrics registry (see
+ * metric_registry.h). The registry is exported by the HTTP scrape endpoint
+ * in Prometheus text format (metrics_port parameter) and may be pushed to
+ * statsd exporter (statsd_ip and statsd_port parameters). Statsd metrics are
+ * batched and many metrics are sent in one datagram.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
 #include "metric.h"
 #include "ev_mgr.h"
+#include "tr-udp.h"
 
 #define MODULE "metrics"
 
+#define METRIC_HTTP_REQUEST_MAX 1024
+#define METRIC_HTTP_TIMEOUT 10.0 ///< Scrape connection lifetime, sec
+
+/**
+ * Scrape endpoint connection
+ */
+typedef struct teoMetricHttpConn {
+    ev_io w;
+    ev_timer timeout_w;
+    teoMetricClass *tm;
+    struct teoMetricHttpConn *next;
+    char request[METRIC_HTTP_REQUEST_MAX];
+    size_t request_len;
+    char *response;
+    size_t response_len;
+    size_t response_sent;
+} teoMetricHttpConn;
+
+static void metricRegisterCore(teoMetricClass *tm);
+static int metricHttpStart(teoMetricClass *tm, int port);
+static void metricHttpStop(teoMetricClass *tm);
+
+/**
+ * Send statsd batch before event loop sleeps
+ */
+static void flush_cb(EV_P_ ev_prepare *w, int revents) {
+    teoMetricFlush(w->data);
+}
+
 /**
  * Initialize Metrics module
  * 
@@ -23,20 +62,41 @@
 teoMetricClass *teoMetricInit(void *kep) {
 
     ksnetEvMgrClass *ke = (ksnetEvMgrClass *)kep;
-    if (ke->teo_cfg.statsd_ip[0] == 0 || ke->teo_cfg.statsd_port == 0)
-        return NULL;
 
-    ksn_printf(ke, MODULE, MESSAGE, 
-        "started, and ready to send metrics to statsd exporter at address: %s:%ld\n",
-        ke->teo_cfg.statsd_ip, ke->teo_cfg.statsd_port);
-
-    teoMetricClass *tm = malloc(sizeof(teoMetricClass));
+    teoMetricClass *tm = calloc(1, sizeof(teoMetricClass));
     tm->ke = ke;
+    tm->http_fd = -1;
+    pthread_mutex_init(&tm->batch_mutex, NULL);
+    snprintf(tm->labels, sizeof(tm->labels), "network=\"%s\",peer=\"%s\"",
+            ke->teo_cfg.network, ke->teo_cfg.host_name);
+
+    // Metrics registry
+    tm->reg = teoMetricRegistryNew();
+    metricRegisterCore(tm);
+
+    // Statsd exporter
+    if (ke->teo_cfg.statsd_ip[0] != 0 && ke->teo_cfg.statsd_port != 0) {
+
+        ksn_printf(ke, MODULE, MESSAGE,
+            "started, and ready to send metrics to statsd exporter at address: %s:%ld\n",
+            ke->teo_cfg.statsd_ip, ke->teo_cfg.statsd_port);
+
+        tm->statsd_f = 1;
+        tm->last = calloc(TEO_METRIC_MAX, sizeof(double));
+        memset(&tm->to, 0, sizeof(tm->to));
+        tm->to.sin_family = AF_INET;
+        tm->to.sin_addr.s_addr = inet_addr(ke->teo_cfg.statsd_ip);
+        tm->to.sin_port = htons(ke->teo_cfg.statsd_port);
 
-    memset(&tm->to, 0, sizeof(tm->to));
-    tm->to.sin_family = AF_INET;
-    tm->to.sin_addr.s_addr = inet_addr(ke->teo_cfg.statsd_ip);
-    tm->to.sin_port = htons(ke->teo_cfg.statsd_port);
+        ev_prepare_init(&tm->flush_w, flush_cb);
+        tm->flush_w.data = tm;
+        ev_prepare_start(ke->ev_loop, &tm->flush_w);
+    }
+
+    // Prometheus scrape endpoint
+    if (ke->teo_cfg.metrics_port) {
+        metricHttpStart(tm, ke->teo_cfg.metrics_port);
+    }
 
     return tm;
 }
@@ -48,7 +108,61 @@ teoMetricClass *teoMetricInit(void *kep) {
  * 
  */ 
 void teoMetricDestroy(teoMetricClass *tm) {
-    if (tm) free(tm);
+    if (tm) {
+        ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+        metricHttpStop(tm);
+        if (tm->statsd_f) {
+            ev_prepare_stop(ke->ev_loop, &tm->flush_w);
+            teoMetricFlush(tm);
+            free(tm->last);
+        }
+        ke->tm = NULL;
+        teoMetricRegistryFree(tm->reg);
+        pthread_mutex_destroy(&tm->batch_mutex);
+        free(tm);
+    }
+}
+
+/**
+ * Add line to statsd batch, send batch when it is full
+ *
+ * @param tm Pointer to teoMetricClass
+ * @param line Metric line
+ * @param len Metric line length
+ */
+static void teoMetricBatch(teoMetricClass *tm, const char *line, int len) {
+
+    if (len <= 0 || len >= TEO_METRIC_BATCH_SIZE) return;
+
+    pthread_mutex_lock(&tm->batch_mutex);
+    if (tm->batch_len + len + 1 > TEO_METRIC_BATCH_SIZE) {
+        ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+        sendto(ke->kc->fd, tm->batch, tm->batch_len, 0,
+               (struct sockaddr *)&tm->to, sizeof(tm->to));
+        tm->batch_len = 0;
+    }
+    if (tm->batch_len) tm->batch[tm->batch_len++] = '\n';
+    memcpy(tm->batch + tm->batch_len, line, len);
+    tm->batch_len += len;
+    pthread_mutex_unlock(&tm->batch_mutex);
+}
+
+/**
+ * Send batched statsd metrics
+ *
+ * @param tm Pointer to teoMetricClass
+ */
+void teoMetricFlush(teoMetricClass *tm) {
+    if (!tm || !tm->statsd_f) return;
+
+    pthread_mutex_lock(&tm->batch_mutex);
+    if (tm->batch_len) {
+        ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+        sendto(ke->kc->fd, tm->batch, tm->batch_len, 0,
+               (struct sockaddr *)&tm->to, sizeof(tm->to));
+        tm->batch_len = 0;
+    }
+    pthread_mutex_unlock(&tm->batch_mutex);
 }
 
 /**
@@ -62,7 +176,7 @@ void teoMetricDestroy(teoMetricClass *tm) {
  */
 static void teoMetric(teoMetricClass *tm, const char *name, const char *type,
                       int value) {
-    if (!tm) return;
+    if (!tm || !tm->statsd_f) return;
     ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
 
     char buffer[256];
@@ -70,8 +184,7 @@ static void teoMetric(teoMetricClass *tm, const char *name, const char *type,
     int len = snprintf(buffer, 255, fmt, type, ke->teo_cfg.network,
                        ke->kc->name, name, value, type);
 
-    sendto(ke->kc->fd, buffer, len, 0, (struct sockaddr *)&tm->to,
-           sizeof(tm->to));
+    teoMetricBatch(tm, buffer, len);
 }
 
 /**
@@ -85,7 +198,7 @@ static void teoMetric(teoMetricClass *tm, const char *name, const char *type,
  */
 static void teoMetricf(teoMetricClass *tm, const char *name, const char *type,
                       double value) {
-    if (!tm) return;
+    if (!tm || !tm->statsd_f) return;
     ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
 
     char buffer[256];
@@ -93,8 +206,7 @@ static void teoMetricf(teoMetricClass *tm, const char *name, const char *type,
     int len = snprintf(buffer, 255, fmt, type, ke->teo_cfg.network,
                        ke->kc->name, name, value, type);
 
-    sendto(ke->kc->fd, buffer, len, 0, (struct sockaddr *)&tm->to,
-           sizeof(tm->to));
+    teoMetricBatch(tm, buffer, len);
 }
 
 /**
@@ -157,6 +269,343 @@ void teoMetricGaugef(teoMetricClass *tm, const char *name, double value) {
     teoMetricf(tm, name, "g", value);
 }
 
+/**
+ * Get metrics registry to register application metrics
+ *
+ * @param tm Pointer to teoMetricClass
+ *
+ * @return Pointer to teoMetricRegistry or NULL if metrics module is disabled
+ */
+teoMetricRegistry *teoMetricGetRegistry(teoMetricClass *tm) {
+    return tm ? tm->reg : NULL;
+}
+
+/**
+ * Add value to registry counter
+ *
+ * @param tm Pointer to teoMetricClass (may be NULL)
+ * @param id Counter id
+ * @param value Value to add
+ */
+void teoMetricCount(teoMetricClass *tm, int id, uint64_t value) {
+    if (tm) teoMetricAdd(tm->reg, id, value);
+}
+
+/**
+ * Add time passed from start to registry histogram (in nanoseconds)
+ *
+ * @param tm Pointer to teoMetricClass (may be NULL)
+ * @param id Histogram id
+ * @param start Start time got with ev_time()
+ */
+void teoMetricTime(teoMetricClass *tm, int id, double start) {
+    if (tm) teoMetricObserve(tm->reg, id, (uint64_t)((ev_time() - start) * 1e9));
+}
+
+/**
+ * Get TR-UDP retransmits number
+ */
+static double metricTrudpRetransmits(void *user_data) {
+
+    ksnetEvMgrClass *ke = user_data;
+    double attempts = 0;
+    teoMapElementData *el;
+    teoMapIterator *it;
+    if ((it = teoMapIteratorNew(ke->kc->ku->map))) {
+        while ((el = teoMapIteratorNext(it))) {
+            trudpChannelData *tcd = (trudpChannelData *)
+                    teoMapIteratorElementData(el, NULL);
+            attempts += tcd->stat.packets_attempt;
+        }
+        teoMapIteratorFree(it);
+    }
+    return attempts;
+}
+
+/**
+ * Get TR-UDP send queues size
+ */
+static double metricTrudpSendQueue(void *user_data) {
+
+    ksnetEvMgrClass *ke = user_data;
+    double size = 0;
+    teoMapElementData *el;
+    teoMapIterator *it;
+    if ((it = teoMapIteratorNew(ke->kc->ku->map))) {
+        while ((el = teoMapIteratorNext(it))) {
+            trudpChannelData *tcd = (trudpChannelData *)
+                    teoMapIteratorElementData(el, NULL);
+            size += trudpSendQueueSize(tcd->sendQueue);
+        }
+        teoMapIteratorFree(it);
+    }
+    return size;
+}
+
+static double metricL0Clients(void *user_data) {
+    ksnLNullSStat *kls = ksnLNullStat(((ksnetEvMgrClass *)user_data)->kl);
+    return kls ? kls->clients : 0;
+}
+
+static double metricCQueDepth(void *user_data) {
+    ksnetEvMgrClass *ke = user_data;
+    return ke->kq ? teoHashMapSize(ke->kq->cque_map) : 0;
+}
+
+static double metricAsyncQueueDepth(void *user_data) {
+    ksnetEvMgrClass *ke = user_data;
+    return ke->ta ? teoAsyncQueueDepth(ke->ta) : 0;
+}
+
+/**
+ * Register teonet core metrics, ids are equal to teoMetricCore values
+ *
+ * @param tm Pointer to teoMetricClass
+ */
+static void metricRegisterCore(teoMetricClass *tm) {
+
+    teoMetricRegistry *mr = tm->reg;
+    void *ke = tm->ke;
+
+    teoMetricRegisterCounter(mr, "teonet_packets_sent_total",
+            "Packets sent to peers");
+    teoMetricRegisterCounter(mr, "teonet_bytes_sent_total",
+            "Bytes sent to peers");
+    teoMetricRegisterCounter(mr, "teonet_packets_received_total",
+            "Packets received from peers");
+    teoMetricRegisterCounter(mr, "teonet_bytes_received_total",
+            "Bytes received from peers");
+    teoMetricRegisterHistogram(mr, "teonet_encrypt_seconds",
+            "Packet encryption time", 1e-9);
+    teoMetricRegisterHistogram(mr, "teonet_decrypt_seconds",
+            "Packet decryption time", 1e-9);
+    teoMetricRegisterCb(mr, "teonet_trudp_retransmits_total",
+            "TR-UDP packets retransmits", TEO_METRIC_COUNTER,
+            metricTrudpRetransmits, ke);
+    teoMetricRegisterCb(mr, "teonet_trudp_send_queue",
+            "TR-UDP packets in send queues", TEO_METRIC_GAUGE,
+            metricTrudpSendQueue, ke);
+    teoMetricRegisterCb(mr, "teonet_l0_clients",
+            "L0 server clients", TEO_METRIC_GAUGE, metricL0Clients, ke);
+    teoMetricRegisterCb(mr, "teonet_cque_depth",
+            "Callbacks waiting in callback queue", TEO_METRIC_GAUGE,
+            metricCQueDepth, ke);
+    teoMetricRegisterCb(mr, "teonet_async_queue_depth",
+            "Async calls waiting for event loop", TEO_METRIC_GAUGE,
+            metricAsyncQueueDepth, ke);
+}
+
+/**
+ * Close scrape endpoint connection
+ */
+static void metricHttpClose(teoMetricHttpConn *conn) {
+
+    teoMetricClass *tm = conn->tm;
+    ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+
+    teoMetricHttpConn **c;
+    for (c = &tm->conns; *c != NULL; c = &(*c)->next) {
+        if (*c == conn) { *c = conn->next; break; }
+    }
+    ev_io_stop(ke->ev_loop, &conn->w);
+    ev_timer_stop(ke->ev_loop, &conn->timeout_w);
+    close(conn->w.fd);
+    free(conn->response);
+    free(conn);
+}
+
+/**
+ * Scrape endpoint connection write callback
+ */
+static void http_write_cb(EV_P_ ev_io *w, int revents) {
+
+    teoMetricHttpConn *conn = w->data;
+    while (conn->response_sent < conn->response_len) {
+        ssize_t snd = send(w->fd, conn->response + conn->response_sent,
+                conn->response_len - conn->response_sent, MSG_NOSIGNAL);
+        if (snd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (snd <= 0) break;
+        conn->response_sent += snd;
+    }
+    metricHttpClose(conn);
+}
+
+/**
+ * Create scrape endpoint response
+ */
+static void metricHttpResponse(teoMetricHttpConn *conn) {
+
+    teoMetricClass *tm = conn->tm;
+    const char *status = "404 Not Found";
+    char *body = NULL;
+    size_t body_len = 0;
+
+    if (!strncmp(conn->request, "GET /metrics", 12) ||
+        !strncmp(conn->request, "GET / ", 6)) {
+        status = "200 OK";
+        body = teoMetricRegistryFormat(tm->reg, tm->labels, &body_len);
+    }
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+            "HTTP/1.1 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", status, body_len);
+
+    conn->response = malloc(header_len + body_len);
+    memcpy(conn->response, header, header_len);
+    if (body != NULL) memcpy(conn->response + header_len, body, body_len);
+    conn->response_len = header_len + body_len;
+    free(body);
+}
+
+/**
+ * Scrape endpoint connection read callback
+ */
+static void http_read_cb(EV_P_ ev_io *w, int revents) {
+
+    teoMetricHttpConn *conn = w->data;
+    ssize_t rcv = recv(w->fd, conn->request + conn->request_len,
+            sizeof(conn->request) - conn->request_len - 1, 0);
+    if (rcv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (rcv <= 0) {
+        metricHttpClose(conn);
+        return;
+    }
+    conn->request_len += rcv;
+    conn->request[conn->request_len] = '\0';
+
+    // Wait for end of request headers
+    if (!strstr(conn->request, "\r\n\r\n") &&
+        conn->request_len < sizeof(conn->request) - 1) return;
+
+    metricHttpResponse(conn);
+    ev_io_stop(EV_A_ w);
+    ev_io_init(w, http_write_cb, w->fd, EV_WRITE);
+    ev_io_start(EV_A_ w);
+}
+
+/**
+ * Scrape endpoint connection timeout callback: close connection of client
+ * which does not send request or does not read response
+ */
+static void http_timeout_cb(EV_P_ ev_timer *w, int revents) {
+
+    metricHttpClose(w->data);
+}
+
+/**
+ * Scrape endpoint accept callback
+ */
+static void http_accept_cb(EV_P_ ev_io *w, int revents) {
+
+    teoMetricClass *tm = w->data;
+
+    int fd = accept(w->fd, NULL, NULL);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    teoMetricHttpConn *conn = calloc(1, sizeof(teoMetricHttpConn));
+    conn->tm = tm;
+    conn->next = tm->conns;
+    tm->conns = conn;
+    ev_io_init(&conn->w, http_read_cb, fd, EV_READ);
+    conn->w.data = conn;
+    ev_io_start(EV_A_ &conn->w);
+    ev_timer_init(&conn->timeout_w, http_timeout_cb, METRIC_HTTP_TIMEOUT, 0.0);
+    conn->timeout_w.data = conn;
+    ev_timer_start(EV_A_ &conn->timeout_w);
+}
+
+/**
+ * Start Prometheus scrape endpoint
+ *
+ * @param tm Pointer to teoMetricClass
+ * @param port TCP port
+ *
+ * @return 0 at success
+ */
+static int metricHttpStart(teoMetricClass *tm, int port) {
+
+    ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 16)) {
+        ksn_printf(ke, MODULE, ERROR_M,
+                "can't start metrics scrape endpoint at port %d: %s\n",
+                port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    tm->http_fd = fd;
+    ev_io_init(&tm->http_w, http_accept_cb, fd, EV_READ);
+    tm->http_w.data = tm;
+    ev_io_start(ke->ev_loop, &tm->http_w);
+
+    ksn_printf(ke, MODULE, MESSAGE,
+            "metrics scrape endpoint started at http://0.0.0.0:%d/metrics\n",
+            port);
+
+    return 0;
+}
+
+/**
+ * Stop Prometheus scrape endpoint
+ *
+ * @param tm Pointer to teoMetricClass
+ */
+static void metricHttpStop(teoMetricClass *tm) {
+
+    ksnetEvMgrClass *ke = (ksnetEvMgrClass *)tm->ke;
+
+    while (tm->conns != NULL) metricHttpClose(tm->conns);
+    if (tm->http_fd >= 0) {
+        ev_io_stop(ke->ev_loop, &tm->http_w);
+        close(tm->http_fd);
+        tm->http_fd = -1;
+    }
+}
+
+/**
+ * Statsd registry push context
+ */
+typedef struct metricStatsdCtx {
+    teoMetricClass *tm;
+    int id;
+} metricStatsdCtx;
+
+/**
+ * Push registry metric to statsd: counters and histograms observations
+ * number as increments, gauges as values
+ */
+static void metricStatsdPush(const char *name, teoMetricType type,
+        double value, double sum, void *user_data) {
+
+    metricStatsdCtx *ctx = user_data;
+    teoMetricClass *tm = ctx->tm;
+    double *last = &tm->last[ctx->id++];
+
+    if (type == TEO_METRIC_GAUGE) {
+        teoMetricGaugef(tm, name, value);
+        return;
+    }
+    if (value != *last) teoMetricCounterf(tm, name, value - *last);
+    *last = value;
+}
+
 /**
  * Send default teonet metrics
  * 
@@ -164,7 +613,7 @@ void teoMetricGaugef(teoMetricClass *tm, const char *name, double value) {
  * 
  */
 void metric_teonet_count(teoMetricClass *tm) {
-    if (!tm) return;
+    if (!tm || !tm->statsd_f) return;
 
     // Standart metrics
     static uint64_t gauge = 0;
@@ -188,4 +637,10 @@ void metric_teonet_count(teoMetricClass *tm) {
         teoMetricGauge(tm, "l0_packets_to_peer", kls->packets_to_peer);
         teoMetricGauge(tm, "l0_packets_from_peer", kls->packets_from_peer);
     }
+
+    // Registry metrics
+    metricStatsdCtx ctx = { tm, 0 };
+    teoMetricForEach(tm->reg, metricStatsdPush, &ctx);
+
+    teoMetricFlush(tm);
 }
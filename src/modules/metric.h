@@ -2,10 +2,50 @@
 #define METRIC_H
 
 #include <netinet/in.h>
+#include <pthread.h>
+#include <ev.h>
+
+#include "metric_registry.h"
+
+#define TEO_METRIC_BATCH_SIZE 1432 ///< Max statsd datagram size
+
+/**
+ * Teonet core metrics ids in metrics registry
+ */
+enum teoMetricCore {
+    TEO_METRIC_PACKETS_SENT,       ///< Packets sent to peers
+    TEO_METRIC_BYTES_SENT,         ///< Bytes sent to peers
+    TEO_METRIC_PACKETS_RECEIVED,   ///< Packets received from peers
+    TEO_METRIC_BYTES_RECEIVED,     ///< Bytes received from peers
+    TEO_METRIC_ENCRYPT_TIME,       ///< Packet encryption time histogram
+    TEO_METRIC_DECRYPT_TIME,       ///< Packet decryption time histogram
+    TEO_METRIC_TRUDP_RETRANSMITS,  ///< TR-UDP packets retransmits
+    TEO_METRIC_TRUDP_SEND_QUEUE,   ///< TR-UDP send queues size
+    TEO_METRIC_L0_CLIENTS,         ///< Number of L0 clients
+    TEO_METRIC_CQUE_DEPTH,         ///< Number of callbacks in CQue
+    TEO_METRIC_ASYNC_QUEUE_DEPTH,  ///< Number of async calls not executed yet
+    TEO_METRIC_CORE_NUM
+};
+
+struct teoMetricHttpConn;
 
 typedef struct teoMetricClass {
     void *ke;
     struct sockaddr_in to;
+
+    int statsd_f;                  ///< Send metrics to statsd exporter
+    pthread_mutex_t batch_mutex;   ///< Statsd batch mutex
+    char batch[TEO_METRIC_BATCH_SIZE]; ///< Statsd metrics batch
+    size_t batch_len;              ///< Statsd metrics batch length
+    ev_prepare flush_w;            ///< Send statsd batch before loop sleeps
+    double *last;                  ///< Registry values sent to statsd
+
+    teoMetricRegistry *reg;        ///< Metrics registry
+    char labels[256];              ///< Labels of exported metrics
+
+    int http_fd;                   ///< Scrape endpoint listen socket or -1
+    ev_io http_w;                  ///< Scrape endpoint accept watcher
+    struct teoMetricHttpConn *conns; ///< Scrape endpoint connections
 } teoMetricClass;
 
 #ifdef	__cplusplus
@@ -26,6 +66,14 @@ void teoMetricMs(teoMetricClass *tm, const char *name, double value);
 void teoMetricGauge(teoMetricClass *tm, const char *name, int value);
 void teoMetricGaugef(teoMetricClass *tm, const char *name, double value);
 
+// Send batched statsd metrics
+void teoMetricFlush(teoMetricClass *tm);
+
+// Metrics registry
+teoMetricRegistry *teoMetricGetRegistry(teoMetricClass *tm);
+void teoMetricCount(teoMetricClass *tm, int id, uint64_t value);
+void teoMetricTime(teoMetricClass *tm, int id, double start);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,409 @@
+/**
+ * \file   metric_registry.c
+ * \author max
+ *
+ * In-process metrics registry and Prometheus text format exporter.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metric_registry.h"
+
+#define HIST_SLOTS (TEO_METRIC_HIST_BUCKETS + 2) // Buckets, count and sum
+
+/**
+ * Metric descriptor
+ */
+typedef struct teoMetricDesc {
+    char name[TEO_METRIC_NAME_SIZE];
+    char help[TEO_METRIC_HELP_SIZE];
+    teoMetricType type;
+    uint32_t slot;          ///< First value slot in shard
+    double scale;           ///< Histogram values scale in exported data
+    teoMetricValueCb cb;    ///< Value callback or NULL
+    void *user_data;        ///< Value callback user data
+} teoMetricDesc;
+
+struct teoMetricRegistry {
+    teoMetricDesc metric[TEO_METRIC_MAX];
+    uint32_t num_metrics;
+    uint32_t num_slots;
+    _Atomic uint64_t *shard[TEO_METRIC_SHARDS];
+};
+
+static atomic_uint next_shard;
+static _Thread_local int thread_shard = -1;
+
+/**
+ * Get value shard of current thread
+ */
+static inline _Atomic uint64_t *metricShard(teoMetricRegistry *mr) {
+    if(thread_shard < 0) {
+        thread_shard = atomic_fetch_add_explicit(&next_shard, 1,
+                memory_order_relaxed) % TEO_METRIC_SHARDS;
+    }
+    return mr->shard[thread_shard];
+}
+
+/**
+ * Sum slot value of all shards
+ */
+static uint64_t metricSlotSum(teoMetricRegistry *mr, uint32_t slot) {
+    uint64_t sum = 0;
+    int i;
+    for(i = 0; i < TEO_METRIC_SHARDS; i++) {
+        sum += atomic_load_explicit(&mr->shard[i][slot], memory_order_relaxed);
+    }
+    return sum;
+}
+
+/**
+ * Create metrics registry
+ *
+ * @return Pointer to teoMetricRegistry, should be freed with
+ *         teoMetricRegistryFree
+ */
+teoMetricRegistry *teoMetricRegistryNew(void) {
+
+    teoMetricRegistry *mr = calloc(1, sizeof(teoMetricRegistry));
+    int i;
+    for(i = 0; i < TEO_METRIC_SHARDS; i++) {
+        mr->shard[i] = aligned_alloc(64,
+                TEO_METRIC_SLOTS * sizeof(_Atomic uint64_t));
+        memset((void*)mr->shard[i], 0,
+                TEO_METRIC_SLOTS * sizeof(_Atomic uint64_t));
+    }
+
+    return mr;
+}
+
+/**
+ * Free metrics registry
+ *
+ * @param mr Pointer to teoMetricRegistry
+ */
+void teoMetricRegistryFree(teoMetricRegistry *mr) {
+
+    if(mr == NULL) return;
+    int i;
+    for(i = 0; i < TEO_METRIC_SHARDS; i++) free((void*)mr->shard[i]);
+    free(mr);
+}
+
+/**
+ * Register metric
+ *
+ * @return Metric id or -1 if registry is full
+ */
+static int metricRegister(teoMetricRegistry *mr, const char *name,
+        const char *help, teoMetricType type, uint32_t slots) {
+
+    if(mr->num_metrics == TEO_METRIC_MAX ||
+       mr->num_slots + slots > TEO_METRIC_SLOTS) return -1;
+
+    teoMetricDesc *md = &mr->metric[mr->num_metrics];
+    memset(md, 0, sizeof(*md));
+    strncpy(md->name, name, sizeof(md->name) - 1);
+    strncpy(md->help, help ? help : name, sizeof(md->help) - 1);
+    md->type = type;
+    md->slot = mr->num_slots;
+    md->scale = 1.0;
+    mr->num_slots += slots;
+
+    return mr->num_metrics++;
+}
+
+/**
+ * Register counter
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param name Metric name, f.e. "teonet_packets_sent_total"
+ * @param help Metric description
+ *
+ * @return Metric id or -1 if registry is full
+ */
+int teoMetricRegisterCounter(teoMetricRegistry *mr, const char *name,
+        const char *help) {
+    return metricRegister(mr, name, help, TEO_METRIC_COUNTER, 1);
+}
+
+/**
+ * Register gauge
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param name Metric name
+ * @param help Metric description
+ *
+ * @return Metric id or -1 if registry is full
+ */
+int teoMetricRegisterGauge(teoMetricRegistry *mr, const char *name,
+        const char *help) {
+    return metricRegister(mr, name, help, TEO_METRIC_GAUGE, 1);
+}
+
+/**
+ * Register histogram
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param name Metric name
+ * @param help Metric description
+ * @param scale Multiplier of observed values in exported data, f.e. 1e-9 to
+ *        export observations in nanoseconds as seconds
+ *
+ * @return Metric id or -1 if registry is full
+ */
+int teoMetricRegisterHistogram(teoMetricRegistry *mr, const char *name,
+        const char *help, double scale) {
+    int id = metricRegister(mr, name, help, TEO_METRIC_HISTOGRAM, HIST_SLOTS);
+    if(id >= 0) mr->metric[id].scale = scale;
+    return id;
+}
+
+/**
+ * Register counter or gauge which value is read by callback
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param name Metric name
+ * @param help Metric description
+ * @param type TEO_METRIC_COUNTER or TEO_METRIC_GAUGE
+ * @param cb Value callback, called from event loop thread
+ * @param user_data Value callback user data
+ *
+ * @return Metric id or -1 if registry is full
+ */
+int teoMetricRegisterCb(teoMetricRegistry *mr, const char *name,
+        const char *help, teoMetricType type, teoMetricValueCb cb,
+        void *user_data) {
+
+    if(type == TEO_METRIC_HISTOGRAM) return -1;
+    int id = metricRegister(mr, name, help, type, 0);
+    if(id >= 0) {
+        mr->metric[id].cb = cb;
+        mr->metric[id].user_data = user_data;
+    }
+    return id;
+}
+
+/**
+ * Add value to counter
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param id Counter id
+ * @param value Value to add
+ */
+void teoMetricAdd(teoMetricRegistry *mr, int id, uint64_t value) {
+    if(mr == NULL || id < 0) return;
+    atomic_fetch_add_explicit(&metricShard(mr)[mr->metric[id].slot], value,
+            memory_order_relaxed);
+}
+
+/**
+ * Set gauge value
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param id Gauge id
+ * @param value Gauge value
+ */
+void teoMetricSet(teoMetricRegistry *mr, int id, double value) {
+    if(mr == NULL || id < 0) return;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    atomic_store_explicit(&mr->shard[0][mr->metric[id].slot], bits,
+            memory_order_relaxed);
+}
+
+/**
+ * Add observation to histogram
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param id Histogram id
+ * @param value Observed value
+ */
+void teoMetricObserve(teoMetricRegistry *mr, int id, uint64_t value) {
+    if(mr == NULL || id < 0) return;
+    _Atomic uint64_t *v = metricShard(mr) + mr->metric[id].slot;
+    atomic_fetch_add_explicit(&v[teoMetricHistBucket(value)], 1,
+            memory_order_relaxed);
+    atomic_fetch_add_explicit(&v[TEO_METRIC_HIST_BUCKETS], 1,
+            memory_order_relaxed);
+    atomic_fetch_add_explicit(&v[TEO_METRIC_HIST_BUCKETS + 1], value,
+            memory_order_relaxed);
+}
+
+/**
+ * Get counter or gauge value
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param id Metric id
+ *
+ * @return Metric value, number of observations for histogram
+ */
+double teoMetricGet(teoMetricRegistry *mr, int id) {
+
+    teoMetricDesc *md = &mr->metric[id];
+    if(md->cb != NULL) return md->cb(md->user_data);
+
+    switch(md->type) {
+        case TEO_METRIC_COUNTER:
+            return (double)metricSlotSum(mr, md->slot);
+        case TEO_METRIC_GAUGE: {
+            double value;
+            uint64_t bits = atomic_load_explicit(&mr->shard[0][md->slot],
+                    memory_order_relaxed);
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        case TEO_METRIC_HISTOGRAM:
+            return (double)metricSlotSum(mr, md->slot +
+                    TEO_METRIC_HIST_BUCKETS);
+    }
+
+    return 0;
+}
+
+/**
+ * Get histogram data
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param id Histogram id
+ * @param buckets Array of TEO_METRIC_HIST_BUCKETS to get buckets counters,
+ *        may be NULL
+ * @param sum Pointer to get sum of observations, may be NULL
+ *
+ * @return Number of observations
+ */
+uint64_t teoMetricHistogramGet(teoMetricRegistry *mr, int id,
+        uint64_t *buckets, uint64_t *sum) {
+
+    teoMetricDesc *md = &mr->metric[id];
+    if(md->type != TEO_METRIC_HISTOGRAM) return 0;
+
+    if(buckets != NULL) {
+        int i;
+        for(i = 0; i < TEO_METRIC_HIST_BUCKETS; i++) {
+            buckets[i] = metricSlotSum(mr, md->slot + i);
+        }
+    }
+    if(sum != NULL) {
+        *sum = metricSlotSum(mr, md->slot + TEO_METRIC_HIST_BUCKETS + 1);
+    }
+
+    return metricSlotSum(mr, md->slot + TEO_METRIC_HIST_BUCKETS);
+}
+
+/**
+ * Call callback for each registered metric
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param cb Visitor callback
+ * @param user_data Visitor callback user data
+ */
+void teoMetricForEach(teoMetricRegistry *mr, teoMetricVisitCb cb,
+        void *user_data) {
+
+    uint32_t id;
+    for(id = 0; id < mr->num_metrics; id++) {
+        teoMetricDesc *md = &mr->metric[id];
+        double sum = 0;
+        if(md->type == TEO_METRIC_HISTOGRAM) {
+            uint64_t s;
+            teoMetricHistogramGet(mr, id, NULL, &s);
+            sum = s * md->scale;
+        }
+        cb(md->name, md->type, teoMetricGet(mr, id), sum, user_data);
+    }
+}
+
+/**
+ * Growing text buffer
+ */
+typedef struct metricText {
+    char *data;
+    size_t length;
+    size_t size;
+} metricText;
+
+static void metricPrintf(metricText *t, const char *fmt, ...) {
+
+    for(;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int len = vsnprintf(t->data + t->length, t->size - t->length, fmt, ap);
+        va_end(ap);
+        if(len < 0) return;
+        if(t->length + len < t->size) {
+            t->length += len;
+            return;
+        }
+        t->size = (t->size + len) * 2;
+        t->data = realloc(t->data, t->size);
+    }
+}
+
+/**
+ * Print histogram in Prometheus text format
+ */
+static void metricFormatHistogram(teoMetricRegistry *mr, int id,
+        const char *labels, const char *sep, metricText *t) {
+
+    teoMetricDesc *md = &mr->metric[id];
+    uint64_t buckets[TEO_METRIC_HIST_BUCKETS], sum;
+    uint64_t count = teoMetricHistogramGet(mr, id, buckets, &sum);
+
+    // Empty buckets are skipped, bucket counters are cumulative
+    uint64_t cumulative = 0;
+    int i;
+    for(i = 0; i < TEO_METRIC_HIST_BUCKETS - 1; i++) {
+        if(!buckets[i]) continue;
+        cumulative += buckets[i];
+        metricPrintf(t, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", md->name, labels,
+                sep, teoMetricHistUpper(i) * md->scale,
+                (unsigned long long)cumulative);
+    }
+    metricPrintf(t, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", md->name, labels, sep,
+            (unsigned long long)count);
+    metricPrintf(t, "%s_sum{%s} %.9g\n", md->name, labels, sum * md->scale);
+    metricPrintf(t, "%s_count{%s} %llu\n", md->name, labels,
+            (unsigned long long)count);
+}
+
+/**
+ * Format all metrics in Prometheus text exposition format
+ *
+ * @param mr Pointer to teoMetricRegistry
+ * @param labels Labels added to all metrics, f.e. "peer=\"teo-1\"", or NULL
+ * @param length Pointer to get text length, may be NULL
+ *
+ * @return Zero terminated text, should be freed after use
+ */
+char *teoMetricRegistryFormat(teoMetricRegistry *mr, const char *labels,
+        size_t *length) {
+
+    static const char *type_name[] = { "counter", "gauge", "histogram" };
+    metricText t = { malloc(4096), 0, 4096 };
+    if(labels == NULL) labels = "";
+    const char *sep = labels[0] ? "," : "";
+
+    uint32_t id;
+    for(id = 0; id < mr->num_metrics; id++) {
+        teoMetricDesc *md = &mr->metric[id];
+        metricPrintf(&t, "# HELP %s %s\n# TYPE %s %s\n", md->name, md->help,
+                md->name, type_name[md->type]);
+        if(md->type == TEO_METRIC_HISTOGRAM) {
+            metricFormatHistogram(mr, id, labels, sep, &t);
+        }
+        else {
+            metricPrintf(&t, "%s{%s} %.17g\n", md->name, labels,
+                    teoMetricGet(mr, id));
+        }
+    }
+
+    if(length != NULL) *length = t.length;
+    return t.data;
+}
@@ -0,0 +1,124 @@
+/**
+ * \file   metric_registry.h
+ * \author max
+ *
+ * In-process metrics registry: counters, gauges and log-linear histograms.
+ *
+ * Metric values are stored in per-thread shards, so threads update metrics
+ * with relaxed atomic adds to their own cache lines. Readers sum all shards.
+ * Metrics should be registered from the event loop thread, values may be
+ * updated from any thread.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#ifndef METRIC_REGISTRY_H
+#define METRIC_REGISTRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TEO_METRIC_MAX 256        ///< Maximum number of metrics
+#define TEO_METRIC_SHARDS 8       ///< Number of per-thread value shards
+#define TEO_METRIC_SLOTS 4096     ///< Number of value slots in one shard
+#define TEO_METRIC_NAME_SIZE 64
+#define TEO_METRIC_HELP_SIZE 128
+
+/**
+ * Histogram buckets: values 0..3 have own buckets, each next power of two
+ * range is split to 4 buckets, so bucket width is less than 25% of value.
+ * The last bucket counts all values bigger than 2^40.
+ */
+#define TEO_METRIC_HIST_BUCKETS 156
+
+/**
+ * Metric types
+ */
+typedef enum teoMetricType {
+    TEO_METRIC_COUNTER,
+    TEO_METRIC_GAUGE,
+    TEO_METRIC_HISTOGRAM
+} teoMetricType;
+
+/**
+ * Metric value callback, used by metrics which values are read on demand
+ *
+ * @param user_data User data set at registration
+ * @return Metric value
+ */
+typedef double (*teoMetricValueCb)(void *user_data);
+
+/**
+ * Metrics visitor callback
+ *
+ * @param name Metric name
+ * @param type Metric type
+ * @param value Counter or gauge value, number of observations for histogram
+ * @param sum Sum of histogram observations (scaled), 0 for other types
+ * @param user_data User data
+ */
+typedef void (*teoMetricVisitCb)(const char *name, teoMetricType type,
+        double value, double sum, void *user_data);
+
+typedef struct teoMetricRegistry teoMetricRegistry;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+teoMetricRegistry *teoMetricRegistryNew(void);
+void teoMetricRegistryFree(teoMetricRegistry *mr);
+
+int teoMetricRegisterCounter(teoMetricRegistry *mr, const char *name,
+        const char *help);
+int teoMetricRegisterGauge(teoMetricRegistry *mr, const char *name,
+        const char *help);
+int teoMetricRegisterHistogram(teoMetricRegistry *mr, const char *name,
+        const char *help, double scale);
+int teoMetricRegisterCb(teoMetricRegistry *mr, const char *name,
+        const char *help, teoMetricType type, teoMetricValueCb cb,
+        void *user_data);
+
+void teoMetricAdd(teoMetricRegistry *mr, int id, uint64_t value);
+void teoMetricSet(teoMetricRegistry *mr, int id, double value);
+void teoMetricObserve(teoMetricRegistry *mr, int id, uint64_t value);
+
+double teoMetricGet(teoMetricRegistry *mr, int id);
+uint64_t teoMetricHistogramGet(teoMetricRegistry *mr, int id,
+        uint64_t *buckets, uint64_t *sum);
+
+void teoMetricForEach(teoMetricRegistry *mr, teoMetricVisitCb cb,
+        void *user_data);
+char *teoMetricRegistryFormat(teoMetricRegistry *mr, const char *labels,
+        size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * Get histogram bucket of value
+ *
+ * @param value Value
+ * @return Bucket index
+ */
+static inline int teoMetricHistBucket(uint64_t value) {
+    if(value < 4) return (int)value;
+    int e = 63 - __builtin_clzll(value);
+    int idx = 4 * (e - 1) + (int)((value >> (e - 2)) & 3);
+    return idx < TEO_METRIC_HIST_BUCKETS ? idx : TEO_METRIC_HIST_BUCKETS - 1;
+}
+
+/**
+ * Get biggest value of histogram bucket
+ *
+ * @param idx Bucket index
+ * @return Biggest value which belongs to the bucket
+ */
+static inline uint64_t teoMetricHistUpper(int idx) {
+    if(idx < 4) return (uint64_t)idx;
+    int e = idx / 4 + 1;
+    return ((uint64_t)(4 + idx % 4 + 1) << (e - 2)) - 1;
+}
+
+#endif /* METRIC_REGISTRY_H */
@@ -0,0 +1,619 @@
+/**
+ * \file   net_sim.c
+ * \author max
+ *
+ * Simulated network: in-memory transport for teonet nodes and tests.
+ *
+ * Packets in flight are kept in binary heap ordered by delivery time and
+ * send order, so packets with equal delivery time are delivered in the
+ * order they were sent. Link bandwidth is modelled as a transmit queue: a
+ * packet starts transmission when the previous one is transmitted, the
+ * queue length in bytes is (busy_until - now) * bandwidth.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "net_sim.h"
+#include "ev_mgr.h"
+#include "utils/teo_memory.h"
+
+#define QUEUE_MIN_SIZE 64
+
+void host_cb(EV_P_ ev_io *w, int revents);
+
+/**
+ * Packet in flight or in node receive queue
+ */
+struct teoNetSimPacket {
+    teoNetSimPacket *next;    ///< Next packet in receive queue
+    double time;              ///< Delivery time
+    uint64_t seq;             ///< Send order
+    struct sockaddr_in from;
+    struct sockaddr_in to;
+    size_t len;
+    uint8_t data[];
+};
+
+/**
+ * Node address key
+ */
+typedef struct addr_key {
+    uint32_t addr;
+    uint16_t port;
+} __attribute__((packed)) addr_key;
+
+/**
+ * Link key: source and destination addresses
+ */
+typedef struct link_key {
+    addr_key from;
+    addr_key to;
+} __attribute__((packed)) link_key;
+
+/**
+ * Link
+ */
+typedef struct teoNetSimLink {
+    teoNetSimLinkParam param;
+    double busy_until;        ///< Time when transmit queue is empty
+    teoNetSimStat stat;
+} teoNetSimLink;
+
+/**
+ * Get random number from 0 to 1 (xorshift64*)
+ */
+static double sim_random(teoNetSim *sim) {
+
+    uint64_t x = sim->rand_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sim->rand_state = x;
+
+    return ((x * UINT64_C(2685821657736338717)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline void make_addr_key(addr_key *key, const struct sockaddr_in *sa) {
+    key->addr = sa->sin_addr.s_addr;
+    key->port = sa->sin_port;
+}
+
+static int make_sockaddr(struct sockaddr_in *sa, const char *addr, int port) {
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons(port);
+
+    return inet_pton(AF_INET, addr, &sa->sin_addr) == 1 ? 0 : -1;
+}
+
+/**
+ * Get link between addresses, create link with default parameters if it
+ * is not configured
+ */
+static teoNetSimLink *get_link(teoNetSim *sim, const struct sockaddr_in *from,
+        const struct sockaddr_in *to) {
+
+    link_key key;
+    make_addr_key(&key.from, from);
+    make_addr_key(&key.to, to);
+
+    teoNetSimLink *link = teoHashMapGet(sim->links, &key, sizeof(key), NULL);
+    if(link == NULL) {
+        link = teoHashMapAdd(sim->links, &key, sizeof(key), NULL,
+                sizeof(teoNetSimLink));
+        link->param = sim->default_link;
+    }
+
+    return link;
+}
+
+static inline int packet_before(const teoNetSimPacket *a,
+        const teoNetSimPacket *b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+/**
+ * Add packet to the heap of packets in flight
+ */
+static void queue_push(teoNetSim *sim, teoNetSimPacket *p) {
+
+    if(sim->queue_len == sim->queue_size) {
+        sim->queue_size = sim->queue_size ? sim->queue_size * 2 : QUEUE_MIN_SIZE;
+        sim->queue = teo_realloc(sim->queue,
+                sim->queue_size * sizeof(teoNetSimPacket *));
+    }
+
+    size_t i = sim->queue_len++;
+    while(i) {
+        size_t parent = (i - 1) / 2;
+        if(!packet_before(p, sim->queue[parent])) break;
+        sim->queue[i] = sim->queue[parent];
+        i = parent;
+    }
+    sim->queue[i] = p;
+}
+
+/**
+ * Remove first packet from the heap of packets in flight
+ */
+static teoNetSimPacket *queue_pop(teoNetSim *sim) {
+
+    teoNetSimPacket *first = sim->queue[0];
+    teoNetSimPacket *last = sim->queue[--sim->queue_len];
+    size_t i = 0, n = sim->queue_len;
+
+    for(;;) {
+        size_t child = i * 2 + 1;
+        if(child >= n) break;
+        if(child + 1 < n && packet_before(sim->queue[child + 1],
+                sim->queue[child])) child++;
+        if(!packet_before(sim->queue[child], last)) break;
+        sim->queue[i] = sim->queue[child];
+        i = child;
+    }
+    if(n) sim->queue[i] = last;
+
+    return first;
+}
+
+/**
+ * Restart next delivery timer when the clock is driven by event loop
+ */
+static void sim_schedule(teoNetSim *sim) {
+
+    if(sim->loop == NULL) return;
+
+    ev_timer_stop(sim->loop, &sim->timer_w);
+    if(sim->queue_len) {
+        double after = sim->queue[0]->time -
+                (ev_now(sim->loop) - sim->loop_start);
+        ev_timer_set(&sim->timer_w, after > 0 ? after : 0, 0.0);
+        ev_timer_start(sim->loop, &sim->timer_w);
+    }
+}
+
+/**
+ * Add copy of packet to packets in flight
+ */
+static void send_packet(teoNetSim *sim, const teoNetSimNode *node,
+        const struct sockaddr_in *to, const void *buffer, size_t buffer_len,
+        double time) {
+
+    teoNetSimPacket *p = teo_malloc(sizeof(teoNetSimPacket) + buffer_len);
+    p->next = NULL;
+    p->time = time;
+    p->seq = sim->seq++;
+    p->from = node->addr;
+    p->to = *to;
+    p->len = buffer_len;
+    memcpy(p->data, buffer, buffer_len);
+
+    queue_push(sim, p);
+    if(sim->queue[0] == p) sim_schedule(sim);
+}
+
+#define stat_add(link, sim, field) \
+    do { (link)->stat.field++; (sim)->stat.field++; } while(0)
+
+/**
+ * Initialize simulated network
+ *
+ * @param seed Random generator seed
+ *
+ * @return Pointer to created teoNetSim
+ */
+teoNetSim *teoNetSimNew(uint64_t seed) {
+
+    teoNetSim *sim = teo_calloc(sizeof(teoNetSim));
+
+    // Mix the seed (splitmix64), xorshift state should not be zero
+    uint64_t z = seed + UINT64_C(0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    z ^= z >> 31;
+    sim->rand_state = z ? z : 1;
+
+    sim->nodes = teoHashMapNew();
+    sim->links = teoHashMapNew();
+    ev_init(&sim->timer_w, NULL);
+
+    return sim;
+}
+
+/**
+ * Destroy simulated network, attached teonet nodes return to UDP sockets
+ *
+ * @param sim Pointer to teoNetSim
+ */
+void teoNetSimFree(teoNetSim *sim) {
+
+    if(sim == NULL) return;
+
+    teoNetSimStop(sim);
+
+    teoHashMapIter it;
+    teoHashMapEntry *e;
+    teoHashMapIterInit(sim->nodes, &it);
+    while((e = teoHashMapIterNext(&it))) {
+        teoNetSimNode *node = e->data;
+        if(node->ke != NULL &&
+           ((ksnetEvMgrClass *)node->ke)->transport == &node->transport)
+            ((ksnetEvMgrClass *)node->ke)->transport = NULL;
+        while(node->rx_first != NULL) {
+            teoNetSimPacket *p = node->rx_first;
+            node->rx_first = p->next;
+            free(p);
+        }
+    }
+    while(sim->queue_len) free(queue_pop(sim));
+
+    free(sim->queue);
+    teoHashMapFree(sim->nodes);
+    teoHashMapFree(sim->links);
+    free(sim);
+}
+
+/**
+ * Set parameters of links which are not configured by teoNetSimSetLink
+ * and were not used yet
+ *
+ * @param sim Pointer to teoNetSim
+ * @param lp Link parameters
+ */
+void teoNetSimSetDefaultLink(teoNetSim *sim, const teoNetSimLinkParam *lp) {
+
+    sim->default_link = *lp;
+}
+
+/**
+ * Set parameters of one direction link
+ *
+ * @param sim Pointer to teoNetSim
+ * @param from_addr Source IPv4 address
+ * @param from_port Source port
+ * @param to_addr Destination IPv4 address
+ * @param to_port Destination port
+ * @param lp Link parameters
+ *
+ * @return 0 on success or -1 if address is wrong
+ */
+int teoNetSimSetLink(teoNetSim *sim, const char *from_addr, int from_port,
+        const char *to_addr, int to_port, const teoNetSimLinkParam *lp) {
+
+    struct sockaddr_in from, to;
+    if(make_sockaddr(&from, from_addr, from_port) ||
+       make_sockaddr(&to, to_addr, to_port)) return -1;
+
+    get_link(sim, &from, &to)->param = *lp;
+
+    return 0;
+}
+
+/**
+ * Get statistic of one direction link
+ *
+ * @param sim Pointer to teoNetSim
+ * @param from_addr Source IPv4 address
+ * @param from_port Source port
+ * @param to_addr Destination IPv4 address
+ * @param to_port Destination port
+ *
+ * @return Pointer to link statistic or NULL if the link was not used or
+ *         configured
+ */
+teoNetSimStat *teoNetSimLinkStat(teoNetSim *sim, const char *from_addr,
+        int from_port, const char *to_addr, int to_port) {
+
+    struct sockaddr_in from, to;
+    link_key key;
+    if(make_sockaddr(&from, from_addr, from_port) ||
+       make_sockaddr(&to, to_addr, to_port)) return NULL;
+    make_addr_key(&key.from, &from);
+    make_addr_key(&key.to, &to);
+
+    teoNetSimLink *link = teoHashMapGet(sim->links, &key, sizeof(key), NULL);
+
+    return link != NULL ? &link->stat : NULL;
+}
+
+static ssize_t transport_sendto(void *user_data, const void *buffer,
+        size_t buffer_len, __CONST_SOCKADDR_ARG addr, socklen_t addr_len) {
+    return teoNetSimSendto(user_data, buffer, buffer_len, addr, addr_len);
+}
+
+static ssize_t transport_recvfrom(void *user_data, void *buffer,
+        size_t buffer_len, __SOCKADDR_ARG addr, socklen_t *addr_len) {
+    return teoNetSimRecvfrom(user_data, buffer, buffer_len, addr, addr_len);
+}
+
+/**
+ * Add node to simulated network
+ *
+ * @param sim Pointer to teoNetSim
+ * @param addr Node IPv4 address
+ * @param port Node port
+ * @param recv_cb Packet delivered callback or NULL
+ * @param user_data Callback user data
+ *
+ * @return Pointer to teoNetSimNode or NULL if address is wrong or used by
+ *         other node
+ */
+teoNetSimNode *teoNetSimNodeAdd(teoNetSim *sim, const char *addr, int port,
+        teoNetSimRecvCb recv_cb, void *user_data) {
+
+    struct sockaddr_in sa;
+    addr_key key;
+    if(make_sockaddr(&sa, addr, port)) return NULL;
+    make_addr_key(&key, &sa);
+    if(teoHashMapGet(sim->nodes, &key, sizeof(key), NULL) != NULL) return NULL;
+
+    teoNetSimNode *node = teoHashMapAdd(sim->nodes, &key, sizeof(key), NULL,
+            sizeof(teoNetSimNode));
+    node->sim = sim;
+    node->addr = sa;
+    node->transport.sendto = transport_sendto;
+    node->transport.recvfrom = transport_recvfrom;
+    node->transport.user_data = node;
+    node->recv_cb = recv_cb;
+    node->user_data = user_data;
+
+    return node;
+}
+
+/**
+ * Send packet from node, the packet is delivered by teoNetSimRun
+ *
+ * @param node Pointer to teoNetSimNode
+ * @param buffer Packet data
+ * @param buffer_len Packet length
+ * @param addr Destination IPv4 address
+ * @param addr_len Destination address length
+ *
+ * @return Packet length (lost packets are sent too) or -1 if destination
+ *         is not IPv4 address
+ */
+ssize_t teoNetSimSendto(teoNetSimNode *node, const void *buffer,
+        size_t buffer_len, __CONST_SOCKADDR_ARG addr, socklen_t addr_len) {
+
+    teoNetSim *sim = node->sim;
+    const struct sockaddr_in *to = (const struct sockaddr_in *)addr;
+
+    if(addr_len < sizeof(struct sockaddr_in) || to->sin_family != AF_INET) {
+        errno = EAFNOSUPPORT;
+        return -1;
+    }
+
+    // Virtual clock follows the event loop
+    if(sim->loop != NULL) {
+        double now = ev_now(sim->loop) - sim->loop_start;
+        if(now > sim->now) sim->now = now;
+    }
+
+    teoNetSimLink *link = get_link(sim, &node->addr, to);
+    const teoNetSimLinkParam *lp = &link->param;
+
+    // Random values are taken for every packet, so decisions for a packet
+    // do not depend on parameters of links used by previous packets
+    double r_loss = sim_random(sim), r_duplicate = sim_random(sim),
+           r_reorder = sim_random(sim), r_jitter = sim_random(sim),
+           r_jitter_dup = sim_random(sim);
+
+    stat_add(link, sim, sent);
+
+    if(lp->mtu && buffer_len > lp->mtu) {
+        stat_add(link, sim, mtu_dropped);
+        return buffer_len;
+    }
+
+    // Transmit queue
+    double sent_time = sim->now;
+    if(lp->bandwidth > 0) {
+        double start = link->busy_until > sim->now ? link->busy_until : sim->now;
+        if(lp->queue_limit &&
+           (start - sim->now) * lp->bandwidth + buffer_len > lp->queue_limit) {
+            stat_add(link, sim, queue_dropped);
+            return buffer_len;
+        }
+        sent_time = link->busy_until = start + buffer_len / lp->bandwidth;
+    }
+
+    if(r_loss < lp->loss) {
+        stat_add(link, sim, lost);
+        return buffer_len;
+    }
+
+    double delay = lp->latency + lp->jitter * r_jitter;
+    if(r_reorder < lp->reorder) {
+        delay += lp->latency + lp->jitter;
+        stat_add(link, sim, reordered);
+    }
+    send_packet(sim, node, to, buffer, buffer_len, sent_time + delay);
+
+    if(r_duplicate < lp->duplicate) {
+        send_packet(sim, node, to, buffer, buffer_len,
+                sent_time + lp->latency + lp->jitter * r_jitter_dup);
+        stat_add(link, sim, duplicated);
+    }
+
+    return buffer_len;
+}
+
+/**
+ * Get packet from node receive queue
+ *
+ * @param node Pointer to teoNetSimNode
+ * @param buffer Buffer to receive packet, larger packets are truncated
+ * @param buffer_len Buffer length
+ * @param[out] addr Source address
+ * @param[in,out] addr_len Source address length
+ *
+ * @return Received length or -1 if the queue is empty (errno is EAGAIN)
+ */
+ssize_t teoNetSimRecvfrom(teoNetSimNode *node, void *buffer,
+        size_t buffer_len, __SOCKADDR_ARG addr, socklen_t *addr_len) {
+
+    teoNetSimPacket *p = node->rx_first;
+    if(p == NULL) {
+        errno = EAGAIN;
+        return -1;
+    }
+    node->rx_first = p->next;
+    if(node->rx_first == NULL) node->rx_last = NULL;
+    node->rx_num--;
+
+    size_t len = p->len < buffer_len ? p->len : buffer_len;
+    memcpy(buffer, p->data, len);
+    if(addr_len != NULL) {
+        size_t sa_len = *addr_len < sizeof(p->from) ? *addr_len : sizeof(p->from);
+        memcpy(addr, &p->from, sa_len);
+        *addr_len = sizeof(p->from);
+    }
+    free(p);
+
+    return len;
+}
+
+/**
+ * Get delivery time of next packet in flight
+ *
+ * @param sim Pointer to teoNetSim
+ *
+ * @return Virtual time or -1 if there are no packets in flight
+ */
+double teoNetSimNextTime(teoNetSim *sim) {
+
+    return sim->queue_len ? sim->queue[0]->time : -1.0;
+}
+
+/**
+ * Deliver packets in flight till virtual time and advance the clock to it.
+ * Packets sent by receive callbacks are delivered too if they arrive
+ * before the time.
+ *
+ * @param sim Pointer to teoNetSim
+ * @param until Virtual time
+ *
+ * @return Number of delivered packets
+ */
+size_t teoNetSimRun(teoNetSim *sim, double until) {
+
+    size_t delivered = 0;
+
+    while(sim->queue_len && sim->queue[0]->time <= until) {
+
+        teoNetSimPacket *p = queue_pop(sim);
+        if(p->time > sim->now) sim->now = p->time;
+
+        teoNetSimLink *link = get_link(sim, &p->from, &p->to);
+        addr_key key;
+        make_addr_key(&key, &p->to);
+        teoNetSimNode *node = teoHashMapGet(sim->nodes, &key, sizeof(key), NULL);
+        if(node == NULL) {
+            stat_add(link, sim, unreachable);
+            free(p);
+            continue;
+        }
+
+        stat_add(link, sim, delivered);
+        link->stat.bytes_delivered += p->len;
+        sim->stat.bytes_delivered += p->len;
+        delivered++;
+
+        if(node->rx_last != NULL) node->rx_last->next = p;
+        else node->rx_first = p;
+        node->rx_last = p;
+        node->rx_num++;
+
+        if(node->recv_cb != NULL) node->recv_cb(node, node->user_data);
+    }
+    if(until > sim->now) sim->now = until;
+
+    return delivered;
+}
+
+/**
+ * Next delivery timer callback
+ */
+static void sim_timer_cb(EV_P_ ev_timer *w, int revents) {
+
+    teoNetSim *sim = w->data;
+    teoNetSimRun(sim, ev_now(EV_A) - sim->loop_start);
+    sim_schedule(sim);
+}
+
+/**
+ * Drive the virtual clock by event loop: virtual time follows the loop
+ * time and packets are delivered by timer
+ *
+ * @param sim Pointer to teoNetSim
+ * @param loop Event loop
+ */
+void teoNetSimStart(teoNetSim *sim, struct ev_loop *loop) {
+
+    teoNetSimStop(sim);
+    sim->loop = loop;
+    sim->loop_start = ev_now(loop) - sim->now;
+    ev_timer_init(&sim->timer_w, sim_timer_cb, 0.0, 0.0);
+    sim->timer_w.data = sim;
+    sim_schedule(sim);
+}
+
+/**
+ * Stop driving the virtual clock by event loop
+ *
+ * @param sim Pointer to teoNetSim
+ */
+void teoNetSimStop(teoNetSim *sim) {
+
+    if(sim->loop != NULL) {
+        ev_timer_stop(sim->loop, &sim->timer_w);
+        sim->loop = NULL;
+    }
+}
+
+/**
+ * Delivered packet callback of teonet node: read it by host socket callback
+ */
+static void teonet_recv_cb(teoNetSimNode *node, void *user_data) {
+
+    ksnetEvMgrClass *ke = user_data;
+    if(ke->kc != NULL) host_cb(ke->ev_loop, &ke->kc->host_w, EV_READ);
+}
+
+/**
+ * Attach teonet node to simulated network. The node sends and receives
+ * UDP packets through the network instead of its socket. Should be called
+ * after the event manager modules are initialized, in the EV_K_STARTED event
+ * or after ksnetEvMgrRun returned for preassigned event loop. The host socket
+ * watcher is stopped if it has been started already. The network clock is
+ * started in the node event loop if it is not driven yet.
+ *
+ * @param sim Pointer to teoNetSim
+ * @param ke Pointer to ksnetEvMgrClass
+ * @param addr Node IPv4 address, port is the node port
+ *
+ * @return Pointer to teoNetSimNode or NULL on error (node uses TCP Proxy,
+ *         wrong or used address)
+ */
+teoNetSimNode *teoNetSimAttach(teoNetSim *sim, void *ke, const char *addr) {
+
+    ksnetEvMgrClass *kev = ke;
+    if(kev->kc == NULL || kev->teo_cfg.r_tcp_f) return NULL;
+
+    teoNetSimNode *node = teoNetSimNodeAdd(sim, addr, kev->kc->port,
+            teonet_recv_cb, ke);
+    if(node == NULL) return NULL;
+
+    node->ke = ke;
+    kev->transport = &node->transport;
+    ev_io_stop(kev->ev_loop, &kev->kc->host_w);
+    if(sim->loop == NULL) teoNetSimStart(sim, kev->ev_loop);
+
+    return node;
+}
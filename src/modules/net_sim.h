@@ -0,0 +1,162 @@
+/**
+ * \file   net_sim.h
+ * \author max
+ *
+ * Simulated network: in-memory transport for teonet nodes and tests.
+ *
+ * Nodes of simulated network are IPv4 addresses with port. A packet sent
+ * from one node to another goes through the link between them, which may
+ * drop, duplicate, reorder and delay it, and is queued to the destination
+ * node at its delivery time of the network virtual clock. All random
+ * decisions are taken from the network seeded generator, so the same sends
+ * at the same virtual times give the same deliveries.
+ *
+ * The clock is advanced by teoNetSimRun, or by the event loop after
+ * teoNetSimStart, where virtual time follows the loop time. Teonet nodes
+ * attached to the network (teoNetSimAttach) send and receive UDP packets
+ * through the teoTransport shim instead of their sockets.
+ *
+ * Created on Oct 19, 2026
+ */
+
+#ifndef NET_SIM_H
+#define NET_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <ev.h>
+
+#include "utils/teo_hashmap.h"
+
+/**
+ * Transport shim: replaces UDP socket of teonet node when set to
+ * ksnetEvMgrClass transport
+ */
+typedef struct teoTransport {
+
+    /// Send packet, return number of bytes sent or -1 on error
+    ssize_t (*sendto)(void *user_data, const void *buffer, size_t buffer_len,
+            __CONST_SOCKADDR_ARG addr, socklen_t addr_len);
+
+    /// Receive packet, return number of bytes received or -1 if there is
+    /// no packet (errno is EAGAIN)
+    ssize_t (*recvfrom)(void *user_data, void *buffer, size_t buffer_len,
+            __SOCKADDR_ARG addr, socklen_t *addr_len);
+
+    void *user_data; ///< User data of the functions
+
+} teoTransport;
+
+/**
+ * Link parameters, zero parameters make perfect link without delay
+ */
+typedef struct teoNetSimLinkParam {
+    double loss;        ///< Packet loss probability, 0 - 1
+    double duplicate;   ///< Packet duplication probability, 0 - 1
+    double reorder;     ///< Probability of packet to be delayed by one more
+                        ///< latency and jitter, 0 - 1
+    double latency;     ///< Packet delay, seconds
+    double jitter;      ///< Maximal random delay added to latency, seconds
+    double bandwidth;   ///< Bytes per second, 0 - unlimited
+    size_t mtu;         ///< Larger packets are dropped, 0 - unlimited
+    size_t queue_limit; ///< Bytes waiting for bandwidth, packets which do
+                        ///< not fit are dropped, 0 - unlimited
+} teoNetSimLinkParam;
+
+/**
+ * Link statistic
+ */
+typedef struct teoNetSimStat {
+    uint64_t sent;          ///< Packets sent to link
+    uint64_t delivered;     ///< Packets delivered to node
+    uint64_t bytes_delivered;
+    uint64_t lost;          ///< Packets dropped by loss probability
+    uint64_t mtu_dropped;   ///< Packets dropped by MTU
+    uint64_t queue_dropped; ///< Packets dropped by queue limit
+    uint64_t unreachable;   ///< Packets to address without node
+    uint64_t duplicated;    ///< Packets duplicated
+    uint64_t reordered;     ///< Packets delayed by reorder probability
+} teoNetSimStat;
+
+typedef struct teoNetSim teoNetSim;
+typedef struct teoNetSimNode teoNetSimNode;
+typedef struct teoNetSimPacket teoNetSimPacket;
+
+/**
+ * Packet delivered callback, the packet is waiting in node receive queue
+ *
+ * @param node Pointer to teoNetSimNode
+ * @param user_data User data of the node
+ */
+typedef void (*teoNetSimRecvCb)(teoNetSimNode *node, void *user_data);
+
+/**
+ * Simulated network node
+ */
+struct teoNetSimNode {
+    teoNetSim *sim;
+    struct sockaddr_in addr;  ///< Node address
+    teoTransport transport;   ///< Transport of the node
+    teoNetSimRecvCb recv_cb;  ///< Packet delivered callback or NULL
+    void *user_data;          ///< Callback user data
+    void *ke;                 ///< Attached teonet node or NULL
+    teoNetSimPacket *rx_first; ///< Receive queue
+    teoNetSimPacket *rx_last;
+    size_t rx_num;            ///< Packets in receive queue
+};
+
+/**
+ * Simulated network
+ */
+struct teoNetSim {
+    double now;               ///< Virtual clock, seconds
+    uint64_t rand_state;      ///< Random generator state
+    uint64_t seq;             ///< Sent packets counter
+    teoNetSimLinkParam default_link; ///< Parameters of not configured links
+    teoHashMap *nodes;        ///< Nodes by address
+    teoHashMap *links;        ///< Links by source and destination address
+    teoNetSimPacket **queue;  ///< Packets in flight, heap by delivery time
+    size_t queue_len;
+    size_t queue_size;
+    teoNetSimStat stat;       ///< Statistic of all links
+
+    struct ev_loop *loop;     ///< Event loop driving the clock or NULL
+    double loop_start;        ///< Loop time of virtual time 0
+    ev_timer timer_w;         ///< Next delivery timer
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+teoNetSim *teoNetSimNew(uint64_t seed);
+void teoNetSimFree(teoNetSim *sim);
+
+void teoNetSimSetDefaultLink(teoNetSim *sim, const teoNetSimLinkParam *lp);
+int teoNetSimSetLink(teoNetSim *sim, const char *from_addr, int from_port,
+        const char *to_addr, int to_port, const teoNetSimLinkParam *lp);
+teoNetSimStat *teoNetSimLinkStat(teoNetSim *sim, const char *from_addr,
+        int from_port, const char *to_addr, int to_port);
+
+teoNetSimNode *teoNetSimNodeAdd(teoNetSim *sim, const char *addr, int port,
+        teoNetSimRecvCb recv_cb, void *user_data);
+ssize_t teoNetSimSendto(teoNetSimNode *node, const void *buffer,
+        size_t buffer_len, __CONST_SOCKADDR_ARG addr, socklen_t addr_len);
+ssize_t teoNetSimRecvfrom(teoNetSimNode *node, void *buffer,
+        size_t buffer_len, __SOCKADDR_ARG addr, socklen_t *addr_len);
+
+double teoNetSimNextTime(teoNetSim *sim);
+size_t teoNetSimRun(teoNetSim *sim, double until);
+
+void teoNetSimStart(teoNetSim *sim, struct ev_loop *loop);
+void teoNetSimStop(teoNetSim *sim);
+teoNetSimNode *teoNetSimAttach(teoNetSim *sim, void *ke, const char *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_SIM_H */
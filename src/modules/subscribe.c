@@ -39,7 +39,7 @@ teoSScrClass *teoSScrInit(void *ke) {
     teoSScrClass *sscr = malloc(sizeof(teoSScrClass));
 
     if(sscr != NULL) {
-        sscr->map = pblMapNewHashMap();
+        sscr->map = teoHashMapNew();
         sscr->ke = ke;
     }
 
@@ -58,9 +58,8 @@ teoSScrClass *teoSScrInit(void *ke) {
 void teoSScrSend(teoSScrClass *sscr, uint16_t ev, void *data,
         size_t data_length, uint8_t cmd) {
 
-    size_t valueLength;
-    teoSScrMapData *sscr_map_data = pblMapGet(sscr->map, &ev, sizeof(ev),
-            &valueLength);
+    teoSScrMapData *sscr_map_data = teoHashMapGet(sscr->map, &ev, sizeof(ev),
+            NULL);
 
     if(sscr_map_data != NULL) {
 
@@ -141,9 +140,8 @@ static int find_in_list(teoSScrClass *sscr, char *peer_name, uint16_t ev) {
 
     int retval = -1;
 
-    size_t valueLength;
-    teoSScrMapData *sscr_map_data = pblMapGet(sscr->map, &ev, sizeof(ev),
-            &valueLength);
+    teoSScrMapData *sscr_map_data = teoHashMapGet(sscr->map, &ev, sizeof(ev),
+            NULL);
     if(sscr_map_data != NULL) {
 
         // Loop list and destroy all loaded modules
@@ -180,17 +178,13 @@ int teoSScrNumberOfSubscribers(teoSScrClass *sscr) {
 
     int retval = 0;
 
-    PblIterator *it = pblMapIteratorNew(sscr->map);
-    if(it != NULL) {
+    teoHashMapIter it;
+    teoHashMapEntry *entry;
+    teoHashMapIterInit(sscr->map, &it);
+    while((entry = teoHashMapIterNext(&it))) {
 
-        while(pblIteratorHasNext(it)) {
-
-            void *entry = pblIteratorNext(it);
-
-            teoSScrMapData *sscr_map_data = pblMapEntryValue(entry);
-            retval += pblListSize(sscr_map_data->list);
-        }
-        pblIteratorFree(it);
+        teoSScrMapData *sscr_map_data = entry->data;
+        retval += pblListSize(sscr_map_data->list);
     }
 
     return retval;
@@ -203,9 +197,8 @@ int teoSScrNumberOfSubscribers(teoSScrClass *sscr) {
  * @return
  */
 int teoSScrNumberOfEventSubscribers(teoSScrClass *sscr, uint16_t event) {
-    size_t valueLength;
-    teoSScrMapData *sscr_map_data = pblMapGet(sscr->map, &event, sizeof(event),
-            &valueLength);
+    teoSScrMapData *sscr_map_data = teoHashMapGet(sscr->map, &event, sizeof(event),
+            NULL);
 
     if(sscr_map_data == NULL) { return 0; }
 
@@ -264,17 +257,16 @@ void teoSScrSubscription(teoSScrClass *sscr, char *peer_name, uint16_t ev,
 
     // Check event in map and create new record or update existing
     teoSScrMapData *sscr_data;
-    size_t valueLength;
 
     // Create new record (new list) in map
-    if((sscr_data = pblMapGet(sscr->map, &ev,
-            sizeof(ev), &valueLength)) == NULL) {
+    if((sscr_data = teoHashMapGet(sscr->map, &ev,
+            sizeof(ev), NULL)) == NULL) {
 
         // Add record to map
         teoSScrMapData sscr_map_data;
         sscr_map_data.list = pblListNewArrayList();
         add_data_to_list(sscr_map_data.list, peer_name, ev, 0);
-        pblMapAdd(sscr->map, &ev, sizeof(ev), &sscr_map_data,
+        teoHashMapAdd(sscr->map, &ev, sizeof(ev), &sscr_map_data,
                 sizeof(sscr_map_data));
     }
 
@@ -314,9 +306,8 @@ void teoSScrSubscription(teoSScrClass *sscr, char *peer_name, uint16_t ev,
 int teoSScrUnSubscription(teoSScrClass *sscr, char *peer_name, uint16_t ev) {
 
     int retval = 0;
-    size_t valueLength;
-    teoSScrMapData *sscr_map_data = pblMapGet(sscr->map, &ev, sizeof(ev),
-            &valueLength);
+    teoSScrMapData *sscr_map_data = teoHashMapGet(sscr->map, &ev, sizeof(ev),
+            NULL);
 
     if(sscr_map_data != NULL) {
 
@@ -361,38 +352,36 @@ const char *teoSScrSubscriptionList(teoSScrClass *sscr) {
 
         printf("Subscriber        event   cmd\n");
         printf("-----------------------------\n");
-        PblIterator *it =  pblMapIteratorNew(sscr->map);
-        if(it != NULL) {
-            while(pblIteratorHasNext(it)) {
-                void *entry = pblIteratorNext(it);
-                teoSScrMapData *sscr_map_data = pblMapEntryValue(entry);
-
-                // Loop list and destroy all loaded modules
-                PblIterator *it_l =  pblListIterator(sscr_map_data->list);
-                if(it_l != NULL) {
-                    while(pblIteratorHasNext(it_l)) {
-                        void *entry = pblIteratorNext(it_l);
-                        teoSScrListData *sscr_list_data = entry;
-                        //if(peer_name[0] && !strcmp(sscr_list_data->data, peer_name)) {
-                        printf("%s\t%7d   %3d", 
-                                sscr_list_data->data, 
-                                sscr_list_data->ev,
-                                sscr_list_data->cmd
+        teoHashMapIter it;
+        teoHashMapEntry *entry;
+        teoHashMapIterInit(sscr->map, &it);
+        while((entry = teoHashMapIterNext(&it))) {
+            teoSScrMapData *sscr_map_data = entry->data;
+
+            // Loop list and destroy all loaded modules
+            PblIterator *it_l =  pblListIterator(sscr_map_data->list);
+            if(it_l != NULL) {
+                while(pblIteratorHasNext(it_l)) {
+                    void *entry = pblIteratorNext(it_l);
+                    teoSScrListData *sscr_list_data = entry;
+                    //if(peer_name[0] && !strcmp(sscr_list_data->data, peer_name)) {
+                    printf("%s\t%7d   %3d", 
+                            sscr_list_data->data, 
+                            sscr_list_data->ev,
+                            sscr_list_data->cmd
+                    );
+                    if(sscr_list_data->l0_f) {
+                        printf(", l0 addr: %s:%d\n", 
+                            sscr_list_data->addr, 
+                            sscr_list_data->port
                         );
-                        if(sscr_list_data->l0_f) {
-                            printf(", l0 addr: %s:%d\n", 
-                                sscr_list_data->addr, 
-                                sscr_list_data->port
-                            );
-                        }
-                        printf("\n");
-                        //teoSScrFree(pblIteratorNext(it_l));
                     }
-                    pblIteratorFree(it_l);
+                    printf("\n");
+                    //teoSScrFree(pblIteratorNext(it_l));
                 }
-                //pblListFree(sscr_map_data->list);
+                pblIteratorFree(it_l);
             }
-            pblIteratorFree(it);
+            //pblListFree(sscr_map_data->list);
         }
         //pblMapFree(sscr->map);
         //free(sscr);
@@ -411,17 +400,14 @@ int teoSScrUnSubscriptionAll(teoSScrClass *sscr, char *peer_name) {
 
     int retval = 0;
 
-    PblIterator *it = pblMapIteratorNew(sscr->map);
-    if(it != NULL) {
-
-        while(pblIteratorHasNext(it)) {
-
-            void *entry = pblIteratorNext(it);
+    teoHashMapIter it;
+    teoHashMapEntry *entry;
+    teoHashMapIterInit(sscr->map, &it);
+    while((entry = teoHashMapIterNext(&it))) {
 
-            uint16_t *ev = (uint16_t *) pblMapEntryKey(entry);
-            retval += teoSScrUnSubscription(sscr, peer_name, *ev);
-        }
-        pblIteratorFree(it);
+        uint16_t ev;
+        memcpy(&ev, entry->key, sizeof(ev));
+        retval += teoSScrUnSubscription(sscr, peer_name, ev);
     }
 
     return retval;
@@ -464,31 +450,27 @@ void teoSScrDestroy(teoSScrClass *sscr) {
 
     if(sscr != NULL) {
 
-        PblIterator *it =  pblMapIteratorNew(sscr->map);
-        if(it != NULL) {
-
-            while(pblIteratorHasNext(it)) {
+        teoHashMapIter it;
+        teoHashMapEntry *entry;
+        teoHashMapIterInit(sscr->map, &it);
+        while((entry = teoHashMapIterNext(&it))) {
 
-                void *entry = pblIteratorNext(it);
-                teoSScrMapData *sscr_map_data = pblMapEntryValue(entry);
+            teoSScrMapData *sscr_map_data = entry->data;
 
-                // Loop list and destroy all loaded modules
-                PblIterator *it_l =  pblListIterator(sscr_map_data->list);
-                if(it_l != NULL) {
+            // Loop list and destroy all loaded modules
+            PblIterator *it_l =  pblListIterator(sscr_map_data->list);
+            if(it_l != NULL) {
 
-                    while(pblIteratorHasNext(it_l)) {
+                while(pblIteratorHasNext(it_l)) {
 
-                        teoSScrFree(pblIteratorNext(it_l));
-                    }
-                    pblIteratorFree(it_l);
+                    teoSScrFree(pblIteratorNext(it_l));
                 }
-
-                pblListFree(sscr_map_data->list);
+                pblIteratorFree(it_l);
             }
 
-            pblIteratorFree(it);
+            pblListFree(sscr_map_data->list);
         }
-        pblMapFree(sscr->map);
+        teoHashMapFree(sscr->map);
         free(sscr);
     }
 }
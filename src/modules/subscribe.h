@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <pbl.h>
 
+#include "utils/teo_hashmap.h"
 #include "teonet_l0_client.h"
 
 /**
@@ -19,7 +20,7 @@
 typedef struct teoSScrClass {
     
     void *ke; ///< Pointer to ksnetEvMgrClass
-    PblMap *map; ///< Pointer to the subscribers map
+    teoHashMap *map; ///< Pointer to the subscribers map
     
 } teoSScrClass;
 
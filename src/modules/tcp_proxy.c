@@ -134,8 +134,14 @@ ssize_t teo_recvfrom (ksnetEvMgrClass* ke,
 
     ssize_t recvlen = 0; 
 
+    // Get data from transport shim
+    if(ke->transport != NULL) {
+        recvlen = ke->transport->recvfrom(ke->transport->user_data,
+                buffer, buffer_len, addr, addr_len);
+    }
+
     // Get data from TCP Proxy buffer 
-    if(!fd && ke->teo_cfg.r_tcp_f && ke->tp->fd_client > 0) {
+    else if(!fd && ke->teo_cfg.r_tcp_f && ke->tp->fd_client > 0) {
         
         if(buffer_len >= ke->tp->packet.header->packet_length) {
 
@@ -201,8 +207,14 @@ ssize_t teo_sendto (ksnetEvMgrClass* ke,
     
     ssize_t sendlen = 0;
 
+    // Sent data to transport shim
+    if(ke->transport != NULL) {
+        sendlen = ke->transport->sendto(ke->transport->user_data,
+                buffer, buffer_len, addr, addr_len);
+    }
+
     // Sent data to TCP Proxy
-    if(ke->teo_cfg.r_tcp_f && ke->tp->fd_client > 0) {
+    else if(ke->teo_cfg.r_tcp_f && ke->tp->fd_client > 0) {
         // Send TCP package
         sendlen = ksnTCPProxySendTo(ke, CMD_TCPP_PROXY, buffer, buffer_len, addr);
         
@@ -39,9 +39,18 @@ ksnTDBClass *ksnTDBinit(void *ke) {
     kf->k = NULL;
     kf->ke = ke;
 
+    kf->def = NULL;
+    kf->cache = pblMapNewHashMap();
+    kf->first = kf->last = NULL;
+    kf->cache_num = 0;
+    kf->cache_size = TDB_CACHE_SIZE;
+    kf->flush_writes = TDB_FLUSH_WRITES;
+
     return kf;
 }
 
+static void tdb_close(ksnTDBClass *kf, ksnTDBhandle *h);
+
 /**
  * Destroy PBL KeyFile module
  *
@@ -51,10 +60,115 @@ inline void ksnTDBdestroy(ksnTDBClass *kf) {
 
     if(kf != NULL) {
         ksnTDBnamespaceSet(kf, NULL);
+        while(kf->first != NULL) tdb_close(kf, kf->first);
+        pblMapFree(kf->cache);
         free(kf);
     }
 }
 
+/**
+ * Get data by key from key file
+ *
+ * @param k Opened key file or NULL
+ * @param key Binary key
+ * @param key_len Key length
+ * @param data_len [out] Length of data
+ *
+ * @return Pointer to data with data_len length or NULL if not found,
+ *         should be free after use
+ */
+static void *tdb_get(pblKeyFile_t *k, const void *key, size_t key_len,
+        size_t *data_len) {
+
+    *data_len = 0;
+    void *data = NULL;
+    char okey[KSN_BUFFER_SM_SIZE];
+    size_t okey_len = KSN_BUFFER_SM_SIZE;
+
+    if(k != NULL) {
+
+        long rc = pblKfFind(k, PBLLA, (void*) key, key_len,
+                (void*) okey, &okey_len);
+
+	if (rc == 0) {
+	    data = strdup(""); // Return empty string if data length equal to 0
+	    return data;
+	}
+
+	if (rc > 0) {
+	    *data_len = rc;
+            data = malloc(rc);
+            pblKfRead(k, data, rc);
+	}
+    }
+
+    return data;
+}
+
+/**
+ * Add (insert or update) data by key to key file
+ *
+ * @param k Opened key file or NULL
+ * @param key Binary key
+ * @param key_len Key length
+ * @param data Pointer to data
+ * @param data_len Data length
+ *
+ * @return 0: call went OK; or an error if != 0
+ */
+static int tdb_set(pblKeyFile_t *k, const void *key, size_t key_len,
+        void *data, size_t data_len) {
+
+    int retval = -1;
+
+    if(k != NULL) {              
+        // \todo Check key & data, and may be do delete record if data == NULL 
+        
+        if(key != NULL && data != NULL) {
+            
+            char okey[KSN_BUFFER_SM_SIZE];
+            size_t okey_len = KSN_BUFFER_SM_SIZE;
+
+            // Check if record exists
+            long rc = pblKfFind(k, PBLLA, (void*) key, key_len, 
+                    (void*) okey, &okey_len);
+            
+            // Update or insert record
+            if(rc >= 0) retval = pblKfUpdate(k, data, data_len);
+            else retval = pblKfInsert(k, (void*) key, key_len, data, data_len);
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * Delete all records with key from key file
+ *
+ * @param k Opened key file or NULL
+ * @param key Binary key
+ * @param key_len Key length
+ *
+ * @return 0: call went OK; != 0 if key not found or some error occurred
+ */
+static int tdb_delete(pblKeyFile_t *k, const void *key, size_t key_len) {
+
+    int retval = -1;
+
+    if(k != NULL) {
+
+        void *data;
+        size_t data_len;
+        while((data = tdb_get(k, key, key_len, &data_len)) != NULL) {
+            pblKfDelete(k);
+            free(data);
+            retval = 0;
+        }
+    }
+
+    return retval;
+}
+
 #define get_file_path(namespace) \
         char path[PATH_MAX], *data_path = (char*)getDataPath(); \
         mkdir(data_path, 0755); \
@@ -62,46 +176,183 @@ inline void ksnTDBdestroy(ksnTDBClass *kf) {
         strncat(path, "/", PATH_MAX - strlen(path) - 1); \
         strncat(path, namespace, PATH_MAX - strlen(path) - 1)
 
+/**
+ * Set namespace key files cache parameters
+ *
+ * @param kf Pointer to ksnTDBClass
+ * @param cache_size Max number of open namespace key files besides default
+ *        namespace, 0 - close key file after each namespaced operation
+ * @param flush_writes Flush namespace key file after this number of writes
+ *        by namespaced operations, 0 - flush when key file is closed or
+ *        ksnTDBflush called
+ */
+void ksnTDBcacheSet(ksnTDBClass *kf, size_t cache_size, size_t flush_writes) {
+
+    kf->cache_size = cache_size;
+    kf->flush_writes = flush_writes;
+}
+
+/**
+ * Set key files block I/O parameters
+ *
+ * The parameters are common for all key files of the process.
+ *
+ * @param kf Pointer to ksnTDBClass
+ * @param block_cache Number of blocks in block cache shared by all open key
+ *        files, 0 - use cache of default size for each open key file
+ * @param read_ahead Number of blocks read ahead during ksnTDBkeyList scans,
+ *        0 - off
+ * @param sync_mode Durability mode: 0 - no fsync, 1 - fsync on flush once in
+ *        sync_interval seconds, 2 - fsync on each flush
+ * @param sync_interval Sync interval in seconds for sync_mode 1
+ */
+void ksnTDBioSet(ksnTDBClass *kf, long block_cache, int read_ahead,
+        int sync_mode, long sync_interval) {
+
+    (void)kf;
+    pblKfSetCacheBlocks(block_cache);
+    pblKfSetReadAhead(read_ahead);
+    // Wrong sync mode switches sync off
+    if(pblKfSetSync(sync_mode, sync_interval))
+        pblKfSetSync(PBL_KF_SYNC_NONE, 0);
+}
+
+/**
+ * Close cached key file
+ *
+ * @param kf Pointer to ksnTDBClass
+ * @param h Pointer to ksnTDBhandle
+ */
+static void tdb_close(ksnTDBClass *kf, ksnTDBhandle *h) {
+
+    size_t len;
+
+    if(h->prev != NULL) h->prev->next = h->next;
+    else kf->first = h->next;
+    if(h->next != NULL) h->next->prev = h->prev;
+    else kf->last = h->prev;
+    kf->cache_num--;
+
+    pblMapRemoveFree(kf->cache, h->ns, strlen(h->ns) + 1, &len);
+    pblKfClose(h->k);
+    free(h->ns);
+    free(h);
+}
+
+/**
+ * Close least recently used key files while cache is bigger than allowed
+ *
+ * @param kf Pointer to ksnTDBClass
+ */
+static void tdb_evict(ksnTDBClass *kf) {
+
+    ksnTDBhandle *h = kf->last;
+    size_t max_num = kf->cache_size + (kf->def != NULL);
+
+    while(kf->cache_num > max_num && h != NULL) {
+        ksnTDBhandle *prev = h->prev;
+        if(h != kf->def) tdb_close(kf, h);
+        h = prev;
+    }
+}
+
+/**
+ * Get open key file of namespace
+ *
+ * Return cached key file or open (create) it and add to cache.
+ *
+ * @param kf Pointer to ksnTDBClass
+ * @param namespace String with namespace
+ *
+ * @return Pointer to ksnTDBhandle or NULL at error
+ */
+static ksnTDBhandle *tdb_handle(ksnTDBClass *kf, const char *namespace) {
+
+    size_t len;
+    ksnTDBhandle **hp = pblMapGet(kf->cache, (void*)namespace,
+            strlen(namespace) + 1, &len);
+    ksnTDBhandle *h;
+
+    // Move cached key file to the top of LRU list
+    if(hp != NULL) {
+        h = *hp;
+        if(h != kf->first) {
+            h->prev->next = h->next;
+            if(h->next != NULL) h->next->prev = h->prev;
+            else kf->last = h->prev;
+            h->prev = NULL;
+            h->next = kf->first;
+            kf->first->prev = h;
+            kf->first = h;
+        }
+        return h;
+    }
+
+    // File path name
+    get_file_path(namespace);
+
+    // Open if file exists or create
+    pblKeyFile_t *k = access(path, F_OK) != -1 ? pblKfOpen(path, 1, NULL) :
+            pblKfCreate(path, NULL);
+    if(k == NULL) return NULL;
+
+    h = malloc(sizeof(ksnTDBhandle));
+    h->ns = strdup(namespace);
+    h->k = k;
+    h->writes = 0;
+    h->prev = NULL;
+    h->next = kf->first;
+    if(kf->first != NULL) kf->first->prev = h;
+    else kf->last = h;
+    kf->first = h;
+    kf->cache_num++;
+    pblMapAdd(kf->cache, (void*)namespace, strlen(namespace) + 1, &h,
+            sizeof(h));
+
+    return h;
+}
+
+/**
+ * Count write to namespace key file and flush it by flush policy
+ *
+ * @param kf Pointer to ksnTDBClass
+ * @param h Pointer to ksnTDBhandle
+ */
+static void tdb_written(ksnTDBClass *kf, ksnTDBhandle *h) {
+
+    if(kf->flush_writes && ++h->writes >= kf->flush_writes) {
+        pblKfFlush(h->k);
+        h->writes = 0;
+    }
+}
+
 /**
  * Set current namespace
  *
  * Set namespace to use in ksnTdbGet, ksnTdbSet and ksnTdbDelete functions
- * to get, set or delete data without select namespace.
+ * to get, set or delete data without select namespace. Key file of previous
+ * namespace is kept open in namespaces cache.
  *
  * @param kf Pointer to ksnTDBClass
  * @param namespace String with namespace
  */
 void ksnTDBnamespaceSet(ksnTDBClass *kf, const char* namespace) {
 
-    // Free current namespace and close PBL KeyFile
+    // Free current namespace
     if(kf->defNameSpace != NULL) free(kf->defNameSpace);
-    if(kf->k != NULL) {
-        pblKfClose(kf->k);
-        kf->k = NULL;
-    }
+    kf->def = NULL;
+    kf->k = NULL;
 
     // Set namespace and open (or create) PBL KeyFile
     if(namespace != NULL) {
 
         kf->defNameSpace = strdup(namespace);
-
-        // File path name
-        get_file_path(namespace);
-
-        // If file exists
-        if(access(path, F_OK ) != -1 ) {
-
-            kf->k = pblKfOpen(path, 1, NULL);
-        }
-
-        // If file doesn't exist
-        else {
-
-            kf->k = pblKfCreate(path, NULL);
-        }
-
+        kf->def = tdb_handle(kf, namespace);
+        if(kf->def != NULL) kf->k = kf->def->k;
     }
     else kf->defNameSpace = NULL;
+
+    tdb_evict(kf);
 }
 
 /**
@@ -125,19 +376,33 @@ inline char *ksnTDBnamespaceGet(ksnTDBClass *kf) {
  */
 void ksnTDBnamespaceRemove(ksnTDBClass *kf, const char* namespace) {
 
+    size_t len;
     ksnTDBnamespaceSet(kf, NULL);
+    ksnTDBhandle **hp = pblMapGet(kf->cache, (void*)namespace,
+            strlen(namespace) + 1, &len);
+    if(hp != NULL) tdb_close(kf, *hp);
+
     get_file_path(namespace);
     remove(path); // Remove test file if exist
 }
 
 /**
- * Flush a key file
+ * Flush default namespace and cached namespaces key files
  * 
  * @param kf
- * @return 
+ * @return 0: call went OK; or an error if != 0
  */
-inline int ksnTDBflush(ksnTDBClass *kf) {
-    return pblKfFlush(kf->k);
+int ksnTDBflush(ksnTDBClass *kf) {
+
+    int retval = 0;
+    ksnTDBhandle *h;
+
+    for(h = kf->first; h != NULL; h = h->next) {
+        if(pblKfFlush(h->k)) retval = -1;
+        h->writes = 0;
+    }
+
+    return retval;
 }
 
 /**
@@ -169,29 +434,7 @@ inline void *ksnTDBgetStr(ksnTDBClass *kf, const char *key, size_t *data_len) {
 void *ksnTDBget(ksnTDBClass *kf, const void *key, size_t key_len, 
         size_t *data_len) {
 
-    *data_len = 0;
-    void *data = NULL;
-    char okey[KSN_BUFFER_SM_SIZE];
-    size_t okey_len = KSN_BUFFER_SM_SIZE;
-
-    if(kf->k != NULL) {
-
-        long rc = pblKfFind(kf->k, PBLLA, (void*) key, key_len,
-                (void*) okey, &okey_len);
-
-	if (rc == 0) {
-	    data = strdup(""); // Return empty string if data length equal to 0
-	    return data;
-	}
-
-	if (rc > 0) {
-	    *data_len = rc;
-            data = malloc(rc);
-            pblKfRead(kf->k, data, rc);
-	}
-    }
-
-    return data;
+    return tdb_get(kf->k, key, key_len, data_len);
 }
 
 /**
@@ -224,27 +467,7 @@ inline int ksnTDBsetStr(ksnTDBClass *kf, const char *key, void *data,
 int ksnTDBset(ksnTDBClass *kf, const void *key, size_t key_len, void *data,
         size_t data_len) {
 
-    int retval = -1;
-
-    if(kf->k != NULL) {              
-        // \todo Check key & data, and may be do delete record if data == NULL 
-        
-        if(key != NULL && data != NULL) {
-            
-            char okey[KSN_BUFFER_SM_SIZE];
-            size_t okey_len = KSN_BUFFER_SM_SIZE;
-
-            // Check if record exists
-            long rc = pblKfFind(kf->k, PBLLA, (void*) key, key_len, 
-                    (void*) okey, &okey_len);
-            
-            // Update or insert record
-            if(rc >= 0) retval = pblKfUpdate(kf->k, data, data_len);
-            else retval = pblKfInsert(kf->k, (void*) key, key_len, data, data_len);
-        }
-    }
-
-    return retval;
+    return tdb_set(kf->k, key, key_len, data, data_len);
 }
 
 /**
@@ -271,20 +494,7 @@ inline int ksnTDBdeleteStr(ksnTDBClass *kf, const char *key) {
  */
 int ksnTDBdelete(ksnTDBClass *kf, const void *key, size_t key_len) {
 
-    int retval = -1;
-
-    if(kf->k != NULL) {
-
-        void *data;
-        size_t data_len;
-        while((data=ksnTDBget(kf, key, key_len, &data_len)) != NULL) {
-            pblKfDelete(kf->k);
-            free(data);
-            retval = 0;
-        }
-    }
-
-    return retval;
+    return tdb_delete(kf->k, key, key_len);
 }
 
 /**
@@ -317,11 +527,9 @@ inline void *ksnTDBgetNsStr(ksnTDBClass *kf, const char *namespace, const char *
 void *ksnTDBgetNs(ksnTDBClass *kf, const char *namespace, const void *key, 
         size_t key_len, size_t *data_len) {
 
-    char *save_namespace = ksnTDBnamespaceGet(kf);
-    ksnTDBnamespaceSet(kf, namespace);
-    void *data = ksnTDBget(kf, key, key_len, data_len);
-    ksnTDBnamespaceSet(kf, save_namespace);
-    if(save_namespace != NULL) free(save_namespace);
+    ksnTDBhandle *h = tdb_handle(kf, namespace);
+    void *data = tdb_get(h ? h->k : NULL, key, key_len, data_len);
+    tdb_evict(kf);
 
     return data;
 }
@@ -358,11 +566,10 @@ inline int ksnTDBsetNsStr(ksnTDBClass *kf, const char *namespace, const char *ke
 int ksnTDBsetNs(ksnTDBClass *kf, const char *namespace, const void *key, 
         size_t key_len, void *data, size_t data_len) {
 
-    char *save_namespace = ksnTDBnamespaceGet(kf);
-    ksnTDBnamespaceSet(kf, namespace);
-    int retval = ksnTDBset(kf, key, key_len, data, data_len);
-    ksnTDBnamespaceSet(kf, save_namespace);
-    if(save_namespace != NULL) free(save_namespace);
+    ksnTDBhandle *h = tdb_handle(kf, namespace);
+    int retval = tdb_set(h ? h->k : NULL, key, key_len, data, data_len);
+    if(!retval) tdb_written(kf, h);
+    tdb_evict(kf);
 
     return retval;
 }
@@ -394,11 +601,10 @@ inline int ksnTDBdeleteNsStr(ksnTDBClass *kf, const char *namespace, const char
 int ksnTDBdeleteNs(ksnTDBClass *kf, const char *namespace, const void *key, 
         size_t key_len) {
 
-    char *save_namespace = ksnTDBnamespaceGet(kf);
-    ksnTDBnamespaceSet(kf, namespace);
-    int retval = ksnTDBdelete(kf, key, key_len);
-    ksnTDBnamespaceSet(kf, save_namespace);
-    if(save_namespace != NULL) free(save_namespace);
+    ksnTDBhandle *h = tdb_handle(kf, namespace);
+    int retval = tdb_delete(h ? h->k : NULL, key, key_len);
+    if(!retval) tdb_written(kf, h);
+    tdb_evict(kf);
 
     return retval;
 }
@@ -12,6 +12,22 @@
 
 #include "utils/string_arr.h"
 
+#define TDB_CACHE_SIZE 16   ///< Default number of cached namespace key files
+#define TDB_FLUSH_WRITES 1  ///< Default number of writes between key file flushes
+
+/**
+ * Cached open namespace key file
+ */
+typedef struct ksnTDBhandle {
+
+    char *ns; ///< Namespace
+    pblKeyFile_t *k; ///< Opened key file
+    size_t writes; ///< Number of writes since last flush
+    struct ksnTDBhandle *prev; ///< More recently used handle
+    struct ksnTDBhandle *next; ///< Less recently used handle
+
+} ksnTDBhandle;
+
 /**
  * PBL KeyFile data 
  */
@@ -20,6 +36,14 @@ typedef struct ksnTDBClass {
     void *ke; ///< Pointer to the ksnEvMgrClass
     char* defNameSpace; ///< Default namespace
     pblKeyFile_t* k; ///< Opened key file or NULL;
+
+    ksnTDBhandle *def; ///< Default namespace handle (never evicted) or NULL
+    PblMap *cache; ///< Namespace -> ksnTDBhandle*
+    ksnTDBhandle *first; ///< Most recently used handle
+    ksnTDBhandle *last; ///< Least recently used handle
+    size_t cache_num; ///< Number of open key files
+    size_t cache_size; ///< Max number of open key files besides default, 0 - close after use
+    size_t flush_writes; ///< Flush namespace key file after this number of writes, 0 - on close only
     
 } ksnTDBClass;
 
@@ -30,6 +54,9 @@ extern "C" {
 
 ksnTDBClass *ksnTDBinit(void *ke);
 void ksnTDBdestroy(ksnTDBClass *kf);
+void ksnTDBcacheSet(ksnTDBClass *kf, size_t cache_size, size_t flush_writes);
+void ksnTDBioSet(ksnTDBClass *kf, long block_cache, int read_ahead,
+        int sync_mode, long sync_interval);
 
 void ksnTDBnamespaceSet(ksnTDBClass *kf, const char* ns);
 char *ksnTDBnamespaceGet(ksnTDBClass *kf);
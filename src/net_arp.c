@@ -10,8 +10,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
 
 #include "ev_mgr.h"
+#include "modules/subscribe.h"
 #include "utils/rlutil.h"
 #include "utils/utils.h"
 #include "utils/teo_memory.h"
@@ -21,6 +26,130 @@
 /*                                                                            */
 /******************************************************************************/
 
+#define ARP_ADDR_KEY_SIZE (sizeof(uint16_t) * 2 + sizeof(struct in6_addr))
+
+/**
+ * Make binary address index key: family, port and IPv4 or IPv6 address
+ *
+ * IPv4-mapped IPv6 address is stored as IPv4 address.
+ *
+ * @param key Buffer of ARP_ADDR_KEY_SIZE bytes
+ * @param family AF_INET or AF_INET6
+ * @param addr Pointer to struct in_addr or struct in6_addr
+ * @param port Port
+ *
+ * @return Key length
+ */
+static size_t arp_addr_key(uint8_t *key, int family, const void *addr,
+        uint16_t port) {
+
+    size_t addr_len = family == AF_INET ? sizeof(struct in_addr) :
+            sizeof(struct in6_addr);
+
+    if(family == AF_INET6 && IN6_IS_ADDR_V4MAPPED((struct in6_addr *)addr)) {
+        family = AF_INET;
+        addr = (const uint8_t *)addr + 12;
+        addr_len = sizeof(struct in_addr);
+    }
+
+    uint16_t f = family;
+    memcpy(key, &f, sizeof(f));
+    memcpy(key + sizeof(f), &port, sizeof(port));
+    memcpy(key + sizeof(f) + sizeof(port), addr, addr_len);
+
+    return sizeof(f) + sizeof(port) + addr_len;
+}
+
+/**
+ * Make binary address index key from address string
+ *
+ * @return Key length or 0 if address is not IPv4 or IPv6 address
+ */
+static size_t arp_addr_key_str(uint8_t *key, const char *addr, int port) {
+
+    uint8_t buf[sizeof(struct in6_addr)];
+
+    if(inet_pton(AF_INET, addr, buf) == 1)
+        return arp_addr_key(key, AF_INET, buf, port);
+    if(inet_pton(AF_INET6, addr, buf) == 1)
+        return arp_addr_key(key, AF_INET6, buf, port);
+
+    return 0;
+}
+
+/**
+ * Make binary address index key from socket address
+ *
+ * @return Key length or 0 if address family is not AF_INET or AF_INET6
+ */
+static size_t arp_addr_key_sa(uint8_t *key, const struct sockaddr *sa) {
+
+    switch(sa->sa_family) {
+        case AF_INET: {
+            const struct sockaddr_in *sin = (const struct sockaddr_in *)sa;
+            return arp_addr_key(key, AF_INET, &sin->sin_addr,
+                    ntohs(sin->sin_port));
+        }
+        case AF_INET6: {
+            const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)sa;
+            return arp_addr_key(key, AF_INET6, &sin6->sin6_addr,
+                    ntohs(sin6->sin6_port));
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Add peer to address index
+ *
+ * The last added peer owns the address if several peers have the same one.
+ */
+static void arp_index_add(ksnetArpClass *ka, const char *name,
+        ksnet_arp_data *data) {
+
+    uint8_t key[ARP_ADDR_KEY_SIZE];
+    size_t key_len = arp_addr_key_str(key, data->addr, data->port);
+    if(key_len) teoHashMapAdd(ka->by_addr, key, key_len, name,
+            strlen(name) + 1);
+}
+
+/**
+ * Remove peer from address index if the address is owned by this peer
+ *
+ * Other peer with the same address becomes the address owner.
+ */
+static void arp_index_remove(ksnetArpClass *ka, const char *name,
+        ksnet_arp_data *data) {
+
+    uint8_t key[ARP_ADDR_KEY_SIZE], peer_key[ARP_ADDR_KEY_SIZE];
+    size_t key_len = arp_addr_key_str(key, data->addr, data->port);
+    if(!key_len) return;
+
+    teoHashMapEntry *owner = teoHashMapGetEntry(ka->by_addr, key, key_len);
+    if(owner == NULL || strcmp(owner->data, name)) return;
+    teoHashMapRemoveEntry(ka->by_addr, owner);
+
+    PblIterator *it = pblMapIteratorNew(ka->map);
+    if(it != NULL) {
+        while(pblIteratorHasNext(it)) {
+            void *entry = pblIteratorNext(it);
+            char *peer_name = pblMapEntryKey(entry);
+            ksnet_arp_data *peer = pblMapEntryValue(entry);
+            if(!strcmp(peer_name, name)) continue;
+            if(arp_addr_key_str(peer_key, peer->addr, peer->port) == key_len &&
+               !memcmp(peer_key, key, key_len)) {
+                teoHashMapAdd(ka->by_addr, key, key_len, peer_name,
+                        strlen(peer_name) + 1);
+                break;
+            }
+        }
+        pblIteratorFree(it);
+    }
+}
+
+static void arp_push_cb(EV_P_ ev_prepare *w, int revents);
+
 /**
  * Initialize ARP table
  */
@@ -28,10 +157,19 @@ ksnetArpClass *ksnetArpInit(void *ke) {
 
     #define kev ((ksnetEvMgrClass*)(ke))
 
-    ksnetArpClass *ka = teo_malloc(sizeof(ksnetArpClass));
+    ksnetArpClass *ka = teo_calloc(sizeof(ksnetArpClass));
     ka->map = pblMapNewHashMap();
+    ka->by_addr = teoHashMapNew();
     ka->ke = ke;
 
+    // Peers table changes
+    ka->epoch = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+    if(!ka->epoch) ka->epoch = 1;
+    ka->log = teo_calloc(TEO_ARP_LOG_SIZE * sizeof(teoArpChange));
+    ev_prepare_init(&ka->push_w, arp_push_cb);
+    ka->push_w.data = ka;
+    ev_prepare_start(kev->ev_loop, &ka->push_w);
+
     ksnetArpAddHost(ka);
 
     return ka;
@@ -43,6 +181,11 @@ ksnetArpClass *ksnetArpInit(void *ke) {
  * Destroy ARP table
  */
 void ksnetArpDestroy(ksnetArpClass *ka) {
+    ev_prepare_stop(((ksnetEvMgrClass*)ka->ke)->ev_loop, &ka->push_w);
+    free(ka->cache_bin.data);
+    free(ka->cache_json.data);
+    free(ka->log);
+
     PblIterator *it =  pblMapIteratorNew(ka->map);
 
     if(it != NULL) {
@@ -57,6 +200,7 @@ void ksnetArpDestroy(ksnetArpClass *ka) {
     }
 
     pblMapFree(ka->map);
+    teoHashMapFree(ka->by_addr);
     free(ka);
 }
 
@@ -85,6 +229,39 @@ int ksnetArpSize(ksnetArpClass *ka) {
     return pblMapSize(ka->map);
 }
 
+/**
+ * Register peers table change
+ *
+ * @param ka Pointer to ksnetArpClass
+ * @param name Peer name
+ * @param op Change operation teoArpOp
+ */
+static void arp_changed(ksnetArpClass *ka, const char *name, uint8_t op) {
+
+    teoArpChange *ch = &ka->log[++ka->version % TEO_ARP_LOG_SIZE];
+    ch->version = ka->version;
+    ch->op = op;
+    strncpy(ch->name, name, sizeof(ch->name) - 1);
+    ch->name[sizeof(ch->name) - 1] = '\0';
+}
+
+/**
+ * Check if peer data visible in peers list was changed
+ *
+ * Trip time, monitor time and CQue id changes are not counted.
+ *
+ * @return True if changed
+ */
+static int arp_data_changed(ksnet_arp_data_ext *arp, ksnet_arp_data_ext *data) {
+
+    if(arp == data) return 0;
+
+    return arp->data.mode != data->data.mode ||
+           arp->data.port != data->data.port ||
+           strcmp(arp->data.addr, data->data.addr) ||
+           strcmp(arp->type ? arp->type : "", data->type ? data->type : "");
+}
+
 /**
  * Add or update record in KSNet Peer ARP table
  *
@@ -93,11 +270,30 @@ int ksnetArpSize(ksnetArpClass *ka) {
  * @param data
  */
 void ksnetArpAdd(ksnetArpClass *ka, char* name, ksnet_arp_data_ext *data) {
+    ksnetEvMgrClass *ke = ka->ke;
+
+    size_t val_len;
+    ksnet_arp_data_ext *arp = pblMapGetStr(ka->map, name, &val_len);
+    uint8_t op = arp == NULL ? TEO_ARP_ADD :
+            arp_data_changed(arp, data) ? TEO_ARP_UPDATE : 0;
+    int addr_changed_f = arp == NULL || (arp != data &&
+            (arp->data.port != data->data.port ||
+             strcmp(arp->data.addr, data->data.addr)));
+    if(arp != NULL && addr_changed_f) arp_index_remove(ka, name, &arp->data);
+
     pblMapAdd(
         ka->map,
         (void *) name, strlen(name) + 1,
         data, sizeof(*data)
     );
+    if(addr_changed_f) arp_index_add(ka, name, &data->data);
+    if(op) arp_changed(ka, name, op);
+
+    // Peers telemetry record (skip this host)
+    if(data->data.mode >= 0 && ke->kc != NULL) {
+        teoPeerTelemetryAdd(ke->kc->kpt, name, data->data.addr,
+                data->data.port);
+    }
 }
 
 /**
@@ -144,13 +340,27 @@ void *ksnetArpSetHostPort(ksnetArpClass *ka, char* name, int port) {
 
     ksnet_arp_data* arp = pblMapGetStr(ka->map, name, &valueLength);
 
-    if(arp != NULL) {
+    if(arp != NULL && arp->port != port) {
+        arp_index_remove(ka, name, arp);
         arp->port = port;
+        arp_index_add(ka, name, arp);
+        arp_changed(ka, name, TEO_ARP_UPDATE);
     }
 
     return arp;
 }
 
+/**
+ * Register change of peer data made directly in ARP table record
+ *
+ * @param ka Pointer to ksnetArpClass
+ * @param name Peer name
+ */
+void teoArpUpdated(ksnetArpClass *ka, char *name) {
+
+    if(ksnetArpGet(ka, name) != NULL) arp_changed(ka, name, TEO_ARP_UPDATE);
+}
+
 /**
  * Remove Peer from the ARP table
  *
@@ -176,6 +386,12 @@ int ksnetArpRemove(ksnetArpClass *ka, char* name) {
 
         // Remove from Stream module
         ksnStreamClosePeer(((ksnetEvMgrClass*) ka->ke)->ks, peer_name);
+
+        // Remove peers telemetry record
+        teoPeerTelemetryRemove(((ksnetEvMgrClass*) ka->ke)->kc->kpt, peer_name);
+
+        if(arp) arp_index_remove(ka, peer_name, &arp->data);
+        arp_changed(ka, peer_name, TEO_ARP_REMOVE);
     }
 
     // If not found
@@ -214,9 +430,14 @@ void ksnetArpRemoveAll(ksnetArpClass *ka) {
     }
 
     pblMapFree(ka->map);
+    teoHashMapClear(ka->by_addr);
     ke->teo_cfg.r_host_name[0] = '\0';
     ka->map = pblMapNewHashMap();
+
+    // Changes before this host is added again are not available as delta
+    ka->reset_version = ka->version + 1;
     ksnetArpAddHost(ka);
+    teoPeerTelemetryRemoveAll(ke->kc->kpt);
     trudpChannelDestroyAll(ke->kc->ku);
 }
 
@@ -278,55 +499,55 @@ inline int ksnetArpGetAllH(ksnetArpClass *ka, peer_callback cb, void *data) {
     return ksnetArpGetAll_(ka, cb, data, 1);
 }
 
-typedef struct find_arp_data {
-
-  __CONST_SOCKADDR_ARG addr;
-  ksnet_arp_data *arp_data;
-  char *peer_name;
-
-} find_arp_data;
-
-int find_arp_by_addr_cb(ksnetArpClass *ka, char *peer_name,
-            ksnet_arp_data_ext *arp, void *data) {
-
-    int retval = 0;
-    find_arp_data *fa = data;
+/**
+ * Find ARP data by address
+ *
+ * @param ka Pointer to ksnetArpClass
+ * @param addr Address
+ * @param peer_name [out] Peer name (may be null)
+ *
+ * @return  Pointer to ARP data or NULL if not found
+ */
+ksnet_arp_data *ksnetArpFindByAddr(ksnetArpClass *ka, __CONST_SOCKADDR_ARG addr,
+        char **peer_name) {
 
-    addr_port_t *ap_obj = wrap_inet_ntop(fa->addr);
+    uint8_t key[ARP_ADDR_KEY_SIZE];
+    size_t key_len = ka != NULL ? arp_addr_key_sa(key, addr) : 0;
+    if(!key_len) return NULL;
 
-    if(ap_obj->equal(ap_obj, arp->data.addr, arp->data.port) == 1) {
-        fa->arp_data = (ksnet_arp_data *)arp;
-        fa->peer_name = peer_name;
-        retval = 1;
-    }
+    char *name = teoHashMapGet(ka->by_addr, key, key_len, NULL);
+    if(name == NULL) return NULL;
 
-    addr_port_free(ap_obj);
+    ksnet_arp_data_ext *arp = ksnetArpGet(ka, name);
+    if(arp != NULL && peer_name) *peer_name = name;
 
-    return retval;
+    return (ksnet_arp_data *)arp;
 }
 
 /**
- * Find ARP data by address
+ * Find ARP data by address string and port
  *
  * @param ka Pointer to ksnetArpClass
- * @param addr Address
+ * @param addr IPv4 or IPv6 address string
+ * @param port Port
  * @param peer_name [out] Peer name (may be null)
  *
  * @return  Pointer to ARP data or NULL if not found
  */
-ksnet_arp_data *ksnetArpFindByAddr(ksnetArpClass *ka, __CONST_SOCKADDR_ARG addr,
-        char **peer_name) {
+ksnet_arp_data *ksnetArpFindByAddrStr(ksnetArpClass *ka, const char *addr,
+        int port, char **peer_name) {
 
-    find_arp_data fa = { .addr = addr, .arp_data = NULL, .peer_name = NULL };
-    ksnet_arp_data *retval = NULL;
+    uint8_t key[ARP_ADDR_KEY_SIZE];
+    size_t key_len = ka != NULL ? arp_addr_key_str(key, addr, port) : 0;
+    if(!key_len) return NULL;
 
-    if(ka != NULL && ksnetArpGetAllH(ka, find_arp_by_addr_cb, (void*) &fa)) {
+    char *name = teoHashMapGet(ka->by_addr, key, key_len, NULL);
+    if(name == NULL) return NULL;
 
-        retval = fa.arp_data;
-        if(peer_name) *peer_name = fa.peer_name;
-    }
+    ksnet_arp_data_ext *arp = ksnetArpGet(ka, name);
+    if(arp != NULL && peer_name) *peer_name = name;
 
-    return retval;
+    return (ksnet_arp_data *)arp;
 }
 
 /**
@@ -515,6 +736,238 @@ inline size_t teoArpGetExtendedArpTableLength(ksnet_arp_data_ext_ar *peers_data)
     return out;
 }
 
+/**
+ * Get cached CMD_PEERS answer
+ *
+ * The snapshot is built once and reused until peers table is changed. Peers
+ * trip time is changed without table version change, so the snapshot is also
+ * rebuilt when it is older than TEO_ARP_CACHE_TTL.
+ *
+ * @param ka Pointer to ksnetArpClass
+ * @param json_f Get JSON snapshot if true, ksnet_arp_data_ext_ar otherwise
+ * @param length [out] Snapshot length
+ *
+ * @return Pointer to snapshot owned by ksnetArpClass, valid until next ARP
+ * table call
+ */
+const void *teoArpGetCachedTable(ksnetArpClass *ka, int json_f,
+        size_t *length) {
+
+    teoArpCache *cache = json_f ? &ka->cache_json : &ka->cache_bin;
+    double now = ksnetEvMgrGetTime(ka->ke);
+
+    if(cache->data == NULL || cache->version != ka->version ||
+       now - cache->time > TEO_ARP_CACHE_TTL) {
+
+        free(cache->data);
+        ksnet_arp_data_ext_ar *peers_data = teoArpGetExtendedArpTable(ka);
+        if(json_f) {
+            cache->data = teoArpGetExtendedArpTable_json(peers_data,
+                    &cache->data_len);
+            free(peers_data);
+        } else {
+            cache->data = peers_data;
+            cache->data_len = ARP_TABLE_DATA_LENGTH(peers_data);
+        }
+        cache->version = ka->version;
+        cache->time = now;
+    }
+
+    if(length != NULL) *length = cache->data_len;
+
+    return cache->data;
+}
+
+/**
+ * Add peer record to peers table delta
+ *
+ * @param dh Pointer to delta buffer, may be reallocated
+ * @param length [in/out] Delta length
+ * @param op Change operation teoArpOp
+ * @param version Version of last peer change
+ * @param name Peer name
+ * @param arp Peer data or NULL for removed peer
+ * @param now Current time
+ */
+static void arp_delta_add(teoArpDeltaHeader **dh, size_t *length, uint8_t op,
+        uint32_t version, const char *name, ksnet_arp_data_ext *arp,
+        double now) {
+
+    const char *type = arp != NULL && arp->type != NULL ? arp->type : "";
+    size_t rec_len = (sizeof(teoArpDelta) + strlen(type) + 1 + 7) & ~(size_t)7;
+
+    *dh = teo_realloc(*dh, *length + rec_len);
+    teoArpDelta *rec = (teoArpDelta *)((char*)*dh + *length);
+    memset(rec, 0, rec_len);
+    rec->length = rec_len;
+    rec->op = op;
+    rec->version = version;
+    strncpy(rec->name, name, sizeof(rec->name) - 1);
+    if(arp != NULL) {
+        memcpy(&rec->data, &arp->data, sizeof(rec->data));
+        rec->data.connected_time = now - arp->data.connected_time;
+    }
+    strcpy(rec->type, type);
+
+    *length += rec_len;
+    (*dh)->length++;
+}
+
+/**
+ * Get peers table changes since version
+ *
+ * Changes of each peer are collapsed into one record with current peer data.
+ * The full table is returned when the changes are not available: version is
+ * 0, epoch is different, the table was cleared or more than TEO_ARP_LOG_SIZE
+ * changes were made since the version.
+ *
+ * @param ka Pointer to ksnetArpClass
+ * @param epoch Table epoch from previous answer
+ * @param version Table version from previous answer
+ * @param length [out] Delta length
+ *
+ * @return Pointer to teoArpDeltaHeader, should be free after use
+ */
+teoArpDeltaHeader *teoArpGetDelta(ksnetArpClass *ka, uint32_t epoch,
+        uint32_t version, size_t *length) {
+
+    double now = ksnetEvMgrGetTime(ka->ke);
+    size_t len = sizeof(teoArpDeltaHeader);
+    teoArpDeltaHeader *dh = teo_calloc(len);
+    dh->epoch = ka->epoch;
+    dh->version = ka->version;
+
+    int full_f = !version || epoch != ka->epoch ||
+            version < ka->reset_version || version > ka->version ||
+            ka->version - version > TEO_ARP_LOG_SIZE;
+
+    // Full table
+    if(full_f) {
+        PblIterator *it = pblMapIteratorNew(ka->map);
+        if(it != NULL) {
+            while(pblIteratorHasNext(it)) {
+                void *entry = pblIteratorNext(it);
+                arp_delta_add(&dh, &len, TEO_ARP_ADD, ka->version,
+                        pblMapEntryKey(entry), pblMapEntryValue(entry), now);
+            }
+            pblIteratorFree(it);
+        }
+    }
+
+    // Changes since version, one record per changed peer
+    else if(version != ka->version) {
+        dh->from_version = version;
+        teoHashMap *seen = teoHashMapNew();
+        uint32_t v;
+        for(v = version + 1; v != ka->version + 1; v++) {
+            teoArpChange *ch = &ka->log[v % TEO_ARP_LOG_SIZE];
+
+            // Next change of the peer: set its record version
+            size_t *rec_ptr = teoHashMapGetStr(seen, ch->name, NULL);
+            if(rec_ptr != NULL) {
+                ((teoArpDelta *)((char*)dh + *rec_ptr))->version = ch->version;
+                continue;
+            }
+            teoHashMapAddStr(seen, ch->name, &len, sizeof(len));
+
+            ksnet_arp_data_ext *arp = ksnetArpGet(ka, ch->name);
+            arp_delta_add(&dh, &len, arp == NULL ? TEO_ARP_REMOVE :
+                    ch->op == TEO_ARP_ADD ? TEO_ARP_ADD : TEO_ARP_UPDATE,
+                    ch->version, ch->name, arp, now);
+        }
+        teoHashMapFree(seen);
+    }
+    else dh->from_version = version;
+
+    if(length != NULL) *length = len;
+
+    return dh;
+}
+
+/**
+ * Convert peers table delta to JSON
+ *
+ * @param delta Pointer to teoArpDeltaHeader
+ * @param length [out] Result json string length
+ *
+ * @return String with delta in JSON format. Should be free after use
+ */
+char *teoArpDeltaJson(teoArpDeltaHeader *delta, size_t *length) {
+
+    static const char *op_str[] = { "", "add", "update", "remove" };
+    const size_t rec_json_len = 192 + ARP_TABLE_NAME_SIZE + ARP_TABLE_IP_SIZE;
+
+    // Calculate buffer size
+    uint32_t i;
+    size_t data_str_len = 128, ptr_rec = 0;
+    for(i = 0; i < delta->length; i++) {
+        teoArpDelta *rec = (teoArpDelta *)(delta->records + ptr_rec);
+        data_str_len += rec_json_len + strlen(rec->type);
+        ptr_rec += rec->length;
+    }
+
+    char *data_str = teo_malloc(data_str_len);
+    int ptr = snprintf(data_str, data_str_len, "{ \"epoch\": %u, "
+            "\"version\": %u, \"from\": %u, \"length\": %u, \"peers\": [ ",
+            delta->epoch, delta->version, delta->from_version, delta->length);
+
+    for(i = 0, ptr_rec = 0; i < delta->length; i++) {
+        teoArpDelta *rec = (teoArpDelta *)(delta->records + ptr_rec);
+        ptr += snprintf(data_str + ptr, data_str_len - ptr,
+                "%s{ "
+                "\"op\": \"%s\", "
+                "\"name\": \"%.*s\", "
+                "\"type\": [%s], "
+                "\"mode\": %d, "
+                "\"addr\": \"%.*s\", "
+                "\"port\": %d, "
+                "\"triptime\": %.3f, "
+                "\"uptime\": %.3f"
+                " }",
+                i ? ", " : "",
+                op_str[rec->op <= TEO_ARP_REMOVE ? rec->op : 0],
+                (int)sizeof(rec->name), rec->name,
+                rec->type,
+                rec->data.mode,
+                (int)sizeof(rec->data.addr), rec->data.addr,
+                rec->data.port,
+                rec->data.last_triptime,
+                rec->data.connected_time // uptime
+        );
+        ptr_rec += rec->length;
+    }
+    snprintf(data_str + ptr, data_str_len - ptr, " ] }");
+
+    if(length != NULL) *length = strlen(data_str) + 1;
+
+    return data_str;
+}
+
+/**
+ * Send peers table changes to EV_K_PEERS_CHANGED subscribers
+ *
+ * Called before event loop sleeps, so all changes made in one loop iteration
+ * are sent in one event.
+ */
+static void arp_push_cb(EV_P_ ev_prepare *w, int revents) {
+
+    ksnetArpClass *ka = w->data;
+    if(ka->push_version == ka->version) return;
+
+    ksnetEvMgrClass *ke = ka->ke;
+    if(ke->kc != NULL && ke->kc->kco != NULL &&
+       teoSScrNumberOfEventSubscribers(ke->kc->kco->ksscr, EV_K_PEERS_CHANGED)) {
+
+        size_t delta_len;
+        teoArpDeltaHeader *delta = teoArpGetDelta(ka, ka->epoch,
+                ka->push_version, &delta_len);
+        teoSScrSend(ke->kc->kco->ksscr, EV_K_PEERS_CHANGED, delta, delta_len, 0);
+        free(delta);
+    }
+
+    ka->push_version = ka->version;
+}
+
 /**
  * Show (return string) with KSNet ARP table header
  *
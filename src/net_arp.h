@@ -14,16 +14,95 @@
 #include <stdint.h>
 #include <sys/socket.h>
 
+#include <ev.h>
 #include <pbl.h>
 
+#include "utils/teo_hashmap.h"
 #include "teonet_l0_client.h"
 
+#define TEO_ARP_LOG_SIZE 1024 ///< Number of peers table changes kept for deltas
+#define TEO_ARP_CACHE_TTL 1.0 ///< Cached peers snapshot max age, sec (trip time refresh)
+
+/**
+ * Peers table change operation
+ */
+enum teoArpOp {
+    TEO_ARP_ADD = 1,    ///< Peer added
+    TEO_ARP_UPDATE,     ///< Peer address, port, mode or type changed
+    TEO_ARP_REMOVE      ///< Peer removed
+};
+
+/**
+ * Peers table change log record
+ */
+typedef struct teoArpChange {
+    uint32_t version;   ///< Table version after this change
+    uint8_t op;         ///< teoArpOp
+    char name[ARP_TABLE_NAME_SIZE]; ///< Peer name
+} teoArpChange;
+
+/**
+ * Cached pre-serialised peers table snapshot
+ */
+typedef struct teoArpCache {
+    void *data;         ///< Snapshot data or NULL
+    size_t data_len;    ///< Snapshot data length
+    uint32_t version;   ///< Table version of the snapshot
+    double time;        ///< Snapshot build time
+} teoArpCache;
+
+/**
+ * CMD_PEERS_DELTA binary request
+ */
+typedef struct teoArpDeltaRequest {
+    uint32_t epoch;     ///< Table epoch from previous answer or 0
+    uint32_t version;   ///< Table version from previous answer or 0
+} teoArpDeltaRequest;
+
+/**
+ * CMD_PEERS_DELTA binary answer and EV_K_PEERS_CHANGED event data
+ *
+ * If from_version is 0 the records contain the full peers table and the
+ * receiver should drop its copy before applying them.
+ */
+typedef struct teoArpDeltaHeader {
+    uint32_t epoch;         ///< Table epoch, changed when host restarts
+    uint32_t version;       ///< Current table version
+    uint32_t from_version;  ///< Version the changes are counted from, 0 - full table
+    uint32_t length;        ///< Number of teoArpDelta records
+    uint8_t records[];      ///< teoArpDelta records
+} teoArpDeltaHeader;
+
+/**
+ * Peer change record of teoArpDeltaHeader
+ */
+typedef struct teoArpDelta {
+    uint16_t length;        ///< Record length including type, 8 bytes aligned
+    uint8_t op;             ///< teoArpOp
+    uint8_t reserved;
+    uint32_t version;       ///< Version of last peer change, table version
+                            ///< in full table
+    char name[ARP_TABLE_NAME_SIZE]; ///< Peer name
+    ksnet_arp_data data;    ///< Peer data, connected_time is uptime (zero for TEO_ARP_REMOVE)
+    char type[];            ///< Peer type, zero terminated string
+} teoArpDelta;
+
 /**
  * KSNet ARP functions data
  */
 typedef struct ksnetArpClass {
     PblMap* map;    ///< Hash Map to store KSNet ARP table
+    teoHashMap* by_addr; ///< Binary address index: family, port, address -> peer name
     void *ke;       ///< Pointer to Event Manager class object
+
+    uint32_t epoch;         ///< Table epoch
+    uint32_t version;       ///< Table version, incremented on each peer change
+    uint32_t reset_version; ///< Version of last ksnetArpRemoveAll
+    uint32_t push_version;  ///< Version last sent to EV_K_PEERS_CHANGED subscribers
+    teoArpChange *log;      ///< Changes ring buffer, TEO_ARP_LOG_SIZE records
+    teoArpCache cache_bin;  ///< CMD_PEERS binary answer cache
+    teoArpCache cache_json; ///< CMD_PEERS JSON answer cache
+    ev_prepare push_w;      ///< Send changes to subscribers before loop sleeps
 } ksnetArpClass;
 
 
@@ -50,7 +129,9 @@ char *ksnetArpShowStr(ksnetArpClass *ka);
 int ksnetArpGetAll_(ksnetArpClass *ka, peer_callback cb, void *data, int flag);
 int ksnetArpGetAll(ksnetArpClass *ka, peer_callback cb, void *data);
 int ksnetArpGetAllH(ksnetArpClass *ka, peer_callback cb, void *data);
+void teoArpUpdated(ksnetArpClass *ka, char *name);
 ksnet_arp_data *ksnetArpFindByAddr(ksnetArpClass *ka, __CONST_SOCKADDR_ARG addr, char **peer_name);
+ksnet_arp_data *ksnetArpFindByAddrStr(ksnetArpClass *ka, const char *addr, int port, char **peer_name);
 
 ksnet_arp_data_ar *ksnetArpShowData(ksnetArpClass *ka);
 ksnet_arp_data_ext_ar *teoArpGetExtendedArpTable(ksnetArpClass *ka);
@@ -60,6 +141,12 @@ void teoArpGetExtendedArpTable_json_delete(char *obj);
 size_t ksnetArpShowDataLength(ksnet_arp_data_ar *peers_data);
 size_t teoArpGetExtendedArpTableLength(ksnet_arp_data_ext_ar *peers_data);
 
+// Cached snapshot and changes
+const void *teoArpGetCachedTable(ksnetArpClass *ka, int json_f, size_t *length);
+teoArpDeltaHeader *teoArpGetDelta(ksnetArpClass *ka, uint32_t epoch,
+        uint32_t version, size_t *length);
+char *teoArpDeltaJson(teoArpDeltaHeader *delta, size_t *length);
+
 #define ARP_TABLE_DATA_LENGTH(X) _Generic((X), \
       ksnet_arp_data_ar* : ksnetArpShowDataLength, \
       ksnet_arp_data_ext_ar* : teoArpGetExtendedArpTableLength \
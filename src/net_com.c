@@ -46,6 +46,8 @@ static int cmd_get_public_ip_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
 static int cmd_reset_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
 static int cmd_l0_info_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
 static int cmd_trudp_info_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
+static int cmd_peer_telemetry_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
+static int cmd_peers_delta_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
 int cmd_l0_check_cb(ksnCommandClass *kco, ksnCorePacketData *rd);
 int cmd_l0_kick_client(ksnCommandClass *kco, ksnCorePacketData *rd);
 
@@ -55,6 +57,111 @@ const char *BINARY = "BINARY";
 
 #define MODULE _ANSI_LIGHTBLUE "net_command" _ANSI_NONE
 
+static int cmd_none_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    ksn_printf(EVENT_MANAGER_OBJECT(kco), MODULE, DEBUG_VV,
+        "recieve CMD_NONE = %u from %s (%s:%d).\n",
+        CMD_NONE, rd->from, rd->addr, rd->port);
+    return 1;
+}
+
+#if M_ENAMBE_VPN
+static int cmd_vpn_packet_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
+    return cmd_vpn_cb(ke->kvpn, rd->from, rd->data, rd->data_len);
+}
+#endif
+
+#ifdef M_ENAMBE_TUN
+static int cmd_tun_packet_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    return cmd_tun_cb(EVENT_MANAGER_OBJECT(kco)->ktun, rd);
+}
+#endif
+
+#ifdef M_ENAMBE_STREAM
+static int cmd_stream_packet_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    return cmd_stream_cb(EVENT_MANAGER_OBJECT(kco)->ks, rd);
+}
+#endif
+
+#ifdef M_ENAMBE_L0s
+static int cmd_l0_packet_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    return cmd_l0_cb(EVENT_MANAGER_OBJECT(kco), rd);
+}
+
+static int cmd_l0_to_packet_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
+    return ke->kl ? cmd_l0_to_cb(ke, rd) : 0;
+}
+
+static int cmd_l0_broadcast_packet_cb(ksnCommandClass *kco,
+        ksnCorePacketData *rd) {
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
+    return ke->kl ? cmd_l0_broadcast_cb(ke, rd) : 0;
+}
+#endif
+
+/**
+ * Teonet commands processed by this module
+ */
+static int (* const cmd_builtin[256])(ksnCommandClass *kco,
+        ksnCorePacketData *rd) = {
+
+    [CMD_NONE] = cmd_none_cb,
+    [CMD_RESET] = cmd_reset_cb,
+    [CMD_ECHO] = cmd_echo_cb,
+    [CMD_ECHO_ANSWER] = cmd_echo_answer_cb,
+    [CMD_ECHO_UNRELIABLE] = cmd_echo_unr_cb,
+    [CMD_CONNECT_R] = cmd_connect_r_cb,
+    [CMD_CONNECT] = cmd_connect_cb,
+    [CMD_DISCONNECTED] = cmd_disconnected_cb,
+    #if M_ENAMBE_VPN
+    [CMD_VPN] = cmd_vpn_packet_cb,
+    #endif
+    [CMD_SPLIT] = cmd_split_cb,
+    #ifdef M_ENAMBE_TUN
+    [CMD_TUN] = cmd_tun_packet_cb,
+    #endif
+    #ifdef M_ENAMBE_STREAM
+    [CMD_STREAM] = cmd_stream_packet_cb,
+    #endif
+    #ifdef M_ENAMBE_L0s
+    [CMD_L0] = cmd_l0_packet_cb,
+    [CMD_L0_TO] = cmd_l0_to_packet_cb,
+    [CMD_L0_CLIENT_BROADCAST] = cmd_l0_broadcast_packet_cb,
+    #endif
+    [CMD_PEERS] = cmd_peers_cb,
+    [CMD_GET_NUM_PEERS] = cmd_peers_num_cb,
+    [CMD_RESEND] = cmd_resend_cb,
+    [CMD_RECONNECT] = cmd_reconnect_cb,
+    [CMD_RECONNECT_ANSWER] = cmd_reconnect_answer_cb,
+    [CMD_L0_CLIENTS] = cmd_l0_clients_cb,
+    [CMD_L0_CLIENTS_N] = cmd_l0_clients_n_cb,
+    [CMD_L0_STAT] = cmd_l0_stat_cb,
+    [CMD_L0_INFO] = cmd_l0_info_cb,
+    [CMD_HOST_INFO] = cmd_host_info_cb,
+    [CMD_GET_PUBLIC_IP] = cmd_get_public_ip_cb,
+    [CMD_HOST_INFO_ANSWER] = cmd_host_info_answer_cb,
+    [CMD_TRUDP_INFO] = cmd_trudp_info_cb,
+    [CMD_PEER_TELEMETRY] = cmd_peer_telemetry_cb,
+    [CMD_PEERS_DELTA] = cmd_peers_delta_cb,
+    [CMD_SUBSCRIBE] = cmd_subscribe_cb,
+    [CMD_UNSUBSCRIBE] = cmd_subscribe_cb,
+    [CMD_SUBSCRIBE_ANSWER] = cmd_subscribe_cb,
+    [CMD_SUBSCRIBE_RND] = cmd_subscribe_cb,
+    [CMD_L0_AUTH] = cmd_l0_check_cb, // CMD_USER + 1
+    [CMD_L0_CLIENT_RESET] = cmd_l0_kick_client
+};
+
+/**
+ * Teonet commands which L0 clients are allowed to send by default
+ */
+static const uint8_t cmd_l0_allowed[] = {
+    CMD_ECHO, CMD_ECHO_ANSWER, CMD_ECHO_UNRELIABLE, CMD_ECHO_UNRELIABLE_ANSWER,
+    CMD_PEERS, CMD_L0_CLIENTS, CMD_RESET, CMD_SUBSCRIBE, CMD_SUBSCRIBE_RND,
+    CMD_UNSUBSCRIBE, CMD_L0_CLIENTS_N, CMD_L0_STAT, CMD_HOST_INFO,
+    CMD_GET_NUM_PEERS, CMD_TRUDP_INFO, CMD_PEER_TELEMETRY, CMD_PEERS_DELTA
+};
+
 /**
  * Initialize ksnet command class
  *
@@ -68,6 +175,23 @@ ksnCommandClass *ksnCommandInit(void *kc) {
     kco->kr = ksnReconnectInit(kco);
     kco->ksscr = teoSScrInit(((ksnCoreClass *)kc)->ke);
 
+    memset(kco->handlers, 0, sizeof(kco->handlers));
+    memset(kco->stat, 0, sizeof(kco->stat));
+
+    // L0 clients allow list: system commands and all user commands
+    memset(kco->l0_allow, 0, sizeof(kco->l0_allow));
+    size_t i;
+    for(i = 0; i < sizeof(cmd_l0_allowed); i++) {
+        ksnCommandL0Allow(kco, cmd_l0_allowed[i], 1);
+    }
+    int cmd;
+    for(cmd = CMD_USER; cmd < CMD_192_RESERVED; cmd++) {
+        ksnCommandL0Allow(kco, cmd, 1);
+    }
+    for(cmd = CMD_USER_NR; cmd < CMD_LAST; cmd++) {
+        ksnCommandL0Allow(kco, cmd, 1);
+    }
+
     return kco;
 }
 
@@ -80,170 +204,156 @@ void ksnCommandDestroy(ksnCommandClass *kco) {
     teoSScrDestroy(kco->ksscr); // Destroy subscribe class
     ksnSplitDestroy(kco->ks); // Destroy split class
     ((ksnReconnectClass*)kco->kr)->destroy(kco->kr); // Destroy reconnect class
+
+    // Free registered handlers
+    int cmd;
+    for(cmd = 0; cmd < 256; cmd++) {
+        while(kco->handlers[cmd] != NULL) {
+            ksnCommandHandlerData *hd = kco->handlers[cmd];
+            kco->handlers[cmd] = hd->next;
+            free(hd);
+        }
+    }
+
     free(kco);
 }
 
 /**
- * Check and process command
+ * Register command handler
  *
- * @return True if command processed
+ * Registered handlers are called when teonet does not process the command
+ * itself, the last registered handler is called first. If no handler
+ * processed the command it is sent to application event callback with
+ * EV_K_RECEIVED event.
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param cmd Command
+ * @param cb Command handler
+ * @param user_data Pointer to user data sent to command handler
+ *
+ * @return 0 at success
  */
-int ksnCommandCheck(ksnCommandClass *kco, ksnCorePacketData *rd) {
- 
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
-
-    int processed = 0;
-
-    switch(rd->cmd) {
-
-        case CMD_NONE:
-            ksn_printf(ke, MODULE, DEBUG_VV, "recieve CMD_NONE = %u from %s (%s:%d).\n",
-                CMD_NONE, rd->from, rd->addr, rd->port);
-            processed = 1;
-            break;
+int ksnCommandRegister(ksnCommandClass *kco, uint8_t cmd, ksnCommandHandler cb,
+        void *user_data) {
 
-        case CMD_RESET:
-            processed = cmd_reset_cb(kco, rd);
-            break;
+    ksnCommandHandlerData *hd = malloc(sizeof(ksnCommandHandlerData));
+    if(hd == NULL) return -1;
+    hd->cb = cb;
+    hd->user_data = user_data;
+    hd->next = kco->handlers[cmd];
+    kco->handlers[cmd] = hd;
 
-        case CMD_ECHO:
-            processed = cmd_echo_cb(kco, rd);
-            break;
+    return 0;
+}
 
-        case CMD_ECHO_ANSWER:
-            processed = cmd_echo_answer_cb(kco, rd);
-            break;
+/**
+ * Unregister command handler
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param cmd Command
+ * @param cb Command handler
+ * @param user_data Pointer to user data used in ksnCommandRegister
+ *
+ * @return 0 at success or -1 if handler was not registered
+ */
+int ksnCommandUnregister(ksnCommandClass *kco, uint8_t cmd,
+        ksnCommandHandler cb, void *user_data) {
+
+    ksnCommandHandlerData **hd;
+    for(hd = &kco->handlers[cmd]; *hd != NULL; hd = &(*hd)->next) {
+        if((*hd)->cb == cb && (*hd)->user_data == user_data) {
+            ksnCommandHandlerData *next = (*hd)->next;
+            free(*hd);
+            *hd = next;
+            return 0;
+        }
+    }
 
-        case CMD_ECHO_UNRELIABLE:
-            processed = cmd_echo_unr_cb(kco, rd);
-            break;
+    return -1;
+}
 
-//        case CMD_ECHO_UNR_ANSWER:
-//            processed = cmd_echo_unr_answer_cb(kco, rd);
-//            break;
+/**
+ * Allow or deny L0 clients to send command
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param cmd Command
+ * @param allow Allow if true
+ */
+void ksnCommandL0Allow(ksnCommandClass *kco, uint8_t cmd, int allow) {
+    if(allow) kco->l0_allow[cmd >> 5] |= (uint32_t)1 << (cmd & 31);
+    else kco->l0_allow[cmd >> 5] &= ~((uint32_t)1 << (cmd & 31));
+}
 
-        case CMD_CONNECT_R:
-            processed = cmd_connect_r_cb(kco, rd);
-            break;
+/**
+ * Get command processing statistic
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param cmd Command
+ *
+ * @return Pointer to ksnCommandStat
+ */
+const ksnCommandStat *ksnCommandGetStat(ksnCommandClass *kco, uint8_t cmd) {
+    return &kco->stat[cmd];
+}
 
-        case CMD_CONNECT:
-            processed = cmd_connect_cb(kco, rd);
-            break;
+/**
+ * Clear commands processing statistic
+ *
+ * @param kco Pointer to ksnCommandClass
+ */
+void ksnCommandStatReset(ksnCommandClass *kco) {
+    memset(kco->stat, 0, sizeof(kco->stat));
+}
 
-        case CMD_DISCONNECTED:
-            processed = cmd_disconnected_cb(kco, rd);
-            break;
+/**
+ * Add command processing time to command statistic
+ *
+ * @param st Pointer to ksnCommandStat
+ * @param t Processing time, sec
+ */
+static void ksnCommandStatAdd(ksnCommandStat *st, double t) {
 
-        #if M_ENAMBE_VPN
-        case CMD_VPN:
-            processed = cmd_vpn_cb(ke->kvpn, rd->from, rd->data, rd->data_len);
-            break;
-        #endif
+    st->time_total += t;
+    if(t > st->time_max) st->time_max = t;
 
-        case CMD_SPLIT:
-            processed = cmd_split_cb(kco, rd);
-            break;
+    uint64_t us = (uint64_t)(t * 1000000.0);
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if(bucket >= KSN_CMD_HIST_SIZE) bucket = KSN_CMD_HIST_SIZE - 1;
+    st->hist[bucket]++;
+}
 
-        #ifdef M_ENAMBE_TUN
-        case CMD_TUN:
-            processed = cmd_tun_cb(ke->ktun, rd);
-            break;
-        #endif
+/**
+ * Check and process command
+ *
+ * The command is processed by teonet command handler and than by handlers
+ * registered with ksnCommandRegister.
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to ksnCorePacketData
+ *
+ * @return True if command processed
+ */
+int ksnCommandCheck(ksnCommandClass *kco, ksnCorePacketData *rd) {
 
-        #ifdef M_ENAMBE_STREAM
-        case CMD_STREAM:
-            processed = cmd_stream_cb(ke->ks, rd);
-            break;
-        #endif
+    uint8_t cmd = rd->cmd;
+    ksnCommandStat *st = &kco->stat[cmd];
+    st->calls++;
 
-        #ifdef M_ENAMBE_L0s
-        case CMD_L0:
-            processed = cmd_l0_cb(ke, rd);
-            break;
-        #endif
+    if(cmd_builtin[cmd] == NULL && kco->handlers[cmd] == NULL) return 0;
 
-        #ifdef M_ENAMBE_L0s
-        case CMD_L0_TO:
-            if(ke->kl) processed = cmd_l0_to_cb(ke, rd);
-            break;
-        #endif
+    int processed = 0;
+    double start = ev_time();
 
-        #ifdef M_ENAMBE_L0s
-        case CMD_L0_CLIENT_BROADCAST:
-            if(ke->kl) processed = cmd_l0_broadcast_cb(ke, rd);
-            break;
-        #endif
+    if(cmd_builtin[cmd] != NULL) processed = cmd_builtin[cmd](kco, rd);
 
-        case CMD_PEERS:
-            processed = cmd_peers_cb(kco, rd);
-            break;
-
-        case CMD_GET_NUM_PEERS:
-            processed = cmd_peers_num_cb(kco, rd);
-            break;
-
-        case CMD_RESEND:
-            processed = cmd_resend_cb(kco, rd);
-            break;
-
-        case CMD_RECONNECT:
-            processed = cmd_reconnect_cb(kco, rd);
-            break;
-
-        case CMD_RECONNECT_ANSWER:
-            processed = cmd_reconnect_answer_cb(kco, rd);
-            break;
-
-        case CMD_L0_CLIENTS:
-            processed = cmd_l0_clients_cb(kco, rd);
-            break;
-
-        case CMD_L0_CLIENTS_N:
-            processed = cmd_l0_clients_n_cb(kco, rd);
-            break;
-
-        case CMD_L0_STAT:
-            processed = cmd_l0_stat_cb(kco, rd);
-            break;
-
-        case CMD_L0_INFO:
-            processed = cmd_l0_info_cb(kco, rd);
-            break;
-
-        case CMD_HOST_INFO:
-            processed = cmd_host_info_cb(kco, rd);
-            break;
-
-        case CMD_GET_PUBLIC_IP:
-            processed = cmd_get_public_ip_cb(kco, rd);
-            break;    
-
-        case CMD_HOST_INFO_ANSWER:
-            processed = cmd_host_info_answer_cb(kco, rd);
-            break;
-            
-        case CMD_TRUDP_INFO:
-            processed = cmd_trudp_info_cb(kco, rd);
-            break;
-
-        case CMD_SUBSCRIBE:
-        case CMD_UNSUBSCRIBE:
-        case CMD_SUBSCRIBE_ANSWER:
-        case CMD_SUBSCRIBE_RND:
-            processed = cmd_subscribe_cb(kco, rd);
-            break;
-
-        case CMD_L0_AUTH: // CMD_USER + 1:
-            processed = cmd_l0_check_cb(kco, rd);
-            break;
-
-        case CMD_L0_CLIENT_RESET:
-            processed = cmd_l0_kick_client(kco, rd);
-            break;
-        default:
-            break;
+    ksnCommandHandlerData *hd;
+    for(hd = kco->handlers[cmd]; !processed && hd != NULL; hd = hd->next) {
+        processed = hd->cb(kco, rd, hd->user_data);
     }
 
+    if(processed) st->processed++;
+    ksnCommandStatAdd(st, ev_time() - start);
+
     return processed;
 }
 
@@ -443,21 +553,13 @@ static int cmd_peers_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
             rd->cmd, rd->from, rd->addr, rd->port);
     #endif
 
-    // Get peers data
-    ksnet_arp_data_ext_ar *peers_data = teoArpGetExtendedArpTable(arp_class);
-    size_t peers_data_length = ARP_TABLE_DATA_LENGTH(peers_data);
-
     // Get type of request: 0 - binary; 1 - JSON
     const int data_type = rd->data_len && !strncmp(rd->data, JSON, rd->data_len)  ? 1 : 0;
 
-    // Convert data to JSON format
-    if(data_type == 1) {
-        size_t peers_json_len;
-        char *peers_json = teoArpGetExtendedArpTable_json(peers_data, &peers_json_len);
-        free(peers_data);
-        peers_data = (ksnet_arp_data_ext_ar *)peers_json;
-        peers_data_length = peers_json_len;
-    }
+    // Get cached peers data
+    size_t peers_data_length;
+    void *peers_data = (void *)teoArpGetCachedTable(arp_class, data_type,
+            &peers_data_length);
 
     // Send PEERS_ANSWER to L0 user
     if(rd->l0_f) {
@@ -467,7 +569,62 @@ static int cmd_peers_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
         ksnCoreSendto(kco->kc, rd->addr, rd->port, CMD_PEERS_ANSWER, peers_data, peers_data_length);
     }
 
-    free(peers_data);
+    return 1; // Command processed
+}
+
+/**
+ * Process CMD_PEERS_DELTA command
+ *
+ * Answer with peers table changes since version from request. Binary request
+ * is teoArpDeltaRequest, JSON request is "JSON" or "JSON <epoch> <version>"
+ * string. Empty request returns full peers table.
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to ksnCorePacketData
+ * @return True if command is processed
+ */
+static int cmd_peers_delta_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
+    ksnetArpClass *arp_class = ARP_TABLE_OBJECT(kco);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(ke, MODULE, DEBUG_VV, "process CMD_PEERS_DELTA (cmd = %u) command, from %s (%s:%d)\n",
+            rd->cmd, rd->from, rd->addr, rd->port);
+    #endif
+
+    // Get type of request: 0 - binary; 1 - JSON
+    const int data_type = rd->data_len >= 4 && !strncmp(rd->data, JSON, 4) ? 1 : 0;
+
+    // Get requested version
+    teoArpDeltaRequest req = { 0, 0 };
+    if(data_type == 1) {
+        char buf[32] = { 0 };
+        memcpy(buf, rd->data, rd->data_len < sizeof(buf) ? rd->data_len : sizeof(buf) - 1);
+        if(sscanf(buf + 4, "%u %u", &req.epoch, &req.version) != 2) req.version = 0;
+    }
+    else if(rd->data_len >= sizeof(req)) memcpy(&req, rd->data, sizeof(req));
+
+    size_t data_out_len;
+    void *data_out = teoArpGetDelta(arp_class, req.epoch, req.version,
+            &data_out_len);
+
+    // Convert data to JSON format
+    if(data_type == 1) {
+        char *json = teoArpDeltaJson(data_out, &data_out_len);
+        free(data_out);
+        data_out = json;
+    }
+
+    if(rd->l0_f) {// Send PEERS_DELTA_ANSWER to L0 user
+        ksnLNullSendToL0(ke, rd->addr, rd->port, rd->from, rd->from_len,
+                CMD_PEERS_DELTA_ANSWER, data_out, data_out_len);
+    } else {// Send PEERS_DELTA_ANSWER to peer
+        ksnCoreSendto(kco->kc, rd->addr, rd->port, CMD_PEERS_DELTA_ANSWER,
+                data_out, data_out_len);
+    }
+
+    free(data_out);
 
     return 1; // Command processed
 }
@@ -727,6 +884,7 @@ static int cmd_host_info_answer_cb(ksnCommandClass *kco, ksnCorePacketData *rd)
 
             // Add type to arp-table
             rd->arp->type = type_str;
+            teoArpUpdated(arp_class, rd->from);
             printf("notype... Peername %s, Type: %s\n", rd->from, rd->arp->type);
             // Metrics
             char *met = ksnet_formatMessage("CON.%s", rd->from);
@@ -936,6 +1094,50 @@ static int cmd_trudp_info_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
     return 1; // Command processed
 }
 
+/**
+ * Process CMD_PEER_TELEMETRY
+ *
+ * Answer with binary teoPeerTelemetrySnapshot of peers table page requested
+ * by optional teoPeerTelemetryRequest, the page has at most
+ * TEO_TELEMETRY_PAGE_MAX records
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to ksnCorePacketData
+ * @return True if command is processed
+ */
+static int cmd_peer_telemetry_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
+
+    #ifdef DEBUG_KSNET
+    ksn_printf(ke, MODULE, DEBUG_VV, "process CMD_PEER_TELEMETRY (cmd = %u) command, from %s (%s:%d)\n",
+            rd->cmd, rd->from, rd->addr, rd->port);
+    #endif
+
+    size_t offset = 0, count = TEO_TELEMETRY_PAGE_MAX;
+    if(rd->data_len >= sizeof(teoPeerTelemetryRequest)) {
+        teoPeerTelemetryRequest req;
+        memcpy(&req, rd->data, sizeof(req));
+        offset = req.offset;
+        if(req.count && req.count < count) count = req.count;
+    }
+
+    size_t data_out_len;
+    teoPeerTelemetrySnapshot *data_out = teoPeerTelemetryGetSnapshotPage(
+            ke->kc->kpt, offset, count, &data_out_len);
+
+    if(rd->l0_f) {// Send PEER_TELEMETRY_ANSWER to L0 user
+        ksnLNullSendToL0(ke, rd->addr, rd->port, rd->from, rd->from_len,
+                CMD_PEER_TELEMETRY_ANSWER, data_out, data_out_len);
+    } else {// Send PEER_TELEMETRY_ANSWER to peer
+        ksnCoreSendto(kco->kc, rd->addr, rd->port, CMD_PEER_TELEMETRY_ANSWER,
+                data_out, data_out_len);
+    }
+
+    free(data_out);
+
+    return 1; // Command processed
+}
+
 /**
  * Process CMD_RESEND command
  *
@@ -949,9 +1151,8 @@ static int cmd_trudp_info_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
  */
 static int cmd_resend_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
 
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
-
     #ifdef DEBUG_KSNET
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
     ksn_printf(ke, MODULE, DEBUG_VV, "process CMD_RESEND (cmd = %u) command, from %s (%s:%d)\n",
             rd->cmd, rd->from, rd->addr, rd->port);
     #endif
@@ -992,9 +1193,8 @@ static int cmd_resend_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
  */
 inline int cmd_reconnect_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
 
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
-
     #ifdef DEBUG_KSNET
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
     ksn_printf(ke, MODULE, DEBUG_VV, "process CMD_RECONNECT (cmd = %u) command, from %s (%s:%d)\n",
             rd->cmd, rd->from, rd->addr, rd->port);
     #endif
@@ -1011,9 +1211,8 @@ inline int cmd_reconnect_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
  */
 inline static int cmd_reconnect_answer_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
 
-    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
-
     #ifdef DEBUG_KSNET
+    ksnetEvMgrClass *ke = EVENT_MANAGER_OBJECT(kco);
     ksn_printf(ke, MODULE, DEBUG_VV, "process CMD_RECONNECT_ANSWER (cmd = %u) command, from %s (%s:%d)\n",
             rd->cmd, rd->from, rd->addr, rd->port);
     #endif
@@ -1045,6 +1244,8 @@ static int cmd_echo_answer_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
     rd->arp->data.last_triptime_got = time_got;
     rd->arp->data.last_triptime = triptime;
     rd->arp->data.triptime = (rd->arp->data.triptime + triptime) / 2.0;
+    teoPeerTelemetryRtt(teoPeerTelemetryFind(ke->kc->kpt, rd->addr, rd->port),
+            triptime);
 
     // Ping answer
     if(!strcmp(rd->data, PING)) {
@@ -1164,6 +1365,7 @@ static int cmd_connect_r_cb(ksnCommandClass *kco, ksnCorePacketData *rd) {
         ksnetArpGetAll(arp_obj, send_cmd_connect_cb_b, rd);
     } else {// For TCP proxy connection resend this host IPs to child
         rd->arp->data.mode = 2;
+        teoArpUpdated(arp_obj, rd->from);
         ksnCorePacketData lrd;
         lrd.port = rd->arp->data.port;
         lrd.from = rd->from;
@@ -1216,10 +1418,7 @@ static void cmd_connect_cque_cb(uint32_t id, int type, void *data) {
         cmd_connect_cque_cb_data *cqd = data;
 
         char *peer_name = "";        
-        struct sockaddr_storage remaddr;         // remote address
-        socklen_t addrlen = sizeof(remaddr); // length of addresses
-        make_addr(cqd->addr, cqd->port, (__SOCKADDR_ARG) &remaddr, &addrlen);
-        ksnet_arp_data *arp = ksnetArpFindByAddr(cqd->ke->kc->ka, (__CONST_SOCKADDR_ARG) &remaddr, &peer_name);
+        ksnet_arp_data *arp = ksnetArpFindByAddrStr(cqd->ke->kc->ka, cqd->addr, cqd->port, &peer_name);
         #ifdef DEBUG_KSNET
         ksn_printf(cqd->ke, MODULE, DEBUG_VV, 
                 "processing CMD_CONNECT cmd_connect_cque_cb, %s, %s:%d %s\n", 
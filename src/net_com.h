@@ -73,6 +73,10 @@ enum ksnCMD {
 
     CMD_GET_PUBLIC_IP,         ///< #102 Request public IPs, which set by l0_public_ipv4, l0_public_ipv6 parameters
     CMD_GET_PUBLIC_IP_ANSWER,  ///< #103 Public IPs answer
+    CMD_PEER_TELEMETRY,        ///< #104 Per-peer telemetry request (teoPeerTelemetryRequest or empty)
+    CMD_PEER_TELEMETRY_ANSWER, ///< #105 Per-peer telemetry snapshot (teoPeerTelemetrySnapshot)
+    CMD_PEERS_DELTA,           ///< #106 Get peers changes since version, data: teoArpDeltaRequest or "JSON [epoch version]"
+    CMD_PEERS_DELTA_ANSWER,    ///< #107 Peers changes answer (teoArpDeltaHeader or JSON)
 
     // Application level TR-UDP mode: 128...191
     CMD_128_RESERVED = 128, ///< #128 Reserver for future use
@@ -89,6 +93,46 @@ enum ksnCMD {
 
 #define CMD_TRUDP_CHECK(CMD) (!CMD || CMD == CMD_CONNECT || (CMD >= CMD_64_RESERVED && CMD < CMD_192_RESERVED))
 
+#define KSN_CMD_HIST_SIZE 20 ///< Number of command latency histogram buckets
+
+struct ksnCommandClass;
+struct ksnCorePacketData;
+
+/**
+ * Command handler
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param rd Pointer to received packet data
+ * @param user_data User data set in ksnCommandRegister
+ *
+ * @return True if command was processed, otherwise next handler is called
+ */
+typedef int (*ksnCommandHandler)(struct ksnCommandClass *kco,
+        struct ksnCorePacketData *rd, void *user_data);
+
+/**
+ * Registered command handler
+ */
+typedef struct ksnCommandHandlerData {
+    struct ksnCommandHandlerData *next;
+    ksnCommandHandler cb;
+    void *user_data;
+} ksnCommandHandlerData;
+
+/**
+ * Command processing statistic
+ *
+ * Histogram bucket 0 counts calls faster than 1 us, bucket N counts calls of
+ * 2^(N-1) ... 2^N us, the last bucket counts all slower calls.
+ */
+typedef struct ksnCommandStat {
+    uint64_t calls;         ///< Number of received commands
+    uint64_t processed;     ///< Number of commands processed by handlers
+    double   time_total;    ///< Total processing time, sec
+    double   time_max;      ///< Maximum processing time, sec
+    uint32_t hist[KSN_CMD_HIST_SIZE]; ///< Processing time histogram
+} ksnCommandStat;
+
 /**
  * KSNet command class data
  */
@@ -99,6 +143,10 @@ typedef struct ksnCommandClass {
     void *kr; ///< Pointer to KSNet reconnect class
     void *ksscr; ///< Pointer to teoSScrClass
 
+    ksnCommandHandlerData *handlers[256]; ///< Registered command handlers
+    ksnCommandStat stat[256]; ///< Commands statistic
+    uint32_t l0_allow[256 / 32]; ///< Commands allowed to L0 clients bitmap
+
 } ksnCommandClass;
 
 /**
@@ -134,6 +182,24 @@ extern "C" {
 ksnCommandClass *ksnCommandInit(void *kc);
 void ksnCommandDestroy(ksnCommandClass *kco);
 int ksnCommandCheck(ksnCommandClass *kco, ksnCorePacketData *rd);
+int ksnCommandRegister(ksnCommandClass *kco, uint8_t cmd, ksnCommandHandler cb,
+    void *user_data);
+int ksnCommandUnregister(ksnCommandClass *kco, uint8_t cmd, 
+    ksnCommandHandler cb, void *user_data);
+void ksnCommandL0Allow(ksnCommandClass *kco, uint8_t cmd, int allow);
+const ksnCommandStat *ksnCommandGetStat(ksnCommandClass *kco, uint8_t cmd);
+void ksnCommandStatReset(ksnCommandClass *kco);
+
+/**
+ * Check that L0 clients are allowed to send command
+ *
+ * @param kco Pointer to ksnCommandClass
+ * @param cmd Command
+ * @return True if command is allowed
+ */
+static inline int ksnCommandL0Allowed(ksnCommandClass *kco, uint8_t cmd) {
+    return (kco->l0_allow[cmd >> 5] >> (cmd & 31)) & 1;
+}
 int ksnCommandSendCmdEcho(ksnCommandClass *kco, char *to, void *data, 
     size_t data_len);
 void *ksnCommandEchoBuffer(ksnCommandClass *kco, void *data, size_t data_len, 
@@ -27,6 +27,7 @@ typedef int socklen_t;
 #include "utils/utils.h"
 #include "utils/rlutil.h"
 #include "utils/teo_memory.h"
+#include "utils/teo_trace.h"
 #include "tr-udp.h"
 
 #include "commands_creator.h"
@@ -42,8 +43,6 @@ const char *localhost = "::1";//"127.0.0.1";
 void host_cb(EV_P_ ev_io *w, int revents);
 int ksnCoreBind(ksnCoreClass *kc);
 void *ksnCoreCreatePacket(ksnCoreClass *kc, uint8_t cmd, const void *data, size_t data_len, size_t *packet_len);
-void *ksnCoreCreatePacketFrom(ksnCoreClass *kc, uint8_t cmd, char *from, size_t from_len, const void *data,
-        size_t data_len, size_t *packet_len);
 int send_cmd_disconnect_peer_cb(ksnetArpClass *ka, char *name, ksnet_arp_data_ext *arp_data, void *data);
 int send_cmd_disconnect_cb(ksnetArpClass *ka, char *name, ksnet_arp_data_ext *arp_data, void *data);
 int send_cmd_connected_cb(ksnetArpClass *ka, char *name, ksnet_arp_data *arp_data, void *data);
@@ -70,13 +69,23 @@ int send_cmd_connected_cb(ksnetArpClass *ka, char *name, ksnet_arp_data *arp_dat
  * @param D_LEN
  * @return
  */
+#define kc_tm(kc) (((ksnetEvMgrClass*)(kc)->ke)->tm)
+#define metric_sent(kc) \
+    if(retval > 0) { \
+        teoMetricCount(kc_tm(kc), TEO_METRIC_PACKETS_SENT, 1); \
+        teoMetricCount(kc_tm(kc), TEO_METRIC_BYTES_SENT, retval); \
+        teoPeerTelemetryOut(telemetry, retval); \
+    }
 #if KSNET_CRYPT
 #define sendto_encrypt(kc, cmd, DATA, D_LEN) \
     { \
         if(((ksnetEvMgrClass*)kc->ke)->teo_cfg.crypt_f) { \
             size_t data_len; \
             char *buffer = NULL; /*[KSN_BUFFER_DB_SIZE];*/ \
+            double t_start = ev_time(); \
             void *data = ksnEncryptPackage(kc->kcr, DATA, D_LEN, buffer, &data_len); \
+            teoMetricTime(kc_tm(kc), TEO_METRIC_ENCRYPT_TIME, t_start); \
+            TEO_TRACE2(encrypt, D_LEN, data_len); \
             retval = ksn_sendto(kc->ku, cmd, kc->fd, data, data_len, 0, \
                                 (struct sockaddr *)&remaddr, addrlen); \
             free(data); \
@@ -85,11 +94,15 @@ int send_cmd_connected_cb(ksnetArpClass *ka, char *name, ksnet_arp_data *arp_dat
             retval = ksn_sendto(kc->ku, cmd, kc->fd, DATA, D_LEN, 0, \
                                 (struct sockaddr *)&remaddr, addrlen); \
         } \
+        metric_sent(kc) \
     }
 #else
 #define sendto_encrypt(kc, cmd, DATA, D_LEN) \
-    retval = ksn_sendto(kc->ku, cmd, kc->fd, DATA, D_LEN, 0, \
-                        (struct sockaddr *)&remaddr, addrlen);
+    { \
+        retval = ksn_sendto(kc->ku, cmd, kc->fd, DATA, D_LEN, 0, \
+                            (struct sockaddr *)&remaddr, addrlen); \
+        metric_sent(kc) \
+    }
 #endif
 
 #pragma GCC diagnostic push
@@ -117,6 +130,7 @@ ksnCoreClass *ksnCoreInit(void* ke, char *name, int port, char* addr) {
     kc->last_check_event = 0;
 
     ((ksnetEvMgrClass*)ke)->kc = kc;
+    kc->kpt = teoPeerTelemetryInit(ke);
     kc->ka = ksnetArpInit(ke);
     kc->kco = ksnCommandInit(kc);
     #if KSNET_CRYPT
@@ -172,6 +186,7 @@ void ksnCoreDestroy(ksnCoreClass *kc) {
         free(kc->name);
         if(kc->addr != NULL) free(kc->addr);
         ksnetArpDestroy(kc->ka);
+        teoPeerTelemetryDestroy(kc->kpt);
         ksnCommandDestroy(kc->kco);
         trudpChannelDestroyAll(kc->ku);
         trudpDestroy(kc->ku);
@@ -251,6 +266,7 @@ int ksnCoreSendto(ksnCoreClass *kc, char *addr, int port, uint8_t cmd,
     ksn_printf(((ksnetEvMgrClass*)kc->ke), MODULE, DEBUG_VV,
                  "send %d bytes data, cmd %u to %s:%d\n", data_len, cmd, addr, port);
     #endif
+    TEO_TRACE4(packet_send, addr, port, cmd, data_len);
 
 
     int retval = 0;
@@ -260,6 +276,7 @@ int ksnCoreSendto(ksnCoreClass *kc, char *addr, int port, uint8_t cmd,
         struct sockaddr_storage remaddr;         // remote address
         socklen_t addrlen = sizeof(remaddr);// length of addresses
         make_addr(addr, port, (__SOCKADDR_ARG) &remaddr, &addrlen);
+        teoPeerTelemetry *telemetry = teoPeerTelemetryFind(kc->kpt, addr, port);
 
         // Split large packet
         void **packets;
@@ -357,7 +374,9 @@ int send_by_type_check_cb(ksnetArpClass *ka, char *peer_name,
  */
 void teoBroadcastSend(ksnCoreClass *kc, char *to, uint8_t cmd, void *data, size_t data_len) {
     send_by_type_check_t sd = { .name = to, .num = 0 };
+    #ifdef DEBUG_KSNET
     ksnetEvMgrClass* ke = (ksnetEvMgrClass*)(kc->ke);
+    #endif
 
     ksnetArpGetAll(kc->ka, send_by_type_check_cb, &sd);
 
@@ -790,6 +809,7 @@ void ksnCoreCheckNewPeer(ksnCoreClass *kc, ksnCorePacketData *rd) {
         // ke->is_rhost = true;
         strncpy(ke->teo_cfg.r_host_name, rd->from, sizeof(ke->teo_cfg.r_host_name)-1);
         rd->arp->data.mode = 1;
+        teoArpUpdated(ke->kc->ka, rd->from);
     }
 }
 
@@ -821,6 +841,11 @@ void ksnCoreProcessPacket (void *vkc, void *buf, size_t recvlen, __SOCKADDR_ARG
         ksn_printf(ke, MODULE, DEBUG_VV,
                 "got %d bytes from %s:%d\n", recvlen, addr, port);
         #endif
+        teoMetricCount(ke->tm, TEO_METRIC_PACKETS_RECEIVED, 1);
+        teoMetricCount(ke->tm, TEO_METRIC_BYTES_RECEIVED, recvlen);
+        TEO_TRACE3(packet_receive, addr, port, recvlen);
+        teoPeerTelemetry *telemetry = teoPeerTelemetryFind(kc->kpt, addr, port);
+        teoPeerTelemetryIn(telemetry, recvlen);
 
         void *data; // Decrypted packet data
         size_t data_len; // Decrypted packet data length
@@ -830,7 +855,11 @@ void ksnCoreProcessPacket (void *vkc, void *buf, size_t recvlen, __SOCKADDR_ARG
         #if KSNET_CRYPT        
         if(ke->teo_cfg.crypt_f && ksnCheckEncrypted(buf, recvlen)) {
             encrypted = 1;
+            double t_start = ev_time();
             data = ksnDecryptPackage(kc->kcr, buf, recvlen, &data_len);
+            teoMetricTime(ke->tm, TEO_METRIC_DECRYPT_TIME, t_start);
+            TEO_TRACE2(decrypt, recvlen, data_len);
+            if(data == buf) teoPeerTelemetryDecryptFailed(telemetry);
         } else { // Use packet without decryption
         #endif
             data = buf;
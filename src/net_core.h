@@ -20,6 +20,7 @@
 
 #include "net_arp.h"
 #include "net_com.h"
+#include "net_telemetry.h"
 #include "tr-udp.h"
 
 #if KSNET_CRYPT
@@ -45,6 +46,7 @@ typedef struct ksnCoreClass {
 
     double last_check_event; ///< Last time of check host event
     ksnetArpClass *ka;       ///< Arp table class object
+    teoPeerTelemetryClass *kpt; ///< Per-peer telemetry table
     ksnCommandClass *kco;    ///< Command class object
     trudpData *ku;          ///< TR-UDP class object
     #if KSNET_CRYPT
@@ -91,6 +93,8 @@ void teoBroadcastSend(ksnCoreClass *kc, char *to, uint8_t cmd, void *data, size_
 ksnet_arp_data *ksnCoreSendCmdto(ksnCoreClass *kc, char *to, uint8_t cmd, void *data, size_t data_len);
 void ksnCoreProcessPacket (void *kc, void *buf, size_t recvlen,
         __SOCKADDR_ARG remaddr);
+void *ksnCoreCreatePacketFrom(ksnCoreClass *kc, uint8_t cmd, char *from, size_t from_len, const void *data,
+        size_t data_len, size_t *packet_len);
 int ksnCoreParsePacket(void *packet, size_t packet_len, ksnCorePacketData *recv_data);
 void ksnCoreCheckNewPeer(ksnCoreClass *kc, ksnCorePacketData *rd);
 #define ksnCoreSetEventTime(kc) kc->last_check_event = ksnetEvMgrGetTime(kc->ke)
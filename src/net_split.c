@@ -13,6 +13,7 @@
 #include "net_split.h"
 #include "utils/rlutil.h"
 #include "utils/teo_memory.h"
+#include "utils/teo_trace.h"
 
 #define MODULE _ANSI_BLUE "net_split" _ANSI_NONE
 
@@ -28,7 +29,7 @@ ksnSplitClass *ksnSplitInit(ksnCommandClass *kco) {
 
     ksnSplitClass *ks = teo_malloc(sizeof(ksnSplitClass));
     ks->kco = kco;
-    ks->map = pblMapNewHashMap();
+    ks->map = teoHashMapNew();
     ks->packet_number = 0;
     ks->last_added = 0;
 
@@ -43,7 +44,7 @@ void ksnSplitDestroy(ksnSplitClass *ks) {
 
     if(ks != NULL) {
 
-        pblMapFree(ks->map);
+        teoHashMapFree(ks->map);
         free(ks);
     }
 }
@@ -94,6 +95,7 @@ void **ksnSplitPacket(ksnSplitClass *ks, uint8_t cmd, void *packet, size_t packe
             "%d bytes packet was split to %d subpackets\n",
             (int)packet_len, *num_subpackets);
         #endif
+        TEO_TRACE3(split, cmd, packet_len, *num_subpackets);
     }
 
     return packets;
@@ -129,23 +131,21 @@ ksnCorePacketData *ksnSplitCombine(ksnSplitClass *ks, ksnCorePacketData *rd) {
 
     // Create maps key macros
     #define create_key(subpacket_num) \
-    size_t key_len = sizeof(uint8_t) + rd->from_len + sizeof(uint16_t)*2; \
-    void *key = teo_malloc(key_len); \
-    size_t ptr = 0; \
-    *(uint8_t*)key = rd->from_len; ptr += sizeof(uint8_t); \
-    memcpy(key + ptr, rd->from, rd->from_len); ptr += rd->from_len; \
-    *(uint16_t*)(key + ptr) = packet_num ; ptr += sizeof(packet_num); \
-    *(uint16_t*)(key + ptr) = subpacket_num ; ptr += sizeof(subpacket_num)
+    uint8_t key[sizeof(uint8_t) + UINT8_MAX + sizeof(uint16_t)*2]; \
+    uint16_t key_num[2] = { packet_num, subpacket_num }; \
+    size_t key_len = 0; \
+    key[key_len++] = rd->from_len; \
+    memcpy(key + key_len, rd->from, rd->from_len); key_len += rd->from_len; \
+    memcpy(key + key_len, key_num, sizeof(key_num)); key_len += sizeof(key_num)
 
     // Clear all map raws if time from last adding is longe than 10 sec
-    if(current_time - ks->last_added > 10.0 && !pblMapIsEmpty(ks->map)) {
-        pblMapClear(ks->map);
+    if(current_time - ks->last_added > 10.0 && teoHashMapSize(ks->map)) {
+        teoHashMapClear(ks->map);
     }
 
     // Add subpacket to map
     create_key(subpacket_num);
-    pblMapAdd(ks->map, key, key_len, rd->data + ptr_d, rd->data_len - ptr_d);
-    free(key);
+    teoHashMapAdd(ks->map, key, key_len, rd->data + ptr_d, rd->data_len - ptr_d);
 
     // Save current time when record was added to map
     ks->last_added = current_time;
@@ -166,18 +166,20 @@ ksnCorePacketData *ksnSplitCombine(ksnSplitClass *ks, ksnCorePacketData *rd) {
 
             // Get subpacket from map
             create_key(i);
-            size_t data_s_len;
-            void *data_s = pblMapGet(ks->map, key, key_len, &data_s_len);
+            teoHashMapEntry *entry = teoHashMapGetEntry(ks->map, key, key_len);
 
             // Check error (the subpacket has not received or added to the map)
-            if(data_s == NULL) {
+            if(entry == NULL) {
                 #ifdef DEBUG_KSNET
                 ksn_puts(kev, MODULE, ERROR_M,
                     "the subpacket has not received or added to the map\n");
-                free(key);
                 #endif
+                free(data);
+                free(rds);
                 return NULL;
             }
+            void *data_s = entry->data;
+            size_t data_s_len = entry->data_len;
 
             // Get command from first subpacket
             if(!i) {
@@ -196,8 +198,7 @@ ksnCorePacketData *ksnSplitCombine(ksnSplitClass *ks, ksnCorePacketData *rd) {
             data_len += data_s_len;
 
             // Remove subpacket from map
-            pblMapRemoveFree(ks->map, key, key_len, &data_s_len);
-            free(key);
+            teoHashMapRemoveEntry(ks->map, entry);
        }
 
         #ifdef DEBUG_KSNET
@@ -205,6 +206,7 @@ ksnCorePacketData *ksnSplitCombine(ksnSplitClass *ks, ksnCorePacketData *rd) {
             "combine %d subpackets to large %d bytes packet\n",
             subpacket_num+1, (int)data_len);
         #endif
+        TEO_TRACE3(combine, rd->from, packet_num, subpacket_num + 1);
 
         // Create new ksnCorePacketData for combined block
         rds->addr = rd->addr;
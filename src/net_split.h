@@ -12,6 +12,7 @@
 #define	NET_SPLIT_H
 
 #include "ev_mgr.h"
+#include "utils/teo_hashmap.h"
 
 #define MAX_DATA_LEN 448
 #define MAX_PACKET_LEN (5*1024*1024)
@@ -23,7 +24,7 @@
 typedef struct ksnSplitClass {
     
     ksnCommandClass *kco;
-    PblMap* map;    ///< Hash Map to store splitted packets
+    teoHashMap* map; ///< Hash Map to store splitted packets
     uint16_t packet_number; ///< Large packet number
     double last_added; ///< Last time when record added to map
     void *data_save; ///< Allocated data pointer
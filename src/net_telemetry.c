@@ -0,0 +1,359 @@
+/**
+ * File:   net_telemetry.c
+ * Author: max
+ *
+ * Created on Oct 19, 2026
+ *
+ * Per-peer telemetry table
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "ev_mgr.h"
+#include "net_telemetry.h"
+#include "utils/teo_hashmap.h"
+#include "utils/teo_memory.h"
+
+#define MODULE "net_telemetry"
+
+#define TELEMETRY_KEY_SIZE (ARP_TABLE_IP_SIZE + sizeof(uint16_t))
+
+_Static_assert(sizeof(teoPeerTelemetryData) == 96,
+        "teoPeerTelemetryData layout is a part of CMD_PEER_TELEMETRY answer");
+_Static_assert(sizeof(teoPeerTelemetrySnapshot) == 24,
+        "teoPeerTelemetrySnapshot layout is a part of CMD_PEER_TELEMETRY answer");
+
+/**
+ * Peer telemetry record
+ */
+struct teoPeerTelemetry {
+    char name[TEO_TELEMETRY_NAME_SIZE]; ///< Peer name
+    char addr[ARP_TABLE_IP_SIZE];   ///< Peer address
+    int port;                       ///< Peer port
+    size_t idx;                     ///< Index in teoPeerTelemetryClass::peers
+    atomic_uint_fast64_t packets_in;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t packets_out;
+    atomic_uint_fast64_t bytes_out;
+    atomic_uint_fast32_t decrypt_failures;
+    atomic_uint_fast32_t rtt;       ///< Smoothed RTT, us
+    atomic_uint_fast32_t rtt_var;   ///< RTT variance, us
+};
+
+/**
+ * Per-peer telemetry table
+ */
+struct teoPeerTelemetryClass {
+    void *ke;                   ///< Pointer to ksnetEvMgrClass
+    teoHashMap *by_addr;        ///< Address and port key -> teoPeerTelemetry*
+    teoHashMap *by_name;        ///< Peer name -> teoPeerTelemetry*
+    teoPeerTelemetry **peers;   ///< Records array
+    size_t num;                 ///< Number of records
+    size_t size;                ///< Records array size
+};
+
+/**
+ * Make address map key: address string with trailing zero and port
+ *
+ * @return Key length
+ */
+static size_t telemetryKey(char *key, const char *addr, int port) {
+    size_t len = strnlen(addr, ARP_TABLE_IP_SIZE - 1);
+    memcpy(key, addr, len);
+    key[len++] = '\0';
+    uint16_t p = port;
+    memcpy(key + len, &p, sizeof(p));
+    return len + sizeof(p);
+}
+
+/**
+ * Initialize per-peer telemetry table
+ *
+ * @param ke Pointer to ksnetEvMgrClass
+ * @return Pointer to teoPeerTelemetryClass
+ */
+teoPeerTelemetryClass *teoPeerTelemetryInit(void *ke) {
+
+    teoPeerTelemetryClass *kpt = teo_calloc(sizeof(teoPeerTelemetryClass));
+    kpt->ke = ke;
+    kpt->by_addr = teoHashMapNew();
+    kpt->by_name = teoHashMapNew();
+
+    return kpt;
+}
+
+/**
+ * Destroy per-peer telemetry table
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ */
+void teoPeerTelemetryDestroy(teoPeerTelemetryClass *kpt) {
+
+    if(kpt == NULL) return;
+
+    teoPeerTelemetryRemoveAll(kpt);
+    teoHashMapFree(kpt->by_addr);
+    teoHashMapFree(kpt->by_name);
+    free(kpt->peers);
+    free(kpt);
+}
+
+/**
+ * Remove telemetry record
+ */
+static void telemetryRemove(teoPeerTelemetryClass *kpt, teoPeerTelemetry *pt) {
+
+    char key[TELEMETRY_KEY_SIZE];
+    size_t key_len = telemetryKey(key, pt->addr, pt->port);
+
+    teoHashMapRemove(kpt->by_addr, key, key_len);
+    teoHashMapRemoveStr(kpt->by_name, pt->name);
+
+    // Move last record to the removed record place
+    kpt->peers[pt->idx] = kpt->peers[--kpt->num];
+    kpt->peers[pt->idx]->idx = pt->idx;
+
+    free(pt);
+}
+
+/**
+ * Add peer telemetry record
+ *
+ * Existing record of the peer is kept if peer address is not changed.
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ * @param name Peer name
+ * @param addr Peer address
+ * @param port Peer port
+ */
+void teoPeerTelemetryAdd(teoPeerTelemetryClass *kpt, const char *name,
+        const char *addr, int port) {
+
+    if(kpt == NULL) return;
+
+    teoPeerTelemetry **ptp;
+    char key[TELEMETRY_KEY_SIZE];
+    size_t key_len = telemetryKey(key, addr, port);
+
+    // Remove records with the same name or the same address
+    if((ptp = teoHashMapGetStr(kpt->by_name, name, NULL))) {
+        if((*ptp)->port == port && !strcmp((*ptp)->addr, addr)) return;
+        telemetryRemove(kpt, *ptp);
+    }
+    if((ptp = teoHashMapGet(kpt->by_addr, key, key_len, NULL))) {
+        telemetryRemove(kpt, *ptp);
+    }
+
+    teoPeerTelemetry *pt = teo_calloc(sizeof(teoPeerTelemetry));
+    strncpy(pt->name, name, sizeof(pt->name) - 1);
+    strncpy(pt->addr, addr, sizeof(pt->addr) - 1);
+    pt->port = port;
+
+    if(kpt->num == kpt->size) {
+        kpt->size = kpt->size ? kpt->size * 2 : 64;
+        kpt->peers = teo_realloc(kpt->peers, kpt->size * sizeof(*kpt->peers));
+    }
+    pt->idx = kpt->num;
+    kpt->peers[kpt->num++] = pt;
+
+    teoHashMapAdd(kpt->by_addr, key, key_len, &pt, sizeof(pt));
+    teoHashMapAddStr(kpt->by_name, name, &pt, sizeof(pt));
+}
+
+/**
+ * Remove peer telemetry record
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ * @param name Peer name
+ */
+void teoPeerTelemetryRemove(teoPeerTelemetryClass *kpt, const char *name) {
+
+    if(kpt == NULL) return;
+
+    teoPeerTelemetry **ptp = teoHashMapGetStr(kpt->by_name, name, NULL);
+    if(ptp != NULL) telemetryRemove(kpt, *ptp);
+}
+
+/**
+ * Remove all peers telemetry records
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ */
+void teoPeerTelemetryRemoveAll(teoPeerTelemetryClass *kpt) {
+
+    if(kpt == NULL) return;
+
+    size_t i;
+    for(i = 0; i < kpt->num; i++) free(kpt->peers[i]);
+    kpt->num = 0;
+    teoHashMapClear(kpt->by_addr);
+    teoHashMapClear(kpt->by_name);
+}
+
+/**
+ * Find peer telemetry record by peer address
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ * @param addr Peer address
+ * @param port Peer port
+ *
+ * @return Pointer to teoPeerTelemetry or NULL if peer is not in ARP table
+ */
+teoPeerTelemetry *teoPeerTelemetryFind(teoPeerTelemetryClass *kpt,
+        const char *addr, int port) {
+
+    if(kpt == NULL || !kpt->num) return NULL;
+
+    char key[TELEMETRY_KEY_SIZE];
+    teoPeerTelemetry **ptp = teoHashMapGet(kpt->by_addr, key,
+            telemetryKey(key, addr, port), NULL);
+
+    return ptp ? *ptp : NULL;
+}
+
+/**
+ * Count packet received from peer
+ *
+ * @param pt Pointer to teoPeerTelemetry or NULL
+ * @param bytes Packet length
+ */
+void teoPeerTelemetryIn(teoPeerTelemetry *pt, size_t bytes) {
+    if(pt == NULL) return;
+    atomic_fetch_add_explicit(&pt->packets_in, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pt->bytes_in, bytes, memory_order_relaxed);
+}
+
+/**
+ * Count packet sent to peer
+ *
+ * @param pt Pointer to teoPeerTelemetry or NULL
+ * @param bytes Packet length
+ */
+void teoPeerTelemetryOut(teoPeerTelemetry *pt, size_t bytes) {
+    if(pt == NULL) return;
+    atomic_fetch_add_explicit(&pt->packets_out, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pt->bytes_out, bytes, memory_order_relaxed);
+}
+
+/**
+ * Count packet which can't be decrypted
+ *
+ * @param pt Pointer to teoPeerTelemetry or NULL
+ */
+void teoPeerTelemetryDecryptFailed(teoPeerTelemetry *pt) {
+    if(pt == NULL) return;
+    atomic_fetch_add_explicit(&pt->decrypt_failures, 1, memory_order_relaxed);
+}
+
+/**
+ * Add round trip time sample
+ *
+ * Smoothed RTT and variance are calculated as in RFC 6298:
+ * rtt_var = 3/4 * rtt_var + 1/4 * |rtt - sample|, rtt = 7/8 * rtt + 1/8 * sample
+ *
+ * @param pt Pointer to teoPeerTelemetry or NULL
+ * @param triptime Round trip time, ms
+ */
+void teoPeerTelemetryRtt(teoPeerTelemetry *pt, double triptime) {
+
+    if(pt == NULL || triptime < 0) return;
+
+    uint32_t r = (uint32_t)(triptime * 1000.0);
+    uint32_t rtt = atomic_load_explicit(&pt->rtt, memory_order_relaxed);
+    uint32_t var = atomic_load_explicit(&pt->rtt_var, memory_order_relaxed);
+
+    if(!rtt) {
+        rtt = r ? r : 1;
+        var = r / 2;
+    }
+    else {
+        uint32_t diff = rtt > r ? rtt - r : r - rtt;
+        var = var - var / 4 + diff / 4;
+        rtt = rtt - rtt / 8 + r / 8;
+    }
+
+    atomic_store_explicit(&pt->rtt, rtt, memory_order_relaxed);
+    atomic_store_explicit(&pt->rtt_var, var, memory_order_relaxed);
+}
+
+/**
+ * Get per-peer telemetry snapshot of all peers
+ *
+ * Should be called from event loop thread.
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ * @param length [out] Snapshot length
+ *
+ * @return Pointer to teoPeerTelemetrySnapshot, should be free after use
+ */
+teoPeerTelemetrySnapshot *teoPeerTelemetryGetSnapshot(
+        teoPeerTelemetryClass *kpt, size_t *length) {
+
+    return teoPeerTelemetryGetSnapshotPage(kpt, 0, SIZE_MAX, length);
+}
+
+/**
+ * Get per-peer telemetry snapshot of peers table page
+ *
+ * Should be called from event loop thread.
+ *
+ * @param kpt Pointer to teoPeerTelemetryClass
+ * @param offset Index of first record
+ * @param count Maximal number of records
+ * @param length [out] Snapshot length
+ *
+ * @return Pointer to teoPeerTelemetrySnapshot, should be free after use
+ */
+teoPeerTelemetrySnapshot *teoPeerTelemetryGetSnapshotPage(
+        teoPeerTelemetryClass *kpt, size_t offset, size_t count,
+        size_t *length) {
+
+    size_t total = kpt ? kpt->num : 0;
+    if(offset > total) offset = total;
+    size_t num = total - offset < count ? total - offset : count;
+    size_t len = sizeof(teoPeerTelemetrySnapshot) +
+            num * sizeof(teoPeerTelemetryData);
+    teoPeerTelemetrySnapshot *ts = teo_calloc(len);
+    ts->version = TEO_TELEMETRY_VERSION;
+    ts->length = num;
+    ts->offset = offset;
+    ts->total = total;
+    if(length != NULL) *length = len;
+    if(kpt == NULL) return ts;
+
+    ksnetEvMgrClass *ke = kpt->ke;
+    ts->time = ksnetEvMgrGetTime(ke);
+
+    size_t i;
+    for(i = 0; i < num; i++) {
+        teoPeerTelemetry *pt = kpt->peers[offset + i];
+        teoPeerTelemetryData *td = &ts->peer[i];
+
+        memcpy(td->name, pt->name, sizeof(td->name));
+        td->packets_in = atomic_load_explicit(&pt->packets_in,
+                memory_order_relaxed);
+        td->bytes_in = atomic_load_explicit(&pt->bytes_in,
+                memory_order_relaxed);
+        td->packets_out = atomic_load_explicit(&pt->packets_out,
+                memory_order_relaxed);
+        td->bytes_out = atomic_load_explicit(&pt->bytes_out,
+                memory_order_relaxed);
+        td->decrypt_failures = atomic_load_explicit(&pt->decrypt_failures,
+                memory_order_relaxed);
+        td->rtt = atomic_load_explicit(&pt->rtt, memory_order_relaxed);
+        td->rtt_var = atomic_load_explicit(&pt->rtt_var, memory_order_relaxed);
+
+        // TR-UDP channel statistic
+        if(ke->kc == NULL || ke->kc->ku == NULL) continue;
+        trudpChannelData *tcd = trudpGetChannelAddr(ke->kc->ku, pt->addr,
+                pt->port, 0);
+        if(tcd != (void*)-1) {
+            td->retransmits = tcd->stat.packets_attempt;
+            td->send_queue = trudpSendQueueSize(tcd->sendQueue);
+        }
+    }
+
+    return ts;
+}
@@ -0,0 +1,103 @@
+/**
+ * File:   net_telemetry.h
+ * Author: max
+ *
+ * Created on Oct 19, 2026
+ *
+ * Per-peer telemetry table
+ *
+ * Telemetry records are created for peers added to the ARP table and keyed by
+ * peer address and port, so the receive path finds the record before the
+ * packet is decrypted. Counters are updated on the hot path with relaxed
+ * atomic adds. The table is read with a fixed layout binary snapshot
+ * (teoPeerTelemetryGetSnapshot or CMD_PEER_TELEMETRY command).
+ *
+ * CMD_PEER_TELEMETRY answer holds at most TEO_TELEMETRY_PAGE_MAX records so
+ * it fits into L0 packet. Larger tables are read by pages: the request data
+ * is teoPeerTelemetryRequest with offset of first record, and the next page
+ * is requested while answer offset + length is less than total.
+ */
+
+#ifndef NET_TELEMETRY_H
+#define NET_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TEO_TELEMETRY_VERSION 2 ///< Snapshot layout version
+#define TEO_TELEMETRY_NAME_SIZE 40 ///< Peer name size (ARP_TABLE_NAME_SIZE)
+#define TEO_TELEMETRY_PAGE_MAX 336 ///< Records in CMD_PEER_TELEMETRY answer,
+                                   ///< limited by L0 packet data (32319 bytes)
+
+/**
+ * Peer telemetry record in snapshot (fixed layout, host byte order)
+ */
+typedef struct teoPeerTelemetryData {
+    char name[TEO_TELEMETRY_NAME_SIZE]; ///< Peer name
+    uint64_t packets_in;        ///< Packets received from peer
+    uint64_t bytes_in;          ///< Bytes received from peer
+    uint64_t packets_out;       ///< Packets sent to peer
+    uint64_t bytes_out;         ///< Bytes sent to peer
+    uint64_t retransmits;       ///< TR-UDP packets retransmits
+    uint32_t decrypt_failures;  ///< Packets which can't be decrypted
+    uint32_t send_queue;        ///< TR-UDP send queue size
+    uint32_t rtt;               ///< Smoothed round trip time, us
+    uint32_t rtt_var;           ///< Round trip time variance, us
+} teoPeerTelemetryData;
+
+/**
+ * Peers telemetry snapshot
+ */
+typedef struct teoPeerTelemetrySnapshot {
+    uint32_t version;           ///< TEO_TELEMETRY_VERSION
+    uint32_t length;            ///< Number of peer records
+    double time;                ///< Snapshot time
+    uint32_t offset;            ///< Index of first record in peers table
+    uint32_t total;             ///< Number of peers in table
+    teoPeerTelemetryData peer[]; ///< Peer records
+} teoPeerTelemetrySnapshot;
+
+/**
+ * CMD_PEER_TELEMETRY request data (optional, host byte order)
+ */
+typedef struct teoPeerTelemetryRequest {
+    uint32_t offset;            ///< Index of first record
+    uint32_t count;             ///< Maximal number of records, 0 - page max
+} teoPeerTelemetryRequest;
+
+typedef struct teoPeerTelemetry teoPeerTelemetry;
+typedef struct teoPeerTelemetryClass teoPeerTelemetryClass;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+teoPeerTelemetryClass *teoPeerTelemetryInit(void *ke);
+void teoPeerTelemetryDestroy(teoPeerTelemetryClass *kpt);
+
+// Peers records, called when ARP table is changed
+void teoPeerTelemetryAdd(teoPeerTelemetryClass *kpt, const char *name,
+        const char *addr, int port);
+void teoPeerTelemetryRemove(teoPeerTelemetryClass *kpt, const char *name);
+void teoPeerTelemetryRemoveAll(teoPeerTelemetryClass *kpt);
+
+// Hot path
+teoPeerTelemetry *teoPeerTelemetryFind(teoPeerTelemetryClass *kpt,
+        const char *addr, int port);
+void teoPeerTelemetryIn(teoPeerTelemetry *pt, size_t bytes);
+void teoPeerTelemetryOut(teoPeerTelemetry *pt, size_t bytes);
+void teoPeerTelemetryDecryptFailed(teoPeerTelemetry *pt);
+void teoPeerTelemetryRtt(teoPeerTelemetry *pt, double triptime);
+
+// Snapshot
+teoPeerTelemetrySnapshot *teoPeerTelemetryGetSnapshot(
+        teoPeerTelemetryClass *kpt, size_t *length);
+teoPeerTelemetrySnapshot *teoPeerTelemetryGetSnapshotPage(
+        teoPeerTelemetryClass *kpt, size_t offset, size_t count,
+        size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_TELEMETRY_H */
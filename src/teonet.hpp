@@ -44,6 +44,12 @@
 #include <string>
 #include <vector>
 
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define TEONET_COROUTINES 1
+#include <coroutine>
+#include <exception>
+#endif
+
 #include "ev_mgr.h"
 #include "modules/log_reader.h"
 #include "modules/subscribe.h"
@@ -257,6 +263,19 @@ public:
     return ksnCommandSendCmdEcho(ke->kc->kco, (char*)to, data, data_len);
   }
 
+  typedef std::unique_ptr<teoPeerTelemetrySnapshot,
+      unique_raw_ptr::destroy<teoPeerTelemetrySnapshot*>> telemetryPtr;
+
+  /**
+   * Get per-peer telemetry snapshot (call it from event loop thread)
+   *
+   * @param length [out] Snapshot length or NULL
+   * @return Pointer to teoPeerTelemetrySnapshot
+   */
+  inline telemetryPtr getPeerTelemetry(size_t* length = NULL) const {
+    return telemetryPtr(teoPeerTelemetryGetSnapshot(ke->kc->kpt, length));
+  }
+
   /**
    * Send data to L0 client. Usually it is an answer to request from L0 client
    *
@@ -964,6 +983,424 @@ public:
       return teoLogReaderClose(wd);
     }
   };
+
+#ifdef TEONET_COROUTINES
+  /**
+   * Coroutine frames allocator.
+   *
+   * Frames of finished coroutines are kept in per size free lists and reused
+   * by next coroutines, so steady state request processing does not allocate
+   * memory. Coroutines run in event loop thread, the pool is thread local.
+   */
+  class FramePool {
+
+    static constexpr size_t GRANULE = 64;  //! Frame size granule
+    static constexpr size_t CLASSES = 64;  //! Number of pooled frame sizes (up to 4K)
+
+    struct Node {
+      Node* next;
+    };
+    Node* free_list[CLASSES] = {};
+
+  public:
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    ~FramePool() {
+      for(auto& head : free_list) {
+        while(head) {
+          auto next = head->next;
+          ::operator delete(head);
+          head = next;
+        }
+      }
+    }
+
+    static FramePool& instance() {
+      static thread_local FramePool pool;
+      return pool;
+    }
+
+    void* allocate(size_t size) {
+      auto idx = (size + GRANULE - 1) / GRANULE;
+      if(idx >= CLASSES) return ::operator new(size);
+      if(auto node = free_list[idx]) {
+        free_list[idx] = node->next;
+        return node;
+      }
+      return ::operator new(idx * GRANULE);
+    }
+
+    void deallocate(void* ptr, size_t size) {
+      auto idx = (size + GRANULE - 1) / GRANULE;
+      if(idx >= CLASSES) {
+        ::operator delete(ptr);
+        return;
+      }
+      auto node = static_cast<Node*>(ptr);
+      node->next = free_list[idx];
+      free_list[idx] = node;
+    }
+  };
+
+  /**
+   * Coroutine task.
+   *
+   * Fire and forget coroutine: starts immediately when called and destroys
+   * itself when finished. Coroutine frame is allocated from FramePool.
+   */
+  struct Task {
+    struct promise_type {
+      Task get_return_object() noexcept { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() noexcept {}
+      void unhandled_exception() noexcept { std::terminate(); }
+
+      static void* operator new(size_t size) { return FramePool::instance().allocate(size); }
+      static void operator delete(void* ptr, size_t size) {
+        FramePool::instance().deallocate(ptr, size);
+      }
+    };
+  };
+
+  /**
+   * Teonet coroutines class.
+   *
+   * Request/response over CQue: the request sent to peer is prefixed with
+   * CoroHeader which contains CQue id, the peer answers with Coro::answer
+   * which returns the same header, and Coro::process called from eventCb
+   * finds the request and resumes the coroutine awaiting it:
+   *
+   *   Task get(Coro& co) {
+   *     auto r = co_await co.request("teo-db", CMD_USER, "key", 2.0);
+   *     if(r.ok()) std::cout << r.getStr() << "\n";
+   *   }
+   *
+   * Coroutines are resumed from the event loop ev_prepare watcher, not from
+   * the CQue callbacks.
+   */
+  class Coro {
+
+  public:
+    static constexpr size_t INLINE_DATA = 512; //! Response data stored without allocation
+    static constexpr uint32_t MAGIC = 0x4F43u; //! CoroHeader label ("CO")
+
+#pragma pack(push)
+#pragma pack(1)
+    struct CoroHeader {
+      uint32_t magic;
+      uint32_t id;
+    };
+#pragma pack(pop)
+
+    enum class Status { Pending, Ok, Timeout, Cancelled };
+
+    /**
+     * Request result
+     */
+    class Response {
+
+      friend class Coro;
+
+      Status status = Status::Pending;
+      uint8_t cmd = 0;
+      size_t data_len = 0;
+      std::unique_ptr<char[]> big;
+      char inline_data[INLINE_DATA];
+
+      void set(uint8_t cmd, const void* data, size_t len) {
+        this->cmd = cmd;
+        data_len = len;
+        if(len > INLINE_DATA) big.reset(new char[len]);
+        memcpy(getData(), data, len);
+      }
+
+    public:
+      Response() = default;
+      Response(Response&& r) noexcept
+          : status(r.status), cmd(r.cmd), data_len(r.data_len), big(std::move(r.big)) {
+        if(!big) memcpy(inline_data, r.inline_data, data_len);
+      }
+
+      inline Status getStatus() const { return status; }
+      inline bool ok() const { return status == Status::Ok; }
+      inline uint8_t getCmd() const { return cmd; }
+      inline void* getData() { return big ? big.get() : inline_data; }
+      inline const char* getStr() { return (const char*)getData(); }
+      inline size_t getDataLength() const { return data_len; }
+    };
+
+  private:
+    /**
+     * Awaiting coroutine and number of requests it waits for
+     */
+    struct Waiter {
+      std::coroutine_handle<> handle;
+      Waiter* next = nullptr; // Next in ready list
+      int pending = 0;
+    };
+
+  public:
+    /**
+     * Request awaitable. The request is sent when created, co_await
+     * suspends until answer, timeout or cancel.
+     */
+    class Request : Waiter {
+
+      friend class Coro;
+      template <size_t N> friend class WhenAll;
+
+      Coro* coro;
+      Waiter* parent = this; // Request or whenAll waiter to notify
+      uint32_t id = 0;
+      char peer[KSN_BUFFER_SM_SIZE];
+      Response response;
+
+      static void cqueCb(uint32_t id, int type, void* data) {
+        auto r = static_cast<Request*>(data);
+        r->complete(type ? Status::Ok : Status::Timeout);
+      }
+
+      void complete(Status status) {
+        response.status = status;
+        id = 0;
+        if(!--parent->pending && parent->handle) coro->schedule(parent);
+      }
+
+    public:
+      Request(Coro* coro, const char* peer, uint8_t cmd, const void* data, size_t data_len,
+              double timeout)
+          : coro(coro) {
+
+        pending = 1;
+        strncpy(this->peer, peer, sizeof(this->peer) - 1);
+        this->peer[sizeof(this->peer) - 1] = '\0';
+
+        auto cq = coro->cque.add((cqueCallback)cqueCb, timeout, this);
+        if(!cq) {
+          response.status = Status::Cancelled;
+          pending = 0;
+          return;
+        }
+        id = cq->id;
+
+        // Send request with header
+        char buf[sizeof(CoroHeader) + INLINE_DATA];
+        std::unique_ptr<char[]> big;
+        char* out = buf;
+        if(data_len > INLINE_DATA) out = (big = std::unique_ptr<char[]>(
+                                               new char[sizeof(CoroHeader) + data_len]))
+                                              .get();
+        auto hdr = reinterpret_cast<CoroHeader*>(out);
+        hdr->magic = MAGIC;
+        hdr->id = id;
+        if(data_len) memcpy(out + sizeof(CoroHeader), data, data_len);
+        coro->teo->sendTo(peer, cmd, out, sizeof(CoroHeader) + data_len);
+      }
+      Request(const Request&) = delete;
+      Request& operator=(const Request&) = delete;
+      ~Request() {
+        if(id) coro->cque.remove(id);
+        coro->unschedule(this);
+      }
+
+      /**
+       * Cancel request, awaiting coroutine is resumed with Status::Cancelled
+       */
+      void cancel() {
+        if(response.status != Status::Pending) return;
+        if(id) coro->cque.remove(id);
+        complete(Status::Cancelled);
+      }
+
+      inline Status getStatus() const { return response.status; }
+      inline Response& getResponse() { return response; }
+
+      bool await_ready() const noexcept { return response.status != Status::Pending; }
+      void await_suspend(std::coroutine_handle<> h) noexcept { handle = h; }
+      Response await_resume() noexcept { return std::move(response); }
+    };
+
+    /**
+     * Awaitable of a group of requests, resumes when all requests are done
+     */
+    template <size_t N> class WhenAll : Waiter {
+
+      friend class Coro;
+
+      Request* requests[N];
+
+    public:
+      template <typename... R> explicit WhenAll(R&... r) : requests{&r...} {}
+      WhenAll(const WhenAll&) = delete;
+      ~WhenAll() {
+        if(handle && N) requests[0]->coro->unschedule(this);
+      }
+
+      bool await_ready() const noexcept {
+        for(auto r : requests)
+          if(r->getStatus() == Status::Pending) return false;
+        return true;
+      }
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        handle = h;
+        for(auto r : requests) {
+          if(r->getStatus() == Status::Pending) {
+            r->parent = this;
+            pending++;
+          }
+        }
+      }
+      void await_resume() const noexcept {}
+    };
+
+  private:
+    Teonet* teo;
+    CQue cque;
+    ev_prepare prepare_w;
+    Waiter* ready = nullptr;      // Ready to resume list
+    Waiter* ready_last = nullptr;
+
+    void schedule(Waiter* w) {
+      w->next = nullptr;
+      if(ready_last)
+        ready_last->next = w;
+      else
+        ready = w;
+      ready_last = w;
+      if(!ev_is_active(&prepare_w)) ev_prepare_start(teo->getKe()->ev_loop, &prepare_w);
+    }
+
+    void unschedule(Waiter* w) {
+      Waiter* prev = nullptr;
+      for(auto it = ready; it; prev = it, it = it->next) {
+        if(it != w) continue;
+        if(prev)
+          prev->next = it->next;
+        else
+          ready = it->next;
+        if(ready_last == it) ready_last = prev;
+        break;
+      }
+    }
+
+    static void prepareCb(EV_P_ ev_prepare* w, int revents) {
+      auto coro = static_cast<Coro*>(w->data);
+      while(auto waiter = coro->ready) {
+        coro->ready = waiter->next;
+        if(!coro->ready) coro->ready_last = nullptr;
+        waiter->handle.resume();
+      }
+      ev_prepare_stop(EV_A_ w);
+    }
+
+  public:
+    explicit Coro(Teonet* t) : teo(t), cque(t) {
+      ev_prepare_init(&prepare_w, prepareCb);
+      prepare_w.data = this;
+    }
+    Coro(const Coro&) = delete;
+    virtual ~Coro() {
+      if(ksnetEvMgrStatus(teo->getKe()) == kEventMgrRunning)
+        ev_prepare_stop(teo->getKe()->ev_loop, &prepare_w);
+    }
+
+    /**
+     * Send request to peer, co_await the result to get Response
+     *
+     * @param peer Peer name
+     * @param cmd Command
+     * @param data Request data
+     * @param data_len Request data length
+     * @param timeout Answer timeout
+     *
+     * @return Request awaitable
+     */
+    inline Request request(const char* peer, uint8_t cmd, const void* data, size_t data_len,
+                           double timeout = 5.00) {
+      return Request(this, peer, cmd, data, data_len, timeout);
+    }
+    inline Request request(const std::string& peer, uint8_t cmd, const std::string& data,
+                           double timeout = 5.00) {
+      return Request(this, peer.c_str(), cmd, data.c_str(), data.size() + 1, timeout);
+    }
+
+    /**
+     * Wait all requests: co_await co.whenAll(r1, r2, r3)
+     */
+    template <typename... R> inline WhenAll<sizeof...(R)> whenAll(R&... r) {
+      return WhenAll<sizeof...(R)>(r...);
+    }
+
+    /**
+     * Send answer to request received from peer or L0 client
+     *
+     * @param rd Pointer to received request packet
+     * @param cmd Answer command
+     * @param data Answer data
+     * @param data_len Answer data length
+     */
+    void answer(teo::teoPacket* rd, uint8_t cmd, const void* data, size_t data_len) const {
+
+      if(!isRequest(rd)) return;
+
+      char buf[sizeof(CoroHeader) + INLINE_DATA];
+      std::unique_ptr<char[]> big;
+      char* out = buf;
+      if(data_len > INLINE_DATA)
+        out = (big = std::unique_ptr<char[]>(new char[sizeof(CoroHeader) + data_len])).get();
+      memcpy(out, rd->data, sizeof(CoroHeader));
+      if(data_len) memcpy(out + sizeof(CoroHeader), data, data_len);
+
+      auto ke = teo->getKe();
+      if(rd->l0_f)
+        ksnLNullSendToL0(ke, rd->addr, rd->port, rd->from, rd->from_len, cmd, out,
+                         sizeof(CoroHeader) + data_len);
+      else
+        ksnCoreSendCmdto(ke->kc, rd->from, cmd, out, sizeof(CoroHeader) + data_len);
+    }
+    inline void answer(teo::teoPacket* rd, uint8_t cmd, const std::string& data) const {
+      answer(rd, cmd, data.c_str(), data.size() + 1);
+    }
+
+    /**
+     * Check that packet contains coroutine request or answer header
+     */
+    static inline bool isRequest(teo::teoPacket* rd) {
+      return rd && rd->data_len >= sizeof(CoroHeader) &&
+             reinterpret_cast<CoroHeader*>(rd->data)->magic == MAGIC;
+    }
+
+    /**
+     * Get request data (without header)
+     */
+    static inline void* getRequestData(teo::teoPacket* rd) {
+      return (char*)rd->data + sizeof(CoroHeader);
+    }
+    static inline size_t getRequestDataLength(teo::teoPacket* rd) {
+      return rd->data_len - sizeof(CoroHeader);
+    }
+
+    /**
+     * Process teonet event, should be called from eventCb
+     *
+     * @return True if event contains answer to one of our requests
+     */
+    bool process(teoEvents event, void* data) {
+
+      if(event != EV_K_RECEIVED) return false;
+      auto rd = teo->getPacket(data);
+      if(!isRequest(rd)) return false;
+
+      auto id = reinterpret_cast<CoroHeader*>(rd->data)->id;
+      auto r = static_cast<Request*>(cque.getCQueData(id));
+      if(!r || strcmp(r->peer, rd->from)) return false;
+
+      r->response.set(rd->cmd, getRequestData(rd), getRequestDataLength(rd));
+      return !cque.exec(id);
+    }
+  };
+#endif
 };
 
 /**
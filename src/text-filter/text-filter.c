@@ -0,0 +1,345 @@
+/**
+* \file text-filter.c
+* \author max
+* Created on Fri Feb 19 00:37:51 2021
+*
+* Compiled log filter.
+*
+* The filter expression is parsed once into a postfix program of substring
+* tests, and all words of the expression are merged into one Aho-Corasick
+* automaton. Matching a log line is then a single pass over the line which
+* collects a bitmask of found words, followed by evaluation of the program on
+* a small stack. Matching does not allocate memory and does not change the
+* compiled filter, so one filter may be used from several threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "text-filter.h"
+
+#define TF_ALPHABET 27 ///< Word characters: 'a'..'z' and '_'
+
+/**
+ * Filter program operations
+ */
+enum tf_op {
+    TF_OP_TERM, ///< Push "word found" flag
+    TF_OP_NOT,
+    TF_OP_AND,
+    TF_OP_OR
+};
+
+/**
+ * Filter program instruction
+ */
+typedef struct tf_insn {
+    unsigned char op;   ///< Operation, one of tf_op
+    unsigned char term; ///< Word index for TF_OP_TERM
+} tf_insn;
+
+/**
+ * Compiled filter
+ */
+struct teoLogFilter {
+
+    tf_insn *code;        ///< Postfix program
+    size_t code_len;      ///< Number of instructions in program
+
+    int *delta;           ///< Automaton transitions: states x TF_ALPHABET
+    uint64_t *out;        ///< Words found when automaton reaches a state
+    size_t states;        ///< Number of automaton states
+
+    uint64_t all_terms;   ///< Mask of all words of the expression
+};
+
+/**
+ * Expression compiler state
+ */
+typedef struct tf_compiler {
+
+    const char *p;        ///< Current position in expression
+    int error;            ///< Error flag
+
+    tf_insn *code;
+    size_t code_len;
+    size_t code_size;
+    size_t depth;         ///< Current program stack depth
+    size_t max_depth;     ///< Maximum program stack depth
+    size_t nesting;       ///< Current nesting of '!' and '(' (recursion)
+
+    char *terms[TEO_LOG_FILTER_MAX_TERMS]; ///< Unique words
+    size_t terms_len[TEO_LOG_FILTER_MAX_TERMS];
+    size_t num_terms;
+
+} tf_compiler;
+
+/**
+ * Map character to automaton symbol
+ *
+ * @param c Character
+ * @return Symbol index or -1 if character can't be a part of word
+ */
+static inline int tf_symbol(unsigned char c) {
+    if(c >= 'a' && c <= 'z') return c - 'a';
+    if(c == '_') return 26;
+    return -1;
+}
+
+static void tf_skip_spaces(tf_compiler *tc) {
+    while(*tc->p == ' ' || *tc->p == '\t') tc->p++;
+}
+
+static void tf_emit(tf_compiler *tc, unsigned char op, unsigned char term) {
+
+    if(tc->code_len == tc->code_size) {
+        tc->code_size = tc->code_size ? tc->code_size * 2 : 16;
+        tc->code = realloc(tc->code, tc->code_size * sizeof(tf_insn));
+    }
+    tc->code[tc->code_len].op = op;
+    tc->code[tc->code_len].term = term;
+    tc->code_len++;
+
+    switch(op) {
+        case TF_OP_TERM:
+            if(++tc->depth > tc->max_depth) tc->max_depth = tc->depth;
+            if(tc->max_depth > TEO_LOG_FILTER_MAX_DEPTH) tc->error = 1;
+            break;
+        case TF_OP_AND:
+        case TF_OP_OR:
+            tc->depth--;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Add word to the unique words list
+ *
+ * @return Word index or -1 if there is too many words
+ */
+static int tf_term(tf_compiler *tc, const char *word, size_t len) {
+
+    size_t i;
+    for(i = 0; i < tc->num_terms; i++) {
+        if(tc->terms_len[i] == len && !memcmp(tc->terms[i], word, len)) {
+            return (int)i;
+        }
+    }
+    if(tc->num_terms == TEO_LOG_FILTER_MAX_TERMS) return -1;
+
+    tc->terms[i] = strndup(word, len);
+    tc->terms_len[i] = len;
+    tc->num_terms++;
+
+    return (int)i;
+}
+
+static void tf_expr(tf_compiler *tc);
+
+static void tf_unary(tf_compiler *tc) {
+
+    if(tc->error) return;
+    tf_skip_spaces(tc);
+
+    if((*tc->p == '!' || *tc->p == '(') &&
+            tc->nesting == TEO_LOG_FILTER_MAX_DEPTH) {
+        tc->error = 1;
+    }
+    else if(*tc->p == '!') {
+        tc->p++;
+        tc->nesting++;
+        tf_unary(tc);
+        tc->nesting--;
+        tf_emit(tc, TF_OP_NOT, 0);
+    }
+    else if(*tc->p == '(') {
+        tc->p++;
+        tc->nesting++;
+        tf_expr(tc);
+        tc->nesting--;
+        tf_skip_spaces(tc);
+        if(*tc->p != ')') tc->error = 1;
+        else tc->p++;
+    }
+    else if(tf_symbol(*tc->p) >= 0) {
+        const char *word = tc->p;
+        while(tf_symbol(*tc->p) >= 0) tc->p++;
+        int term = tf_term(tc, word, tc->p - word);
+        if(term < 0) tc->error = 1;
+        else tf_emit(tc, TF_OP_TERM, (unsigned char)term);
+    }
+    else tc->error = 1;
+}
+
+/*
+ * AND and OR have the same priority and are left associative, the same as in
+ * the grammar-filter.y
+ */
+static void tf_expr(tf_compiler *tc) {
+
+    tf_unary(tc);
+    while(!tc->error) {
+        tf_skip_spaces(tc);
+        if(*tc->p == '&') {
+            tc->p++;
+            tf_unary(tc);
+            tf_emit(tc, TF_OP_AND, 0);
+        }
+        else if(*tc->p == '|') {
+            tc->p++;
+            tf_unary(tc);
+            tf_emit(tc, TF_OP_OR, 0);
+        }
+        else break;
+    }
+}
+
+/**
+ * Build Aho-Corasick automaton of the expression words
+ */
+static void tf_build_automaton(teoLogFilter *lf, tf_compiler *tc) {
+
+    size_t i, j, max_states = 1;
+    for(i = 0; i < tc->num_terms; i++) max_states += tc->terms_len[i];
+
+    lf->delta = malloc(max_states * TF_ALPHABET * sizeof(int));
+    lf->out = calloc(max_states, sizeof(uint64_t));
+    int *fail = calloc(max_states, sizeof(int));
+    int *queue = malloc(max_states * sizeof(int));
+    for(i = 0; i < max_states * TF_ALPHABET; i++) lf->delta[i] = -1;
+
+    // Trie
+    lf->states = 1;
+    for(i = 0; i < tc->num_terms; i++) {
+        int s = 0;
+        for(j = 0; j < tc->terms_len[i]; j++) {
+            int *next = &lf->delta[s * TF_ALPHABET + tf_symbol(tc->terms[i][j])];
+            if(*next < 0) *next = (int)lf->states++;
+            s = *next;
+        }
+        lf->out[s] |= (uint64_t)1 << i;
+    }
+
+    // Failure links resolved into a complete transition table
+    size_t head = 0, tail = 0;
+    for(j = 0; j < TF_ALPHABET; j++) {
+        int *next = &lf->delta[j];
+        if(*next < 0) *next = 0;
+        else { fail[*next] = 0; queue[tail++] = *next; }
+    }
+    while(head < tail) {
+        int s = queue[head++];
+        lf->out[s] |= lf->out[fail[s]];
+        for(j = 0; j < TF_ALPHABET; j++) {
+            int *next = &lf->delta[s * TF_ALPHABET + j];
+            int f = lf->delta[fail[s] * TF_ALPHABET + j];
+            if(*next < 0) *next = f;
+            else { fail[*next] = f; queue[tail++] = *next; }
+        }
+    }
+
+    free(queue);
+    free(fail);
+}
+
+/**
+ * Compile filter expression
+ *
+ * @param match Logic expression, f.e. "(net_core|net_crypt)&(!tr_udp)"
+ *
+ * @return Pointer to compiled filter or NULL if expression is invalid. Should
+ *         be freed with teoLogFilterFree
+ */
+teoLogFilter *teoLogFilterCompile(const char *match) {
+
+    if(match == NULL) return NULL;
+
+    tf_compiler tc;
+    memset(&tc, 0, sizeof(tc));
+    tc.p = match;
+
+    tf_expr(&tc);
+    tf_skip_spaces(&tc);
+    if(*tc.p != '\0') tc.error = 1;
+
+    teoLogFilter *lf = NULL;
+    if(!tc.error && tc.code_len) {
+        lf = calloc(1, sizeof(teoLogFilter));
+        lf->code = tc.code;
+        lf->code_len = tc.code_len;
+        lf->all_terms = tc.num_terms == 64 ? ~(uint64_t)0 :
+                ((uint64_t)1 << tc.num_terms) - 1;
+        tf_build_automaton(lf, &tc);
+        tc.code = NULL;
+    }
+
+    size_t i;
+    for(i = 0; i < tc.num_terms; i++) free(tc.terms[i]);
+    free(tc.code);
+
+    return lf;
+}
+
+/**
+ * Apply compiled filter to log string
+ *
+ * @param lf Compiled filter
+ * @param log Log string
+ *
+ * @return 1 if log string match filter, 0 if not
+ */
+int teoLogFilterMatch(const teoLogFilter *lf, const char *log) {
+
+    // Collect words found in the log line
+    uint64_t found = 0;
+    int s = 0;
+    const unsigned char *p;
+    for(p = (const unsigned char *)log; *p; p++) {
+        int c = tf_symbol(*p);
+        if(c < 0) { s = 0; continue; }
+        s = lf->delta[s * TF_ALPHABET + c];
+        found |= lf->out[s];
+        if(found == lf->all_terms) break;
+    }
+
+    // Execute program
+    unsigned char stack[TEO_LOG_FILTER_MAX_DEPTH];
+    size_t i, sp = 0;
+    for(i = 0; i < lf->code_len; i++) {
+        switch(lf->code[i].op) {
+            case TF_OP_TERM:
+                stack[sp++] = (found >> lf->code[i].term) & 1;
+                break;
+            case TF_OP_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+            case TF_OP_AND:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] && stack[sp];
+                break;
+            case TF_OP_OR:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] || stack[sp];
+                break;
+        }
+    }
+
+    return stack[0];
+}
+
+/**
+ * Free compiled filter
+ *
+ * @param lf Compiled filter (may be NULL)
+ */
+void teoLogFilterFree(teoLogFilter *lf) {
+
+    if(lf == NULL) return;
+    free(lf->code);
+    free(lf->delta);
+    free(lf->out);
+    free(lf);
+}
@@ -10,6 +10,12 @@
 #ifndef TEXT_FILTER_H
 #define TEXT_FILTER_H
 
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 
 /*
  * This function applies logic expression "match" to string "log"
@@ -28,4 +34,29 @@
 
 int log_string_match(char *log, char *match);
 
+/*
+ * Compiled filter. The expression is parsed once by teoLogFilterCompile and
+ * then applied to any number of log strings by teoLogFilterMatch without
+ * re-parsing and without memory allocation:
+ *
+ * teoLogFilter *lf = teoLogFilterCompile("(net_core|net_crypt)&(!tr_udp)");
+ * if(lf != NULL) {
+ *     int res = teoLogFilterMatch(lf, log);
+ *     teoLogFilterFree(lf);
+ * }
+ */
+
+#define TEO_LOG_FILTER_MAX_TERMS 64 ///< Maximum number of unique words in expression
+#define TEO_LOG_FILTER_MAX_DEPTH 64 ///< Maximum expression nesting
+
+typedef struct teoLogFilter teoLogFilter;
+
+teoLogFilter *teoLogFilterCompile(const char *match);
+int teoLogFilterMatch(const teoLogFilter *lf, const char *log);
+void teoLogFilterFree(teoLogFilter *lf);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
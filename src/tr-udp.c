@@ -82,7 +82,9 @@ ssize_t ksnTRUDPsendto(trudpData *td, int resend_flg, uint32_t id,
     }
 
     // UDP
-    ssize_t sent = trudpUdpSendto(td->fd, (void *)buf, buf_len, (__CONST_SOCKADDR_ARG)&tcd->remaddr, sizeof(tcd->remaddr));
+    ssize_t sent = kev->transport != NULL ?
+        teo_sendto(kev, td->fd, buf, buf_len, 0, (__CONST_SOCKADDR_ARG)&tcd->remaddr, sizeof(tcd->remaddr)) :
+        trudpUdpSendto(td->fd, (void *)buf, buf_len, (__CONST_SOCKADDR_ARG)&tcd->remaddr, sizeof(tcd->remaddr));
 
     #ifdef DEBUG_KSNET
     addr_port_t *ap_obj = wrap_inet_ntop(addr);
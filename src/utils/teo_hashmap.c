@@ -0,0 +1,339 @@
+/**
+ * \file   teo_hashmap.c
+ * \author max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Open addressing hash map
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "teo_hashmap.h"
+#include "teo_memory.h"
+
+#define TEO_HASHMAP_MIN_SIZE 16 ///< Initial slots table size
+
+// Values are aligned as malloc result
+#define DATA_ALIGN alignof(max_align_t)
+#define DATA_OFFSET(key_len) \
+    ((sizeof(teoHashMapEntry) + (key_len) + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1))
+
+/**
+ * Finalize 64 bit hash value
+ */
+static inline uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Load up to 8 key bytes
+ */
+static inline uint64_t load_tail(const unsigned char *p, size_t len) {
+
+    uint32_t v32;
+    uint64_t v = 0;
+
+    // Fixed size loads for integer keys
+    switch(len) {
+        case 8: memcpy(&v, p, 8); break;
+        case 4: memcpy(&v32, p, 4); v = v32; break;
+        default: while(len--) v = (v << 8) | p[len]; break;
+    }
+
+    return v;
+}
+
+/**
+ * Compare keys
+ */
+static inline int key_equal(const void *a, const void *b, size_t len) {
+
+    uint32_t a32, b32;
+    uint64_t a64, b64;
+
+    switch(len) {
+        case 4:
+            memcpy(&a32, a, 4); memcpy(&b32, b, 4);
+            return a32 == b32;
+        case 8:
+            memcpy(&a64, a, 8); memcpy(&b64, b, 8);
+            return a64 == b64;
+        default:
+            return !memcmp(a, b, len);
+    }
+}
+
+/**
+ * Calculate key hash
+ *
+ * Keys up to 8 bytes (integers, short names) are hashed with one mix.
+ *
+ * @param key Pointer to key
+ * @param key_len Key length
+ *
+ * @return Key hash
+ */
+uint32_t teoHashMapHash(const void *key, size_t key_len) {
+
+    const unsigned char *p = key;
+    uint64_t h = key_len * 0x9e3779b97f4a7c15ULL, v;
+
+    while(key_len > 8) {
+        memcpy(&v, p, 8);
+        h = (h ^ hash_mix(v)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        key_len -= 8;
+    }
+    h = hash_mix(h ^ load_tail(p, key_len));
+
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/**
+ * Create new hash map
+ *
+ * @return Pointer to teoHashMap, should be free with teoHashMapFree
+ */
+teoHashMap *teoHashMapNew(void) {
+    return teo_calloc(sizeof(teoHashMap));
+}
+
+/**
+ * Free hash map and all its entries
+ *
+ * @param map Pointer to teoHashMap
+ */
+void teoHashMapFree(teoHashMap *map) {
+
+    if(map == NULL) return;
+
+    teoHashMapClear(map);
+    free(map->slots);
+    free(map);
+}
+
+/**
+ * Remove all entries from hash map
+ *
+ * @param map Pointer to teoHashMap
+ */
+void teoHashMapClear(teoHashMap *map) {
+
+    teoHashMapEntry *e = map->first, *next;
+    for(; e != NULL; e = next) {
+        next = e->next;
+        free(e);
+    }
+    if(map->slots != NULL)
+        memset(map->slots, 0, (map->mask + 1) * sizeof(teoHashMapSlot));
+    map->first = map->last = NULL;
+    map->size = 0;
+}
+
+/**
+ * Find slot of key
+ *
+ * @return Slot index, empty slot if key is not in map
+ */
+static inline size_t find_slot(teoHashMap *map, const void *key,
+        size_t key_len, uint32_t hash) {
+
+    size_t i = hash & map->mask;
+    teoHashMapSlot *s;
+
+    for(;;) {
+        s = &map->slots[i];
+        if(s->entry == NULL) break;
+        if(s->hash == hash && s->entry->key_len == key_len &&
+                key_equal(s->entry->key, key, key_len)) break;
+        i = (i + 1) & map->mask;
+    }
+
+    return i;
+}
+
+/**
+ * Resize slots table
+ */
+static void resize(teoHashMap *map, size_t size) {
+
+    teoHashMapSlot *slots = map->slots;
+    size_t i, old_size = slots != NULL ? map->mask + 1 : 0;
+
+    map->slots = teo_calloc(size * sizeof(teoHashMapSlot));
+    map->mask = size - 1;
+
+    for(i = 0; i < old_size; i++) {
+        if(slots[i].entry == NULL) continue;
+        size_t j = slots[i].hash & map->mask;
+        while(map->slots[j].entry != NULL) j = (j + 1) & map->mask;
+        map->slots[j] = slots[i];
+    }
+    free(slots);
+}
+
+/**
+ * Unlink entry from insertion order list
+ */
+static inline void unlink_entry(teoHashMap *map, teoHashMapEntry *e) {
+
+    if(e->prev != NULL) e->prev->next = e->next;
+    else map->first = e->next;
+    if(e->next != NULL) e->next->prev = e->prev;
+    else map->last = e->prev;
+}
+
+/**
+ * Remove slot with backward shift of following slots
+ */
+static void remove_slot(teoHashMap *map, size_t i) {
+
+    size_t j = i, k;
+
+    for(;;) {
+        j = (j + 1) & map->mask;
+        if(map->slots[j].entry == NULL) break;
+        k = map->slots[j].hash & map->mask;
+        // Move the entry if its home slot is not in (i, j]
+        if((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].entry = NULL;
+    map->slots[i].hash = 0;
+}
+
+/**
+ * Add entry to hash map or replace existing entry value
+ *
+ * @param map Pointer to teoHashMap
+ * @param key Pointer to key
+ * @param key_len Key length
+ * @param data Pointer to value or NULL to add zeroed value
+ * @param data_len Value length
+ *
+ * @return Pointer to value stored in map
+ */
+void *teoHashMapAdd(teoHashMap *map, const void *key, size_t key_len,
+        const void *data, size_t data_len) {
+
+    // Keep load factor not bigger than 3/4
+    if(map->slots == NULL) resize(map, TEO_HASHMAP_MIN_SIZE);
+    else if((map->size + 1) * 4 > (map->mask + 1) * 3)
+        resize(map, (map->mask + 1) * 2);
+
+    uint32_t hash = teoHashMapHash(key, key_len);
+    size_t i = find_slot(map, key, key_len, hash);
+    teoHashMapEntry *old = map->slots[i].entry;
+
+    teoHashMapEntry *e = teo_malloc(DATA_OFFSET(key_len) + data_len);
+    e->hash = hash;
+    e->key_len = key_len;
+    e->data_len = data_len;
+    e->data = (char*)e + DATA_OFFSET(key_len);
+    memcpy(e->key, key, key_len);
+    if(data != NULL) memcpy(e->data, data, data_len);
+    else memset(e->data, 0, data_len);
+
+    if(old != NULL) {
+        // Replace entry keeping its place in insertion order
+        e->prev = old->prev;
+        e->next = old->next;
+        if(e->prev != NULL) e->prev->next = e; else map->first = e;
+        if(e->next != NULL) e->next->prev = e; else map->last = e;
+        free(old);
+    }
+    else {
+        e->prev = map->last;
+        e->next = NULL;
+        if(map->last != NULL) map->last->next = e; else map->first = e;
+        map->last = e;
+        map->size++;
+    }
+    map->slots[i].hash = hash;
+    map->slots[i].entry = e;
+
+    return e->data;
+}
+
+/**
+ * Get hash map entry
+ *
+ * @param map Pointer to teoHashMap
+ * @param key Pointer to key
+ * @param key_len Key length
+ *
+ * @return Pointer to teoHashMapEntry or NULL if key is not in map
+ */
+teoHashMapEntry *teoHashMapGetEntry(teoHashMap *map, const void *key,
+        size_t key_len) {
+
+    if(!map->size) return NULL;
+
+    return map->slots[find_slot(map, key, key_len,
+            teoHashMapHash(key, key_len))].entry;
+}
+
+/**
+ * Get value from hash map
+ *
+ * @param map Pointer to teoHashMap
+ * @param key Pointer to key
+ * @param key_len Key length
+ * @param data_len [out] Value length, may be NULL
+ *
+ * @return Pointer to value stored in map or NULL if key is not in map
+ */
+void *teoHashMapGet(teoHashMap *map, const void *key, size_t key_len,
+        size_t *data_len) {
+
+    teoHashMapEntry *e = teoHashMapGetEntry(map, key, key_len);
+    if(e == NULL) return NULL;
+    if(data_len != NULL) *data_len = e->data_len;
+
+    return e->data;
+}
+
+/**
+ * Remove entry from hash map
+ *
+ * @param map Pointer to teoHashMap
+ * @param e Pointer to teoHashMapEntry of this map
+ */
+void teoHashMapRemoveEntry(teoHashMap *map, teoHashMapEntry *e) {
+
+    size_t i = e->hash & map->mask;
+    while(map->slots[i].entry != e) i = (i + 1) & map->mask;
+
+    remove_slot(map, i);
+    unlink_entry(map, e);
+    map->size--;
+    free(e);
+}
+
+/**
+ * Remove key from hash map
+ *
+ * @param map Pointer to teoHashMap
+ * @param key Pointer to key
+ * @param key_len Key length
+ *
+ * @return 1 if key removed, 0 if key is not in map
+ */
+int teoHashMapRemove(teoHashMap *map, const void *key, size_t key_len) {
+
+    teoHashMapEntry *e = teoHashMapGetEntry(map, key, key_len);
+    if(e == NULL) return 0;
+    teoHashMapRemoveEntry(map, e);
+
+    return 1;
+}
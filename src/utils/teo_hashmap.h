@@ -0,0 +1,141 @@
+/**
+ * \file   teo_hashmap.h
+ * \author max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Open addressing hash map used by teonet core modules instead of PblMap.
+ *
+ * Keys and values are copied into one entry allocation, so a value pointer
+ * returned by teoHashMapAdd or teoHashMapGet is stable until the entry is
+ * removed or replaced. The table holds a hash tag and an entry pointer per
+ * slot (linear probing, backward shift deletion), entries are linked in
+ * insertion order and iterated without allocations.
+ *
+ * Keys include the terminating zero for string keys (teoHashMap*Str) and
+ * are 4 byte integers for integer keys (teoHashMap*Int).
+ */
+
+#ifndef TEO_HASHMAP_H
+#define TEO_HASHMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct teoHashMapEntry teoHashMapEntry;
+
+/**
+ * Hash map entry: key and value follow the header
+ */
+struct teoHashMapEntry {
+    teoHashMapEntry *prev;  ///< Previous entry in insertion order
+    teoHashMapEntry *next;  ///< Next entry in insertion order
+    uint32_t hash;          ///< Key hash
+    uint32_t key_len;       ///< Key length
+    size_t data_len;        ///< Value length
+    void *data;             ///< Pointer to value
+    char key[];             ///< Key
+};
+
+/**
+ * Hash map slot
+ */
+typedef struct teoHashMapSlot {
+    uint32_t hash;          ///< Key hash of the entry
+    teoHashMapEntry *entry; ///< Entry or NULL if slot is empty
+} teoHashMapSlot;
+
+/**
+ * Hash map
+ */
+typedef struct teoHashMap {
+    teoHashMapSlot *slots;  ///< Slots table
+    size_t mask;            ///< Table size - 1
+    size_t size;            ///< Number of entries
+    teoHashMapEntry *first; ///< First entry in insertion order
+    teoHashMapEntry *last;  ///< Last entry in insertion order
+} teoHashMap;
+
+/**
+ * Hash map iterator, the current entry may be removed while iterating
+ */
+typedef struct teoHashMapIter {
+    teoHashMapEntry *next;  ///< Next entry
+} teoHashMapIter;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+teoHashMap *teoHashMapNew(void);
+void teoHashMapFree(teoHashMap *map);
+void teoHashMapClear(teoHashMap *map);
+
+void *teoHashMapAdd(teoHashMap *map, const void *key, size_t key_len,
+        const void *data, size_t data_len);
+void *teoHashMapGet(teoHashMap *map, const void *key, size_t key_len,
+        size_t *data_len);
+teoHashMapEntry *teoHashMapGetEntry(teoHashMap *map, const void *key,
+        size_t key_len);
+int teoHashMapRemove(teoHashMap *map, const void *key, size_t key_len);
+void teoHashMapRemoveEntry(teoHashMap *map, teoHashMapEntry *e);
+
+uint32_t teoHashMapHash(const void *key, size_t key_len);
+
+/**
+ * Get number of entries in hash map
+ */
+static inline size_t teoHashMapSize(teoHashMap *map) {
+    return map->size;
+}
+
+/**
+ * Start iteration over hash map entries in insertion order
+ */
+static inline void teoHashMapIterInit(teoHashMap *map, teoHashMapIter *it) {
+    it->next = map->first;
+}
+
+/**
+ * Get next hash map entry
+ *
+ * @return Pointer to teoHashMapEntry or NULL at the end of map
+ */
+static inline teoHashMapEntry *teoHashMapIterNext(teoHashMapIter *it) {
+    teoHashMapEntry *e = it->next;
+    if(e != NULL) it->next = e->next;
+    return e;
+}
+
+// String keys, key length includes terminating zero
+static inline void *teoHashMapAddStr(teoHashMap *map, const char *key,
+        const void *data, size_t data_len) {
+    return teoHashMapAdd(map, key, strlen(key) + 1, data, data_len);
+}
+static inline void *teoHashMapGetStr(teoHashMap *map, const char *key,
+        size_t *data_len) {
+    return teoHashMapGet(map, key, strlen(key) + 1, data_len);
+}
+static inline int teoHashMapRemoveStr(teoHashMap *map, const char *key) {
+    return teoHashMapRemove(map, key, strlen(key) + 1);
+}
+
+// Integer keys
+static inline void *teoHashMapAddInt(teoHashMap *map, uint32_t key,
+        const void *data, size_t data_len) {
+    return teoHashMapAdd(map, &key, sizeof(key), data, data_len);
+}
+static inline void *teoHashMapGetInt(teoHashMap *map, uint32_t key,
+        size_t *data_len) {
+    return teoHashMapGet(map, &key, sizeof(key), data_len);
+}
+static inline int teoHashMapRemoveInt(teoHashMap *map, uint32_t key) {
+    return teoHashMapRemove(map, &key, sizeof(key));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEO_HASHMAP_H */
@@ -0,0 +1,42 @@
+/**
+* \file teo_trace.h
+* \author max
+* Created on Oct 19, 2026
+*
+* Static USDT (SystemTap/bpftrace) probes on teonet hot paths.
+*
+* Probes are compiled in with --enable-usdt (TEO_USDT defined). Each probe is
+* a nop instruction plus an ELF note, so a disabled probe costs nothing.
+* List probes with: bpftrace -l 'usdt:./libteonet.so:teonet:*'
+*
+* Probes:
+*   packet_receive(addr, port, length)     - UDP packet received
+*   packet_send(addr, port, cmd, length)   - packet sent to peer
+*   encrypt(length, encrypted_length)      - packet encrypted
+*   decrypt(length, decrypted_length)      - packet decrypted
+*   split(cmd, length, num_subpackets)     - large packet split
+*   combine(from, id, num_subpackets)      - split packet combined
+*   l0_frame_in(fd, cmd, length)           - L0 client frame received
+*   l0_frame_out(fd, cmd, length)          - L0 client frame sent
+*   cque_add(id, timeout_ms)               - callback added to CQue
+*   cque_exec(id, type)                    - CQue callback executed
+*/
+
+#ifndef TEO_TRACE_H
+#define TEO_TRACE_H
+
+#ifdef TEO_USDT
+#include <sys/sdt.h>
+# define TEO_TRACE1(name, a1) DTRACE_PROBE1(teonet, name, a1)
+# define TEO_TRACE2(name, a1, a2) DTRACE_PROBE2(teonet, name, a1, a2)
+# define TEO_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(teonet, name, a1, a2, a3)
+# define TEO_TRACE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4(teonet, name, a1, a2, a3, a4)
+#else
+# define TEO_TRACE1(name, a1)
+# define TEO_TRACE2(name, a1, a2)
+# define TEO_TRACE3(name, a1, a2, a3)
+# define TEO_TRACE4(name, a1, a2, a3, a4)
+#endif
+
+#endif /* TEO_TRACE_H */
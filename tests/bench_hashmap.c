@@ -0,0 +1,229 @@
+/*
+ * File:   bench_hashmap.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Compare teoHashMap with PblMap hash map on the key shapes used by teonet
+ * core modules:
+ *
+ * * CQue callback ID: uint32_t
+ * * L0 client fd: int
+ * * Peer and L0 client name: short string with terminating zero
+ * * ARP address index: family, port and binary IPv4 address
+ * * Split subpacket: from name length, name, packet and subpacket numbers
+ *
+ * Usage: bench_hashmap [number_of_keys] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <pbl.h>
+#include "utils/teo_hashmap.h"
+
+#define KEY_SIZE 64
+
+/**
+ * Benchmark keys
+ */
+typedef struct bench_keys {
+    const char *name;   ///< Key shape name
+    size_t num;         ///< Number of keys
+    uint8_t *keys;      ///< Keys, KEY_SIZE bytes each
+    size_t *lens;       ///< Keys length
+} bench_keys;
+
+/**
+ * Benchmark value, as large as CQue record
+ */
+typedef struct bench_value {
+    void *cb;
+    void *data;
+    double timeout;
+    uint32_t id;
+    char w[56];
+} bench_value;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void keys_init(bench_keys *bk, const char *name, size_t num) {
+    bk->name = name;
+    bk->num = num;
+    bk->keys = calloc(num, KEY_SIZE);
+    bk->lens = calloc(num, sizeof(size_t));
+}
+
+static void keys_free(bench_keys *bk) {
+    free(bk->keys);
+    free(bk->lens);
+}
+
+#define KEY(bk, i) ((bk)->keys + (i) * KEY_SIZE)
+
+static void keys_uint32(bench_keys *bk, size_t num) {
+    size_t i;
+    keys_init(bk, "cque id (uint32)", num);
+    for(i = 0; i < num; i++) {
+        uint32_t id = i + 1;
+        memcpy(KEY(bk, i), &id, sizeof(id));
+        bk->lens[i] = sizeof(id);
+    }
+}
+
+static void keys_fd(bench_keys *bk, size_t num) {
+    size_t i;
+    keys_init(bk, "l0 fd (int)", num);
+    for(i = 0; i < num; i++) {
+        int fd = 10 + i * 3;
+        memcpy(KEY(bk, i), &fd, sizeof(fd));
+        bk->lens[i] = sizeof(fd);
+    }
+}
+
+static void keys_name(bench_keys *bk, size_t num) {
+    size_t i;
+    keys_init(bk, "peer name (string)", num);
+    for(i = 0; i < num; i++) {
+        bk->lens[i] = snprintf((char*)KEY(bk, i), KEY_SIZE,
+                "teo-peer-%08x", (unsigned)(i * 2654435761u)) + 1;
+    }
+}
+
+static void keys_addr(bench_keys *bk, size_t num) {
+    size_t i;
+    keys_init(bk, "arp addr (binary)", num);
+    for(i = 0; i < num; i++) {
+        uint16_t family = 2, port = 9000 + i % 1000;
+        uint32_t addr = 0x0a000000 + i / 1000;
+        uint8_t *k = KEY(bk, i);
+        memcpy(k, &family, sizeof(family));
+        memcpy(k + 2, &port, sizeof(port));
+        memcpy(k + 4, &addr, sizeof(addr));
+        bk->lens[i] = 8;
+    }
+}
+
+static void keys_split(bench_keys *bk, size_t num) {
+    size_t i;
+    keys_init(bk, "split subpacket", num);
+    for(i = 0; i < num; i++) {
+        uint8_t *k = KEY(bk, i);
+        uint16_t packet = i / 64, subpacket = i % 64;
+        int len = snprintf((char*)k + 1, KEY_SIZE - 1, "teo-peer-%02d",
+                (int)(i % 16));
+        k[0] = len;
+        memcpy(k + 1 + len, &packet, sizeof(packet));
+        memcpy(k + 1 + len + 2, &subpacket, sizeof(subpacket));
+        bk->lens[i] = 1 + len + 4;
+    }
+}
+
+/**
+ * Run add, get, iterate and remove on both maps and print ns/op
+ */
+static void bench(bench_keys *bk, int rounds) {
+
+    bench_value v;
+    memset(&v, 0, sizeof(v));
+    double t_pbl[4] = { 0 }, t_teo[4] = { 0 }, t;
+    size_t i, sum = 0;
+    int r;
+
+    for(r = 0; r < rounds; r++) {
+
+        // PblMap
+        PblMap *pm = pblMapNewHashMap();
+        t = now();
+        for(i = 0; i < bk->num; i++)
+            pblMapAdd(pm, KEY(bk, i), bk->lens[i], &v, sizeof(v));
+        t_pbl[0] += now() - t;
+        t = now();
+        for(i = 0; i < bk->num; i++) {
+            size_t len;
+            sum += pblMapGet(pm, KEY(bk, i), bk->lens[i], &len) != NULL;
+        }
+        t_pbl[1] += now() - t;
+        t = now();
+        PblIterator *it = pblMapIteratorNew(pm);
+        while(pblIteratorHasNext(it)) {
+            void *entry = pblIteratorNext(it);
+            sum += ((bench_value*)pblMapEntryValue(entry))->id;
+        }
+        pblIteratorFree(it);
+        t_pbl[2] += now() - t;
+        t = now();
+        for(i = 0; i < bk->num; i++) {
+            size_t len;
+            void *rv = pblMapRemove(pm, KEY(bk, i), bk->lens[i], &len);
+            if(rv != NULL && rv != (void*)-1) free(rv);
+        }
+        t_pbl[3] += now() - t;
+        pblMapFree(pm);
+
+        // teoHashMap
+        teoHashMap *tm = teoHashMapNew();
+        t = now();
+        for(i = 0; i < bk->num; i++)
+            teoHashMapAdd(tm, KEY(bk, i), bk->lens[i], &v, sizeof(v));
+        t_teo[0] += now() - t;
+        t = now();
+        for(i = 0; i < bk->num; i++)
+            sum += teoHashMapGet(tm, KEY(bk, i), bk->lens[i], NULL) != NULL;
+        t_teo[1] += now() - t;
+        t = now();
+        teoHashMapIter ti;
+        teoHashMapEntry *e;
+        teoHashMapIterInit(tm, &ti);
+        while((e = teoHashMapIterNext(&ti)))
+            sum += ((bench_value*)e->data)->id;
+        t_teo[2] += now() - t;
+        t = now();
+        for(i = 0; i < bk->num; i++)
+            teoHashMapRemove(tm, KEY(bk, i), bk->lens[i]);
+        t_teo[3] += now() - t;
+        teoHashMapFree(tm);
+    }
+
+    static const char *op[] = { "add", "get", "iterate", "remove" };
+    double n = (double)bk->num * rounds / 1e9;
+    for(i = 0; i < 4; i++) {
+        printf("%-20s %-8s %10.1f %10.1f %8.2fx\n", bk->name, op[i],
+                t_pbl[i] / n, t_teo[i] / n, t_pbl[i] / t_teo[i]);
+    }
+    if(sum == (size_t)-1) printf("\n"); // Keep results used
+}
+
+int main(int argc, char** argv) {
+
+    size_t num = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+    if(!num || rounds < 1) {
+        fprintf(stderr, "Usage: %s [number_of_keys] [rounds]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu keys, %d rounds, ns/op\n", num, rounds);
+    printf("%-20s %-8s %10s %10s %9s\n", "keys", "op", "PblMap",
+            "teoHashMap", "speedup");
+
+    void (*shapes[])(bench_keys *, size_t) = {
+        keys_uint32, keys_fd, keys_name, keys_addr, keys_split
+    };
+    size_t i;
+    for(i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        bench_keys bk;
+        shapes[i](&bk, num);
+        bench(&bk, rounds);
+        keys_free(&bk);
+    }
+
+    return 0;
+}
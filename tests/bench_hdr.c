@@ -0,0 +1,191 @@
+/*
+ * File:   bench_hdr.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * HDR latency histogram used by teonet benchmarks
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_hdr.h"
+
+#define SUB_HALF_BITS (BENCH_HDR_SUB_BITS - 1)
+
+/**
+ * Get counter index of value: index = bucket * 1024 + sub bucket, where
+ * sub bucket is value shifted right by bucket
+ */
+static inline size_t hdr_index(uint64_t value) {
+
+    if(value > BENCH_HDR_MAX) value = BENCH_HDR_MAX;
+    int bucket = value < (UINT64_C(1) << BENCH_HDR_SUB_BITS) ? 0 :
+            63 - __builtin_clzll(value) - SUB_HALF_BITS;
+
+    return ((size_t)bucket << SUB_HALF_BITS) + (value >> bucket);
+}
+
+/**
+ * Get highest value equivalent to counter index
+ */
+static inline uint64_t hdr_value(size_t index) {
+
+    int bucket = index < (1 << BENCH_HDR_SUB_BITS) ? 0 :
+            (int)(index >> SUB_HALF_BITS) - 1;
+    uint64_t sub = index - ((size_t)bucket << SUB_HALF_BITS);
+
+    return (sub << bucket) + (UINT64_C(1) << bucket) - 1;
+}
+
+/**
+ * Initialize histogram
+ *
+ * @param h Pointer to bench_hdr
+ *
+ * @return 0 on success or -1 if out of memory
+ */
+int bench_hdr_init(bench_hdr *h) {
+
+    memset(h, 0, sizeof(*h));
+    h->counts = calloc(BENCH_HDR_COUNTS, sizeof(uint64_t));
+    h->min = UINT64_MAX;
+
+    return h->counts ? 0 : -1;
+}
+
+/**
+ * Free histogram counters
+ *
+ * @param h Pointer to bench_hdr
+ */
+void bench_hdr_free(bench_hdr *h) {
+
+    free(h->counts);
+    h->counts = NULL;
+}
+
+/**
+ * Remove all recorded values
+ *
+ * @param h Pointer to bench_hdr
+ */
+void bench_hdr_reset(bench_hdr *h) {
+
+    memset(h->counts, 0, BENCH_HDR_COUNTS * sizeof(uint64_t));
+    h->count = 0;
+    h->min = UINT64_MAX;
+    h->max = 0;
+    h->sum = 0;
+}
+
+/**
+ * Record value
+ *
+ * @param h Pointer to bench_hdr
+ * @param value Value in nanoseconds
+ */
+void bench_hdr_record(bench_hdr *h, uint64_t value) {
+
+    h->counts[hdr_index(value)]++;
+    h->count++;
+    h->sum += value;
+    if(value < h->min) h->min = value;
+    if(value > h->max) h->max = value;
+}
+
+/**
+ * Add values recorded in other histogram
+ *
+ * @param to Pointer to destination bench_hdr
+ * @param from Pointer to source bench_hdr
+ */
+void bench_hdr_merge(bench_hdr *to, const bench_hdr *from) {
+
+    size_t i;
+    if(!from->count) return;
+    for(i = 0; i < BENCH_HDR_COUNTS; i++) to->counts[i] += from->counts[i];
+    to->count += from->count;
+    to->sum += from->sum;
+    if(from->min < to->min) to->min = from->min;
+    if(from->max > to->max) to->max = from->max;
+}
+
+/**
+ * Get value at percentile
+ *
+ * @param h Pointer to bench_hdr
+ * @param percentile Percentile from 0 to 100
+ *
+ * @return Highest value equivalent to the value at percentile, or 0 if
+ *         nothing was recorded
+ */
+uint64_t bench_hdr_percentile(const bench_hdr *h, double percentile) {
+
+    if(!h->count) return 0;
+    if(percentile > 100.0) percentile = 100.0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->count + 0.5);
+    if(rank < 1) rank = 1;
+
+    uint64_t total = 0;
+    size_t i;
+    for(i = 0; i < BENCH_HDR_COUNTS; i++) {
+        total += h->counts[i];
+        if(total >= rank) {
+            uint64_t value = hdr_value(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+/**
+ * Get histogram summary
+ *
+ * @param h Pointer to bench_hdr
+ * @param s Pointer to bench_hdr_summary to fill
+ */
+void bench_hdr_summarize(const bench_hdr *h, bench_hdr_summary *s) {
+
+    s->count = h->count;
+    s->min = h->count ? h->min : 0;
+    s->mean = h->count ? (uint64_t)(h->sum / h->count) : 0;
+    s->p50 = bench_hdr_percentile(h, 50.0);
+    s->p90 = bench_hdr_percentile(h, 90.0);
+    s->p99 = bench_hdr_percentile(h, 99.0);
+    s->p999 = bench_hdr_percentile(h, 99.9);
+    s->max = h->max;
+}
+
+/**
+ * Write histogram summary as JSON object
+ *
+ * @param f Output file
+ * @param s Pointer to bench_hdr_summary
+ */
+void bench_hdr_summary_json(FILE *f, const bench_hdr_summary *s) {
+
+    fprintf(f, "{\"count\": %llu, \"min\": %llu, \"mean\": %llu, "
+            "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+            "\"max\": %llu}",
+            (unsigned long long)s->count, (unsigned long long)s->min,
+            (unsigned long long)s->mean, (unsigned long long)s->p50,
+            (unsigned long long)s->p90, (unsigned long long)s->p99,
+            (unsigned long long)s->p999, (unsigned long long)s->max);
+}
+
+/**
+ * Get monotonic time in nanoseconds, comparable between processes of
+ * one host
+ */
+uint64_t bench_now_ns(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
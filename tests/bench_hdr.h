@@ -0,0 +1,71 @@
+/*
+ * File:   bench_hdr.h
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * HDR (high dynamic range) latency histogram used by teonet benchmarks.
+ *
+ * Values are nanoseconds from 0 to BENCH_HDR_MAX. Every power of two range
+ * is divided into 1024 linear sub buckets, so recorded values keep three
+ * significant decimal digits and the histogram has a fixed size whatever
+ * the number of recorded values is.
+ */
+
+#ifndef BENCH_HDR_H
+#define BENCH_HDR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BENCH_HDR_SUB_BITS 11 ///< Sub bucket bits of the first bucket
+#define BENCH_HDR_MAX_BITS 40 ///< Maximal value bits (about 18 minutes)
+#define BENCH_HDR_MAX ((UINT64_C(1) << BENCH_HDR_MAX_BITS) - 1)
+#define BENCH_HDR_COUNTS ((BENCH_HDR_MAX_BITS - BENCH_HDR_SUB_BITS + 2) \
+        << (BENCH_HDR_SUB_BITS - 1))
+
+/**
+ * Latency histogram
+ */
+typedef struct bench_hdr {
+    uint64_t count;  ///< Number of recorded values
+    uint64_t min;    ///< Minimal recorded value
+    uint64_t max;    ///< Maximal recorded value
+    double sum;      ///< Sum of recorded values
+    uint64_t *counts; ///< BENCH_HDR_COUNTS counters
+} bench_hdr;
+
+/**
+ * Latency histogram summary, may be sent between benchmark processes
+ */
+typedef struct bench_hdr_summary {
+    uint64_t count;
+    uint64_t min;
+    uint64_t mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} bench_hdr_summary;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int bench_hdr_init(bench_hdr *h);
+void bench_hdr_free(bench_hdr *h);
+void bench_hdr_reset(bench_hdr *h);
+void bench_hdr_record(bench_hdr *h, uint64_t value);
+void bench_hdr_merge(bench_hdr *to, const bench_hdr *from);
+uint64_t bench_hdr_percentile(const bench_hdr *h, double percentile);
+void bench_hdr_summarize(const bench_hdr *h, bench_hdr_summary *s);
+void bench_hdr_summary_json(FILE *f, const bench_hdr_summary *s);
+
+uint64_t bench_now_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_HDR_H */
@@ -0,0 +1,597 @@
+/*
+ * File:   bench_primitives.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Microbenchmark of teonet hot path primitives.
+ *
+ * Every benchmark runs its primitive in a loop, the number of iterations is
+ * calibrated to take --min-time seconds, and the loop is repeated
+ * --repetitions times. Median nanoseconds per operation and allocations
+ * (malloc, calloc and realloc calls) per operation are reported:
+ *
+ * * core_create_packet/N - ksnCoreCreatePacketFrom with N bytes of data
+ *   (packet is freed)
+ * * core_parse_packet/N - ksnCoreParsePacket of N bytes data packet
+ * * split_packet/N - ksnSplitPacket of N bytes packet (subpackets are freed)
+ * * split_combine/N - ksnSplitCombine of all subpackets of N bytes packet
+ *   and ksnSplitFreeRds of the combined packet
+ * * encrypt/N - ksnEncryptPackage of N bytes packet to allocated buffer as
+ *   sendto_encrypt does (buffer is freed)
+ * * decrypt/N - ksnDecryptPackage of N bytes packet, includes copy of the
+ *   encrypted packet because it is decrypted in place
+ * * byte_checksum/N - get_byte_checksum of N bytes
+ * * l0_packet_create/N - teoLNullPacketCreate with N bytes of data
+ * * l0_frame_parse/N - L0 server read buffer loop of cmd_l0_read_cb over
+ *   frames with N bytes of data, one operation is one frame
+ *
+ * Results are printed as table and may be written as JSON. The JSON file
+ * may be used as baseline of next runs: benchmarks slower than baseline by
+ * more than --threshold percent or doing more allocations per operation
+ * are reported as regressions and the program exits with status 2.
+ *
+ * Usage: bench_primitives [options]
+ *
+ *   -f, --filter=TEXT    Run benchmarks which name contains TEXT
+ *   -m, --min-time=SEC   Minimal time of one repetition (default 0.1)
+ *   -r, --repetitions=N  Number of repetitions (default 5)
+ *   -o, --output=FILE    Write results as JSON to FILE
+ *   -b, --baseline=FILE  Compare with results saved by --output
+ *   -t, --threshold=PCT  Allowed ns/op regression in percent (default 10)
+ *   -l, --list           List benchmarks
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ev_mgr.h"
+#include "net_split.h"
+#include "crypt.h"
+#include "bench_hdr.h"
+
+#define BENCH_VERSION "0.0.1"
+
+#define BENCH_FROM "bench-0"
+#define BENCH_MAX_SIZE 16384
+#define BENCH_L0_FRAMES 64 ///< Frames in L0 read buffer
+#define BENCH_MAX_REPETITIONS 101
+#define BENCH_NAME_LEN 64
+
+/*
+ * Allocations counter. The wrappers replace libc allocation functions for
+ * the whole process, libteonet and libcrypto included.
+ */
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t allocs;
+
+void *malloc(size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+static inline uint64_t allocs_get(void) {
+    return __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+}
+#else
+#define BENCH_COUNT_ALLOCS 0
+static inline uint64_t allocs_get(void) { return 0; }
+#endif
+
+/**
+ * Benchmark description
+ */
+typedef struct bench_case {
+    const char *name;
+    size_t size; ///< Data size
+    void (*prepare)(size_t size); ///< Called once before calibration
+    void (*run)(size_t size, uint64_t iterations);
+    unsigned ops; ///< Operations in one iteration, 0 is one
+} bench_case;
+
+/**
+ * Benchmark result
+ */
+typedef struct bench_result {
+    char name[BENCH_NAME_LEN];
+    uint64_t iterations; ///< Iterations of one repetition
+    double ns_per_op; ///< Median of repetitions
+    double ns_min; ///< Fastest repetition
+    double allocs_per_op;
+} bench_result;
+
+/**
+ * Benchmark data
+ */
+static struct {
+
+    // Fake modules chain used by split and crypt modules
+    ksnetEvMgrClass ke;
+    ksnCoreClass kc;
+    ksnCommandClass kco;
+    ksnSplitClass *ks;
+    ksnCryptClass *kcr;
+
+    uint8_t data[BENCH_MAX_SIZE];
+    uint8_t packet[BENCH_MAX_SIZE + 256];
+    size_t packet_len;
+    uint8_t encrypted[BENCH_MAX_SIZE + 256];
+    size_t encrypted_len;
+    void **subpackets;
+    int num_subpackets;
+    uint8_t *frames;
+    size_t frames_len;
+
+    volatile uint64_t sink; ///< Keeps results of pure functions
+} bp;
+
+/*
+ * Packet build and parse
+ */
+
+static void run_core_create(size_t size, uint64_t iterations) {
+
+    size_t packet_len;
+    uint64_t i;
+    for(i = 0; i < iterations; i++) {
+        void *packet = ksnCoreCreatePacketFrom(&bp.kc, CMD_USER, BENCH_FROM,
+                sizeof(BENCH_FROM), bp.data, size, &packet_len);
+        bp.sink += *(uint8_t *)packet;
+        free(packet);
+    }
+}
+
+static void prepare_core_parse(size_t size) {
+
+    size_t packet_len;
+    void *packet = ksnCoreCreatePacketFrom(&bp.kc, CMD_USER, BENCH_FROM,
+            sizeof(BENCH_FROM), bp.data, size, &packet_len);
+    memcpy(bp.packet, packet, packet_len);
+    bp.packet_len = packet_len;
+    free(packet);
+}
+
+static void run_core_parse(size_t size, uint64_t iterations) {
+
+    ksnCorePacketData rd;
+    uint64_t i;
+    for(i = 0; i < iterations; i++) {
+        bp.sink += ksnCoreParsePacket(bp.packet, bp.packet_len, &rd);
+        bp.sink += rd.data_len;
+    }
+}
+
+/*
+ * Split and combine
+ */
+
+static void free_subpackets(void **packets, int num) {
+
+    int i;
+    for(i = 0; i < num; i++) free(packets[i]);
+    free(packets);
+}
+
+static void run_split(size_t size, uint64_t iterations) {
+
+    int num;
+    uint64_t i;
+    for(i = 0; i < iterations; i++) {
+        void **packets = ksnSplitPacket(bp.ks, CMD_USER, bp.data, size, &num);
+        bp.sink += num;
+        free_subpackets(packets, num);
+    }
+}
+
+static void prepare_combine(size_t size) {
+
+    if(bp.subpackets) free_subpackets(bp.subpackets, bp.num_subpackets);
+    bp.subpackets = ksnSplitPacket(bp.ks, CMD_USER, bp.data, size,
+            &bp.num_subpackets);
+}
+
+static void run_combine(size_t size, uint64_t iterations) {
+
+    ksnCorePacketData rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.from = BENCH_FROM;
+    rd.from_len = sizeof(BENCH_FROM);
+    rd.cmd = CMD_SPLIT;
+
+    uint64_t i;
+    int j;
+    for(i = 0; i < iterations; i++) {
+        // Subpackets are passed as CMD_SPLIT data: packet number, subpacket
+        // number and subpacket data
+        for(j = 0; j < bp.num_subpackets; j++) {
+            uint8_t *sp = bp.subpackets[j];
+            rd.data = sp + sizeof(uint16_t);
+            rd.data_len = *(uint16_t *)sp + sizeof(uint16_t) * 2;
+            ksnCorePacketData *rds = ksnSplitCombine(bp.ks, &rd);
+            if(rds != NULL) {
+                bp.sink += rds->data_len;
+                ksnSplitFreeRds(bp.ks, rds);
+            }
+        }
+    }
+}
+
+/*
+ * Encrypt and decrypt
+ */
+
+static void run_encrypt(size_t size, uint64_t iterations) {
+
+    size_t encrypted_len;
+    uint64_t i;
+    for(i = 0; i < iterations; i++) {
+        void *data = ksnEncryptPackage(bp.kcr, bp.data, size, NULL,
+                &encrypted_len);
+        bp.sink += encrypted_len;
+        free(data);
+    }
+}
+
+static void prepare_decrypt(size_t size) {
+
+    ksnEncryptPackage(bp.kcr, bp.data, size, bp.encrypted, &bp.encrypted_len);
+}
+
+static void run_decrypt(size_t size, uint64_t iterations) {
+
+    size_t decrypted_len;
+    uint64_t i;
+    for(i = 0; i < iterations; i++) {
+        memcpy(bp.packet, bp.encrypted, bp.encrypted_len);
+        ksnDecryptPackage(bp.kcr, bp.packet, bp.encrypted_len, &decrypted_len);
+        bp.sink += decrypted_len;
+    }
+}
+
+/*
+ * L0 frames
+ */
+
+static void run_checksum(size_t size, uint64_t iterations) {
+
+    uint64_t i;
+    for(i = 0; i < iterations; i++)
+        bp.sink += get_byte_checksum(bp.data, size);
+}
+
+static void run_l0_create(size_t size, uint64_t iterations) {
+
+    uint64_t i;
+    for(i = 0; i < iterations; i++)
+        bp.sink += teoLNullPacketCreate(bp.packet, sizeof(bp.packet), CMD_USER,
+                BENCH_FROM, bp.data, size);
+}
+
+static void prepare_l0_parse(size_t size) {
+
+    size_t len = teoLNullBufferSize(sizeof(BENCH_FROM), size), i;
+    free(bp.frames);
+    bp.frames = malloc(len * BENCH_L0_FRAMES);
+    bp.frames_len = 0;
+    for(i = 0; i < BENCH_L0_FRAMES; i++) {
+        void *frame = bp.frames + bp.frames_len;
+        teoLNullPacketCreate(frame, len, CMD_USER, BENCH_FROM, bp.data, size);
+        teoLNullPacketSeal(NULL, false, frame);
+        bp.frames_len += sizeof(teoLNullCPacket) +
+                ((teoLNullCPacket *)frame)->peer_name_length +
+                ((teoLNullCPacket *)frame)->data_length;
+    }
+}
+
+/**
+ * Same loop as cmd_l0_read_cb runs over its read buffer, valid frames are
+ * counted instead of processed. One iteration parses BENCH_L0_FRAMES frames.
+ */
+static void run_l0_parse(size_t size, uint64_t iterations) {
+
+    uint64_t i, valid = 0;
+    for(i = 0; i < iterations; i++) {
+
+        teoLNullCPacket *packet = (teoLNullCPacket *)bp.frames;
+        size_t len, ptr = 0;
+
+        while(bp.frames_len - ptr >= sizeof(teoLNullCPacket) &&
+              bp.frames_len - ptr >= (len = sizeof(teoLNullCPacket) +
+                packet->peer_name_length + packet->data_length)) {
+
+            uint8_t *packet_header = (uint8_t *)packet;
+            uint8_t *packet_body = (uint8_t *)packet->peer_name;
+            if(packet->header_checksum == get_byte_checksum(packet_header,
+                sizeof(teoLNullCPacket) - sizeof(packet->header_checksum)) &&
+               packet->checksum == get_byte_checksum(packet_body,
+                    packet->peer_name_length + packet->data_length)) {
+                valid++;
+            }
+
+            ptr += len;
+            packet = (void *)((uint8_t *)packet + len);
+        }
+    }
+    bp.sink += valid;
+}
+
+#define SIZES(name, prepare, run) \
+    { name "/64", 64, prepare, run }, \
+    { name "/1024", 1024, prepare, run }, \
+    { name "/4096", 4096, prepare, run }
+
+static const bench_case cases[] = {
+    { "core_create_packet/64", 64, NULL, run_core_create },
+    { "core_create_packet/1024", 1024, NULL, run_core_create },
+    { "core_parse_packet/64", 64, prepare_core_parse, run_core_parse },
+    { "core_parse_packet/1024", 1024, prepare_core_parse, run_core_parse },
+    { "split_packet/4096", 4096, NULL, run_split },
+    { "split_packet/16384", 16384, NULL, run_split },
+    { "split_combine/4096", 4096, prepare_combine, run_combine },
+    { "split_combine/16384", 16384, prepare_combine, run_combine },
+    SIZES("encrypt", NULL, run_encrypt),
+    SIZES("decrypt", prepare_decrypt, run_decrypt),
+    SIZES("byte_checksum", NULL, run_checksum),
+    { "l0_packet_create/64", 64, NULL, run_l0_create },
+    { "l0_packet_create/1024", 1024, NULL, run_l0_create },
+    { "l0_frame_parse/64", 64, prepare_l0_parse, run_l0_parse,
+            BENCH_L0_FRAMES },
+    { "l0_frame_parse/1024", 1024, prepare_l0_parse, run_l0_parse,
+            BENCH_L0_FRAMES },
+};
+
+#undef SIZES
+
+#define CASES_NUM (sizeof(cases) / sizeof(cases[0]))
+
+static int cmp_double(const void *a, const void *b) {
+
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Run benchmark
+ *
+ * @param bc Pointer to bench_case
+ * @param min_time Minimal time of one repetition in seconds
+ * @param repetitions Number of repetitions
+ * @param r Pointer to bench_result to fill
+ */
+static void run_case(const bench_case *bc, double min_time, int repetitions,
+        bench_result *r) {
+
+    double ns[BENCH_MAX_REPETITIONS];
+    uint64_t iterations = 1, elapsed, allocs_start, allocs_sum = 0;
+    uint64_t min_ns = (uint64_t)(min_time * 1e9);
+    unsigned ops = bc->ops ? bc->ops : 1;
+    int i;
+
+    if(bc->prepare) bc->prepare(bc->size);
+
+    // Calibrate number of iterations
+    for(;;) {
+        uint64_t start = bench_now_ns();
+        bc->run(bc->size, iterations);
+        elapsed = bench_now_ns() - start;
+        if(elapsed >= min_ns || iterations >= UINT64_C(1) << 40) break;
+        if(elapsed < min_ns / 100) iterations *= 10;
+        else iterations = iterations * min_ns / elapsed * 11 / 10 + 1;
+    }
+
+    for(i = 0; i < repetitions; i++) {
+        allocs_start = allocs_get();
+        uint64_t start = bench_now_ns();
+        bc->run(bc->size, iterations);
+        ns[i] = (double)(bench_now_ns() - start) / iterations / ops;
+        allocs_sum += allocs_get() - allocs_start;
+    }
+    qsort(ns, repetitions, sizeof(ns[0]), cmp_double);
+
+    snprintf(r->name, sizeof(r->name), "%s", bc->name);
+    r->iterations = iterations * ops;
+    r->ns_per_op = ns[repetitions / 2];
+    r->ns_min = ns[0];
+    r->allocs_per_op = (double)allocs_sum / repetitions / iterations / ops;
+}
+
+/**
+ * Write results as JSON, one benchmark in line
+ */
+static void write_json(FILE *f, const bench_result *res, size_t num,
+        double min_time, int repetitions) {
+
+    size_t i;
+    fprintf(f, "{\"version\": \"%s\", \"min_time\": %.3f, "
+            "\"repetitions\": %d, \"count_allocs\": %s, \"benchmarks\": [\n",
+            BENCH_VERSION, min_time, repetitions,
+            BENCH_COUNT_ALLOCS ? "true" : "false");
+    for(i = 0; i < num; i++) {
+        fprintf(f, "  {\"name\": \"%s\", \"ns_per_op\": %.2f, "
+                "\"ns_min\": %.2f, \"allocs_per_op\": %.3f, "
+                "\"iterations\": %llu}%s\n",
+                res[i].name, res[i].ns_per_op, res[i].ns_min,
+                res[i].allocs_per_op, (unsigned long long)res[i].iterations,
+                i + 1 < num ? "," : "");
+    }
+    fprintf(f, "]}\n");
+}
+
+/**
+ * Find benchmark in baseline file written by write_json
+ *
+ * @return 1 if found
+ */
+static int baseline_find(FILE *f, const char *name, bench_result *base) {
+
+    char line[512];
+    rewind(f);
+    while(fgets(line, sizeof(line), f)) {
+        char *p = strstr(line, "{\"name\": \"");
+        if(p == NULL) continue;
+        if(sscanf(p, "{\"name\": \"%63[^\"]\", \"ns_per_op\": %lf, "
+                "\"ns_min\": %lf, \"allocs_per_op\": %lf",
+                base->name, &base->ns_per_op, &base->ns_min,
+                &base->allocs_per_op) == 4 && !strcmp(base->name, name))
+            return 1;
+    }
+
+    return 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n\n"
+        "  -f, --filter=TEXT    Run benchmarks which name contains TEXT\n"
+        "  -m, --min-time=SEC   Minimal time of one repetition (default 0.1)\n"
+        "  -r, --repetitions=N  Number of repetitions (default 5)\n"
+        "  -o, --output=FILE    Write results as JSON to FILE\n"
+        "  -b, --baseline=FILE  Compare with results saved by --output\n"
+        "  -t, --threshold=PCT  Allowed ns/op regression in percent (default 10)\n"
+        "  -l, --list           List benchmarks\n", name);
+}
+
+/**
+ * Main microbenchmark function
+ *
+ * @param argc Number of parameters
+ * @param argv Parameters array
+ *
+ * @return EXIT_SUCCESS, EXIT_FAILURE on error or 2 if regressions was found
+ */
+int main(int argc, char** argv) {
+
+    static struct option long_options[] = {
+        { "filter",      required_argument, 0, 'f' },
+        { "min-time",    required_argument, 0, 'm' },
+        { "repetitions", required_argument, 0, 'r' },
+        { "output",      required_argument, 0, 'o' },
+        { "baseline",    required_argument, 0, 'b' },
+        { "threshold",   required_argument, 0, 't' },
+        { "list",        no_argument,       0, 'l' },
+        { "help",        no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    const char *filter = NULL, *output = NULL, *baseline = NULL;
+    double min_time = 0.1, threshold = 10.0;
+    int repetitions = 5, list = 0, opt;
+    size_t i;
+    while((opt = getopt_long(argc, argv, "f:m:r:o:b:t:lh", long_options,
+            NULL)) != -1) {
+        switch(opt) {
+            case 'f': filter = optarg; break;
+            case 'm': min_time = atof(optarg); break;
+            case 'r': repetitions = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': threshold = atof(optarg); break;
+            case 'l': list = 1; break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if(min_time <= 0 || repetitions < 1 ||
+       repetitions > BENCH_MAX_REPETITIONS || threshold < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(list) {
+        for(i = 0; i < CASES_NUM; i++) printf("%s\n", cases[i].name);
+        return EXIT_SUCCESS;
+    }
+
+    FILE *base_f = NULL;
+    if(baseline && !(base_f = fopen(baseline, "r"))) {
+        perror(baseline);
+        return EXIT_FAILURE;
+    }
+
+    // Modules used by primitives, the event manager is not started
+    KSN_SET_TEST_MODE(1);
+    bp.kc.ke = &bp.ke;
+    bp.kco.kc = &bp.kc;
+    bp.ks = ksnSplitInit(&bp.kco);
+    bp.kcr = ksnCryptInit(&bp.ke);
+    for(i = 0; i < sizeof(bp.data); i++) bp.data[i] = (uint8_t)(i * 31 + 7);
+
+    bench_result *res = calloc(CASES_NUM, sizeof(bench_result));
+    size_t num = 0;
+    int regressions = 0;
+
+    printf("%-26s %12s %12s %10s", "Benchmark", "ns/op", "allocs/op",
+            "iterations");
+    if(base_f) printf(" %12s %9s  %s", "base ns/op", "change", "status");
+    printf("\n");
+
+    for(i = 0; i < CASES_NUM; i++) {
+
+        if(filter && !strstr(cases[i].name, filter)) continue;
+
+        bench_result *r = &res[num++];
+        run_case(&cases[i], min_time, repetitions, r);
+        printf("%-26s %12.2f %12.3f %10llu", r->name, r->ns_per_op,
+                r->allocs_per_op, (unsigned long long)r->iterations);
+
+        if(base_f) {
+            bench_result base;
+            if(!baseline_find(base_f, r->name, &base)) printf("  new");
+            else {
+                double change = base.ns_per_op > 0 ?
+                        (r->ns_per_op / base.ns_per_op - 1.0) * 100.0 : 0;
+                int slower = change > threshold,
+                    more_allocs = r->allocs_per_op > base.allocs_per_op + 0.005;
+                printf(" %12.2f %+8.1f%%  %s", base.ns_per_op, change,
+                        slower ? "REGRESSION" :
+                        more_allocs ? "REGRESSION (allocs)" : "ok");
+                regressions += slower || more_allocs;
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if(output) {
+        FILE *f = fopen(output, "w");
+        if(f == NULL) perror(output);
+        else {
+            write_json(f, res, num, min_time, repetitions);
+            fclose(f);
+        }
+    }
+    if(base_f) {
+        fclose(base_f);
+        printf("%d regression(s) against %s, threshold %.1f%%\n", regressions,
+                baseline, threshold);
+    }
+
+    free(res);
+    free(bp.frames);
+    if(bp.subpackets) free_subpackets(bp.subpackets, bp.num_subpackets);
+    ksnCryptDestroy(bp.kcr);
+    ksnSplitDestroy(bp.ks);
+
+    return regressions ? 2 : EXIT_SUCCESS;
+}
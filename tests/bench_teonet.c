@@ -0,0 +1,1059 @@
+/*
+ * File:   bench_teonet.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Teonet core stack throughput and latency benchmark.
+ *
+ * The benchmark starts a driver node in this process and the other nodes
+ * as child processes on loopback, runs scenarios in the driver and writes
+ * results as JSON, latencies are HDR histogram summaries in nanoseconds:
+ *
+ * * rtt - request/response round trip time with one request in flight
+ * * throughput - one way messages by message size, including sizes above
+ *   MAX_DATA_LEN which are split
+ * * crypt - packets encryption and decryption cost of one way messages
+ * * l0_fan_in - L0 clients login to L0 server and send echo requests to
+ *   the driver through it
+ * * sub_fan_out - driver sends events to peers subscribed to it
+ * * cque_storm - bursts of requests which answers are waited with CQue
+ *
+ * Nodes:
+ *
+ * * bench-0 - driver (this process)
+ * * bench-1 - echo node with L0 server
+ * * bench-sub-N - subscribers
+ *
+ * Usage: bench_teonet [options]
+ *
+ *   -n, --messages=N     Messages in each run (default 10000)
+ *   -p, --port=PORT      Driver port, nodes use next ports (default 9700)
+ *   -s, --scenarios=LIST Comma separated scenarios (default all)
+ *   -S, --subscribers=N  Number of subscriber nodes (default 4)
+ *   -l, --l0_clients=N   Number of L0 clients (default 16)
+ *   -b, --burst=N        CQue requests in one burst (default 1000)
+ *   -t, --timeout=SEC    Run timeout (default 60)
+ *   -o, --output=FILE    Write JSON to file instead of stdout
+ *   -v, --verbose        Show teonet output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include <openssl/md5.h>
+
+#include "ev_mgr.h"
+#include "net_split.h"
+#include "modules/metric.h"
+#include "modules/subscribe.h"
+#include "bench_hdr.h"
+
+#define BENCH_VERSION "0.0.1"
+
+#define BENCH_DRIVER "bench-0"
+#define BENCH_ECHO_NODE "bench-1"
+#define BENCH_SUB_PREFIX "bench-sub-"
+#define BENCH_L0_PREFIX "bench-l0-"
+#define BENCH_SECRET "teonet-bench"
+#define BENCH_EVENT (EV_K_APP_USER + 1)
+
+#define BENCH_MAX_NODES 64
+#define BENCH_MAX_SIZE 16384
+#define BENCH_WARMUP 100         ///< Not recorded round trips
+#define BENCH_WINDOW_BYTES (1024 * 1024) ///< One way bytes in flight
+#define BENCH_ACK_EVERY 32       ///< Receiver acknowledges every N messages
+#define BENCH_L0_WINDOW 4        ///< Requests in flight of one L0 client
+#define BENCH_SUB_WINDOW 64      ///< Events in flight
+#define BENCH_CQUE_TIMEOUT 5.0
+
+/**
+ * Benchmark commands
+ */
+enum {
+    CMD_BENCH_HELLO = CMD_USER + 1, ///< Node ready, bench_hello
+    CMD_BENCH_ECHO,         ///< Request answered with CMD_BENCH_ECHO_ANSWER
+    CMD_BENCH_ECHO_ANSWER,  ///< Echo answer
+    CMD_BENCH_START,        ///< Start one way run, bench_start
+    CMD_BENCH_DATA,         ///< One way message
+    CMD_BENCH_ACK,          ///< Number of received messages, uint64_t
+    CMD_BENCH_DONE,         ///< One way run statistic, bench_done
+    CMD_BENCH_REQUEST,      ///< CQue request answered with CMD_BENCH_ANSWER
+    CMD_BENCH_ANSWER,       ///< CQue answer
+    CMD_BENCH_SUB_ACK       ///< Event delivery latency, uint64_t
+};
+
+/**
+ * Timed message header
+ */
+typedef struct bench_msg {
+    uint64_t time;  ///< Send time, bench_now_ns()
+    uint64_t seq;   ///< Message number or CQue id
+} bench_msg;
+
+typedef struct bench_hello {
+    int32_t l0_port; ///< L0 server port or 0
+} bench_hello;
+
+typedef struct bench_start {
+    uint64_t messages; ///< Messages in run
+} bench_start;
+
+typedef struct bench_done {
+    uint64_t messages;    ///< Messages received
+    uint64_t bytes;       ///< Bytes received
+    uint64_t decrypt_ns;  ///< Time receiver spent to decrypt packets
+    bench_hdr_summary latency; ///< One way latency
+} bench_done;
+
+/**
+ * L0 client of l0_fan_in scenario
+ */
+typedef struct bench_l0_client {
+    int fd;
+    ev_io w;
+    char name[32];
+    uint64_t login_time;
+    int logged_in;
+    uint64_t sent;
+    uint64_t received;
+    size_t read_len;
+    uint8_t read_buf[BENCH_MAX_SIZE];
+} bench_l0_client;
+
+/**
+ * Benchmark state
+ */
+typedef struct bench {
+    ksnetEvMgrClass *ke;
+    int driver_f;           ///< This process is the driver
+
+    // Options
+    long messages;
+    int port;
+    int subscribers;
+    int l0_clients;
+    int burst;
+    double timeout;
+    char *scenarios;
+    int verbose;
+    FILE *out;
+
+    // Nodes
+    pid_t pids[BENCH_MAX_NODES];
+    int nodes_num;
+    int nodes_ready;
+    int subscribed;
+    int l0_port;
+
+    // Current run
+    int active;
+    int done_f;
+    uint64_t total;
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t window;
+    uint64_t completed;
+    uint64_t timeouts;
+    size_t size;
+    bench_hdr hdr;
+    bench_hdr login_hdr;
+    bench_done done;
+    uint64_t *cque_time;
+    bench_l0_client *clients;
+    uint8_t buf[BENCH_MAX_SIZE];
+    int results;
+
+    // One way receiver
+    uint64_t rx_expected;
+    uint64_t rx_received;
+    uint64_t rx_bytes;
+    uint64_t rx_decrypt_ns;
+} bench;
+
+static bench b;
+
+static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event, void *data,
+        size_t data_len, void *user_data);
+
+/**
+ * Get sum of registry histogram in nanoseconds
+ */
+static uint64_t metric_sum(ksnetEvMgrClass *ke, int id) {
+
+    uint64_t sum = 0;
+    teoMetricHistogramGet(teoMetricGetRegistry(ke->tm), id, NULL, &sum);
+    return sum;
+}
+
+/**
+ * Send answer to peer or L0 client
+ */
+static void bench_answer(ksnetEvMgrClass *ke, ksnCorePacketData *rd,
+        uint8_t cmd, void *data, size_t data_len) {
+
+    if(rd->l0_f)
+        ksnLNullSendToL0(ke, rd->addr, rd->port, rd->from, rd->from_len, cmd,
+                data, data_len);
+    else
+        ksnCoreSendCmdto(ke->kc, rd->from, cmd, data, data_len);
+}
+
+/******************************************************************************
+ * Nodes
+ ******************************************************************************/
+
+/**
+ * Node connected to driver
+ */
+static void node_connected(ksnetEvMgrClass *ke) {
+
+    bench_hello hello = {
+        (int32_t)(ke->teo_cfg.l0_allow_f ? ke->teo_cfg.l0_tcp_port : 0)
+    };
+
+    if(!strncmp(ksnetEvMgrGetHostName(ke), BENCH_SUB_PREFIX,
+            strlen(BENCH_SUB_PREFIX)))
+        teoSScrSubscribe(ke->kc->kco->ksscr, BENCH_DRIVER, BENCH_EVENT);
+
+    ksnCoreSendCmdto(ke->kc, BENCH_DRIVER, CMD_BENCH_HELLO, &hello,
+            sizeof(hello));
+}
+
+/**
+ * Node received data
+ */
+static void node_received(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
+
+    static bench_hdr rx_hdr;
+
+    switch(rd->cmd) {
+
+        case CMD_BENCH_ECHO:
+            bench_answer(ke, rd, CMD_BENCH_ECHO_ANSWER, rd->data, rd->data_len);
+            break;
+
+        case CMD_BENCH_REQUEST:
+            bench_answer(ke, rd, CMD_BENCH_ANSWER, rd->data, rd->data_len);
+            break;
+
+        case CMD_BENCH_START:
+            if(!rx_hdr.counts) bench_hdr_init(&rx_hdr);
+            bench_hdr_reset(&rx_hdr);
+            b.rx_expected = ((bench_start *)rd->data)->messages;
+            b.rx_received = 0;
+            b.rx_bytes = 0;
+            b.rx_decrypt_ns = metric_sum(ke, TEO_METRIC_DECRYPT_TIME);
+            break;
+
+        case CMD_BENCH_DATA: {
+            if(!rx_hdr.counts) break;
+            bench_msg *m = rd->data;
+            bench_hdr_record(&rx_hdr, bench_now_ns() - m->time);
+            b.rx_received++;
+            b.rx_bytes += rd->data_len;
+
+            if(b.rx_received == b.rx_expected) {
+                bench_done done;
+                done.messages = b.rx_received;
+                done.bytes = b.rx_bytes;
+                done.decrypt_ns = metric_sum(ke, TEO_METRIC_DECRYPT_TIME) -
+                        b.rx_decrypt_ns;
+                bench_hdr_summarize(&rx_hdr, &done.latency);
+                ksnCoreSendCmdto(ke->kc, rd->from, CMD_BENCH_DONE, &done,
+                        sizeof(done));
+            }
+            else if(!(b.rx_received % BENCH_ACK_EVERY)) {
+                ksnCoreSendCmdto(ke->kc, rd->from, CMD_BENCH_ACK,
+                        &b.rx_received, sizeof(b.rx_received));
+            }
+        } break;
+    }
+}
+
+/**
+ * Subscriber received event
+ */
+static void node_event(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
+
+    teoSScrData *sd = rd->data;
+    if(sd->ev != BENCH_EVENT) return;
+
+    uint64_t latency = bench_now_ns() - ((bench_msg *)sd->data)->time;
+    ksnCoreSendCmdto(ke->kc, rd->from, CMD_BENCH_SUB_ACK, &latency,
+            sizeof(latency));
+}
+
+/**
+ * Start node process
+ *
+ * @param name Node name
+ * @param port Node port
+ * @param l0_f Start L0 server
+ *
+ * @return Child process id or -1 on error
+ */
+static pid_t node_start(const char *name, int port, int l0_f) {
+
+    char port_s[16], r_port_s[16], l0_port_s[16];
+    snprintf(port_s, sizeof(port_s), "%d", port);
+    snprintf(r_port_s, sizeof(r_port_s), "%d", (int)b.ke->teo_cfg.port);
+    snprintf(l0_port_s, sizeof(l0_port_s), "%d", port + 1000);
+
+    char *argv[] = {
+        "bench_teonet", "--bench-node", "-p", port_s, "-r", r_port_s,
+        "-a", "127.0.0.1", (char*)name, NULL, NULL, NULL, NULL, NULL, NULL
+    };
+    if(l0_f) {
+        int i = 8;
+        argv[i++] = "--l0_allow";
+        argv[i++] = "-l";
+        argv[i++] = l0_port_s;
+        argv[i++] = "-u";
+        argv[i++] = BENCH_SECRET;
+        argv[i] = (char*)name;
+    }
+
+    pid_t pid = fork();
+    if(pid) return pid;
+
+    // Child: stop with driver and don't use driver sockets
+    #ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    #endif
+    if(!b.verbose) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+    }
+    int fd;
+    for(fd = STDERR_FILENO + 1; fd < 1024; fd++) close(fd);
+    execv("/proc/self/exe", argv);
+    _exit(EXIT_FAILURE);
+}
+
+/**
+ * Node process main function
+ */
+static int node_main(int argc, char **argv) {
+
+    ksnetEvMgrClass *ke = ksnetEvMgrInitPort(argc, argv, event_cb,
+            READ_OPTIONS|READ_CONFIGURATION, 0, NULL);
+    teoSetAppType(ke, "teo-bench");
+    teoSetAppVersion(ke, BENCH_VERSION);
+    b.ke = ke;
+    ksnetEvMgrRun(ke);
+
+    return EXIT_SUCCESS;
+}
+
+/******************************************************************************
+ * Driver
+ ******************************************************************************/
+
+/**
+ * Run driver event loop until run is done or timeout
+ *
+ * @return 0 if done or -1 at timeout
+ */
+static int run_until_done(void) {
+
+    double end = ev_time() + b.timeout;
+    while(!b.done_f) {
+        if(ev_time() > end || !ksnetEvMgrStatus(b.ke)) return -1;
+        ev_run(b.ke->ev_loop, EVRUN_ONCE);
+    }
+    return 0;
+}
+
+static double retransmits(void) {
+    return teoMetricGet(teoMetricGetRegistry(b.ke->tm),
+            TEO_METRIC_TRUDP_RETRANSMITS);
+}
+
+static void run_start(size_t size, uint64_t total) {
+    b.size = size;
+    b.total = total;
+    b.sent = b.acked = b.completed = b.timeouts = 0;
+    b.done_f = 0;
+    memset(&b.done, 0, sizeof(b.done));
+    memset(b.buf, 'b', size);
+    bench_hdr_reset(&b.hdr);
+    bench_hdr_reset(&b.login_hdr);
+    b.active = 1;
+}
+
+/**
+ * Begin scenario result, fields are added with result_* functions
+ */
+static void result_begin(const char *scenario) {
+    fprintf(b.out, "%s\n  {\"scenario\": \"%s\"", b.results++ ? "," : "",
+            scenario);
+}
+
+static void result_long(const char *name, long long value) {
+    fprintf(b.out, ", \"%s\": %lld", name, value);
+}
+
+static void result_double(const char *name, double value) {
+    fprintf(b.out, ", \"%s\": %.6g", name, value);
+}
+
+static void result_hdr(const char *name, const bench_hdr_summary *s) {
+    fprintf(b.out, ", \"%s\": ", name);
+    bench_hdr_summary_json(b.out, s);
+}
+
+/**
+ * End scenario result and show it
+ */
+static void result_end(const char *scenario, size_t size, double seconds,
+        uint64_t messages, int timeout, const bench_hdr_summary *s) {
+
+    double rate = seconds > 0 ? messages / seconds : 0;
+    result_long("messages", messages);
+    result_double("seconds", seconds);
+    result_double("msg_per_sec", rate);
+    if(timeout) fprintf(b.out, ", \"error\": \"timeout\"");
+    fprintf(b.out, "}");
+    fflush(b.out);
+
+    fprintf(stderr, "%-12s %6d bytes %10.0f msg/s  p50 %8.1f us  "
+            "p99 %8.1f us%s\n", scenario, (int)size, rate, s->p50 / 1e3,
+            s->p99 / 1e3, timeout ? "  TIMEOUT" : "");
+}
+
+/**
+ * Request/response round trip time
+ */
+static void scenario_rtt(size_t size) {
+
+    bench_hdr_summary s;
+    double r_start = retransmits();
+
+    run_start(size, b.messages + BENCH_WARMUP);
+    bench_msg *m = (bench_msg *)b.buf;
+    m->time = bench_now_ns();
+    m->seq = b.sent++;
+    double start = ev_time();
+    ksnCoreSendCmdto(b.ke->kc, BENCH_ECHO_NODE, CMD_BENCH_ECHO, b.buf, size);
+    int timeout = run_until_done();
+    double seconds = ev_time() - start;
+    b.active = 0;
+
+    bench_hdr_summarize(&b.hdr, &s);
+    result_begin("rtt");
+    result_long("size", size);
+    result_double("retransmits", retransmits() - r_start);
+    result_hdr("latency_ns", &s);
+    result_end("rtt", size, seconds, b.hdr.count, timeout, &s);
+}
+
+static void rtt_answer(ksnetEvMgrClass *ke, bench_msg *m) {
+
+    if(m->seq >= BENCH_WARMUP) bench_hdr_record(&b.hdr, bench_now_ns() - m->time);
+    if(++b.completed == b.total) {
+        b.done_f = 1;
+        return;
+    }
+    m = (bench_msg *)b.buf;
+    m->time = bench_now_ns();
+    m->seq = b.sent++;
+    ksnCoreSendCmdto(ke->kc, BENCH_ECHO_NODE, CMD_BENCH_ECHO, b.buf, b.size);
+}
+
+/**
+ * Send one way messages while window is not full
+ */
+static void one_way_pump(ksnetEvMgrClass *ke) {
+
+    bench_msg *m = (bench_msg *)b.buf;
+    while(b.sent < b.total && b.sent - b.acked < b.window) {
+        m->time = bench_now_ns();
+        m->seq = b.sent++;
+        ksnCoreSendCmdto(ke->kc, BENCH_ECHO_NODE, CMD_BENCH_DATA, b.buf,
+                b.size);
+    }
+}
+
+/**
+ * One way throughput, crypt_f adds packets encryption cost
+ */
+static void scenario_one_way(const char *scenario, size_t size, int crypt_f) {
+
+    bench_hdr_summary *s = &b.done.latency;
+    double r_start = retransmits();
+    uint64_t encrypt_start = metric_sum(b.ke, TEO_METRIC_ENCRYPT_TIME);
+
+    run_start(size, b.messages);
+    b.window = BENCH_WINDOW_BYTES / size;
+    if(b.window < BENCH_ACK_EVERY * 2) b.window = BENCH_ACK_EVERY * 2;
+    if(b.window > 1024) b.window = 1024;
+
+    bench_start st = { b.total };
+    double start = ev_time();
+    ksnCoreSendCmdto(b.ke->kc, BENCH_ECHO_NODE, CMD_BENCH_START, &st,
+            sizeof(st));
+    one_way_pump(b.ke);
+    int timeout = run_until_done();
+    double seconds = ev_time() - start;
+    uint64_t encrypt_ns = metric_sum(b.ke, TEO_METRIC_ENCRYPT_TIME) -
+            encrypt_start;
+    b.active = 0;
+
+    result_begin(scenario);
+    result_long("size", size);
+    result_long("split", size > MAX_DATA_LEN);
+    result_double("mbit_per_sec", seconds > 0 ?
+            b.done.bytes * 8 / seconds / 1e6 : 0);
+    result_double("retransmits", retransmits() - r_start);
+    if(crypt_f) {
+        uint64_t n = b.done.messages ? b.done.messages : 1;
+        result_long("crypt", b.ke->teo_cfg.crypt_f);
+        result_double("encrypt_ns_per_msg", (double)encrypt_ns / n);
+        result_double("decrypt_ns_per_msg", (double)b.done.decrypt_ns / n);
+        result_double("sender_crypt_share", seconds > 0 ?
+                encrypt_ns / 1e9 / seconds : 0);
+        result_double("receiver_crypt_share", seconds > 0 ?
+                b.done.decrypt_ns / 1e9 / seconds : 0);
+    }
+    result_hdr("latency_ns", s);
+    result_end(scenario, size, seconds, b.done.messages, timeout, s);
+}
+
+/**
+ * Connect L0 client and send login
+ */
+static int l0_connect(bench_l0_client *c, int num) {
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(b.l0_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if((c->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
+    if(connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    int on = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // Signed login: MD5(userId + secret + timestamp)
+    char ts[32], sign[MD5_DIGEST_LENGTH * 2 + 1], login[256];
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    int i;
+    snprintf(c->name, sizeof(c->name), BENCH_L0_PREFIX "%d", num);
+    snprintf(ts, sizeof(ts), "%ld", (long)time(NULL) + 3600);
+    MD5_CTX ctx;
+    MD5_Init(&ctx);
+    MD5_Update(&ctx, c->name, strlen(c->name));
+    MD5_Update(&ctx, BENCH_SECRET, strlen(BENCH_SECRET));
+    MD5_Update(&ctx, ts, strlen(ts));
+    MD5_Final(digest, &ctx);
+    for(i = 0; i < MD5_DIGEST_LENGTH; i++)
+        sprintf(sign + i * 2, "%02x", digest[i]);
+    snprintf(login, sizeof(login),
+            "{\"userId\":\"%s\",\"timestamp\":\"%s\",\"sign\":\"%s\"}",
+            c->name, ts, sign);
+
+    char packet[KSN_BUFFER_SIZE];
+    size_t len = teoLNullPacketCreateLogin(packet, sizeof(packet), login);
+    c->login_time = bench_now_ns();
+    return write(c->fd, packet, len) == (ssize_t)len ? 0 : -1;
+}
+
+/**
+ * Send L0 client echo request
+ */
+static void l0_send(bench_l0_client *c) {
+
+    char packet[BENCH_MAX_SIZE + 256];
+    bench_msg *m = (bench_msg *)b.buf;
+    m->time = bench_now_ns();
+    m->seq = c->sent++;
+    b.sent++;
+    size_t len = teoLNullPacketCreate(packet, sizeof(packet), CMD_BENCH_ECHO,
+            BENCH_DRIVER, b.buf, b.size);
+    if(write(c->fd, packet, len) != (ssize_t)len) b.timeouts++;
+}
+
+/**
+ * L0 client read callback
+ */
+static void l0_read_cb(struct ev_loop *loop, ev_io *w, int revents) {
+
+    bench_l0_client *c = w->data;
+    ssize_t rc = read(w->fd, c->read_buf + c->read_len,
+            sizeof(c->read_buf) - c->read_len);
+    if(rc <= 0) {
+        ev_io_stop(loop, w);
+        return;
+    }
+    c->read_len += rc;
+
+    size_t ptr = 0, len;
+    while(c->read_len - ptr >= sizeof(teoLNullCPacket)) {
+
+        teoLNullCPacket *p = (teoLNullCPacket *)(c->read_buf + ptr);
+        len = sizeof(teoLNullCPacket) + p->peer_name_length + p->data_length;
+        if(c->read_len - ptr < len) break;
+
+        if(p->cmd == CMD_CONFIRM_AUTH && !c->logged_in) {
+            c->logged_in = 1;
+            bench_hdr_record(&b.login_hdr, bench_now_ns() - c->login_time);
+            int i;
+            for(i = 0; i < BENCH_L0_WINDOW && c->sent < b.total; i++)
+                l0_send(c);
+        }
+        else if(p->cmd == CMD_BENCH_ECHO_ANSWER) {
+            bench_msg *m = (bench_msg *)(p->peer_name + p->peer_name_length);
+            bench_hdr_record(&b.hdr, bench_now_ns() - m->time);
+            c->received++;
+            if(++b.completed == b.total * b.l0_clients) b.done_f = 1;
+            else if(c->sent < b.total) l0_send(c);
+        }
+        ptr += len;
+    }
+    c->read_len -= ptr;
+    memmove(c->read_buf, c->read_buf + ptr, c->read_len);
+}
+
+/**
+ * L0 clients send echo requests through L0 server to the driver
+ */
+static void scenario_l0_fan_in(size_t size) {
+
+    bench_hdr_summary s, login;
+    int i, connected = 0;
+
+    if(!b.l0_port) {
+        fprintf(stderr, "l0_fan_in: L0 server is not started\n");
+        return;
+    }
+
+    run_start(size, b.messages / b.l0_clients);
+    if(!b.total) b.total = 1;
+    b.clients = calloc(b.l0_clients, sizeof(bench_l0_client));
+    double start = ev_time();
+    for(i = 0; i < b.l0_clients; i++) {
+        bench_l0_client *c = &b.clients[i];
+        if(l0_connect(c, i)) continue;
+        connected++;
+        ev_io_init(&c->w, l0_read_cb, c->fd, EV_READ);
+        c->w.data = c;
+        ev_io_start(b.ke->ev_loop, &c->w);
+    }
+    int timeout = connected == b.l0_clients ? run_until_done() : -1;
+    double seconds = ev_time() - start;
+    b.active = 0;
+
+    for(i = 0; i < b.l0_clients; i++) {
+        bench_l0_client *c = &b.clients[i];
+        if(c->fd <= 0) continue;
+        ev_io_stop(b.ke->ev_loop, &c->w);
+        close(c->fd);
+    }
+    free(b.clients);
+    b.clients = NULL;
+
+    bench_hdr_summarize(&b.hdr, &s);
+    bench_hdr_summarize(&b.login_hdr, &login);
+    result_begin("l0_fan_in");
+    result_long("size", size);
+    result_long("clients", b.l0_clients);
+    result_long("connected", connected);
+    result_long("write_errors", b.timeouts);
+    result_hdr("login_ns", &login);
+    result_hdr("latency_ns", &s);
+    result_end("l0_fan_in", size, seconds, b.hdr.count, timeout, &s);
+}
+
+/**
+ * Send events while window is not full
+ */
+static void sub_pump(ksnetEvMgrClass *ke) {
+
+    bench_msg *m = (bench_msg *)b.buf;
+    while(b.sent < b.total &&
+          b.sent - b.completed / b.subscribers < BENCH_SUB_WINDOW) {
+        m->time = bench_now_ns();
+        m->seq = b.sent++;
+        teoSScrSend(ke->kc->kco->ksscr, BENCH_EVENT, b.buf, b.size, 0);
+    }
+}
+
+/**
+ * Driver sends events to subscribers
+ */
+static void scenario_sub_fan_out(size_t size) {
+
+    bench_hdr_summary s;
+
+    if(!b.subscribers) return;
+    run_start(size, b.messages / b.subscribers);
+    if(!b.total) b.total = 1;
+    double start = ev_time();
+    sub_pump(b.ke);
+    int timeout = run_until_done();
+    double seconds = ev_time() - start;
+    b.active = 0;
+
+    bench_hdr_summarize(&b.hdr, &s);
+    result_begin("sub_fan_out");
+    result_long("size", size);
+    result_long("subscribers", b.subscribers);
+    result_long("events", b.sent);
+    result_hdr("latency_ns", &s);
+    result_end("sub_fan_out", size, seconds, b.completed, timeout, &s);
+}
+
+static void cque_cb(uint32_t id, int type, void *data);
+
+/**
+ * Send burst of requests
+ */
+static void cque_burst(ksnetEvMgrClass *ke) {
+
+    bench_msg *m = (bench_msg *)b.buf;
+    int i;
+    for(i = 0; i < b.burst && b.sent < b.total; i++) {
+        uint64_t *t = &b.cque_time[i];
+        ksnCQueData *cq = ksnCQueAdd(ke->kq, cque_cb, BENCH_CQUE_TIMEOUT, t);
+        m->time = *t = bench_now_ns();
+        m->seq = cq->id;
+        b.sent++;
+        ksnCoreSendCmdto(ke->kc, BENCH_ECHO_NODE, CMD_BENCH_REQUEST, b.buf,
+                b.size);
+    }
+}
+
+/**
+ * CQue callback
+ *
+ * @param id Request id
+ * @param type 0 - timeout; 1 - answer received
+ * @param data Request send time
+ */
+static void cque_cb(uint32_t id, int type, void *data) {
+
+    if(!b.active) return;
+    if(type) bench_hdr_record(&b.hdr, bench_now_ns() - *(uint64_t *)data);
+    else b.timeouts++;
+    if(++b.completed == b.total) b.done_f = 1;
+    else if(b.completed == b.sent) cque_burst(b.ke);
+}
+
+/**
+ * Bursts of requests with answers waited in CQue
+ */
+static void scenario_cque_storm(size_t size) {
+
+    bench_hdr_summary s;
+
+    run_start(size, b.messages);
+    b.cque_time = calloc(b.burst, sizeof(uint64_t));
+    double start = ev_time();
+    cque_burst(b.ke);
+    int timeout = run_until_done();
+    double seconds = ev_time() - start;
+    b.active = 0;
+    free(b.cque_time);
+    b.cque_time = NULL;
+
+    bench_hdr_summarize(&b.hdr, &s);
+    result_begin("cque_storm");
+    result_long("size", size);
+    result_long("burst", b.burst);
+    result_long("timeouts", b.timeouts);
+    result_hdr("latency_ns", &s);
+    result_end("cque_storm", size, seconds, b.hdr.count, timeout, &s);
+}
+
+/**
+ * Driver received data
+ */
+static void driver_received(ksnetEvMgrClass *ke, ksnCorePacketData *rd) {
+
+    switch(rd->cmd) {
+
+        case CMD_BENCH_HELLO:
+            b.nodes_ready++;
+            if(!strcmp(rd->from, BENCH_ECHO_NODE))
+                b.l0_port = ((bench_hello *)rd->data)->l0_port;
+            break;
+
+        case CMD_BENCH_ECHO:
+            bench_answer(ke, rd, CMD_BENCH_ECHO_ANSWER, rd->data, rd->data_len);
+            break;
+
+        case CMD_BENCH_ECHO_ANSWER:
+            if(b.active) rtt_answer(ke, rd->data);
+            break;
+
+        case CMD_BENCH_ACK:
+            if(!b.active) break;
+            b.acked = *(uint64_t *)rd->data;
+            one_way_pump(ke);
+            break;
+
+        case CMD_BENCH_DONE:
+            if(!b.active) break;
+            memcpy(&b.done, rd->data, sizeof(b.done));
+            b.done_f = 1;
+            break;
+
+        case CMD_BENCH_ANSWER:
+            if(b.active) ksnCQueExec(ke->kq, ((bench_msg *)rd->data)->seq);
+            break;
+
+        case CMD_BENCH_SUB_ACK:
+            if(!b.active) break;
+            bench_hdr_record(&b.hdr, *(uint64_t *)rd->data);
+            if(++b.completed == b.total * b.subscribers) b.done_f = 1;
+            else sub_pump(ke);
+            break;
+    }
+}
+
+/**
+ * Teonet events callback of driver and nodes
+ */
+static void event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event, void *data,
+        size_t data_len, void *user_data) {
+
+    ksnCorePacketData *rd = data;
+
+    switch(event) {
+
+        case EV_K_CONNECTED:
+            if(!b.driver_f && !strcmp(rd->from, BENCH_DRIVER))
+                node_connected(ke);
+            break;
+
+        case EV_K_SUBSCRIBED:
+            if(b.driver_f) b.subscribed++;
+            break;
+
+        case EV_K_SUBSCRIBE:
+            if(!b.driver_f) node_event(ke, rd);
+            break;
+
+        case EV_K_RECEIVED:
+            if(b.driver_f) driver_received(ke, rd);
+            else node_received(ke, rd);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Check scenario is selected
+ */
+static int selected(const char *scenario) {
+
+    if(!b.scenarios) return 1;
+
+    size_t len = strlen(scenario);
+    const char *p = b.scenarios;
+    while((p = strstr(p, scenario))) {
+        if((p == b.scenarios || p[-1] == ',') && (!p[len] || p[len] == ','))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+/**
+ * Stop node processes
+ */
+static void nodes_stop(void) {
+
+    int i, status;
+    for(i = 0; i < b.nodes_num; i++) if(b.pids[i] > 0) kill(b.pids[i], SIGTERM);
+    double end = ev_time() + 5.0;
+    for(i = 0; i < b.nodes_num; i++) {
+        if(b.pids[i] <= 0) continue;
+        while(waitpid(b.pids[i], &status, WNOHANG) == 0) {
+            if(ev_time() > end) {
+                kill(b.pids[i], SIGKILL);
+                waitpid(b.pids[i], &status, 0);
+                break;
+            }
+            usleep(10000);
+        }
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n\n"
+        "  -n, --messages=N     Messages in each run (default 10000)\n"
+        "  -p, --port=PORT      Driver port, nodes use next ports (default 9700)\n"
+        "  -s, --scenarios=LIST rtt,throughput,crypt,l0_fan_in,sub_fan_out,cque_storm\n"
+        "  -S, --subscribers=N  Number of subscriber nodes (default 4)\n"
+        "  -l, --l0_clients=N   Number of L0 clients (default 16)\n"
+        "  -b, --burst=N        CQue requests in one burst (default 1000)\n"
+        "  -t, --timeout=SEC    Run timeout (default 60)\n"
+        "  -o, --output=FILE    Write JSON to file instead of stdout\n"
+        "  -v, --verbose        Show teonet output\n", name);
+}
+
+/**
+ * Main benchmark function
+ *
+ * @param argc Number of parameters
+ * @param argv Parameters array
+ *
+ * @return EXIT_SUCCESS or EXIT_FAILURE if nodes did not start
+ */
+int main(int argc, char** argv) {
+
+    // Node process
+    if(argc > 1 && !strcmp(argv[1], "--bench-node")) {
+        argv[1] = argv[0];
+        return node_main(argc - 1, argv + 1);
+    }
+
+    static const size_t rtt_sizes[] = { 64, 1024 };
+    static const size_t one_way_sizes[] = {
+        64, 256, MAX_DATA_LEN, MAX_DATA_LEN + 1, 1024, 4096, 16384
+    };
+    static const size_t crypt_sizes[] = { 64, 1024, 16384 };
+    static struct option long_options[] = {
+        { "messages",    required_argument, 0, 'n' },
+        { "port",        required_argument, 0, 'p' },
+        { "scenarios",   required_argument, 0, 's' },
+        { "subscribers", required_argument, 0, 'S' },
+        { "l0_clients",  required_argument, 0, 'l' },
+        { "burst",       required_argument, 0, 'b' },
+        { "timeout",     required_argument, 0, 't' },
+        { "output",      required_argument, 0, 'o' },
+        { "verbose",     no_argument,       0, 'v' },
+        { "help",        no_argument,       0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    const char *output = NULL;
+    int opt;
+    size_t i;
+    b.messages = 10000;
+    b.port = 9700;
+    b.subscribers = 4;
+    b.l0_clients = 16;
+    b.burst = 1000;
+    b.timeout = 60.0;
+    while((opt = getopt_long(argc, argv, "n:p:s:S:l:b:t:o:vh", long_options,
+            NULL)) != -1) {
+        switch(opt) {
+            case 'n': b.messages = atol(optarg); break;
+            case 'p': b.port = atoi(optarg); break;
+            case 's': b.scenarios = optarg; break;
+            case 'S': b.subscribers = atoi(optarg); break;
+            case 'l': b.l0_clients = atoi(optarg); break;
+            case 'b': b.burst = atoi(optarg); break;
+            case 't': b.timeout = atof(optarg); break;
+            case 'o': output = optarg; break;
+            case 'v': b.verbose = 1; break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if(b.messages < 1 || b.l0_clients < 1 || b.burst < 1 || b.subscribers < 0 ||
+       b.subscribers > BENCH_MAX_NODES - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // JSON goes to stdout or file, teonet output is hidden if not verbose
+    if(output) b.out = fopen(output, "w");
+    else b.out = fdopen(dup(STDOUT_FILENO), "w");
+    if(!b.out) {
+        perror(output ? output : "stdout");
+        return EXIT_FAILURE;
+    }
+    if(!b.verbose) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Start driver in this process, its loop is run by scenarios
+    char port_s[16];
+    snprintf(port_s, sizeof(port_s), "%d", b.port);
+    char *d_argv[] = { argv[0], "-p", port_s, BENCH_DRIVER, NULL };
+    b.driver_f = 1;
+    b.ke = ksnetEvMgrInitPort(4, d_argv, event_cb,
+            READ_OPTIONS|READ_CONFIGURATION, 0, NULL);
+    teoSetAppType(b.ke, "teo-bench");
+    teoSetAppVersion(b.ke, BENCH_VERSION);
+    b.ke->ev_loop = EV_DEFAULT;
+    ksnetEvMgrRun(b.ke);
+    bench_hdr_init(&b.hdr);
+    bench_hdr_init(&b.login_hdr);
+
+    // Start nodes and wait they connected
+    int port = b.ke->teo_cfg.port + 1;
+    b.pids[b.nodes_num++] = node_start(BENCH_ECHO_NODE, port++, 1);
+    for(i = 0; i < (size_t)b.subscribers; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), BENCH_SUB_PREFIX "%d", (int)i + 1);
+        b.pids[b.nodes_num++] = node_start(name, port++, 0);
+    }
+    double end = ev_time() + b.timeout;
+    while((b.nodes_ready < b.nodes_num || b.subscribed < b.subscribers) &&
+          ev_time() < end && ksnetEvMgrStatus(b.ke))
+        ev_run(b.ke->ev_loop, EVRUN_ONCE);
+    int started = b.nodes_ready == b.nodes_num && b.subscribed == b.subscribers;
+
+    fprintf(b.out, "{\"benchmark\": \"bench_teonet\", \"version\": \"%s\", "
+            "\"teonet\": \"%s\", \"messages\": %ld, \"nodes\": %d, "
+            "\"crypt\": %d, \"results\": [",
+            BENCH_VERSION, VERSION, b.messages, b.nodes_num + 1,
+            (int)b.ke->teo_cfg.crypt_f);
+
+    if(started) {
+        if(selected("rtt"))
+            for(i = 0; i < sizeof(rtt_sizes) / sizeof(rtt_sizes[0]); i++)
+                scenario_rtt(rtt_sizes[i]);
+        if(selected("throughput"))
+            for(i = 0; i < sizeof(one_way_sizes) / sizeof(one_way_sizes[0]); i++)
+                scenario_one_way("throughput", one_way_sizes[i], 0);
+        if(selected("crypt"))
+            for(i = 0; i < sizeof(crypt_sizes) / sizeof(crypt_sizes[0]); i++)
+                scenario_one_way("crypt", crypt_sizes[i], 1);
+        if(selected("l0_fan_in")) scenario_l0_fan_in(64);
+        if(selected("sub_fan_out")) scenario_sub_fan_out(64);
+        if(selected("cque_storm")) scenario_cque_storm(64);
+    }
+    else fprintf(stderr, "Nodes did not start: %d of %d ready, "
+            "%d of %d subscribed\n", b.nodes_ready, b.nodes_num,
+            b.subscribed, b.subscribers);
+
+    fprintf(b.out, "\n]}\n");
+    fclose(b.out);
+
+    nodes_stop();
+    bench_hdr_free(&b.hdr);
+    bench_hdr_free(&b.login_hdr);
+    ksnetEvMgrFree(b.ke, 2);
+
+    return started ? EXIT_SUCCESS : EXIT_FAILURE;
+}
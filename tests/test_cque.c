@@ -88,10 +88,10 @@ void test_4_2() {
     // Add callback to queue
     ksnCQueData *cq = ksnCQueAdd(kq, kq_cb, 0.050, NULL);
     CU_ASSERT_PTR_NOT_NULL_FATAL(cq);
-    CU_ASSERT(pblMapSize(kq->cque_map) == 1);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 1);
     cq = ksnCQueAdd(kq, kq_cb, 0.050, NULL);
     CU_ASSERT_PTR_NOT_NULL_FATAL(cq);
-    CU_ASSERT(pblMapSize(kq->cque_map) == 2);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 2);
     
     // Define timer to stop event loop after 1.0 sec
     ev_timer timeout_watcher;
@@ -99,7 +99,7 @@ void test_4_2() {
     ev_timer_start (ke->ev_loop, &timeout_watcher);     
     // Start event loop
     ev_run (ke->ev_loop, 0);
-    CU_ASSERT(pblMapSize(kq->cque_map) == 0);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 0);
     
     // Destroy module
     ksnCQueDestroy(kq);
@@ -120,18 +120,18 @@ void test_4_3() {
     // Add callback to queue
     ksnCQueData *cq = ksnCQueAdd(kq, kq_cb, 0.050, NULL);
     CU_ASSERT_PTR_NOT_NULL_FATAL(cq);
-    CU_ASSERT(pblMapSize(kq->cque_map) == 1);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 1);
     cq = ksnCQueAdd(kq, kq_cb, 0.050, NULL);
     CU_ASSERT_PTR_NOT_NULL_FATAL(cq);
-    CU_ASSERT(pblMapSize(kq->cque_map) == 2);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 2);
     
     // Execute callback queue record 
     int rv = ksnCQueExec(kq, 1);
     CU_ASSERT(rv == 0)
-    CU_ASSERT(pblMapSize(kq->cque_map) == 1);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 1);
     rv = ksnCQueExec(kq, 2);
     CU_ASSERT(rv == 0)
-    CU_ASSERT(pblMapSize(kq->cque_map) == 0);
+    CU_ASSERT(teoHashMapSize(kq->cque_map) == 0);
     
     // Destroy module
     ksnCQueDestroy(kq);
@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <CUnit/Basic.h>
 #include "text-filter/text-filter.h"
 
@@ -30,10 +31,51 @@ void test_filter_2() {
     CU_ASSERT(res == 1);
 }
 
+void test_filter_compiled() {
+    char *test_log_1 = "[2021-04-07 11:49:18:442] DEBUG_VV net_core: ksnCoreSendto:(net_core.c:250): send 17 bytes data, cmd 65 to ::ffff:127.0.0.1:9010";
+    char *test_log_2 = "MESSAGE tcp_server: ksnTcpServerStop:(modules/net_tcp.c:246): server fd 8 was stopped";
+    char *test_log_3 = "DEBUG_VV tr_udp: net_core send";
+    char *match[] = { "(net_core|net_crypt)&(!tr_udp)", "a&b", "!a&h", "a|b&h",
+                      "send & ( stopped | !data )", "net_cor|tcp_serve" };
+    char *logs[] = { test_log_1, test_log_2, test_log_3, "a b c d" };
+    int i, j;
+
+    // Compiled filter gives the same results as log_string_match
+    for(i = 0; i < (int)(sizeof(match) / sizeof(match[0])); i++) {
+        teoLogFilter *lf = teoLogFilterCompile(match[i]);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(lf);
+        for(j = 0; j < (int)(sizeof(logs) / sizeof(logs[0])); j++) {
+            CU_ASSERT(teoLogFilterMatch(lf, logs[j]) ==
+                    log_string_match(logs[j], match[i]));
+        }
+        teoLogFilterFree(lf);
+    }
+
+    // Invalid expressions
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile(""));
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile("a&"));
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile("(a|b"));
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile("Net_core"));
+
+    // Too deep nesting
+    char deep[TEO_LOG_FILTER_MAX_DEPTH * 2 + 8];
+    memset(deep, '!', TEO_LOG_FILTER_MAX_DEPTH);
+    strcpy(deep + TEO_LOG_FILTER_MAX_DEPTH, "a");
+    teoLogFilter *lf = teoLogFilterCompile(deep);
+    CU_ASSERT_PTR_NOT_NULL(lf);
+    teoLogFilterFree(lf);
+    memset(deep, '(', TEO_LOG_FILTER_MAX_DEPTH + 1);
+    strcpy(deep + TEO_LOG_FILTER_MAX_DEPTH + 1, "a");
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile(deep));
+    memset(deep, '!', TEO_LOG_FILTER_MAX_DEPTH + 1);
+    CU_ASSERT_PTR_NULL(teoLogFilterCompile(deep));
+}
+
 
 int add_suite_filter_tests(void) {
     if ((NULL == CU_add_test(pSuite, "Text filter test-1", test_filter_1)) ||
-        (NULL == CU_add_test(pSuite, "Text filter test-2", test_filter_2))
+        (NULL == CU_add_test(pSuite, "Text filter test-2", test_filter_2)) ||
+        (NULL == CU_add_test(pSuite, "Compiled text filter test", test_filter_compiled))
         
         ) {
         CU_cleanup_registry();
@@ -0,0 +1,105 @@
+/*
+ * File:   test_hashmap.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/Basic.h>
+#include "utils/teo_hashmap.h"
+
+extern CU_pSuite pSuite;
+
+void test_hashmap_add_get_remove() {
+
+    teoHashMap *map = teoHashMapNew();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(map);
+
+    // Integer keys, values are stable while map grows
+    uint32_t i, num = 10000;
+    uint32_t *first = teoHashMapAddInt(map, 0, &num, sizeof(num));
+    for(i = 1; i < num; i++) {
+        uint32_t v = i * 3;
+        CU_ASSERT(*(uint32_t*)teoHashMapAddInt(map, i, &v, sizeof(v)) == v);
+    }
+    CU_ASSERT(teoHashMapSize(map) == num);
+    CU_ASSERT(teoHashMapGetInt(map, 0, NULL) == first);
+
+    size_t len;
+    for(i = 1; i < num; i++) {
+        uint32_t *v = teoHashMapGetInt(map, i, &len);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+        CU_ASSERT(len == sizeof(*v) && *v == i * 3);
+    }
+    CU_ASSERT_PTR_NULL(teoHashMapGetInt(map, num, &len));
+
+    // Remove odd keys, even keys are still found
+    for(i = 1; i < num; i += 2) CU_ASSERT(teoHashMapRemoveInt(map, i) == 1);
+    CU_ASSERT(teoHashMapRemoveInt(map, 1) == 0);
+    CU_ASSERT(teoHashMapSize(map) == num / 2);
+    for(i = 0; i < num; i++) {
+        void *v = teoHashMapGetInt(map, i, NULL);
+        CU_ASSERT((i & 1) ? v == NULL : v != NULL);
+    }
+
+    // String keys and replace
+    CU_ASSERT_STRING_EQUAL(teoHashMapAddStr(map, "peer-1", "one", 4), "one");
+    CU_ASSERT_STRING_EQUAL(teoHashMapAddStr(map, "peer-1", "two", 4), "two");
+    CU_ASSERT_STRING_EQUAL(teoHashMapGetStr(map, "peer-1", &len), "two");
+    CU_ASSERT(teoHashMapSize(map) == num / 2 + 1);
+    CU_ASSERT(teoHashMapRemoveStr(map, "peer-1") == 1);
+    CU_ASSERT_PTR_NULL(teoHashMapGetStr(map, "peer-1", &len));
+
+    teoHashMapClear(map);
+    CU_ASSERT(teoHashMapSize(map) == 0);
+    CU_ASSERT_PTR_NULL(teoHashMapGetInt(map, 0, NULL));
+
+    teoHashMapFree(map);
+}
+
+void test_hashmap_iterator() {
+
+    teoHashMap *map = teoHashMapNew();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(map);
+
+    uint32_t i;
+    for(i = 0; i < 100; i++) teoHashMapAddInt(map, i, &i, sizeof(i));
+
+    // Entries are iterated in insertion order, current entry may be removed
+    teoHashMapIter it;
+    teoHashMapEntry *e;
+    uint32_t n = 0;
+    teoHashMapIterInit(map, &it);
+    while((e = teoHashMapIterNext(&it))) {
+        CU_ASSERT(*(uint32_t*)e->data == n);
+        CU_ASSERT(e->key_len == sizeof(n) && !memcmp(e->key, &n, sizeof(n)));
+        if(n % 3 == 0) teoHashMapRemoveEntry(map, e);
+        n++;
+    }
+    CU_ASSERT(n == 100);
+    CU_ASSERT(teoHashMapSize(map) == 66);
+
+    n = 0;
+    teoHashMapIterInit(map, &it);
+    while((e = teoHashMapIterNext(&it))) {
+        CU_ASSERT(*(uint32_t*)e->data % 3 != 0);
+        n++;
+    }
+    CU_ASSERT(n == 66);
+
+    teoHashMapFree(map);
+}
+
+int add_suite_hashmap_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Hash map add, get and remove test", test_hashmap_add_get_remove)) ||
+        (NULL == CU_add_test(pSuite, "Hash map iterator test", test_hashmap_iterator))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
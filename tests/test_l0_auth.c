@@ -0,0 +1,357 @@
+/*
+ * File:   test_l0_auth.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/md5.h>
+#include <arpa/inet.h>
+#include <CUnit/Basic.h>
+#include "ev_mgr.h"
+#include "tr-udp.h"
+#include "modules/l0-auth.h"
+
+extern CU_pSuite pSuite;
+
+#define SECRET "l0-secret"
+#define NOW 1700000000L
+
+/**
+ * Make login payload signed with secret
+ */
+static void make_payload(char *buf, size_t buf_len, const char *name,
+        long valid_until, const char *secret) {
+
+    char ts[32], sign[MD5_DIGEST_LENGTH * 2 + 1];
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    int i;
+
+    snprintf(ts, sizeof(ts), "%ld", valid_until);
+    MD5_CTX ctx;
+    MD5_Init(&ctx);
+    MD5_Update(&ctx, name, strlen(name));
+    MD5_Update(&ctx, secret, strlen(secret));
+    MD5_Update(&ctx, ts, strlen(ts));
+    MD5_Final(digest, &ctx);
+    for(i = 0; i < MD5_DIGEST_LENGTH; i++)
+        sprintf(sign + i * 2, "%02x", digest[i]);
+
+    snprintf(buf, buf_len,
+            "{\"userId\":\"%s\",\"timestamp\":\"%s\",\"sign\":\"%s\"}",
+            name, ts, sign);
+}
+
+void test_l0_auth_parse_verify() {
+
+    char payload[256];
+    teoL0AuthData ad;
+
+    // Missing fields
+    CU_ASSERT(!teoL0AuthParse("{\"userId\":\"user\",\"timestamp\":\"1\"}", &ad));
+    CU_ASSERT(!teoL0AuthParse("[\"userId\"]", &ad));
+    CU_ASSERT(!teoL0AuthParse("{\"userId\"", &ad));
+
+    make_payload(payload, sizeof(payload), "user", NOW + 60, SECRET);
+    CU_ASSERT_FATAL(teoL0AuthParse(payload, &ad));
+    CU_ASSERT(ad.name_len == 4 && !strncmp(ad.name, "user", 4));
+    CU_ASSERT(ad.sign_len == MD5_DIGEST_LENGTH * 2);
+    CU_ASSERT(teoL0AuthVerify(SECRET, strlen(SECRET), &ad));
+    CU_ASSERT(!teoL0AuthVerify("other", 5, &ad));
+
+    // Timestamp
+    CU_ASSERT(teoL0AuthTimeValid(&ad, NOW));
+    CU_ASSERT(teoL0AuthTimeValid(&ad, NOW + 60));
+    CU_ASSERT(!teoL0AuthTimeValid(&ad, NOW + 61));
+
+    // Upper case signature is not accepted
+    char *sign = strstr(payload, "\"sign\":\"") + 8;
+    int i;
+    for(i = 0; i < MD5_DIGEST_LENGTH * 2; i++)
+        if(sign[i] >= 'a') sign[i] -= 'a' - 'A';
+    CU_ASSERT_FATAL(teoL0AuthParse(payload, &ad));
+    CU_ASSERT(!teoL0AuthVerify(SECRET, strlen(SECRET), &ad));
+}
+
+void test_l0_auth_cache() {
+
+    char payload[256], other[256];
+    teoL0AuthData ad;
+
+    teoL0Auth *la = teoL0AuthNew(NULL, SECRET, 0, NULL, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(la);
+
+    make_payload(payload, sizeof(payload), "user", NOW + 60, SECRET);
+    teoL0AuthParse(payload, &ad);
+
+    // First login is hashed, next logins are verified from cache
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 0, 0) == TEO_L0_AUTH_OK);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 0, 0) == TEO_L0_AUTH_OK);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 0, 0) == TEO_L0_AUTH_OK);
+    CU_ASSERT(la->stat.hashed == 1);
+    CU_ASSERT(la->stat.cache_hits == 2);
+
+    // Cached signature with other name is checked
+    make_payload(other, sizeof(other), "evil", NOW + 60, SECRET);
+    char *sign = strstr(payload, "\"sign\":\"") + 8;
+    memcpy(strstr(other, "\"sign\":\"") + 8, sign, MD5_DIGEST_LENGTH * 2);
+    teoL0AuthParse(other, &ad);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 0, 0) == TEO_L0_AUTH_FAILED);
+    CU_ASSERT(la->stat.hashed == 2);
+
+    // Cached credentials expire with timestamp
+    teoL0AuthParse(payload, &ad);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW + 61, 0, 0) == TEO_L0_AUTH_FAILED);
+
+    // Wrong secret
+    make_payload(other, sizeof(other), "user", NOW + 60, "other");
+    teoL0AuthParse(other, &ad);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 0, 0) == TEO_L0_AUTH_FAILED);
+    CU_ASSERT(la->stat.failed == 3);
+
+    teoL0AuthFree(la);
+}
+
+typedef struct auth_results {
+    int count;
+    int verified;
+    int fd_sum;
+} auth_results;
+
+static void auth_cb(void *user_data, int fd, uint32_t seq, teoL0AuthData *ad,
+        int verified) {
+
+    auth_results *r = user_data;
+    r->count++;
+    r->verified += verified;
+    r->fd_sum += fd;
+    // Credentials are copied with the job
+    CU_ASSERT(ad->name_len == 6 && !strncmp(ad->name, "user-", 5));
+    CU_ASSERT(seq == (uint32_t)fd + 100);
+}
+
+static void wake_cb(struct ev_loop *loop, ev_timer *w, int revents) { }
+
+void test_l0_auth_workers() {
+
+    struct ev_loop *loop = ev_loop_new(0);
+    auth_results r = { 0, 0, 0 };
+    char payload[256], name[16];
+    teoL0AuthData ad;
+    int i;
+
+    teoL0Auth *la = teoL0AuthNew(loop, SECRET, 2, auth_cb, &r);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(la);
+    CU_ASSERT(la->workers_num == 2);
+
+    // Signatures are checked by workers, bad ones fail
+    for(i = 0; i < 10; i++) {
+        snprintf(name, sizeof(name), "user-%d", i);
+        make_payload(payload, sizeof(payload), name, NOW + 60,
+                i % 5 ? SECRET : "bad");
+        teoL0AuthParse(payload, &ad);
+        CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, i, i + 100) ==
+                TEO_L0_AUTH_PENDING);
+    }
+
+    ev_timer w;
+    ev_timer_init(&w, wake_cb, 0.01, 0.01);
+    ev_timer_start(loop, &w);
+    double end = ev_time() + 5.0;
+    while(r.count < 10 && ev_time() < end) ev_run(loop, EVRUN_ONCE);
+    ev_timer_stop(loop, &w);
+
+    CU_ASSERT(r.count == 10);
+    CU_ASSERT(r.verified == 8);
+    CU_ASSERT(r.fd_sum == 45);
+    CU_ASSERT(la->stat.offloaded == 10 && la->stat.failed == 2);
+
+    // Verified credentials are answered from cache without workers
+    make_payload(payload, sizeof(payload), "user-1", NOW + 60, SECRET);
+    teoL0AuthParse(payload, &ad);
+    CU_ASSERT(teoL0AuthCheck(la, &ad, NOW, 1, 101) == TEO_L0_AUTH_OK);
+
+    teoL0AuthFree(la);
+    ev_loop_destroy(loop);
+}
+
+static void l0_event_cb(ksnetEvMgrClass *ke, ksnetEvMgrEvents event,
+        void *data, size_t data_len, void *user_data) { }
+
+void test_l0_auth_async_reject() {
+
+    // L0 server with login verification worker on simulated network
+    char *argv[] = { "test_teonet", "--l0_allow", "--auth_secret=" SECRET,
+            "-p", "9710", "l0-auth-test", NULL };
+    ksnetEvMgrClass *ke = ksnetEvMgrInitPort(6, argv, l0_event_cb,
+            READ_OPTIONS, 0, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ke);
+    ke->teo_cfg.l0_auth_workers = 1;
+    ke->ev_loop = EV_DEFAULT;
+    ksnetEvMgrRun(ke);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ke->kl);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ke->kl->auth);
+
+    teoNetSim *sim = teoNetSimNew(5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(teoNetSimAttach(sim, ke, "10.0.0.1"));
+    teoNetSimNodeAdd(sim, "10.0.0.2", 9100, NULL, NULL);
+    teoNetSimLinkParam lp = { 0 };
+    teoNetSimSetLink(sim, "10.0.0.1", ke->kc->port, "10.0.0.2", 9100, &lp);
+
+    // TR-UDP client sends login signed with wrong secret
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9100);
+    inet_pton(AF_INET, "10.0.0.2", &sa.sin_addr);
+    trudpChannelData *tcd = trudpGetChannelCreate(ke->kc->ku,
+            (__CONST_SOCKADDR_ARG)&sa, sizeof(sa), 0);
+    CU_ASSERT_FATAL(tcd != (void*)-1);
+
+    char payload[256], buf[512];
+    make_payload(payload, sizeof(payload), "user-r", (long)ev_time() + 60,
+            "bad");
+    ksnCorePacketData rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.addr = "10.0.0.2";
+    rd.port = 9100;
+    rd.data = buf;
+    rd.data_len = teoLNullPacketCreate(buf, sizeof(buf), 0, "", payload,
+            strlen(payload) + 1);
+    ksnLNulltrudpCheckPaket(ke->kl, &rd);
+    int fd = tcd->fd;
+    CU_ASSERT(fd >= MAX_FD_NUMBER);
+    CU_ASSERT_PTR_NOT_NULL(teoHashMapGetInt(ke->kl->map, fd, NULL));
+    teoNetSimStat *st = teoNetSimLinkStat(sim, "10.0.0.1", ke->kc->port,
+            "10.0.0.2", 9100);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(st);
+    uint64_t sent = st->sent;
+
+    // Worker rejects the login: client is disconnected and its channel reset
+    double end = ev_time() + 5.0;
+    while(!ke->kl->auth->stat.failed && ev_time() < end)
+        ev_run(ke->ev_loop, EVRUN_ONCE);
+    CU_ASSERT(ke->kl->auth->stat.offloaded == 1);
+    CU_ASSERT(ke->kl->auth->stat.failed == 1);
+    CU_ASSERT_PTR_NULL(teoHashMapGetInt(ke->kl->map, fd, NULL));
+    CU_ASSERT(st->sent > sent);
+
+    teoNetSimStop(sim);
+    ksnetEvMgrFree(ke, 2);
+    teoNetSimFree(sim);
+}
+
+typedef struct local_results {
+    int packets;
+    int disconnected;
+    uint8_t cmd;
+    char from[32];
+    char data[64];
+} local_results;
+
+static void local_client_cb(void *user_data, teoLNullCPacket *packet,
+        size_t packet_length) {
+
+    local_results *r = user_data;
+    if(packet == NULL) {
+        r->disconnected++;
+        return;
+    }
+    r->packets++;
+    r->cmd = packet->cmd;
+    snprintf(r->from, sizeof(r->from), "%s", packet->peer_name);
+    snprintf(r->data, sizeof(r->data), "%.*s", (int)packet->data_length,
+            packet->peer_name + packet->peer_name_length);
+}
+
+void test_l0_local_client() {
+
+    // L0 server with inline login verification
+    char *argv[] = { "test_teonet", "--l0_allow", "--auth_secret=" SECRET,
+            "-p", "9711", "l0-local-test", NULL };
+    ksnetEvMgrClass *ke = ksnetEvMgrInitPort(6, argv, l0_event_cb,
+            READ_OPTIONS, 0, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ke);
+    ke->teo_cfg.l0_auth_workers = 0;
+    ke->ev_loop = EV_DEFAULT;
+    ksnetEvMgrRun(ke);
+    ksnLNullClass *kl = ke->kl;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(kl);
+
+    local_results r;
+    memset(&r, 0, sizeof(r));
+    CU_ASSERT(ksnLNullLocalClientConnect(kl, "127.0.0.1", NULL, &r) == -1);
+    int fd = ksnLNullLocalClientConnect(kl, "127.0.0.1", local_client_cb, &r);
+    CU_ASSERT_FATAL(fd >= MAX_FD_NUMBER);
+    CU_ASSERT_PTR_NOT_NULL(teoHashMapGetInt(kl->map, fd, NULL));
+
+    // Packets before login are dropped
+    CU_ASSERT(ksnLNullLocalClientSend(kl, fd, CMD_ECHO, "", "echo", 5) == -1);
+    CU_ASSERT(r.packets == 0);
+
+    // Login is confirmed through the callback
+    char payload[256];
+    make_payload(payload, sizeof(payload), "user-l", (long)ev_time() + 60,
+            SECRET);
+    CU_ASSERT(ksnLNullLocalClientSend(kl, fd, 0, "", payload,
+            strlen(payload) + 1) > 0);
+    CU_ASSERT(r.packets == 1 && r.cmd == CMD_CONFIRM_AUTH);
+    CU_ASSERT_STRING_EQUAL(r.from, "l0-local-test");
+    CU_ASSERT_STRING_EQUAL(r.data, "user-l");
+    CU_ASSERT(ksnLNullClientIsConnected(kl, "user-l") == fd);
+
+    // Answer of peer to the client is delivered through the callback
+    char buf[128];
+    ksnLNullSPacket *spacket = (ksnLNullSPacket *)buf;
+    spacket->cmd = CMD_ECHO_ANSWER;
+    spacket->client_name_length = 7;
+    spacket->data_length = 5;
+    memcpy(spacket->payload, "user-l\0echo", 12);
+    ksnCorePacketData rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.cmd = CMD_L0_TO;
+    rd.from = "peer-a";
+    rd.from_len = 7;
+    rd.data = spacket;
+    rd.data_len = sizeof(ksnLNullSPacket) + 12;
+    CU_ASSERT(ksnCommandCheck(ke->kc->kco, &rd));
+    CU_ASSERT(r.packets == 2 && r.cmd == CMD_ECHO_ANSWER);
+    CU_ASSERT_STRING_EQUAL(r.from, "peer-a");
+    CU_ASSERT_STRING_EQUAL(r.data, "echo");
+
+    // Owner disconnect is notified
+    ksnLNullClientDisconnect(kl, fd, 1);
+    CU_ASSERT(r.disconnected == 1);
+    CU_ASSERT_PTR_NULL(teoHashMapGetInt(kl->map, fd, NULL));
+    CU_ASSERT(ksnLNullLocalClientSend(kl, fd, CMD_ECHO, "", "echo", 5) == -1);
+
+    // Rejected login disconnects the client
+    memset(&r, 0, sizeof(r));
+    fd = ksnLNullLocalClientConnect(kl, "127.0.0.1", local_client_cb, &r);
+    CU_ASSERT_FATAL(fd >= MAX_FD_NUMBER);
+    make_payload(payload, sizeof(payload), "user-b", (long)ev_time() + 60,
+            "bad");
+    CU_ASSERT(ksnLNullLocalClientSend(kl, fd, 0, "", payload,
+            strlen(payload) + 1) == -1);
+    CU_ASSERT(r.packets == 0 && r.disconnected == 1);
+    CU_ASSERT_PTR_NULL(teoHashMapGetInt(kl->map, fd, NULL));
+
+    ksnetEvMgrFree(ke, 2);
+}
+
+int add_suite_l0_auth_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Login payload parse and verify test", test_l0_auth_parse_verify)) ||
+        (NULL == CU_add_test(pSuite, "Verified credentials cache test", test_l0_auth_cache)) ||
+        (NULL == CU_add_test(pSuite, "Login verification workers test", test_l0_auth_workers)) ||
+        (NULL == CU_add_test(pSuite, "Async login reject test", test_l0_auth_async_reject)) ||
+        (NULL == CU_add_test(pSuite, "In-process L0 client test", test_l0_local_client))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * File:   test_metric.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <CUnit/Basic.h>
+#include "modules/metric_registry.h"
+
+extern CU_pSuite pSuite;
+
+void test_metric_hist_bucket() {
+
+    uint64_t v;
+    int prev = 0;
+
+    // Each value is not bigger than upper bound of its bucket and bigger
+    // than upper bound of previous bucket
+    for(v = 0; v < 100000; v++) {
+        int idx = teoMetricHistBucket(v);
+        CU_ASSERT(idx == prev || idx == prev + 1);
+        CU_ASSERT(v <= teoMetricHistUpper(idx));
+        if(idx) CU_ASSERT(v > teoMetricHistUpper(idx - 1));
+        prev = idx;
+    }
+
+    // Relative bucket width is less than 25%
+    for(v = 16; v < (1ULL << 40); v = v * 3 + 1) {
+        int idx = teoMetricHistBucket(v);
+        uint64_t low = teoMetricHistUpper(idx - 1) + 1;
+        CU_ASSERT((teoMetricHistUpper(idx) - low + 1) * 4 <= low);
+    }
+
+    CU_ASSERT(teoMetricHistBucket(~0ULL) == TEO_METRIC_HIST_BUCKETS - 1);
+}
+
+static double metric_cb(void *user_data) {
+    return *(int*)user_data;
+}
+
+static void *metric_thread(void *mr) {
+    int i;
+    for(i = 0; i < 100000; i++) teoMetricAdd(mr, 0, 1);
+    return NULL;
+}
+
+void test_metric_registry() {
+
+    teoMetricRegistry *mr = teoMetricRegistryNew();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mr);
+
+    int value = 7;
+    CU_ASSERT(teoMetricRegisterCounter(mr, "test_total", "Counter") == 0);
+    CU_ASSERT(teoMetricRegisterGauge(mr, "test_gauge", "Gauge") == 1);
+    CU_ASSERT(teoMetricRegisterHistogram(mr, "test_seconds", "Histogram",
+            1e-3) == 2);
+    CU_ASSERT(teoMetricRegisterCb(mr, "test_cb", "Callback",
+            TEO_METRIC_GAUGE, metric_cb, &value) == 3);
+
+    // Counter updated from several threads
+    pthread_t t[4];
+    int i;
+    for(i = 0; i < 4; i++) pthread_create(&t[i], NULL, metric_thread, mr);
+    for(i = 0; i < 4; i++) pthread_join(t[i], NULL);
+    CU_ASSERT(teoMetricGet(mr, 0) == 400000);
+
+    teoMetricSet(mr, 1, 2.5);
+    CU_ASSERT(teoMetricGet(mr, 1) == 2.5);
+    CU_ASSERT(teoMetricGet(mr, 3) == 7);
+
+    uint64_t buckets[TEO_METRIC_HIST_BUCKETS], sum;
+    teoMetricObserve(mr, 2, 1);
+    teoMetricObserve(mr, 2, 1);
+    teoMetricObserve(mr, 2, 1000);
+    CU_ASSERT(teoMetricHistogramGet(mr, 2, buckets, &sum) == 3);
+    CU_ASSERT(sum == 1002);
+    CU_ASSERT(buckets[1] == 2);
+    CU_ASSERT(buckets[teoMetricHistBucket(1000)] == 1);
+
+    // Prometheus text format
+    size_t len;
+    char *text = teoMetricRegistryFormat(mr, "peer=\"teo\"", &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(text);
+    CU_ASSERT(strlen(text) == len);
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "# TYPE test_total counter\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "test_total{peer=\"teo\"} 400000\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "test_gauge{peer=\"teo\"} 2.5\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "test_cb{peer=\"teo\"} 7\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text,
+            "test_seconds_bucket{peer=\"teo\",le=\"0.001\"} 2\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text,
+            "test_seconds_bucket{peer=\"teo\",le=\"+Inf\"} 3\n"));
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "test_seconds_count{peer=\"teo\"} 3\n"));
+    free(text);
+
+    teoMetricRegistryFree(mr);
+}
+
+int add_suite_metric_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Histogram buckets test", test_metric_hist_bucket)) ||
+        (NULL == CU_add_test(pSuite, "Metrics registry test", test_metric_registry))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * File:   test_net_arp.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <CUnit/Basic.h>
+#include "ev_mgr.h"
+#include "net_arp.h"
+
+extern CU_pSuite pSuite;
+
+/**
+ * TR-UDP event callback: peers of the test have no channels
+ */
+static void arp_test_trudp_cb(void *tcd_pointer, int event, void *data,
+        size_t data_length, void *user_data) {
+}
+
+/**
+ * Create event manager with ARP table of host "arp-test"
+ */
+static ksnetEvMgrClass *arp_test_init() {
+
+    ksnetEvMgrClass *ke = calloc(1, sizeof(ksnetEvMgrClass));
+    strcpy(ke->teo_cfg.host_name, "arp-test");
+    ke->ev_loop = ev_loop_new(0);
+    ke->kc = calloc(1, sizeof(ksnCoreClass));
+    ke->kc->port = 9000;
+    ke->kc->ku = trudpInit(-1, ke->kc->port, arp_test_trudp_cb, ke);
+    ke->ks = ksnStreamInit(ke);
+    ke->kc->ka = ksnetArpInit(ke);
+
+    return ke;
+}
+
+static void arp_test_destroy(ksnetEvMgrClass *ke) {
+
+    ksnetArpDestroy(ke->kc->ka);
+    ksnStreamDestroy(ke->ks);
+    trudpDestroy(ke->kc->ku);
+    ev_loop_destroy(ke->ev_loop);
+    free(ke->kc);
+    free(ke);
+}
+
+static void arp_test_add(ksnetArpClass *ka, char *name, int port) {
+
+    ksnet_arp_data_ext arp;
+    memset(&arp, 0, sizeof(arp));
+    strcpy(arp.data.addr, "127.0.0.1");
+    arp.data.port = port;
+    ksnetArpAdd(ka, name, &arp);
+}
+
+/**
+ * Find peer record in delta
+ */
+static teoArpDelta *delta_find(teoArpDeltaHeader *dh, const char *name) {
+
+    uint32_t i;
+    size_t ptr = 0;
+    for(i = 0; i < dh->length; i++) {
+        teoArpDelta *rec = (teoArpDelta *)(dh->records + ptr);
+        if(!strcmp(rec->name, name)) return rec;
+        ptr += rec->length;
+    }
+
+    return NULL;
+}
+
+void test_arp_delta_collapse() {
+
+    ksnetEvMgrClass *ke = arp_test_init();
+    ksnetArpClass *ka = ke->kc->ka;
+    uint32_t v0 = ka->version;
+
+    arp_test_add(ka, "peer-1", 9001);
+    arp_test_add(ka, "peer-2", 9002);
+    arp_test_add(ka, "peer-3", 9003);
+    uint32_t v1 = ka->version;
+    CU_ASSERT(v1 == v0 + 3);
+
+    // Changes of each peer are collapsed into one record
+    arp_test_add(ka, "peer-1", 9011);
+    teoArpUpdated(ka, "peer-2");
+    arp_test_add(ka, "peer-1", 9021);
+    ksnetArpRemove(ka, "peer-2");
+    arp_test_add(ka, "peer-3", 9003); // Not changed
+    CU_ASSERT(ka->version == v1 + 4);
+
+    size_t len;
+    teoArpDeltaHeader *dh = teoArpGetDelta(ka, ka->epoch, v1, &len);
+    CU_ASSERT(dh->epoch == ka->epoch && dh->version == ka->version);
+    CU_ASSERT(dh->from_version == v1);
+    CU_ASSERT_FATAL(dh->length == 2);
+    teoArpDelta *rec = delta_find(dh, "peer-1");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+    CU_ASSERT(rec->op == TEO_ARP_UPDATE && rec->version == v1 + 3);
+    CU_ASSERT(rec->data.port == 9021);
+    rec = delta_find(dh, "peer-2");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+    CU_ASSERT(rec->op == TEO_ARP_REMOVE && rec->version == v1 + 4);
+    free(dh);
+
+    // Peer added and changed since version is added
+    dh = teoArpGetDelta(ka, ka->epoch, v0, &len);
+    CU_ASSERT_FATAL(dh->length == 3);
+    rec = delta_find(dh, "peer-1");
+    CU_ASSERT(rec->op == TEO_ARP_ADD && rec->version == v1 + 3);
+    rec = delta_find(dh, "peer-3");
+    CU_ASSERT(rec->op == TEO_ARP_ADD && rec->version == v0 + 3);
+    CU_ASSERT(delta_find(dh, "peer-2")->op == TEO_ARP_REMOVE);
+    free(dh);
+
+    // Mode changed in ARP table record (TCP proxy child of r-host)
+    uint32_t v2 = ka->version;
+    ksnetArpGet(ka, "peer-3")->data.mode = 2;
+    teoArpUpdated(ka, "peer-3");
+    dh = teoArpGetDelta(ka, ka->epoch, v2, &len);
+    CU_ASSERT_FATAL(dh->length == 1);
+    rec = delta_find(dh, "peer-3");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+    CU_ASSERT(rec->op == TEO_ARP_UPDATE && rec->version == v2 + 1);
+    CU_ASSERT(rec->data.mode == 2);
+    free(dh);
+
+    // No changes
+    dh = teoArpGetDelta(ka, ka->epoch, ka->version, &len);
+    CU_ASSERT(dh->length == 0 && dh->from_version == ka->version);
+    CU_ASSERT(len == sizeof(teoArpDeltaHeader));
+    free(dh);
+
+    arp_test_destroy(ke);
+}
+
+void test_arp_delta_full() {
+
+    ksnetEvMgrClass *ke = arp_test_init();
+    ksnetArpClass *ka = ke->kc->ka;
+    uint32_t v0 = ka->version;
+    arp_test_add(ka, "peer-1", 9001);
+    arp_test_add(ka, "peer-2", 9002);
+
+    // Version 0: full table
+    teoArpDeltaHeader *dh = teoArpGetDelta(ka, ka->epoch, 0, NULL);
+    CU_ASSERT(dh->from_version == 0 && dh->length == 3);
+    CU_ASSERT_PTR_NOT_NULL(delta_find(dh, "arp-test"));
+    teoArpDelta *rec = delta_find(dh, "peer-2");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(rec);
+    CU_ASSERT(rec->op == TEO_ARP_ADD && rec->version == ka->version);
+    free(dh);
+
+    // Other epoch and version after current: full table
+    dh = teoArpGetDelta(ka, ka->epoch + 1, v0, NULL);
+    CU_ASSERT(dh->from_version == 0 && dh->length == 3);
+    free(dh);
+    dh = teoArpGetDelta(ka, ka->epoch, ka->version + 1, NULL);
+    CU_ASSERT(dh->from_version == 0 && dh->length == 3);
+    free(dh);
+
+    // Changes log overflow: full table
+    uint32_t v1 = ka->version;
+    int i;
+    for(i = 0; i < TEO_ARP_LOG_SIZE; i++) teoArpUpdated(ka, "peer-1");
+    dh = teoArpGetDelta(ka, ka->epoch, v1, NULL);
+    CU_ASSERT(dh->from_version == v1 && dh->length == 1);
+    CU_ASSERT(delta_find(dh, "peer-1")->version == ka->version);
+    free(dh);
+    teoArpUpdated(ka, "peer-1");
+    dh = teoArpGetDelta(ka, ka->epoch, v1, NULL);
+    CU_ASSERT(dh->from_version == 0 && dh->length == 3);
+    free(dh);
+
+    // Table reset: full table
+    v1 = ka->version;
+    ksnetArpRemoveAll(ka);
+    CU_ASSERT(ksnetArpSize(ka) == 1);
+    dh = teoArpGetDelta(ka, ka->epoch, v1, NULL);
+    CU_ASSERT(dh->from_version == 0 && dh->length == 1);
+    CU_ASSERT_PTR_NOT_NULL(delta_find(dh, "arp-test"));
+    free(dh);
+
+    // Changes after reset are available
+    v1 = ka->version;
+    arp_test_add(ka, "peer-3", 9003);
+    dh = teoArpGetDelta(ka, ka->epoch, v1, NULL);
+    CU_ASSERT(dh->from_version == v1 && dh->length == 1);
+    CU_ASSERT(delta_find(dh, "peer-3")->op == TEO_ARP_ADD);
+    free(dh);
+
+    arp_test_destroy(ke);
+}
+
+void test_arp_addr_index() {
+
+    ksnetEvMgrClass *ke = arp_test_init();
+    ksnetArpClass *ka = ke->kc->ka;
+    char *name;
+
+    arp_test_add(ka, "peer-1", 9001);
+    CU_ASSERT_PTR_NOT_NULL(ksnetArpFindByAddrStr(ka, "127.0.0.1", 9001,
+            &name));
+    CU_ASSERT_STRING_EQUAL(name, "peer-1");
+    CU_ASSERT_PTR_NULL(ksnetArpFindByAddrStr(ka, "127.0.0.1", 9002, NULL));
+
+    // Last added peer owns the address
+    arp_test_add(ka, "peer-2", 9001);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(9001);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CU_ASSERT_PTR_NOT_NULL(ksnetArpFindByAddr(ka, (struct sockaddr *)&sa,
+            &name));
+    CU_ASSERT_STRING_EQUAL(name, "peer-2");
+
+    // Other peer with the address is found when owner is removed
+    ksnetArpRemove(ka, "peer-2");
+    CU_ASSERT_PTR_NOT_NULL(ksnetArpFindByAddr(ka, (struct sockaddr *)&sa,
+            &name));
+    CU_ASSERT_STRING_EQUAL(name, "peer-1");
+
+    // Owner address changed
+    arp_test_add(ka, "peer-3", 9001);
+    arp_test_add(ka, "peer-3", 9003);
+    CU_ASSERT_PTR_NOT_NULL(ksnetArpFindByAddrStr(ka, "127.0.0.1", 9001,
+            &name));
+    CU_ASSERT_STRING_EQUAL(name, "peer-1");
+    CU_ASSERT_PTR_NOT_NULL(ksnetArpFindByAddrStr(ka, "127.0.0.1", 9003,
+            &name));
+    CU_ASSERT_STRING_EQUAL(name, "peer-3");
+
+    ksnetArpRemove(ka, "peer-1");
+    CU_ASSERT_PTR_NULL(ksnetArpFindByAddrStr(ka, "127.0.0.1", 9001, NULL));
+
+    arp_test_destroy(ke);
+}
+
+int add_suite_net_arp_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Peers table delta collapsing test", test_arp_delta_collapse)) ||
+        (NULL == CU_add_test(pSuite, "Peers table delta full table fallbacks test", test_arp_delta_full)) ||
+        (NULL == CU_add_test(pSuite, "Peers address index test", test_arp_addr_index))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * File:   test_net_sim.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <CUnit/Basic.h>
+#include "ev_mgr.h"
+
+extern CU_pSuite pSuite;
+
+// Teonet TCP proxy functions
+ssize_t teo_recvfrom (ksnetEvMgrClass* ke,
+            int fd, void *buffer, size_t buffer_len, int flags,
+            __SOCKADDR_ARG addr, socklen_t *__restrict addr_len);
+ssize_t teo_sendto (ksnetEvMgrClass* ke,
+            int fd, const void *buffer, size_t buffer_len, int flags,
+            __CONST_SOCKADDR_ARG addr, socklen_t addr_len);
+
+#define ADDR "10.0.0.1"
+
+static void make_sa(struct sockaddr_in *sa, int port) {
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons(port);
+    inet_pton(AF_INET, ADDR, &sa->sin_addr);
+}
+
+void test_net_sim_link() {
+
+    teoNetSim *sim = teoNetSimNew(1);
+    teoNetSimNode *a = teoNetSimNodeAdd(sim, ADDR, 1000, NULL, NULL);
+    teoNetSimNode *b = teoNetSimNodeAdd(sim, ADDR, 2000, NULL, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(a);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+    CU_ASSERT_PTR_NULL(teoNetSimNodeAdd(sim, ADDR, 1000, NULL, NULL));
+
+    // 10 ms latency, 1000 bytes per second, MTU 500, 250 bytes queue
+    teoNetSimLinkParam lp = { 0 };
+    lp.latency = 0.01;
+    lp.bandwidth = 1000;
+    lp.mtu = 500;
+    lp.queue_limit = 250;
+    CU_ASSERT(!teoNetSimSetLink(sim, ADDR, 1000, ADDR, 2000, &lp));
+
+    char buf[1024];
+    struct sockaddr_in to, from;
+    socklen_t from_len = sizeof(from);
+    make_sa(&to, 2000);
+    memset(buf, 'x', sizeof(buf));
+    CU_ASSERT(teoNetSimSendto(a, buf, 100, (struct sockaddr *)&to,
+            sizeof(to)) == 100);
+    CU_ASSERT(teoNetSimSendto(a, buf, 100, (struct sockaddr *)&to,
+            sizeof(to)) == 100);
+    CU_ASSERT(teoNetSimSendto(a, buf, 100, (struct sockaddr *)&to,
+            sizeof(to)) == 100); // Does not fit queue
+    CU_ASSERT(teoNetSimSendto(a, buf, 600, (struct sockaddr *)&to,
+            sizeof(to)) == 600); // Larger than MTU
+
+    // Transmitted in 0.1 sec each and delivered after latency
+    CU_ASSERT_DOUBLE_EQUAL(teoNetSimNextTime(sim), 0.11, 1e-9);
+    CU_ASSERT(teoNetSimRun(sim, 0.1) == 0);
+    CU_ASSERT(teoNetSimRecvfrom(b, buf, sizeof(buf), (struct sockaddr *)&from,
+            &from_len) == -1);
+    CU_ASSERT(teoNetSimRun(sim, 0.11) == 1);
+    CU_ASSERT(b->rx_num == 1);
+    CU_ASSERT(teoNetSimRecvfrom(b, buf, 10, (struct sockaddr *)&from,
+            &from_len) == 10); // Truncated
+    CU_ASSERT(ntohs(from.sin_port) == 1000);
+    CU_ASSERT(teoNetSimRun(sim, 1.0) == 1);
+    CU_ASSERT_DOUBLE_EQUAL(sim->now, 1.0, 1e-9);
+    CU_ASSERT_DOUBLE_EQUAL(teoNetSimNextTime(sim), -1.0, 1e-9);
+
+    teoNetSimStat *st = teoNetSimLinkStat(sim, ADDR, 1000, ADDR, 2000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(st);
+    CU_ASSERT(st->sent == 4 && st->delivered == 2);
+    CU_ASSERT(st->bytes_delivered == 200);
+    CU_ASSERT(st->queue_dropped == 1 && st->mtu_dropped == 1);
+
+    // Address without node
+    make_sa(&to, 3000);
+    teoNetSimSendto(a, buf, 10, (struct sockaddr *)&to, sizeof(to));
+    CU_ASSERT(teoNetSimRun(sim, 2.0) == 0);
+    CU_ASSERT(sim->stat.unreachable == 1);
+
+    teoNetSimFree(sim);
+}
+
+void test_net_sim_loss() {
+
+    teoNetSim *sim = teoNetSimNew(2);
+    teoNetSimLinkParam lp = { 0 };
+    lp.loss = 0.3;
+    lp.duplicate = 0.1;
+    lp.latency = 0.01;
+    lp.jitter = 0.01;
+    teoNetSimSetDefaultLink(sim, &lp);
+    teoNetSimNode *a = teoNetSimNodeAdd(sim, ADDR, 1000, NULL, NULL);
+    teoNetSimNode *b = teoNetSimNodeAdd(sim, ADDR, 2000, NULL, NULL);
+
+    struct sockaddr_in to;
+    make_sa(&to, 2000);
+    uint32_t i, prev = 0, n;
+    int reordered = 0;
+    for(i = 0; i < 10000; i++) {
+        teoNetSimSendto(a, &i, sizeof(i), (struct sockaddr *)&to, sizeof(to));
+        teoNetSimRun(sim, sim->now + 0.001);
+    }
+    teoNetSimRun(sim, sim->now + 1.0);
+
+    CU_ASSERT(sim->stat.lost > 2700 && sim->stat.lost < 3300);
+    CU_ASSERT(sim->stat.duplicated > 500 && sim->stat.duplicated < 900);
+    CU_ASSERT(sim->stat.delivered ==
+            sim->stat.sent - sim->stat.lost + sim->stat.duplicated);
+    CU_ASSERT(b->rx_num == sim->stat.delivered);
+
+    // Jitter bigger than send interval reorders packets
+    while(teoNetSimRecvfrom(b, &n, sizeof(n), NULL, NULL) == sizeof(n)) {
+        if(n < prev) reordered++;
+        prev = n;
+    }
+    CU_ASSERT(reordered > 0);
+
+    teoNetSimFree(sim);
+}
+
+typedef struct trace {
+    teoNetSimNode *node;
+    int num;
+    double time[256];
+    uint32_t data[256];
+} trace;
+
+/**
+ * Echo node: record packet and send it back with incremented data
+ */
+static void echo_cb(teoNetSimNode *node, void *user_data) {
+
+    trace *t = user_data;
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    uint32_t n;
+    while(teoNetSimRecvfrom(node, &n, sizeof(n), (struct sockaddr *)&from,
+            &from_len) == sizeof(n)) {
+        if(t->num < 256) {
+            t->time[t->num] = node->sim->now;
+            t->data[t->num++] = n;
+        }
+        n++;
+        teoNetSimSendto(node, &n, sizeof(n), (struct sockaddr *)&from,
+                from_len);
+    }
+}
+
+static void run_trace(uint64_t seed, trace *ta, trace *tb) {
+
+    teoNetSim *sim = teoNetSimNew(seed);
+    teoNetSimLinkParam lp = { 0.2, 0.05, 0.1, 0.02, 0.01, 100000, 0, 0 };
+    teoNetSimSetDefaultLink(sim, &lp);
+    memset(ta, 0, sizeof(*ta));
+    memset(tb, 0, sizeof(*tb));
+    ta->node = teoNetSimNodeAdd(sim, ADDR, 1000, echo_cb, ta);
+    tb->node = teoNetSimNodeAdd(sim, ADDR, 2000, echo_cb, tb);
+
+    struct sockaddr_in to;
+    make_sa(&to, 2000);
+    uint32_t i;
+    for(i = 0; i < 16; i++) {
+        uint32_t n = i * 1000;
+        teoNetSimSendto(ta->node, &n, sizeof(n), (struct sockaddr *)&to,
+                sizeof(to));
+    }
+    teoNetSimRun(sim, 5.0);
+    teoNetSimFree(sim);
+}
+
+void test_net_sim_deterministic() {
+
+    trace *t = malloc(sizeof(trace) * 4);
+
+    // Same seed gives the same deliveries
+    run_trace(7, &t[0], &t[1]);
+    run_trace(7, &t[2], &t[3]);
+    CU_ASSERT(t[0].num > 10 && t[1].num > 10);
+    CU_ASSERT(t[0].num == t[2].num && t[1].num == t[3].num);
+    CU_ASSERT(!memcmp(t[0].time, t[2].time, sizeof(double) * t[0].num));
+    CU_ASSERT(!memcmp(t[0].data, t[2].data, sizeof(uint32_t) * t[0].num));
+    CU_ASSERT(!memcmp(t[1].time, t[3].time, sizeof(double) * t[1].num));
+    CU_ASSERT(!memcmp(t[1].data, t[3].data, sizeof(uint32_t) * t[1].num));
+
+    // Other seed gives other deliveries
+    run_trace(8, &t[2], &t[3]);
+    CU_ASSERT(t[0].num != t[2].num ||
+            memcmp(t[0].time, t[2].time, sizeof(double) * t[0].num));
+
+    free(t);
+}
+
+void test_net_sim_transport() {
+
+    ksnetEvMgrClass *ke = calloc(1, sizeof(ksnetEvMgrClass));
+    ke->runEventMgr = 1;
+
+    teoNetSim *sim = teoNetSimNew(3);
+    teoNetSimNode *a = teoNetSimNodeAdd(sim, ADDR, 1000, NULL, NULL);
+    teoNetSimNode *b = teoNetSimNodeAdd(sim, ADDR, 2000, NULL, NULL);
+
+    // Teonet UDP functions use transport shim
+    struct sockaddr_in to, from;
+    socklen_t from_len = sizeof(from);
+    char buf[16];
+    make_sa(&to, 2000);
+    ke->transport = &a->transport;
+    CU_ASSERT(teo_sendto(ke, -1, "hello", 6, 0, (struct sockaddr *)&to,
+            sizeof(to)) == 6);
+    teoNetSimRun(sim, 0.0);
+    ke->transport = &b->transport;
+    CU_ASSERT(teo_recvfrom(ke, -1, buf, sizeof(buf), 0,
+            (struct sockaddr *)&from, &from_len) == 6);
+    CU_ASSERT_STRING_EQUAL(buf, "hello");
+    CU_ASSERT(ntohs(from.sin_port) == 1000);
+    CU_ASSERT(teo_recvfrom(ke, -1, buf, sizeof(buf), 0,
+            (struct sockaddr *)&from, &from_len) == -1);
+
+    teoNetSimFree(sim);
+    free(ke);
+}
+
+int add_suite_net_sim_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Link latency, bandwidth and MTU test", test_net_sim_link)) ||
+        (NULL == CU_add_test(pSuite, "Link loss, duplication and reorder test", test_net_sim_loss)) ||
+        (NULL == CU_add_test(pSuite, "Deterministic deliveries test", test_net_sim_deterministic)) ||
+        (NULL == CU_add_test(pSuite, "Teonet transport shim test", test_net_sim_transport))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * File:   test_net_telemetry.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <CUnit/Basic.h>
+#include "ev_mgr.h"
+#include "net_telemetry.h"
+
+extern CU_pSuite pSuite;
+
+void test_net_telemetry_table() {
+
+    ksnetEvMgrClass *ke = calloc(1, sizeof(ksnetEvMgrClass));
+    teoPeerTelemetryClass *kpt = teoPeerTelemetryInit(ke);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(kpt);
+    CU_ASSERT_PTR_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9000));
+
+    teoPeerTelemetryAdd(kpt, "peer-1", "127.0.0.1", 9001);
+    teoPeerTelemetryAdd(kpt, "peer-2", "127.0.0.1", 9002);
+    teoPeerTelemetry *pt = teoPeerTelemetryFind(kpt, "127.0.0.1", 9001);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pt);
+    CU_ASSERT_PTR_NULL(teoPeerTelemetryFind(kpt, "127.0.0.2", 9001));
+
+    // Record is kept when the peer is added with the same address
+    teoPeerTelemetryAdd(kpt, "peer-1", "127.0.0.1", 9001);
+    CU_ASSERT(teoPeerTelemetryFind(kpt, "127.0.0.1", 9001) == pt);
+
+    // Record is replaced when the peer address is changed
+    teoPeerTelemetryAdd(kpt, "peer-1", "127.0.0.1", 9003);
+    CU_ASSERT_PTR_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9001));
+    CU_ASSERT_PTR_NOT_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9003));
+
+    // Record of other peer with the same address is replaced
+    teoPeerTelemetryAdd(kpt, "peer-3", "127.0.0.1", 9002);
+    size_t len;
+    teoPeerTelemetrySnapshot *ts = teoPeerTelemetryGetSnapshot(kpt, &len);
+    CU_ASSERT(ts->length == 2 && ts->total == 2);
+    CU_ASSERT(len == sizeof(*ts) + 2 * sizeof(teoPeerTelemetryData));
+    CU_ASSERT(strcmp(ts->peer[0].name, "peer-2") &&
+            strcmp(ts->peer[1].name, "peer-2"));
+    free(ts);
+
+    teoPeerTelemetryRemove(kpt, "peer-1");
+    CU_ASSERT_PTR_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9003));
+    CU_ASSERT_PTR_NOT_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9002));
+    teoPeerTelemetryRemoveAll(kpt);
+    CU_ASSERT_PTR_NULL(teoPeerTelemetryFind(kpt, "127.0.0.1", 9002));
+
+    teoPeerTelemetryDestroy(kpt);
+    free(ke);
+}
+
+void test_net_telemetry_counters() {
+
+    ksnetEvMgrClass *ke = calloc(1, sizeof(ksnetEvMgrClass));
+    teoPeerTelemetryClass *kpt = teoPeerTelemetryInit(ke);
+    teoPeerTelemetryAdd(kpt, "peer-1", "127.0.0.1", 9001);
+    teoPeerTelemetry *pt = teoPeerTelemetryFind(kpt, "127.0.0.1", 9001);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pt);
+
+    teoPeerTelemetryIn(pt, 100);
+    teoPeerTelemetryIn(pt, 50);
+    teoPeerTelemetryOut(pt, 10);
+    teoPeerTelemetryDecryptFailed(pt);
+    teoPeerTelemetryIn(NULL, 100); // Unknown peer
+
+    // First RTT sample sets RTT and half of it variance, next are smoothed
+    teoPeerTelemetryRtt(pt, 8.0);
+    teoPeerTelemetryRtt(pt, -1.0);
+    teoPeerTelemetrySnapshot *ts = teoPeerTelemetryGetSnapshot(kpt, NULL);
+    CU_ASSERT(ts->peer[0].rtt == 8000 && ts->peer[0].rtt_var == 4000);
+    free(ts);
+    teoPeerTelemetryRtt(pt, 16.0);
+
+    ts = teoPeerTelemetryGetSnapshot(kpt, NULL);
+    CU_ASSERT(ts->version == TEO_TELEMETRY_VERSION);
+    CU_ASSERT_STRING_EQUAL(ts->peer[0].name, "peer-1");
+    CU_ASSERT(ts->peer[0].packets_in == 2 && ts->peer[0].bytes_in == 150);
+    CU_ASSERT(ts->peer[0].packets_out == 1 && ts->peer[0].bytes_out == 10);
+    CU_ASSERT(ts->peer[0].decrypt_failures == 1);
+    CU_ASSERT(ts->peer[0].rtt == 9000 && ts->peer[0].rtt_var == 5000);
+    free(ts);
+
+    teoPeerTelemetryDestroy(kpt);
+    free(ke);
+}
+
+void test_net_telemetry_snapshot() {
+
+    // Snapshot layout is a part of CMD_PEER_TELEMETRY answer
+    CU_ASSERT(sizeof(teoPeerTelemetrySnapshot) == 24);
+    CU_ASSERT(offsetof(teoPeerTelemetrySnapshot, time) == 8);
+    CU_ASSERT(offsetof(teoPeerTelemetrySnapshot, offset) == 16);
+    CU_ASSERT(offsetof(teoPeerTelemetrySnapshot, total) == 20);
+    CU_ASSERT(sizeof(teoPeerTelemetryData) == 96);
+    CU_ASSERT(offsetof(teoPeerTelemetryData, packets_in) ==
+            TEO_TELEMETRY_NAME_SIZE);
+    CU_ASSERT(offsetof(teoPeerTelemetryData, decrypt_failures) == 80);
+    CU_ASSERT(offsetof(teoPeerTelemetryData, rtt_var) == 92);
+    CU_ASSERT(sizeof(teoPeerTelemetryRequest) == 8);
+
+    // Page answer fits into L0 packet
+    CU_ASSERT(sizeof(teoPeerTelemetrySnapshot) + TEO_TELEMETRY_PAGE_MAX *
+            sizeof(teoPeerTelemetryData) <= 32319);
+
+    size_t len;
+    teoPeerTelemetrySnapshot *ts = teoPeerTelemetryGetSnapshot(NULL, &len);
+    CU_ASSERT(len == sizeof(*ts) && !ts->length && !ts->total);
+    free(ts);
+}
+
+void test_net_telemetry_page() {
+
+    ksnetEvMgrClass *ke = calloc(1, sizeof(ksnetEvMgrClass));
+    teoPeerTelemetryClass *kpt = teoPeerTelemetryInit(ke);
+
+    const int num = TEO_TELEMETRY_PAGE_MAX * 2 + 10;
+    char name[TEO_TELEMETRY_NAME_SIZE];
+    int i;
+    for(i = 0; i < num; i++) {
+        snprintf(name, sizeof(name), "peer-%d", i);
+        teoPeerTelemetryAdd(kpt, name, "127.0.0.1", 10000 + i);
+        teoPeerTelemetryIn(teoPeerTelemetryFind(kpt, "127.0.0.1", 10000 + i),
+                i);
+    }
+
+    // Read all pages: every peer is returned once
+    char *seen = calloc(num, 1);
+    size_t offset = 0, len, pages = 0;
+    for(;;) {
+        teoPeerTelemetrySnapshot *ts = teoPeerTelemetryGetSnapshotPage(kpt,
+                offset, TEO_TELEMETRY_PAGE_MAX, &len);
+        CU_ASSERT(ts->offset == offset && ts->total == (uint32_t)num);
+        CU_ASSERT(ts->length <= TEO_TELEMETRY_PAGE_MAX);
+        CU_ASSERT(len == sizeof(*ts) +
+                ts->length * sizeof(teoPeerTelemetryData));
+        uint32_t j;
+        for(j = 0; j < ts->length; j++) {
+            int n = atoi(ts->peer[j].name + 5);
+            CU_ASSERT(ts->peer[j].bytes_in == (uint64_t)n);
+            seen[n]++;
+        }
+        pages++;
+        offset += ts->length;
+        int last = offset >= ts->total;
+        free(ts);
+        if(last) break;
+    }
+    CU_ASSERT(pages == 3);
+    for(i = 0; i < num; i++) CU_ASSERT(seen[i] == 1);
+    free(seen);
+
+    // Offset after the table end gives empty page
+    teoPeerTelemetrySnapshot *ts = teoPeerTelemetryGetSnapshotPage(kpt,
+            num + 5, 10, &len);
+    CU_ASSERT(ts->length == 0 && ts->offset == (uint32_t)num);
+    CU_ASSERT(len == sizeof(*ts));
+    free(ts);
+
+    teoPeerTelemetryDestroy(kpt);
+    free(ke);
+}
+
+int add_suite_net_telemetry_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Peer telemetry table test", test_net_telemetry_table)) ||
+        (NULL == CU_add_test(pSuite, "Peer telemetry counters and RTT test", test_net_telemetry_counters)) ||
+        (NULL == CU_add_test(pSuite, "Telemetry snapshot layout test", test_net_telemetry_snapshot)) ||
+        (NULL == CU_add_test(pSuite, "Telemetry snapshot paging test", test_net_telemetry_page))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
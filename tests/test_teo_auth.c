@@ -0,0 +1,352 @@
+/*
+ * File:   test_teo_auth.c
+ * Author: max <mpano91@gmail.com>
+ *
+ * Created on Oct 19, 2026
+ *
+ * Teoweb authentication module tests with local stand-in authentication
+ * server
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <CUnit/Basic.h>
+
+#include "modules/teo_auth/teo_auth.h"
+
+extern CU_pSuite pSuite;
+
+/**
+ * Stand-in authentication server
+ */
+typedef struct auth_server {
+    int fd;                 ///< Listen socket
+    int port;               ///< Listen port
+    int delay_ms;           ///< Answer delay
+    int stop;               ///< Stop server flag
+    pthread_t tid;          ///< Accept thread
+    pthread_mutex_t mutex;
+    int requests;           ///< Requests received
+    int connections;        ///< Connections accepted
+    int conn_fd[64];        ///< Accepted connections sockets
+} auth_server;
+
+/**
+ * Command answer
+ */
+typedef struct auth_answer {
+    int count;
+    char result[256];
+} auth_answer;
+
+static auth_server srv = { .fd = -1, .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static void *server_conn_thread(void *fd_p) {
+
+    int fd = (intptr_t)fd_p;
+    char buf[4096], body[128];
+    size_t len = 0;
+    ssize_t rc;
+
+    // Answer keep-alive requests until client closes connection
+    while((rc = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0) {
+        len += rc;
+        buf[len] = 0;
+        char *end = strstr(buf, "\r\n\r\n");
+        if(end == NULL) continue;
+        char *cl = strcasestr(buf, "Content-Length:");
+        size_t need = end + 4 - buf + (cl ? atoi(cl + 15) : 0);
+        if(len < need) continue;
+
+        pthread_mutex_lock(&srv.mutex);
+        int n = ++srv.requests;
+        pthread_mutex_unlock(&srv.mutex);
+        if(srv.delay_ms) usleep(srv.delay_ms * 1000);
+
+        int body_len = snprintf(body, sizeof(body), "{\"token\":\"t%d\"}", n);
+        int hdr_len = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: %d\r\n\r\n%s", body_len, body);
+        if(write(fd, buf, hdr_len) != hdr_len) break;
+
+        len -= need;
+        memmove(buf, buf + need, len);
+    }
+    close(fd);
+
+    return NULL;
+}
+
+static void *server_thread(void *arg) {
+
+    struct pollfd pfd = { srv.fd, POLLIN, 0 };
+    while(!srv.stop) {
+        if(poll(&pfd, 1, 50) <= 0) continue;
+        int fd = accept(srv.fd, NULL, NULL);
+        if(fd < 0) continue;
+        pthread_mutex_lock(&srv.mutex);
+        if(srv.connections < 64) srv.conn_fd[srv.connections] = fd;
+        srv.connections++;
+        pthread_mutex_unlock(&srv.mutex);
+        pthread_t tid;
+        pthread_create(&tid, NULL, server_conn_thread, (void*)(intptr_t)fd);
+        pthread_detach(tid);
+    }
+
+    return NULL;
+}
+
+static void server_start(int delay_ms) {
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    srv.fd = socket(AF_INET, SOCK_STREAM, 0);
+    CU_ASSERT_FATAL(srv.fd >= 0);
+    CU_ASSERT_FATAL(!bind(srv.fd, (struct sockaddr*)&addr, sizeof(addr)));
+    CU_ASSERT_FATAL(!listen(srv.fd, 64));
+    getsockname(srv.fd, (struct sockaddr*)&addr, &addr_len);
+    srv.port = ntohs(addr.sin_port);
+    srv.delay_ms = delay_ms;
+    srv.stop = 0;
+    srv.requests = 0;
+    srv.connections = 0;
+    pthread_create(&srv.tid, NULL, server_thread, NULL);
+}
+
+static void server_stop() {
+
+    int i;
+    srv.stop = 1;
+    pthread_join(srv.tid, NULL);
+    close(srv.fd);
+
+    // Drop keep-alive connections
+    pthread_mutex_lock(&srv.mutex);
+    for(i = 0; i < srv.connections && i < 64; i++)
+        shutdown(srv.conn_fd[i], SHUT_RDWR);
+    pthread_mutex_unlock(&srv.mutex);
+    srv.fd = -1;
+}
+
+static teoAuthClass *auth_new(struct ev_loop *loop, int transfers,
+        double cache_ttl, teoMetricRegistry *mr) {
+
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/api/auth/", srv.port);
+    return teoAuthNew(loop, url, transfers, cache_ttl, mr);
+}
+
+static void answer_cb(void *nc_p, char *err, char *result) {
+
+    auth_answer *a = nc_p;
+    a->count++;
+    snprintf(a->result, sizeof(a->result), "%s", result);
+}
+
+static void wake_cb(struct ev_loop *loop, ev_timer *w, int revents) { }
+
+/**
+ * Run event loop until number of answers received or timeout
+ */
+static void run_until(struct ev_loop *loop, auth_answer *a, int num,
+        int expected) {
+
+    ev_timer w;
+    ev_timer_init(&w, wake_cb, 0.01, 0.01);
+    ev_timer_start(loop, &w);
+
+    double end = ev_time() + 5.0;
+    for(;;) {
+        int i, count = 0;
+        for(i = 0; i < num; i++) count += a[i].count;
+        if(count >= expected || ev_time() > end) break;
+        ev_run(loop, EVRUN_ONCE);
+    }
+    ev_timer_stop(loop, &w);
+}
+
+void test_teo_auth_request() {
+
+    struct ev_loop *loop = ev_loop_new(0);
+    auth_answer a[2];
+    memset(a, 0, sizeof(a));
+
+    server_start(0);
+    teoAuthClass *ta = auth_new(loop, 0, 0, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ta);
+
+    // Wrong command url
+    CU_ASSERT(!teoAuthProcessCommand(ta, "POST", "wrong", "{}", "", &a[0],
+            answer_cb));
+
+    // Answer is returned in the event loop
+    CU_ASSERT(teoAuthProcessCommand(ta, "POST", "register", "{\"a\":1}", "",
+            &a[0], answer_cb));
+    CU_ASSERT(a[0].count == 0);
+    run_until(loop, a, 1, 1);
+    CU_ASSERT(a[0].count == 1);
+    CU_ASSERT(strstr(a[0].result, "\"status\": 200") != NULL);
+    CU_ASSERT(strstr(a[0].result, "\"token\":\"t1\"") != NULL);
+
+    // Not cached commands are not coalesced
+    teoAuthProcessCommand(ta, "POST", "register", "{\"a\":1}", "", &a[0],
+            answer_cb);
+    teoAuthProcessCommand(ta, "POST", "register", "{\"a\":1}", "", &a[1],
+            answer_cb);
+    run_until(loop, a, 2, 3);
+    CU_ASSERT(a[0].count == 2 && a[1].count == 1);
+    CU_ASSERT(srv.requests == 3);
+
+    teoAuthDestroy(ta);
+    server_stop();
+    ev_loop_destroy(loop);
+}
+
+void test_teo_auth_cache() {
+
+    struct ev_loop *loop = ev_loop_new(0);
+    teoMetricRegistry *mr = teoMetricRegistryNew();
+    auth_answer a[6];
+    int i;
+    memset(a, 0, sizeof(a));
+
+    server_start(100);
+    teoAuthClass *ta = auth_new(loop, 0, 60.0, mr);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ta);
+
+    // Identical token commands in flight share one request
+    for(i = 0; i < 5; i++) {
+        teoAuthProcessCommand(ta, "POST", "me", "", "Authorization: Bearer x",
+                &a[i], answer_cb);
+    }
+    run_until(loop, a, 5, 5);
+    CU_ASSERT(srv.requests == 1);
+    for(i = 0; i < 5; i++) {
+        CU_ASSERT(a[i].count == 1);
+        CU_ASSERT(!strcmp(a[i].result, a[0].result));
+    }
+    CU_ASSERT(teoMetricGet(mr, ta->m.coalesced) == 4);
+
+    // Repeated command is answered from cache without request
+    teoAuthProcessCommand(ta, "POST", "me", "", "Authorization: Bearer x",
+            &a[5], answer_cb);
+    CU_ASSERT(a[5].count == 1);
+    CU_ASSERT(!strcmp(a[5].result, a[0].result));
+    CU_ASSERT(teoMetricGet(mr, ta->m.cache_hits) == 1);
+
+    // Other token is verified by server
+    teoAuthProcessCommand(ta, "POST", "me", "", "Authorization: Bearer y",
+            &a[5], answer_cb);
+    run_until(loop, a + 5, 1, 2);
+    CU_ASSERT(a[5].count == 2);
+    CU_ASSERT(srv.requests == 2);
+    CU_ASSERT(teoMetricGet(mr, ta->m.requests) == 2);
+
+    teoAuthDestroy(ta);
+    server_stop();
+    teoMetricRegistryFree(mr);
+    ev_loop_destroy(loop);
+}
+
+void test_teo_auth_concurrent() {
+
+    struct ev_loop *loop = ev_loop_new(0);
+    teoMetricRegistry *mr = teoMetricRegistryNew();
+    auth_answer a[8];
+    char data[32];
+    int i;
+    memset(a, 0, sizeof(a));
+
+    server_start(200);
+    teoAuthClass *ta = auth_new(loop, 8, 0, mr);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ta);
+
+    // Requests are executed concurrently
+    double t = ev_time();
+    for(i = 0; i < 8; i++) {
+        snprintf(data, sizeof(data), "{\"n\":%d}", i);
+        teoAuthProcessCommand(ta, "POST", "login", data, "", &a[i], answer_cb);
+    }
+    run_until(loop, a, 8, 8);
+    t = ev_time() - t;
+    CU_ASSERT(srv.requests == 8);
+    CU_ASSERT(t < 8 * 0.2 / 2);
+    int connections = srv.connections;
+    CU_ASSERT(connections <= 8);
+
+    // Connections are reused
+    for(i = 0; i < 8; i++) {
+        snprintf(data, sizeof(data), "{\"n\":%d}", i + 8);
+        teoAuthProcessCommand(ta, "POST", "login", data, "", &a[i], answer_cb);
+    }
+    run_until(loop, a, 8, 16);
+    CU_ASSERT(srv.requests == 16);
+    CU_ASSERT(srv.connections == connections);
+    CU_ASSERT(teoMetricGet(mr, ta->m.requests) == 16);
+    CU_ASSERT(teoMetricGet(mr, ta->m.queue_depth) == 0);
+
+    uint64_t sum;
+    CU_ASSERT(teoMetricHistogramGet(mr, ta->m.latency, NULL, &sum) == 16);
+    CU_ASSERT(sum >= 16 * 200000000ULL);
+
+    teoAuthDestroy(ta);
+    server_stop();
+    teoMetricRegistryFree(mr);
+    ev_loop_destroy(loop);
+}
+
+void test_teo_auth_cancel_error() {
+
+    struct ev_loop *loop = ev_loop_new(0);
+    teoMetricRegistry *mr = teoMetricRegistryNew();
+    auth_answer a[2];
+    memset(a, 0, sizeof(a));
+
+    server_start(50);
+    teoAuthClass *ta = auth_new(loop, 0, 0, mr);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ta);
+
+    // Canceled command is not answered
+    teoAuthProcessCommand(ta, "POST", "refresh", "{}", "", &a[0], answer_cb);
+    teoAuthProcessCommand(ta, "POST", "refresh", "{}", "", &a[1], answer_cb);
+    teoAuthCancel(ta, &a[0]);
+    run_until(loop, a, 2, 2);
+    CU_ASSERT(a[0].count == 0 && a[1].count == 1);
+    CU_ASSERT(ta->pending == NULL);
+
+    // Closed server: the command is answered with error
+    server_stop();
+    teoAuthProcessCommand(ta, "POST", "refresh", "{}", "", &a[1], answer_cb);
+    run_until(loop, a + 1, 1, 2);
+    CU_ASSERT(a[1].count == 2);
+    CU_ASSERT(strstr(a[1].result, "\"status\": 0") != NULL);
+    CU_ASSERT(teoMetricGet(mr, ta->m.errors) == 1);
+
+    teoAuthDestroy(ta);
+    teoMetricRegistryFree(mr);
+    ev_loop_destroy(loop);
+}
+
+int add_suite_teo_auth_tests(void) {
+    if ((NULL == CU_add_test(pSuite, "Authentication request test", test_teo_auth_request)) ||
+        (NULL == CU_add_test(pSuite, "Authentication cache and coalescing test", test_teo_auth_cache)) ||
+        (NULL == CU_add_test(pSuite, "Concurrent authentication requests test", test_teo_auth_concurrent)) ||
+        (NULL == CU_add_test(pSuite, "Authentication cancel and error test", test_teo_auth_cancel_error))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    return 0;
+}
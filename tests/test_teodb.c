@@ -10,6 +10,9 @@
  * * Set default namespace: test_3_2()
  * * Set and get data: test_3_3()
  * * Set and get data without default namespace: test_3_4()
+ * * Get list of keys without default namespace: test_3_5()
+ * * Namespaces key files cache: test_3_6()
+ * * Key files block I/O parameters: test_3_7()
  * 
  * cUnit test suite code: \include test_teodb.c
  * 
@@ -18,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CUnit/Basic.h>
 
 #include "ev_mgr.h"
@@ -284,6 +288,118 @@ void test_3_5() {
     CU_PASS("Destroy ksnPblKfClass done");
 }
 
+//! Namespaces key files cache
+void test_3_6() {
+    
+    // Emulate ksnCoreClass
+    kc_emul();
+    
+    // Initialize module with one cached namespace key file
+    ksnTDBClass *kf = ksnTDBinit(ke);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(kf);
+    ksnTDBcacheSet(kf, 1, 0);
+    ksnTDBnamespaceRemove(kf, "test");
+    ksnTDBnamespaceRemove(kf, "test_1");
+    ksnTDBnamespaceRemove(kf, "test_2");
+    
+    // Set default namespace
+    ksnTDBnamespaceSet(kf, "test");
+    pblKeyFile_t *k = kf->k;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(k);
+    
+    // Namespaced operations don't change default namespace
+    CU_ASSERT(ksnTDBsetNsStr(kf, "test_1", "key", "data - 1", 9) == 0);
+    CU_ASSERT(ksnTDBsetNsStr(kf, "test_2", "key", "data - 2", 9) == 0);
+    CU_ASSERT_STRING_EQUAL(kf->defNameSpace, "test");
+    CU_ASSERT(kf->k == k);
+    
+    // Default namespace is not evicted
+    CU_ASSERT(kf->cache_num == 2);
+    CU_ASSERT(kf->last == kf->def);
+    
+    // Read from evicted and cached namespace
+    size_t data_len;
+    char *data = ksnTDBgetNsStr(kf, "test_1", "key", &data_len);
+    CU_ASSERT_STRING_EQUAL(data, "data - 1");
+    free(data);
+    data = ksnTDBgetNsStr(kf, "test_2", "key", &data_len);
+    CU_ASSERT_STRING_EQUAL(data, "data - 2");
+    free(data);
+    
+    // Default namespace data is not visible in other namespace
+    CU_ASSERT(ksnTDBsetStr(kf, "key_def", "data", 5) == 0);
+    data = ksnTDBgetNsStr(kf, "test_1", "key_def", &data_len);
+    CU_ASSERT_PTR_NULL(data);
+    data = ksnTDBgetNsStr(kf, "test", "key_def", &data_len);
+    CU_ASSERT_STRING_EQUAL(data, "data");
+    free(data);
+    CU_ASSERT(ksnTDBflush(kf) == 0);
+    
+    // Remove namespaces
+    ksnTDBnamespaceRemove(kf, "test");
+    ksnTDBnamespaceRemove(kf, "test_1");
+    ksnTDBnamespaceRemove(kf, "test_2");
+    CU_ASSERT_PTR_NULL(kf->k);
+    CU_ASSERT(kf->cache_num == 0);
+    
+    // Destroy module
+    ksnTDBdestroy(kf);
+    CU_PASS("Destroy ksnPblKfClass done");
+}
+
+//! Key files block I/O parameters
+void test_3_7() {
+    
+    // Emulate ksnCoreClass
+    kc_emul();
+    
+    // Initialize module with small shared block cache, read ahead and sync
+    // on each flush
+    ksnTDBClass *kf = ksnTDBinit(ke);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(kf);
+    ksnTDBioSet(kf, 16, 4, PBL_KF_SYNC_FLUSH, 0);
+    ksnTDBnamespaceRemove(kf, "test");
+    ksnTDBnamespaceSet(kf, "test");
+    
+    // Write more blocks than the cache holds
+    int i, num = 2000;
+    char key[32], data[32];
+    for(i = 0; i < num; i++) {
+        snprintf(key, sizeof(key), "key_%05d", i);
+        snprintf(data, sizeof(data), "data - %d", i);
+        CU_ASSERT(ksnTDBsetStr(kf, key, data, strlen(data) + 1) == 0);
+    }
+    CU_ASSERT(ksnTDBflush(kf) == 0);
+    
+    // Read keys back
+    size_t data_len;
+    for(i = 0; i < num; i += 97) {
+        snprintf(key, sizeof(key), "key_%05d", i);
+        snprintf(data, sizeof(data), "data - %d", i);
+        char *d = ksnTDBgetStr(kf, key, &data_len);
+        CU_ASSERT_PTR_NOT_NULL(d);
+        if(d != NULL) CU_ASSERT_STRING_EQUAL(d, data);
+        free(d);
+    }
+    
+    // Scan all keys with read ahead
+    ksnet_stringArr argv = ksnet_stringArrCreate();
+    CU_ASSERT(ksnTDBkeyList(kf, NULL, &argv) == num);
+    ksnet_stringArrFree(&argv);
+    
+    // Wrong sync mode switches sync off
+    ksnTDBioSet(kf, 0, 0, 10, 0);
+    CU_ASSERT(ksnTDBsetStr(kf, "key", "data", 5) == 0);
+    CU_ASSERT(ksnTDBflush(kf) == 0);
+    
+    // Remove namespace
+    ksnTDBnamespaceRemove(kf, "test");
+    
+    // Destroy module
+    ksnTDBdestroy(kf);
+    CU_PASS("Destroy ksnPblKfClass done");
+}
+
 //! Test template
 void test_3_template() {
     
@@ -312,7 +428,9 @@ int add_suite_3_tests(void) {
         (NULL == CU_add_test(pSuite, "Set default namespace", test_3_2)) ||
         (NULL == CU_add_test(pSuite, "Set and get data with default namespace", test_3_3)) ||
         (NULL == CU_add_test(pSuite, "Set and get data without default namespace", test_3_4)) ||
-        (NULL == CU_add_test(pSuite, "Get list of keys without default namespace", test_3_5))) {
+        (NULL == CU_add_test(pSuite, "Get list of keys without default namespace", test_3_5)) ||
+        (NULL == CU_add_test(pSuite, "Namespaces key files cache", test_3_6)) ||
+        (NULL == CU_add_test(pSuite, "Key files block I/O parameters", test_3_7))) {
         
         CU_cleanup_registry();
         return CU_get_error();
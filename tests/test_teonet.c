@@ -23,6 +23,13 @@ int add_suite_4_tests(void);
 int add_suite_5_tests(void);
 int add_suite_6_tests(void);
 int add_suite_filter_tests(void);
+int add_suite_metric_tests(void);
+int add_suite_hashmap_tests(void);
+int add_suite_teo_auth_tests(void);
+int add_suite_l0_auth_tests(void);
+int add_suite_net_sim_tests(void);
+int add_suite_net_telemetry_tests(void);
+int add_suite_net_arp_tests(void);
 
 // Global variables
 CU_pSuite pSuite = NULL;
@@ -109,6 +116,58 @@ int main() {
     }
     add_suite_filter_tests();
 
+    // Add a suite to the registry
+    pSuite = CU_add_suite("Metrics registry module functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_metric_tests();
+
+    // Add a suite to the registry
+    pSuite = CU_add_suite("Hash map functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_hashmap_tests();
+
+    // Add a suite to the registry
+    pSuite = CU_add_suite("Teoweb authentication module functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_teo_auth_tests();
+
+    pSuite = CU_add_suite("L0 server login verification functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_l0_auth_tests();
+
+    pSuite = CU_add_suite("Simulated network functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_net_sim_tests();
+
+    pSuite = CU_add_suite("Peer telemetry functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_net_telemetry_tests();
+
+    pSuite = CU_add_suite("Peers table functions", init_suite, clean_suite);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    add_suite_net_arp_tests();
+
     /* Run all tests using the CUnit Basic interface */
     CU_basic_set_mode(CU_BRM_VERBOSE);
     //CU_list_tests_to_file();